@@ -572,6 +572,20 @@ ssize_t ArmArchVmAspace::UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel,
 
         pte = page_table[index];
 
+        // Unmapping part of a block requires splitting it first, otherwise the
+        // rest of the block would go away with it.
+        if (index_shift > page_size_shift &&
+                (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK &&
+                chunk_size != block_size) {
+            zx_status_t s = SplitLargePage(vaddr, index_shift, page_size_shift, index, page_table);
+            // If split fails, the whole block is unmapped below and a subsequent
+            // page fault brings the rest of it back in. The old translation must
+            // not be left behind, as the caller may be about to free its pages.
+            if (likely(s == ZX_OK)) {
+                pte = page_table[index];
+            }
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
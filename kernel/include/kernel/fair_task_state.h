@@ -130,4 +130,7 @@ private:
     // Takes the value of FairScheduler::generation_count_ + 1 at the time this
     // node is added to the run queue.
     uint64_t generation_{0};
+
+    // The time the thread was last unblocked, or zero once it has run since.
+    SchedTime wake_time_{0};
 };
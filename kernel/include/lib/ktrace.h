@@ -49,10 +49,11 @@ static inline uint64_t ktrace_timestamp() { return current_ticks(); }
 #define KTRACE_STRING_REF_CAT(a, b) a##b
 #define KTRACE_STRING_REF(string) KTRACE_STRING_REF_CAT(string, _stringref)
 
-// Allocates a new trace record in the trace buffer. Returns a pointer to the
-// start of the record or nullptr if tracing is disabled or the end of the
-// buffer is reached.
-void* ktrace_open(uint32_t tag, uint64_t ts = ktrace_timestamp());
+// Writes a trace record to the current cpu's trace buffer: the header for |tag|
+// followed by the |len| bytes at |payload|, which must fill the rest of the
+// record. Returns false if tracing is disabled or the buffer is full.
+bool ktrace_write(uint32_t tag, const void* payload, size_t len,
+                  uint64_t ts = ktrace_timestamp());
 
 // Emits a tiny trace record.
 void ktrace_tiny(uint32_t tag, uint32_t arg);
@@ -66,12 +67,8 @@ inline void ktrace(TraceEnabled<enabled>, TraceContext context, uint32_t tag,
     if constexpr (enabled) {
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
-        if (uint32_t* data = static_cast<uint32_t*>(ktrace_open(effective_tag, explicit_ts))) {
-            data[0] = a;
-            data[1] = b;
-            data[2] = c;
-            data[3] = d;
-        }
+        const uint32_t args[] = {a, b, c, d};
+        ktrace_write(effective_tag, args, sizeof(args), explicit_ts);
     } else {
         (void)context;
         (void)tag;
@@ -106,7 +103,7 @@ inline void ktrace_probe(TraceEnabled<enabled>, TraceContext context,
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
 
-        ktrace_open(effective_tag);
+        ktrace_write(effective_tag, nullptr, 0);
     } else {
         (void)context;
         (void)string_ref;
@@ -121,12 +118,8 @@ inline void ktrace_probe(TraceEnabled<enabled>, TraceContext context,
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
 
-        void* const payload = ktrace_open(effective_tag);
-        uint32_t* const args = static_cast<uint32_t*>(payload);
-        if (args) {
-            args[0] = a;
-            args[1] = b;
-        }
+        const uint32_t args[] = {a, b};
+        ktrace_write(effective_tag, args, sizeof(args));
     } else {
         (void)context;
         (void)string_ref;
@@ -143,11 +136,8 @@ inline void ktrace_probe(TraceEnabled<enabled>, TraceContext context,
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
 
-        void* const payload = ktrace_open(effective_tag);
-        uint64_t* const args = static_cast<uint64_t*>(payload);
-        if (args) {
-            args[0] = a;
-        }
+        const uint64_t args[] = {a};
+        ktrace_write(effective_tag, args, sizeof(args));
     } else {
         (void)context;
         (void)string_ref;
@@ -163,12 +153,8 @@ inline void ktrace_probe(TraceEnabled<enabled>, TraceContext context,
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
 
-        void* const payload = ktrace_open(effective_tag);
-        uint64_t* const args = static_cast<uint64_t*>(payload);
-        if (args) {
-            args[0] = a;
-            args[1] = b;
-        }
+        const uint64_t args[] = {a, b};
+        ktrace_write(effective_tag, args, sizeof(args));
     } else {
         (void)context;
         (void)string_ref;
@@ -185,7 +171,7 @@ inline void ktrace_begin_duration(TraceEnabled<enabled>, TraceContext context,
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
 
-        ktrace_open(effective_tag);
+        ktrace_write(effective_tag, nullptr, 0);
     } else {
         (void)context;
         (void)group;
@@ -201,7 +187,7 @@ inline void ktrace_end_duration(TraceEnabled<enabled>, TraceContext context,
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
 
-        ktrace_open(effective_tag);
+        ktrace_write(effective_tag, nullptr, 0);
     } else {
         (void)context;
         (void)group;
@@ -218,12 +204,8 @@ inline void ktrace_begin_duration(TraceEnabled<enabled>, TraceContext context,
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
 
-        void* const payload = ktrace_open(effective_tag);
-        uint64_t* const args = static_cast<uint64_t*>(payload);
-        if (args) {
-            args[0] = a;
-            args[1] = b;
-        }
+        const uint64_t args[] = {a, b};
+        ktrace_write(effective_tag, args, sizeof(args));
     } else {
         (void)context;
         (void)group;
@@ -242,12 +224,8 @@ inline void ktrace_end_duration(TraceEnabled<enabled>, TraceContext context,
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
 
-        void* const payload = ktrace_open(effective_tag);
-        uint64_t* const args = static_cast<uint64_t*>(payload);
-        if (args) {
-            args[0] = a;
-            args[1] = b;
-        }
+        const uint64_t args[] = {a, b};
+        ktrace_write(effective_tag, args, sizeof(args));
     } else {
         (void)context;
         (void)group;
@@ -266,11 +244,8 @@ inline void ktrace_flow_begin(TraceEnabled<enabled>, TraceContext context,
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
 
-        void* const payload = ktrace_open(effective_tag);
-        uint64_t* const args = static_cast<uint64_t*>(payload);
-        if (args) {
-            args[0] = flow_id;
-        }
+        const uint64_t args[] = {flow_id};
+        ktrace_write(effective_tag, args, sizeof(args));
     } else {
         (void)context;
         (void)group;
@@ -288,11 +263,8 @@ inline void ktrace_flow_end(TraceEnabled<enabled>, TraceContext context,
         const uint32_t effective_tag = KTRACE_TAG_FLAGS(
             tag, context == TraceContext::Thread ? 0 : KTRACE_FLAGS_CPU);
 
-        void* const payload = ktrace_open(effective_tag);
-        uint64_t* const args = static_cast<uint64_t*>(payload);
-        if (args) {
-            args[0] = flow_id;
-        }
+        const uint64_t args[] = {flow_id};
+        ktrace_write(effective_tag, args, sizeof(args));
     } else {
         (void)context;
         (void)group;
@@ -307,7 +279,13 @@ static inline void ktrace_name(uint32_t tag, uint32_t id, uint32_t arg, const ch
     ktrace_name_etc(tag, id, arg, name, false);
 }
 
+// Copies |len| bytes of the trace, starting |off| bytes in, to |ptr|. If |ptr|
+// is null, returns the size of the trace instead.
 ssize_t ktrace_read_user(void* ptr, uint32_t off, size_t len);
+
+// Copies whole records which have not yet been streamed to |ptr|, up to |len|
+// bytes, and frees the space they used for new records.
+ssize_t ktrace_read_stream_user(void* ptr, size_t len);
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr);
 
 #define KTRACE_DEFAULT_BUFSIZE 32 // MB
@@ -17,6 +17,7 @@
 #include <kernel/thread.h>
 #include <kernel/thread_lock.h>
 #include <ktl/move.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <list.h>
 #include <platform.h>
@@ -62,6 +63,9 @@ using ffl::Round;
 #define SCHED_LTRACEF(str, args...) LTRACEF("[%u] " str, arch_curr_cpu_num(), ##args)
 #define SCHED_TRACEF(str, args...) TRACEF("[%u] " str, arch_curr_cpu_num(), ##args)
 
+// Time from a thread being unblocked until it starts running.
+KCOUNTER_HISTOGRAM(wakeup_latency, "sched.wakeup_latency_ns")
+
 namespace {
 
 // Conversion table entry. Scales the integer argument to a fixed-point weight
@@ -425,6 +429,12 @@ void FairScheduler::RescheduleCommon(SchedTime now) {
         // thread was enqueued. Emitting in this scope ensures that thread just
         // came from the run queue (and is not the idle thread).
         LOCAL_KTRACE_FLOW_END("sched_latency", FlowIdFromThreadGeneration(next_thread));
+
+        if (next_state->wake_time_ != SchedTime{0}) {
+            const SchedDuration wakeup_latency_ns = now - next_state->wake_time_;
+            kcounter_histogram_add(wakeup_latency, wakeup_latency_ns.raw_value());
+            next_state->wake_time_ = SchedTime{0};
+        }
     }
 
     if (next_thread != current_thread) {
@@ -666,6 +676,7 @@ bool FairScheduler::Unblock(thread_t* thread) {
     FairScheduler* const target = Get(target_cpu);
 
     thread->state = THREAD_READY;
+    thread->fair_task_state.wake_time_ = now;
     target->Insert(now, thread);
 
     if (target_cpu == arch_curr_cpu_num()) {
@@ -696,6 +707,7 @@ bool FairScheduler::Unblock(list_node* list) {
         FairScheduler* const target = Get(target_cpu);
 
         thread->state = THREAD_READY;
+        thread->fair_task_state.wake_time_ = now;
         target->Insert(now, thread);
 
         cpus_to_reschedule_mask |= cpu_num_to_mask(target_cpu);
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <inttypes.h>
+#include <stddef.h>
 
 // This file describes how the kernel exposes its internal counters to userland.
 // This is a PRIVATE UNSTABLE ABI that may change at any time!  The layouts used
@@ -25,8 +26,15 @@ enum class Type : uint64_t {
     kSum = 1,
     kMin = 2,
     kMax = 3,
+    kHistogram = 4,
 };
 
+// A histogram is kHistogramBuckets kHistogram counters named
+// "<histogram name>.00" through "<histogram name>.NN", which are adjacent in
+// the descriptor table. Bucket 0 counts values of 0, bucket n counts values in
+// [2^(n-1), 2^n), and the last bucket also counts every larger value.
+static constexpr size_t kHistogramBuckets = 32;
+
 struct Descriptor {
     char name[56];
     Type type;
@@ -33,6 +33,13 @@
 // By default with KCOUNTER, the `kcounter` presentation will calculate a
 // sum() across cores rather than summing.
 //
+// Latency histograms:
+//      KCOUNTER_HISTOGRAM(histogram_name, "<histogram name>");
+//      kcounter_histogram_add(histogram_name, elapsed_ns);
+//
+// A histogram has counters::kHistogramBuckets log2 buckets, each of which is
+// an ordinary per-cpu counter, so adding a value is as cheap as kcounter_add.
+//
 // Naming the counters
 // The naming convention is "subsystem.thing_or_action"
 // for example "dispatcher.destroy"
@@ -140,6 +147,25 @@ private:
     const counters::Descriptor* desc_;
 };
 
+class Histogram {
+public:
+    explicit constexpr Histogram(const counters::Descriptor* first_bucket) :
+        first_bucket_(first_bucket) { }
+
+    // Counts |value| in bucket 0 if it is zero, otherwise in the bucket of its
+    // highest set bit, see counter-vmo-abi.h.
+    void Add(uint64_t value) const {
+        size_t bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+        if (bucket >= counters::kHistogramBuckets) {
+            bucket = counters::kHistogramBuckets - 1;
+        }
+        Counter(first_bucket_ + bucket).Add(1);
+    }
+
+private:
+    const counters::Descriptor* first_bucket_;
+};
+
 // Define the descriptor and reserve the arena space for the counters.
 // Because of -fdata-sections, each kcounter_arena_* array will be
 // placed in a .bss.kcounter.* section; kernel.ld recognizes those names
@@ -157,6 +183,53 @@ private:
 
 #define KCOUNTER(var, name) KCOUNTER_DECLARE(var, name, Sum)
 
+// The buckets' names sort in bucket order, so their descriptors are adjacent.
+#define KCOUNTER_HISTOGRAM_BUCKET(var, name, n) \
+    __USED int64_t kcounter_arena_##var##_##n[SMP_MAX_CPUS] __asm__("kcounter." name "." #n); \
+    alignas(counters::Descriptor) __USED __SECTION("kcountdesc." name "." #n) const counters::Descriptor kcounter_desc_##var##_##n{name "." #n, counters::Type::kHistogram};
+
+#define KCOUNTER_HISTOGRAM(var, name) \
+    namespace { \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 00) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 01) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 02) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 03) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 04) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 05) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 06) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 07) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 08) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 09) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 10) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 11) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 12) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 13) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 14) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 15) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 16) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 17) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 18) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 19) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 20) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 21) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 22) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 23) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 24) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 25) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 26) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 27) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 28) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 29) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 30) \
+    KCOUNTER_HISTOGRAM_BUCKET(var, name, 31) \
+    static_assert(counters::kHistogramBuckets == 32, "update KCOUNTER_HISTOGRAM"); \
+    constexpr Histogram var(&kcounter_desc_##var##_00); \
+    }  // anonymous namespace
+
 static inline void kcounter_add(const Counter& counter, int64_t delta) {
     counter.Add(delta);
 }
+
+static inline void kcounter_histogram_add(const Histogram& histogram, uint64_t value) {
+    histogram.Add(value);
+}
@@ -7,13 +7,21 @@
 #include <debug.h>
 #include <err.h>
 #include <platform.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <arch/ops.h>
 #include <arch/user_copy.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <hypervisor/ktrace.h>
+#include <kernel/align.h>
 #include <kernel/cmdline.h>
+#include <kernel/lockdep.h>
+#include <kernel/mutex.h>
+#include <kernel/spinlock.h>
+#include <ktl/atomic.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <lib/ktrace/string_ref.h>
 #include <lk/init.h>
@@ -60,59 +68,271 @@ static void ktrace_report_probes(void) {
     }
 }
 
-typedef struct ktrace_state {
-    // where the next record will be written
-    int offset;
+KCOUNTER(ktrace_dropped, "ktrace.dropped")
+KCOUNTER(ktrace_overwritten, "ktrace.overwritten")
+
+namespace {
+
+// The fraction of the trace buffer used for metadata.
+constexpr uint32_t kMetaBufferDivisor = 16;
+
+// Each cpu records into its own ring, so tracing never bounces a cache line
+// between cpus. Positions are logical byte counts which only ever grow; the
+// offset of a position in the ring is |pos % size|. Records never straddle the
+// end of the ring: a record which does not fit starts the next lap, and the
+// rest of the lap it did not fit in is left unused.
+struct KTraceCpuBuffer {
+    DECLARE_SPINLOCK(KTraceCpuBuffer) lock;
+
+    // Where the next record will be written.
+    uint64_t head TA_GUARDED(lock) = 0;
+
+    // The oldest record which has not been consumed or overwritten.
+    uint64_t tail TA_GUARDED(lock) = 0;
+
+    // The end of the records in the lap before the one |head| is in.
+    uint32_t wrap_end TA_GUARDED(lock) = 0;
+
+    uint8_t* buffer = nullptr;
+    uint32_t size = 0;
+
+    uint32_t RecordLenLocked(uint64_t pos) const TA_REQ(lock) {
+        return KTRACE_LEN(reinterpret_cast<const ktrace_header_t*>(buffer + pos % size)->tag);
+    }
+
+    // Moves |pos|, which is in the lap before |head|'s, past the unused end
+    // of that lap if it has reached it.
+    uint64_t SkipWrapLocked(uint64_t pos) const TA_REQ(lock) {
+        if (pos / size != head / size && pos % size == wrap_end) {
+            return pos + (size - wrap_end);
+        }
+        return pos;
+    }
+
+    void AdvanceTailLocked() TA_REQ(lock) {
+        const uint32_t len = RecordLenLocked(tail);
+        DEBUG_ASSERT(len != 0);
+        tail = SkipWrapLocked(tail + len);
+    }
+
+    // Returns the first contiguous run of unconsumed records.
+    void FirstSpanLocked(uint64_t* start, uint32_t* len) const TA_REQ(lock) {
+        DEBUG_ASSERT(tail <= head && head - tail <= size);
+        *start = tail;
+        if (tail / size == head / size) {
+            *len = static_cast<uint32_t>(head - tail);
+        } else {
+            *len = wrap_end - static_cast<uint32_t>(tail % size);
+        }
+    }
+
+    void ResetLocked() TA_REQ(lock) {
+        head = 0;
+        tail = 0;
+        wrap_end = 0;
+    }
+} __CPU_ALIGN;
+
+// Serializes readers of the trace buffers.
+DECLARE_SINGLETON_MUTEX(KTraceReadLock);
+
+// Serializes writers of the metadata buffer.
+DECLARE_SINGLETON_SPINLOCK(KTraceMetaLock);
+
+} // namespace
 
+typedef struct ktrace_state {
     // mask of groups we allow, 0 == tracing disabled
     int grpmask;
 
-    // total size of the trace buffer
-    uint32_t bufsize;
+    // whether full cpu buffers overwrite their oldest records, rather than
+    // dropping new ones
+    ktl::atomic<bool> circular;
 
-    // offset where tracing was stopped, 0 if tracing active
-    uint32_t marker;
+    // Records emitted by ktrace_name_etc() describe the ids used by other
+    // records, so they are kept in a separate buffer which is never
+    // overwritten, even when tracing is circular.
+    //
+    // where the next metadata record will be written; records before it are
+    // complete
+    ktl::atomic<uint32_t> meta_offset;
 
-    // raw trace buffer
-    uint8_t* buffer;
+    // size of the metadata buffer
+    uint32_t meta_size;
+
+    // how much of the metadata buffer has been consumed by streaming reads
+    uint32_t meta_read TA_GUARDED(KTraceReadLock::Get());
+
+    // raw metadata buffer
+    uint8_t* meta;
+
+    // cpu to stream from first on the next streaming read, so that a slow
+    // reader doesn't starve the higher numbered cpus
+    uint32_t stream_cpu TA_GUARDED(KTraceReadLock::Get());
+
+    uint32_t num_cpus;
+    KTraceCpuBuffer cpus[SMP_MAX_CPUS];
 } ktrace_state_t;
 
 static ktrace_state_t KTRACE_STATE;
 
+// Calls |func(const uint8_t* data, uint32_t len)| for each contiguous run of
+// records in the trace buffers: first the metadata, then each cpu's records in
+// turn, oldest first.
+template <typename Func>
+static void ktrace_for_each_span(ktrace_state_t* ks, Func func) {
+    func(ks->meta, fbl::min(ks->meta_offset.load(), ks->meta_size));
+    for (uint32_t i = 0; i < ks->num_cpus; i++) {
+        KTraceCpuBuffer& cb = ks->cpus[i];
+        uint64_t head, start;
+        uint32_t len;
+        {
+            Guard<SpinLock, IrqSave> guard{&cb.lock};
+            head = cb.head;
+            cb.FirstSpanLocked(&start, &len);
+        }
+        func(cb.buffer + start % cb.size, len);
+        if (start + len != head) {
+            // The rest of the records are at the start of the ring.
+            func(cb.buffer, static_cast<uint32_t>(head % cb.size));
+        }
+    }
+}
+
 ssize_t ktrace_read_user(void* ptr, uint32_t off, size_t len) {
     ktrace_state_t* ks = &KTRACE_STATE;
+    if (ks->meta == nullptr) {
+        return 0;
+    }
+
+    Guard<Mutex> guard{KTraceReadLock::Get()};
+
+    // The trace is the concatenation of the runs of records in each buffer.
+    // null read is a query for its size
+    if (ptr == nullptr) {
+        size_t size = 0;
+        ktrace_for_each_span(ks, [&size](const uint8_t*, uint32_t span_len) {
+            size += span_len;
+        });
+        return size;
+    }
 
-    // Buffer size is limited by the marker if set,
-    // otherwise limited by offset (last written point).
-    // Offset can end up pointing past the end, so clip
-    // it to the actual buffer size to be safe.
-    uint32_t max;
-    if (ks->marker) {
-        max = ks->marker;
-    } else {
-        max = ks->offset;
-        if (max > ks->bufsize) {
-            max = ks->bufsize;
+    size_t span_off = 0;
+    size_t actual = 0;
+    zx_status_t status = ZX_OK;
+    ktrace_for_each_span(ks, [&](const uint8_t* data, uint32_t span_len) {
+        if (status != ZX_OK || actual == len || off >= span_off + span_len) {
+            span_off += span_len;
+            return;
         }
+        const size_t skip = off + actual - span_off;
+        const size_t n = fbl::min(span_len - skip, len - actual);
+        status = arch_copy_to_user(static_cast<uint8_t*>(ptr) + actual, data + skip, n);
+        actual += n;
+        span_off += span_len;
+    });
+    if (status != ZX_OK) {
+        return ZX_ERR_INVALID_ARGS;
     }
+    return actual;
+}
 
-    // null read is a query for trace buffer size
-    if (ptr == nullptr) {
-        return max;
+// Returns the length of the whole records at the start of the |len| bytes at
+// |data|, up to |max| bytes.
+static uint32_t ktrace_whole_records(const uint8_t* data, uint32_t len, size_t max) {
+    uint32_t n = 0;
+    while (n + KTRACE_HDRSIZE <= len) {
+        const uint32_t rec_len =
+            KTRACE_LEN(reinterpret_cast<const ktrace_header_t*>(data + n)->tag);
+        // A zero length can only be read from a record which is being
+        // overwritten, which the caller detects.
+        if (rec_len == 0 || n + rec_len > len || n + rec_len > max) {
+            break;
+        }
+        n += rec_len;
+    }
+    return n;
+}
+
+// Copies and consumes whole records from |cb| to |ptr|, up to |len| bytes.
+// Returns the number of bytes copied, or an error.
+static ssize_t ktrace_stream_cpu(KTraceCpuBuffer* cb, uint8_t* ptr, size_t len) {
+    size_t actual = 0;
+    while (actual < len) {
+        uint64_t start;
+        uint32_t span_len;
+        {
+            Guard<SpinLock, IrqSave> guard{&cb->lock};
+            cb->FirstSpanLocked(&start, &span_len);
+        }
+        const uint8_t* data = cb->buffer + start % cb->size;
+        const uint32_t n = ktrace_whole_records(data, span_len, len - actual);
+        if (n == 0) {
+            break;
+        }
+        if (arch_copy_to_user(ptr + actual, data, n) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+
+        Guard<SpinLock, IrqSave> guard{&cb->lock};
+        if (cb->tail != start || start + n > cb->head) {
+            // A circular trace overwrote the records while they were being
+            // copied. Try again from the oldest remaining record.
+            continue;
+        }
+        cb->tail = cb->SkipWrapLocked(start + n);
+        actual += n;
     }
+    return actual;
+}
 
-    // constrain read to available buffer
-    if (off >= max) {
+ssize_t ktrace_read_stream_user(void* ptr, size_t len) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    if (ks->meta == nullptr) {
         return 0;
     }
-    if (len > (max - off)) {
-        len = max - off;
+
+    Guard<Mutex> guard{KTraceReadLock::Get()};
+    uint8_t* out = static_cast<uint8_t*>(ptr);
+    size_t actual = 0;
+
+    // Metadata goes first, since it describes the records which follow it.
+    const uint32_t meta_end = fbl::min(ks->meta_offset.load(), ks->meta_size);
+    const uint32_t meta_len = ktrace_whole_records(ks->meta + ks->meta_read,
+                                                   meta_end - ks->meta_read, len);
+    if (meta_len > 0) {
+        if (arch_copy_to_user(out, ks->meta + ks->meta_read, meta_len) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        ks->meta_read += meta_len;
+        actual += meta_len;
     }
 
-    if (arch_copy_to_user(ptr, ks->buffer + off, len) != ZX_OK) {
-        return ZX_ERR_INVALID_ARGS;
+    for (uint32_t i = 0; i < ks->num_cpus && actual < len; i++) {
+        KTraceCpuBuffer* cb = &ks->cpus[(ks->stream_cpu + i) % ks->num_cpus];
+        ssize_t n = ktrace_stream_cpu(cb, out + actual, len - actual);
+        if (n < 0) {
+            return n;
+        }
+        actual += n;
+    }
+    ks->stream_cpu = (ks->stream_cpu + 1) % ks->num_cpus;
+    return actual;
+}
+
+// Discards every record written after the metadata written at init.
+static void ktrace_rewind(ktrace_state_t* ks) {
+    // Readers must not see the buffers move back underneath them.
+    Guard<Mutex> guard{KTraceReadLock::Get()};
+    ks->meta_read = 0;
+    {
+        Guard<SpinLock, IrqSave> meta_guard{KTraceMetaLock::Get()};
+        ks->meta_offset.store(KTRACE_RECSIZE * 2);
+    }
+    for (uint32_t i = 0; i < ks->num_cpus; i++) {
+        Guard<SpinLock, IrqSave> guard{&ks->cpus[i].lock};
+        ks->cpus[i].ResetLocked();
     }
-    return len;
 }
 
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
@@ -120,27 +340,21 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
 
     switch (action) {
     case KTRACE_ACTION_START:
+    case KTRACE_ACTION_START_CIRCULAR:
         options = KTRACE_GRP_TO_MASK(options);
-        ks->marker = 0;
+        ks->circular.store(action == KTRACE_ACTION_START_CIRCULAR);
         atomic_store(&ks->grpmask, options ? options : KTRACE_GRP_TO_MASK(KTRACE_GRP_ALL));
         ktrace_report_live_processes();
         ktrace_report_live_threads();
         break;
 
-    case KTRACE_ACTION_STOP: {
+    case KTRACE_ACTION_STOP:
         atomic_store(&ks->grpmask, 0);
-        uint32_t n = ks->offset;
-        if (n > ks->bufsize) {
-            ks->marker = ks->bufsize;
-        } else {
-            ks->marker = n;
-        }
         break;
-    }
 
     case KTRACE_ACTION_REWIND:
         // roll back to just after the metadata
-        atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
+        ktrace_rewind(ks);
         ktrace_report_syscalls(kt_syscall_info);
         ktrace_report_probes();
         ktrace_report_vcpu_meta();
@@ -195,24 +409,37 @@ void ktrace_init(unsigned level) {
 
     mb *= (1024 * 1024);
 
+    uint8_t* buffer;
     zx_status_t status;
     VmAspace* aspace = VmAspace::kernel_aspace();
-    if ((status = aspace->Alloc("ktrace", mb, reinterpret_cast<void**>(&ks->buffer),
+    if ((status = aspace->Alloc("ktrace", mb, reinterpret_cast<void**>(&buffer),
                                 0, VmAspace::VMM_FLAG_COMMIT,
                                 ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE)) < 0) {
         dprintf(INFO, "ktrace: cannot alloc buffer %d\n", status);
         return;
     }
 
-    // The last packet written can overhang the end of the buffer,
-    // so we reduce the reported size by the max size of a record
-    ks->bufsize = mb - 256;
+    // A slice of the buffer holds the metadata, and the rest is split evenly
+    // between the cpus.
+    const uint32_t meta_size = ROUNDUP(mb / kMetaBufferDivisor, KTRACE_RECSIZE);
+    const uint32_t num_cpus = arch_max_num_cpus();
+    const uint32_t cpu_size = ROUNDDOWN((mb - meta_size) / num_cpus, KTRACE_RECSIZE);
+    if (cpu_size < PAGE_SIZE) {
+        dprintf(INFO, "ktrace: buffer too small for %u cpus\n", num_cpus);
+        return;
+    }
+    for (uint32_t i = 0; i < num_cpus; i++) {
+        ks->cpus[i].buffer = buffer + meta_size + i * cpu_size;
+        ks->cpus[i].size = cpu_size;
+    }
+    ks->num_cpus = num_cpus;
+    ks->meta_size = meta_size;
 
-    dprintf(INFO, "ktrace: buffer at %p (%u bytes)\n", ks->buffer, mb);
+    dprintf(INFO, "ktrace: buffer at %p (%u bytes, %u per cpu)\n", buffer, mb, cpu_size);
 
     // write metadata to the first two event slots
     uint64_t n = ktrace_ticks_per_ms();
-    ktrace_rec_32b_t* rec = reinterpret_cast<ktrace_rec_32b_t*>(ks->buffer);
+    ktrace_rec_32b_t* rec = reinterpret_cast<ktrace_rec_32b_t*>(buffer);
     rec[0].tag = TAG_VERSION;
     rec[0].a = KTRACE_VERSION;
     rec[1].tag = TAG_TICKS_PER_MS;
@@ -220,7 +447,8 @@ void ktrace_init(unsigned level) {
     rec[1].b = static_cast<uint32_t>(n >> 32);
 
     // enable tracing
-    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
+    ks->meta_offset.store(KTRACE_RECSIZE * 2);
+    ks->meta = buffer;
     ktrace_report_syscalls(kt_syscall_info);
     ktrace_report_probes();
     atomic_store(&ks->grpmask, KTRACE_GRP_TO_MASK(grpmask));
@@ -238,65 +466,107 @@ void ktrace_init(unsigned level) {
     ktrace_probe(TraceAlways, TraceContext::Thread, "ktrace_ready"_stringref);
 }
 
+// Writes a |KTRACE_LEN(tag)| byte record, made of a header and the |payload_len|
+// bytes at |payload|, to the current cpu's buffer. Returns false if there is no
+// room for the record.
+static bool ktrace_write_record(ktrace_state_t* ks, uint32_t tag, uint32_t tid, uint64_t ts,
+                                const void* payload, size_t payload_len) {
+    const uint32_t len = KTRACE_LEN(tag);
+    DEBUG_ASSERT(len == KTRACE_HDRSIZE + payload_len);
+
+    // No need to pin ourselves to this cpu; if we migrate we end up using another cpu's
+    // buffer, which its lock makes safe.
+    KTraceCpuBuffer& cb = ks->cpus[arch_curr_cpu_num()];
+    Guard<SpinLock, IrqSave> guard{&cb.lock};
+    if (cb.size == 0) {
+        return false;
+    }
+
+    // Start a new lap if the record doesn't fit in this one.
+    const uint32_t pos = static_cast<uint32_t>(cb.head % cb.size);
+    const uint32_t skip = pos + len > cb.size ? cb.size - pos : 0;
+    const uint64_t head = cb.head + skip + len;
+    if (head - cb.tail > cb.size) {
+        if (!ks->circular.load(ktl::memory_order_relaxed)) {
+            kcounter_add(ktrace_dropped, 1);
+            return false;
+        }
+        // Make room by overwriting the oldest records. This must happen
+        // before |wrap_end| moves on to the lap being started.
+        while (head - cb.tail > cb.size) {
+            cb.AdvanceTailLocked();
+            kcounter_add(ktrace_overwritten, 1);
+        }
+    }
+    if (skip > 0) {
+        cb.wrap_end = pos;
+    }
+    cb.head = head;
+    if (head % cb.size == 0) {
+        // The record ends the lap exactly.
+        cb.wrap_end = cb.size;
+    }
+
+    // The whole record is written under the lock, so every record between
+    // |tail| and |head| is complete and readers can trust its length.
+    ktrace_header_t* hdr = reinterpret_cast<ktrace_header_t*>(cb.buffer + (head - len) % cb.size);
+    hdr->ts = ts;
+    hdr->tag = tag;
+    hdr->tid = tid;
+    if (payload_len > 0) {
+        memcpy(hdr + 1, payload, payload_len);
+    }
+    return true;
+}
+
 void ktrace_tiny(uint32_t tag, uint32_t arg) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (tag & atomic_load(&ks->grpmask)) {
         tag = (tag & 0xFFFFFFF0) | 2;
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_HDRSIZE)) >= static_cast<int>(ks->bufsize)) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_header_t* hdr = reinterpret_cast<ktrace_header_t*>(ks->buffer + off);
-            hdr->ts = ktrace_timestamp();
-            hdr->tag = tag;
-            hdr->tid = arg;
-        }
+        ktrace_write_record(ks, tag, arg, ktrace_timestamp(), nullptr, 0);
     }
 }
 
-void* ktrace_open(uint32_t tag, uint64_t ts) {
+bool ktrace_write(uint32_t tag, const void* payload, size_t len, uint64_t ts) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (!(tag & atomic_load(&ks->grpmask))) {
-        return nullptr;
-    }
-
-    int off;
-    if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= static_cast<int>(ks->bufsize)) {
-        // if we arrive at the end, stop
-        atomic_store(&ks->grpmask, 0);
-        return nullptr;
+        return false;
     }
 
-    ktrace_header_t* hdr = reinterpret_cast<ktrace_header_t*>(ks->buffer + off);
-    hdr->ts = ts;
-    hdr->tag = tag;
-    hdr->tid = KTRACE_FLAGS(tag) & KTRACE_FLAGS_CPU
-                   ? arch_curr_cpu_num()
-                   : static_cast<uint32_t>(get_current_thread()->user_tid);
-    return hdr + 1;
+    const uint32_t tid = KTRACE_FLAGS(tag) & KTRACE_FLAGS_CPU
+                             ? arch_curr_cpu_num()
+                             : static_cast<uint32_t>(get_current_thread()->user_tid);
+    return ktrace_write_record(ks, tag, tid, ts, payload, len);
 }
 
 void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always) {
     ktrace_state_t* ks = &KTRACE_STATE;
+    if (ks->meta == nullptr) {
+        return;
+    }
     if ((tag & atomic_load(&ks->grpmask)) || always) {
         const uint32_t len = static_cast<uint32_t>(strnlen(name, ZX_MAX_NAME_LEN - 1));
 
         // set size to: sizeof(hdr) + len + 1, round up to multiple of 8
         tag = (tag & 0xFFFFFFF0) | ((KTRACE_NAMESIZE + len + 1 + 7) >> 3);
 
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= static_cast<int>(ks->bufsize)) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_rec_name_t* rec = reinterpret_cast<ktrace_rec_name_t*>(ks->buffer + off);
-            rec->tag = tag;
-            rec->id = id;
-            rec->arg = arg;
-            memcpy(rec->name, name, len);
-            rec->name[len] = 0;
+        // Names are rare enough for all cpus to share the metadata buffer.
+        // The record is complete before |meta_offset| moves past it, since
+        // readers copy everything before |meta_offset| without locking.
+        Guard<SpinLock, IrqSave> guard{KTraceMetaLock::Get()};
+        const uint32_t off = ks->meta_offset.load(ktl::memory_order_relaxed);
+        if (off + KTRACE_LEN(tag) > ks->meta_size) {
+            kcounter_add(ktrace_dropped, 1);
+            return;
         }
+
+        ktrace_rec_name_t* rec = reinterpret_cast<ktrace_rec_name_t*>(ks->meta + off);
+        rec->tag = tag;
+        rec->id = id;
+        rec->arg = arg;
+        memcpy(rec->name, name, len);
+        rec->name[len] = 0;
+        ks->meta_offset.store(off + KTRACE_LEN(tag), ktl::memory_order_release);
     }
 }
 
@@ -0,0 +1,165 @@
+// Copyright 2019 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <debug.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/macros.h>
+#include <kernel/align.h>
+#include <kernel/spinlock.h>
+#include <lib/counters.h>
+#include <zircon/compiler.h>
+#include <zircon/thread_annotations.h>
+
+#include <sys/types.h>
+
+namespace object_cache {
+
+// An ObjectCache holds freed objects of a single size so that they can be handed
+// out again without going through the heap, which serializes every allocation
+// on a single lock.
+//
+// Freed objects are kept in a magazine per cpu, which is only contended when a
+// thread migrates between cpus mid-operation. When a magazine fills up, half
+// of it is moved to a depot shared by all cpus, and an empty magazine is
+// refilled from the depot before falling back to the heap. Objects which do not
+// fit in the depot are returned to the heap.
+//
+// Caches are registered globally when constructed and must have static storage
+// duration. All cached objects are returned to the heap by Reclaim(), which is
+// invoked on every cache when the system is low on memory.
+class ObjectCache {
+public:
+    // The largest supported |magazine_size|.
+    static constexpr size_t kMaxMagazineSize = 32;
+
+    // Objects are |object_size| bytes. Each cpu caches up to |magazine_size|
+    // objects, and the depot up to |depot_max|.
+    ObjectCache(const char* name, size_t object_size, size_t magazine_size, size_t depot_max,
+                const Counter* hit, const Counter* miss, const Counter* reclaimed);
+
+    // Returns a block of at least |object_size()| bytes, or nullptr.
+    void* Alloc();
+
+    // Frees a block returned by Alloc().
+    void Free(void* ptr);
+
+    // Returns all objects cached by this cache to the heap.
+    // Returns the number of objects freed.
+    size_t Reclaim();
+
+    // Reclaims every cache in the system.
+    static size_t ReclaimAll();
+
+    const char* name() const { return name_; }
+    size_t object_size() const { return object_size_; }
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ObjectCache);
+
+private:
+    struct FreeObject {
+        FreeObject* next;
+    };
+
+    struct CpuMagazine {
+        DECLARE_SPINLOCK(CpuMagazine) lock;
+        size_t count TA_GUARDED(lock) = 0;
+        void* objects[kMaxMagazineSize] TA_GUARDED(lock);
+    } __CPU_ALIGN;
+
+    // Moves every object held by this cache onto |list|.
+    // Returns the number of objects moved.
+    size_t TakeAll(FreeObject** list);
+
+    static void FreeList(FreeObject* list);
+
+    const char* const name_;
+    const size_t object_size_;
+    const size_t magazine_size_;
+    const size_t depot_max_;
+    const Counter* const hit_;
+    const Counter* const miss_;
+    const Counter* const reclaimed_;
+
+    // Next in the list of all caches. Never changes after construction.
+    ObjectCache* next_ = nullptr;
+
+    CpuMagazine magazines_[SMP_MAX_CPUS];
+
+    DECLARE_SPINLOCK(ObjectCache) depot_lock_;
+    FreeObject* depot_ TA_GUARDED(depot_lock_) = nullptr;
+    size_t depot_count_ TA_GUARDED(depot_lock_) = 0;
+};
+
+// Describes the cache for objects of type |T|, in the style of
+// fbl::SlabAllocatorTraits.
+template <typename T, size_t MagazineSize = 16, size_t DepotMax = 256>
+struct ObjectCacheTraits {
+    using ObjType = T;
+    static constexpr size_t kMagazineSize = MagazineSize;
+    static constexpr size_t kDepotMax = DepotMax;
+
+    static_assert(MagazineSize >= 2 && MagazineSize <= ObjectCache::kMaxMagazineSize,
+                  "Unsupported magazine size");
+};
+
+// Types deriving from ObjectCacheAllocated<Traits> are allocated from and freed
+// to the cache described by |Traits| when created with new (&ac) and destroyed
+// with delete. Types which are subclassed must not use this, since the cache
+// only holds objects of exactly |Traits::ObjType|'s size.
+//
+// Example:
+//
+// class Foo;
+// using FooCacheTraits = object_cache::ObjectCacheTraits<Foo>;
+// class Foo final : public object_cache::ObjectCacheAllocated<FooCacheTraits> { ... };
+// FWD_DECL_OBJECT_CACHE(FooCacheTraits);
+//
+// And in exactly one translation unit:
+//
+// DECLARE_OBJECT_CACHE_STORAGE(FooCacheTraits, foo_cache, "foo");
+//
+// which also defines the object_cache.foo.{hit,miss,reclaimed} kcounters.
+template <typename Traits>
+class ObjectCacheAllocated {
+public:
+    static void* operator new(size_t size, fbl::AllocChecker* ac) noexcept {
+        DEBUG_ASSERT(size == sizeof(typename Traits::ObjType));
+        void* ptr = cache_.Alloc();
+        ac->arm(size, ptr != nullptr);
+        return ptr;
+    }
+
+    static void operator delete(void* ptr) {
+        cache_.Free(ptr);
+    }
+
+    static ObjectCache* cache() { return &cache_; }
+
+private:
+    static ObjectCache cache_;
+};
+
+} // namespace object_cache
+
+// Defines the cache storage for |TRAITS| and its counters. |var| must be an
+// identifier unique within the translation unit.
+#define DECLARE_OBJECT_CACHE_STORAGE(TRAITS, var, name)                                            \
+    KCOUNTER(var##_hit, "object_cache." name ".hit")                                               \
+    KCOUNTER(var##_miss, "object_cache." name ".miss")                                             \
+    KCOUNTER(var##_reclaimed, "object_cache." name ".reclaimed")                                   \
+    template <>                                                                                    \
+    ::object_cache::ObjectCache ::object_cache::ObjectCacheAllocated<TRAITS>::cache_(              \
+        name, sizeof(TRAITS::ObjType), TRAITS::kMagazineSize, TRAITS::kDepotMax,                   \
+        &var##_hit, &var##_miss, &var##_reclaimed)
+
+// Declares the existence of the cache storage for |TRAITS|. Use this in the
+// header declaring the cached type if it is allocated or freed outside of the
+// translation unit holding its storage.
+#define FWD_DECL_OBJECT_CACHE(TRAITS)                                                              \
+    template <>                                                                                    \
+    ::object_cache::ObjectCache ::object_cache::ObjectCacheAllocated<TRAITS>::cache_
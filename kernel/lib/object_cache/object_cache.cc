@@ -0,0 +1,154 @@
+// Copyright 2019 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/object_cache.h>
+
+#include <arch/ops.h>
+#include <fbl/algorithm.h>
+#include <kernel/lockdep.h>
+#include <ktl/atomic.h>
+#include <stdlib.h>
+
+namespace object_cache {
+
+namespace {
+
+// All caches, newest first. Caches are constructed by global constructors,
+// before locks may be taken, so they are pushed without one.
+ktl::atomic<ObjectCache*> all_caches{nullptr};
+
+// Serializes reclaiming, so that concurrent reclaims don't fight over the
+// same depots.
+DECLARE_SINGLETON_SPINLOCK(ReclaimLock);
+
+} // namespace
+
+ObjectCache::ObjectCache(const char* name, size_t object_size, size_t magazine_size,
+                         size_t depot_max, const Counter* hit, const Counter* miss,
+                         const Counter* reclaimed)
+    : name_(name), object_size_(fbl::max(object_size, sizeof(FreeObject))),
+      magazine_size_(magazine_size), depot_max_(depot_max), hit_(hit), miss_(miss),
+      reclaimed_(reclaimed) {
+    DEBUG_ASSERT(magazine_size_ >= 2 && magazine_size_ <= kMaxMagazineSize);
+    ObjectCache* head = all_caches.load(ktl::memory_order_relaxed);
+    do {
+        next_ = head;
+    } while (!all_caches.compare_exchange_weak(head, this, ktl::memory_order_release,
+                                               ktl::memory_order_relaxed));
+}
+
+void* ObjectCache::Alloc() {
+    // No need to pin ourselves to this cpu; if we migrate we end up using another cpu's
+    // magazine, which its lock makes safe.
+    CpuMagazine& mag = magazines_[arch_curr_cpu_num()];
+    {
+        Guard<SpinLock, IrqSave> guard{&mag.lock};
+        if (mag.count == 0) {
+            // Refill half of the magazine from the depot, leaving room for frees.
+            Guard<SpinLock, NoIrqSave> depot_guard{&depot_lock_};
+            while (depot_ != nullptr && mag.count < magazine_size_ / 2) {
+                FreeObject* obj = depot_;
+                depot_ = obj->next;
+                depot_count_--;
+                mag.objects[mag.count++] = obj;
+            }
+        }
+        if (mag.count > 0) {
+            kcounter_add(*hit_, 1);
+            return mag.objects[--mag.count];
+        }
+    }
+    kcounter_add(*miss_, 1);
+    return malloc(object_size_);
+}
+
+void ObjectCache::Free(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    FreeObject* overflow = nullptr;
+    CpuMagazine& mag = magazines_[arch_curr_cpu_num()];
+    {
+        Guard<SpinLock, IrqSave> guard{&mag.lock};
+        if (mag.count == magazine_size_) {
+            // Move half of the magazine to the depot, leaving room for allocations.
+            Guard<SpinLock, NoIrqSave> depot_guard{&depot_lock_};
+            while (mag.count > magazine_size_ / 2) {
+                FreeObject* obj = static_cast<FreeObject*>(mag.objects[--mag.count]);
+                if (depot_count_ < depot_max_) {
+                    obj->next = depot_;
+                    depot_ = obj;
+                    depot_count_++;
+                } else {
+                    obj->next = overflow;
+                    overflow = obj;
+                }
+            }
+        }
+        mag.objects[mag.count++] = ptr;
+    }
+    // The heap can't be called with spinlocks held.
+    FreeList(overflow);
+}
+
+size_t ObjectCache::TakeAll(FreeObject** list) {
+    size_t taken = 0;
+    for (CpuMagazine& mag : magazines_) {
+        Guard<SpinLock, IrqSave> guard{&mag.lock};
+        while (mag.count > 0) {
+            FreeObject* obj = static_cast<FreeObject*>(mag.objects[--mag.count]);
+            obj->next = *list;
+            *list = obj;
+            taken++;
+        }
+    }
+    Guard<SpinLock, IrqSave> guard{&depot_lock_};
+    while (depot_ != nullptr) {
+        FreeObject* obj = depot_;
+        depot_ = obj->next;
+        obj->next = *list;
+        *list = obj;
+        taken++;
+    }
+    depot_count_ = 0;
+    kcounter_add(*reclaimed_, static_cast<int64_t>(taken));
+    return taken;
+}
+
+void ObjectCache::FreeList(FreeObject* list) {
+    while (list != nullptr) {
+        FreeObject* next = list->next;
+        free(list);
+        list = next;
+    }
+}
+
+size_t ObjectCache::Reclaim() {
+    FreeObject* list = nullptr;
+    size_t reclaimed;
+    {
+        Guard<SpinLock, IrqSave> guard{ReclaimLock::Get()};
+        reclaimed = TakeAll(&list);
+    }
+    FreeList(list);
+    return reclaimed;
+}
+
+size_t ObjectCache::ReclaimAll() {
+    FreeObject* list = nullptr;
+    size_t reclaimed = 0;
+    {
+        Guard<SpinLock, IrqSave> guard{ReclaimLock::Get()};
+        for (ObjectCache* cache = all_caches.load(ktl::memory_order_acquire); cache != nullptr;
+             cache = cache->next_) {
+            reclaimed += cache->TakeAll(&list);
+        }
+    }
+    FreeList(list);
+    return reclaimed;
+}
+
+} // namespace object_cache
@@ -0,0 +1,214 @@
+// Copyright 2019 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/object_cache.h>
+
+#include <arch/ops.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <inttypes.h>
+#include <kernel/cpu.h>
+#include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <ktl/atomic.h>
+#include <lib/unittest/unittest.h>
+#include <platform.h>
+#include <stdlib.h>
+
+namespace {
+
+class TestObject;
+using TestObjectCacheTraits = object_cache::ObjectCacheTraits<TestObject, 8, 16>;
+
+class TestObject final : public object_cache::ObjectCacheAllocated<TestObjectCacheTraits> {
+public:
+    uint64_t payload[8];
+};
+
+} // namespace
+
+DECLARE_OBJECT_CACHE_STORAGE(TestObjectCacheTraits, test_object_cache, "test_object");
+
+namespace {
+
+object_cache::ObjectCache* cache() {
+    return TestObject::cache();
+}
+
+// Pins the current thread to the cpu it is running on for the lifetime of the
+// object, so that allocations and frees hit the same magazine.
+class AutoPin {
+public:
+    AutoPin() : old_affinity_(get_current_thread()->cpu_affinity) {
+        thread_set_cpu_affinity(get_current_thread(), cpu_num_to_mask(arch_curr_cpu_num()));
+    }
+    ~AutoPin() { thread_set_cpu_affinity(get_current_thread(), old_affinity_); }
+
+private:
+    const cpu_mask_t old_affinity_;
+};
+
+bool alloc_free_reuses() {
+    BEGIN_TEST;
+
+    AutoPin pin;
+    cache()->Reclaim();
+
+    fbl::AllocChecker ac;
+    TestObject* first = new (&ac) TestObject;
+    ASSERT_TRUE(ac.check(), "");
+    delete first;
+
+    // The most recently freed object is handed out first.
+    TestObject* second = new (&ac) TestObject;
+    ASSERT_TRUE(ac.check(), "");
+    EXPECT_EQ(first, second, "");
+    delete second;
+
+    EXPECT_EQ(1u, cache()->Reclaim(), "");
+    EXPECT_EQ(0u, cache()->Reclaim(), "");
+
+    END_TEST;
+}
+
+bool depot_overflow() {
+    BEGIN_TEST;
+
+    constexpr size_t kMagazineSize = TestObjectCacheTraits::kMagazineSize;
+    constexpr size_t kDepotMax = TestObjectCacheTraits::kDepotMax;
+    constexpr size_t kCount = kMagazineSize + kDepotMax * 2;
+
+    AutoPin pin;
+    cache()->Reclaim();
+
+    void* objects[kCount];
+    for (auto& obj : objects) {
+        obj = cache()->Alloc();
+        ASSERT_NONNULL(obj, "");
+    }
+    for (auto obj : objects) {
+        cache()->Free(obj);
+    }
+
+    // Everything beyond a full magazine and a full depot went back to the heap.
+    EXPECT_LE(cache()->Reclaim(), kMagazineSize + kDepotMax, "");
+    EXPECT_EQ(0u, cache()->Reclaim(), "");
+
+    END_TEST;
+}
+
+bool reclaim_all() {
+    BEGIN_TEST;
+
+    AutoPin pin;
+    cache()->Reclaim();
+
+    void* obj = cache()->Alloc();
+    ASSERT_NONNULL(obj, "");
+    cache()->Free(obj);
+
+    EXPECT_GE(object_cache::ObjectCache::ReclaimAll(), 1u, "");
+    EXPECT_EQ(0u, cache()->Reclaim(), "");
+
+    END_TEST;
+}
+
+constexpr size_t kBenchBatch = 8;
+constexpr size_t kBenchIterations = 20000;
+
+struct BenchState {
+    bool use_cache;
+    ktl::atomic<bool> go{false};
+};
+
+int bench_thread(void* arg) {
+    auto state = static_cast<BenchState*>(arg);
+    while (!state->go.load(ktl::memory_order_acquire)) {
+        arch_spinloop_pause();
+    }
+    void* objects[kBenchBatch];
+    for (size_t i = 0; i < kBenchIterations; i++) {
+        for (auto& obj : objects) {
+            obj = state->use_cache ? cache()->Alloc() : malloc(sizeof(TestObject));
+        }
+        for (auto obj : objects) {
+            if (state->use_cache) {
+                cache()->Free(obj);
+            } else {
+                free(obj);
+            }
+        }
+    }
+    return 0;
+}
+
+// Allocates and frees batches of objects on every cpu in |cpus| at once, and
+// returns the total number of allocations per microsecond.
+uint64_t bench_run(bool use_cache, cpu_mask_t cpus) {
+    thread_t* threads[SMP_MAX_CPUS];
+    size_t count = 0;
+    BenchState state;
+    state.use_cache = use_cache;
+
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (!(cpus & cpu_num_to_mask(cpu))) {
+            continue;
+        }
+        thread_t* t = thread_create("object cache bench", bench_thread, &state, DEFAULT_PRIORITY);
+        if (t == nullptr) {
+            break;
+        }
+        thread_set_cpu_affinity(t, cpu_num_to_mask(cpu));
+        thread_resume(t);
+        threads[count++] = t;
+    }
+
+    zx_time_t start = current_time();
+    state.go.store(true, ktl::memory_order_release);
+    for (size_t i = 0; i < count; i++) {
+        thread_join(threads[i], nullptr, ZX_TIME_INFINITE);
+    }
+    zx_duration_t elapsed = current_time() - start;
+
+    uint64_t ops = count * kBenchIterations * kBenchBatch;
+    return ops * ZX_USEC(1) / fbl::max<zx_duration_t>(elapsed, 1);
+}
+
+bool bench_scaling() {
+    BEGIN_TEST;
+
+    // Start from an empty cache.
+    cache()->Reclaim();
+
+    cpu_mask_t online = mp_get_online_mask();
+    cpu_mask_t cpus = 0;
+    unsigned int num_cpus = 0;
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (!(online & cpu_num_to_mask(cpu))) {
+            continue;
+        }
+        cpus |= cpu_num_to_mask(cpu);
+        num_cpus++;
+
+        uint64_t heap = bench_run(false, cpus);
+        uint64_t cached = bench_run(true, cpus);
+        printf("%u cpus: heap %" PRIu64 " allocs/usec, object cache %" PRIu64 " allocs/usec\n",
+               num_cpus, heap, cached);
+    }
+
+    cache()->Reclaim();
+
+    END_TEST;
+}
+
+} // namespace
+
+UNITTEST_START_TESTCASE(object_cache_tests)
+UNITTEST("alloc and free reuse objects", alloc_free_reuses)
+UNITTEST("depot overflows to the heap", depot_overflow)
+UNITTEST("reclaim all caches", reclaim_all)
+UNITTEST("allocation throughput by cpu count", bench_scaling)
+UNITTEST_END_TESTCASE(object_cache_tests, "object_cache", "Object cache tests");
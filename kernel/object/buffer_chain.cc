@@ -6,6 +6,34 @@
 
 #include <object/buffer_chain.h>
 
+#include <arch/ops.h>
+#include <kernel/align.h>
+#include <kernel/lockdep.h>
+#include <kernel/spinlock.h>
+#include <lib/counters.h>
+
+KCOUNTER(buffer_chain_cache_hit, "buffer_chain.page_cache.hit")
+KCOUNTER(buffer_chain_cache_miss, "buffer_chain.page_cache.miss")
+KCOUNTER(buffer_chain_cache_drained, "buffer_chain.page_cache.drained")
+
+namespace {
+
+// Maximum number of pages each cpu keeps around for reuse. Most messages fit in a single
+// buffer, so this is plenty to absorb bursts of channel traffic.
+constexpr size_t kPageCacheMaxPages = 32;
+
+// A per-cpu cache of pages that are already in VM_PAGE_STATE_IPC, so that message packets can
+// skip the PMM entirely in the common case.
+struct PageCache {
+    DECLARE_SPINLOCK(PageCache) lock;
+    list_node pages TA_GUARDED(lock) = LIST_INITIAL_VALUE(pages);
+    size_t count TA_GUARDED(lock) = 0;
+} __CPU_ALIGN;
+
+PageCache page_cache[SMP_MAX_CPUS];
+
+} // namespace
+
 // Makes a const void* look like a user_in_ptr<const void>.
 //
 // Sometimes we need to copy data from kernel space. KernelPtrAdapter allows us to implement the
@@ -32,3 +60,71 @@ zx_status_t BufferChain::CopyInKernel(const void* src, size_t dst_offset, size_t
 
 template zx_status_t BufferChain::CopyInCommon(user_in_ptr<const void> src, size_t dst_offset,
                                                size_t size);
+
+zx_status_t BufferChain::AllocPages(size_t num_pages, list_node* pages) {
+    DEBUG_ASSERT(list_is_empty(pages));
+
+    // No need to pin ourselves to this cpu; if we migrate we end up using another cpu's cache,
+    // which its lock makes safe.
+    PageCache& cache = page_cache[arch_curr_cpu_num()];
+    size_t cached = 0;
+    {
+        Guard<SpinLock, IrqSave> guard{&cache.lock};
+        while (cached < num_pages && cache.count > 0) {
+            list_add_tail(pages, list_remove_head(&cache.pages));
+            cache.count--;
+            cached++;
+        }
+    }
+    if (cached == num_pages) {
+        kcounter_add(buffer_chain_cache_hit, 1);
+        return ZX_OK;
+    }
+    kcounter_add(buffer_chain_cache_miss, 1);
+
+    list_node new_pages = LIST_INITIAL_VALUE(new_pages);
+    zx_status_t status = pmm_alloc_pages(num_pages - cached, 0, &new_pages);
+    if (unlikely(status == ZX_ERR_NO_MEMORY)) {
+        // Other cpus may be sitting on enough pages to satisfy us.
+        DrainPageCaches();
+        status = pmm_alloc_pages(num_pages - cached, 0, &new_pages);
+    }
+    if (unlikely(status != ZX_OK)) {
+        FreePages(pages);
+        return status;
+    }
+    vm_page_t* page;
+    list_for_every_entry (&new_pages, page, vm_page_t, queue_node) {
+        DEBUG_ASSERT(page->state() == VM_PAGE_STATE_ALLOC);
+        page->set_state(VM_PAGE_STATE_IPC);
+    }
+    list_splice_after(&new_pages, pages->prev);
+    return ZX_OK;
+}
+
+void BufferChain::FreePages(list_node* pages) {
+    PageCache& cache = page_cache[arch_curr_cpu_num()];
+    {
+        Guard<SpinLock, IrqSave> guard{&cache.lock};
+        while (cache.count < kPageCacheMaxPages && !list_is_empty(pages)) {
+            list_add_head(&cache.pages, list_remove_head(pages));
+            cache.count++;
+        }
+    }
+    if (!list_is_empty(pages)) {
+        pmm_free(pages);
+    }
+}
+
+void BufferChain::DrainPageCaches() {
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    size_t drained = 0;
+    for (PageCache& cache : page_cache) {
+        Guard<SpinLock, IrqSave> guard{&cache.lock};
+        drained += cache.count;
+        list_splice_after(&cache.pages, &pages);
+        cache.count = 0;
+    }
+    kcounter_add(buffer_chain_cache_drained, drained);
+    pmm_free(&pages);
+}
@@ -138,9 +138,42 @@ static bool copy_in_copy_out() {
     END_TEST;
 }
 
+// Pages freed into the per-cpu cache have to come back out as clean, usable chains, and
+// draining the caches must leave allocation working.
+static bool page_cache_reuse() {
+    BEGIN_TEST;
+
+    constexpr size_t kNumChains = 64;
+    constexpr size_t kSize = BufferChain::kContig + BufferChain::kRawDataSize;
+
+    BufferChain* chains[kNumChains];
+    for (int round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < kNumChains; ++i) {
+            chains[i] = BufferChain::Alloc(kSize);
+            ASSERT_NE(nullptr, chains[i], "");
+            ASSERT_EQ(2u, chains[i]->buffers()->size_slow(), "");
+            ASSERT_EQ(BufferChain::kContig, chains[i]->buffers()->front().size(), "");
+            for (auto& buf : *chains[i]->buffers()) {
+                memset(buf.data(), static_cast<int>(i), buf.size());
+            }
+        }
+        for (size_t i = 0; i < kNumChains; ++i) {
+            BufferChain::Free(chains[i]);
+        }
+    }
+    BufferChain::DrainPageCaches();
+
+    BufferChain* bc = BufferChain::Alloc(kSize);
+    ASSERT_NE(nullptr, bc, "");
+    BufferChain::Free(bc);
+
+    END_TEST;
+}
+
 }  // namespace
 
 UNITTEST_START_TESTCASE(buffer_chain_tests)
 UNITTEST("alloc_free_basic", alloc_free_basic)
 UNITTEST("copy_in_copy_out", copy_in_copy_out)
+UNITTEST("page_cache_reuse", page_cache_reuse)
 UNITTEST_END_TESTCASE(buffer_chain_tests, "buffer_chain", "BufferChain tests");
@@ -15,6 +15,8 @@
 KCOUNTER(dispatcher_event_create_count, "dispatcher.event.create")
 KCOUNTER(dispatcher_event_destroy_count, "dispatcher.event.destroy")
 
+DECLARE_OBJECT_CACHE_STORAGE(EventDispatcherCacheTraits, event_cache, "event_dispatcher");
+
 zx_status_t EventDispatcher::Create(uint32_t options, KernelHandle<EventDispatcher>* handle,
                                     zx_rights_t* rights) {
     fbl::AllocChecker ac;
@@ -15,8 +15,10 @@
 
 #include <lk/init.h>
 
+#include <lib/object_cache.h>
 #include <lib/oom.h>
 
+#include <object/buffer_chain.h>
 #include <object/diagnostics.h>
 #include <object/event_dispatcher.h>
 #include <object/excp_port.h>
@@ -46,6 +48,10 @@ static void oom_lowmem(size_t shortfall_bytes) {
     zx_status_t status;
     printf("OOM: oom_lowmem(shortfall_bytes=%zu) called\n", shortfall_bytes);
 
+    // Give back memory that is only being held onto for speed.
+    BufferChain::DrainPageCaches();
+    object_cache::ObjectCache::ReclaimAll();
+
     status = low_mem_event->user_signal_self(0, ZX_EVENT_SIGNALED);
     if (status != ZX_OK) {
         printf("OOM: signal low mem failed: %d\n", status);
@@ -93,7 +93,7 @@ public:
 
         // Allocate a list of pages.
         list_node pages = LIST_INITIAL_VALUE(pages);
-        zx_status_t status = pmm_alloc_pages(num_buffers, 0, &pages);
+        zx_status_t status = AllocPages(num_buffers, &pages);
         if (unlikely(status != ZX_OK)) {
             return nullptr;
         }
@@ -102,8 +102,7 @@ public:
         BufferChain::BufferList temp;
         vm_page_t* page;
         list_for_every_entry (&pages, page, vm_page_t, queue_node) {
-            DEBUG_ASSERT(page->state() == VM_PAGE_STATE_ALLOC);
-            page->set_state(VM_PAGE_STATE_IPC);
+            DEBUG_ASSERT(page->state() == VM_PAGE_STATE_IPC);
             void* va = paddr_to_physmap(page->paddr());
             temp.push_front(new (va) BufferChain::Buffer);
         }
@@ -129,9 +128,14 @@ public:
             BufferChain::Buffer* buf = buffers.pop_front();
             buf->Buffer::~Buffer();
         }
-        pmm_free(&pages);
+        FreePages(&pages);
     }
 
+    // Returns the pages held in the per-cpu page caches to the PMM.
+    //
+    // Called when the system is low on memory.
+    static void DrainPageCaches();
+
     // Copies |size| bytes from |src| to this chain starting at offset |dst_offset|.
     //
     // |dst_offset| must be in the range [0, kContig).
@@ -169,6 +173,14 @@ public:
     BufferList* buffers() { return &buffers_; }
 
 private:
+    // Allocates |num_pages| pages, already marked VM_PAGE_STATE_IPC, into the empty list |pages|.
+    //
+    // Pages are taken from the current cpu's page cache first and from the PMM after that.
+    static zx_status_t AllocPages(size_t num_pages, list_node* pages);
+
+    // Frees |pages| to the current cpu's page cache, handing whatever doesn't fit back to the PMM.
+    static void FreePages(list_node* pages);
+
     explicit BufferChain(BufferList* buffers, list_node* pages) {
         buffers_.swap(*buffers);
         list_move(pages, &pages_);
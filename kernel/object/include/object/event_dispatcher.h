@@ -10,13 +10,18 @@
 #include <zircon/types.h>
 
 #include <fbl/canary.h>
+#include <lib/object_cache.h>
 #include <object/dispatcher.h>
 #include <object/handle.h>
 
 #include <sys/types.h>
 
+class EventDispatcher;
+using EventDispatcherCacheTraits = object_cache::ObjectCacheTraits<EventDispatcher>;
+
 class EventDispatcher final :
-    public SoloDispatcher<EventDispatcher, ZX_DEFAULT_EVENT_RIGHTS, ZX_EVENT_SIGNALED> {
+    public SoloDispatcher<EventDispatcher, ZX_DEFAULT_EVENT_RIGHTS, ZX_EVENT_SIGNALED>,
+    public object_cache::ObjectCacheAllocated<EventDispatcherCacheTraits> {
 public:
     static zx_status_t Create(uint32_t options, KernelHandle<EventDispatcher>* handle,
                               zx_rights_t* rights);
@@ -28,4 +33,6 @@ private:
     explicit EventDispatcher(uint32_t options);
 };
 
+FWD_DECL_OBJECT_CACHE(EventDispatcherCacheTraits);
+
 fbl::RefPtr<EventDispatcher> GetLowMemEvent();
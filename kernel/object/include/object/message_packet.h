@@ -50,9 +50,16 @@ public:
     // Copies the packet's |data_size()| bytes to |buf|.
     // Returns an error if |buf| points to a bad user address.
     zx_status_t CopyDataTo(user_out_ptr<void> buf) const {
+        if (!buffer_chain_) {
+            return buf.copy_array_to_user(payload_start(), data_size_);
+        }
         return buffer_chain_->CopyOut(buf, payload_offset_, data_size_);
     }
 
+    // Returns true if the packet is stored inline in a small packet slot
+    // rather than in a BufferChain.
+    bool is_inline() const { return buffer_chain_ == nullptr; }
+
     uint32_t num_handles() const { return num_handles_; }
     Handle* const* handles() const { return handles_; }
     Handle** mutable_handles() { return handles_; }
@@ -66,14 +73,12 @@ public:
             return 0;
         }
         // The first few bytes of the payload are a zx_txid_t.
-        void* payload_start = buffer_chain_->buffers()->front().data() + payload_offset_;
-        return *reinterpret_cast<zx_txid_t*>(payload_start);
+        return *reinterpret_cast<zx_txid_t*>(payload_start());
     }
 
     void set_txid(zx_txid_t txid) {
         if (data_size_ >= sizeof(zx_txid_t)) {
-            void* payload_start = buffer_chain_->buffers()->front().data() + payload_offset_;
-            *(reinterpret_cast<zx_txid_t*>(payload_start)) = txid;
+            *(reinterpret_cast<zx_txid_t*>(payload_start())) = txid;
         }
     }
 
@@ -106,6 +111,14 @@ private:
     static zx_status_t CreateCommon(uint32_t data_size, uint32_t num_handles,
                                     MessagePacketPtr* msg);
 
+    // Whether the packet is stored inline or in a BufferChain, it is followed
+    // by its handles and then by the start of its payload, which is always
+    // contiguous with it for at least sizeof(zx_txid_t) bytes.
+    char* payload_start() const {
+        return reinterpret_cast<char*>(const_cast<MessagePacket*>(this)) + payload_offset_;
+    }
+
+    // nullptr if the packet is stored inline.
     BufferChain* buffer_chain_;
     Handle** const handles_;
     const uint32_t data_size_;
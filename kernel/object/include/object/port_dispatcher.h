@@ -21,6 +21,7 @@
 #include <fbl/mutex.h>
 #include <ktl/unique_ptr.h>
 #include <kernel/spinlock.h>
+#include <lib/object_cache.h>
 
 #include <sys/types.h>
 
@@ -87,6 +88,9 @@ class PortDispatcher;
 class PortObserver;
 struct PortPacket;
 
+// One PortObserver is created and destroyed per zx_object_wait_async().
+using PortObserverCacheTraits = object_cache::ObjectCacheTraits<PortObserver>;
+
 struct PortAllocator {
     virtual ~PortAllocator() = default;
 
@@ -116,7 +120,8 @@ struct PortInterruptPacket final : public fbl::DoublyLinkedListable<PortInterrup
 
 // Observers are weakly contained in Dispatchers until their OnInitialize(), OnStateChange() or
 // OnCancel() callbacks return StateObserver::kNeedRemoval.
-class PortObserver final : public StateObserver {
+class PortObserver final : public StateObserver,
+                           public object_cache::ObjectCacheAllocated<PortObserverCacheTraits> {
 public:
     using ListNodeState = fbl::DoublyLinkedListNodeState<PortObserver*>;
 
@@ -169,6 +174,8 @@ private:
     fbl::RefPtr<Dispatcher> dispatcher_;
 };
 
+FWD_DECL_OBJECT_CACHE(PortObserverCacheTraits);
+
 // The PortDispatcher implements the port kernel object which is the cornerstone
 // for waiting on object changes in Zircon. The PortDispatcher handles 4 usage
 // cases:
@@ -207,6 +214,9 @@ public:
     zx_status_t QueueUser(const zx_port_packet_t& packet);
     bool QueueInterruptPacket(PortInterruptPacket* port_packet, zx_time_t timestamp);
     zx_status_t Dequeue(const Deadline& deadline, zx_port_packet_t* packet);
+    // Moves up to |max_packets| packets that are already queued to |packets| without blocking,
+    // in the same order Dequeue() would return them. Returns the number of packets moved.
+    size_t DequeueAvailable(zx_port_packet_t* packets, size_t max_packets);
     bool RemoveInterruptPacket(PortInterruptPacket* port_packet);
 
     // This method determines the observer's fate. Upon return, one of the following will have
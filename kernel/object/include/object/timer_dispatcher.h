@@ -14,12 +14,18 @@
 
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
+#include <lib/object_cache.h>
 #include <object/dispatcher.h>
 #include <object/handle.h>
 
 #include <sys/types.h>
 
-class TimerDispatcher final : public SoloDispatcher<TimerDispatcher, ZX_DEFAULT_TIMER_RIGHTS> {
+class TimerDispatcher;
+using TimerDispatcherCacheTraits = object_cache::ObjectCacheTraits<TimerDispatcher>;
+
+class TimerDispatcher final :
+    public SoloDispatcher<TimerDispatcher, ZX_DEFAULT_TIMER_RIGHTS>,
+    public object_cache::ObjectCacheAllocated<TimerDispatcherCacheTraits> {
 public:
     static zx_status_t Create(uint32_t options,
                               KernelHandle<TimerDispatcher>* handle,
@@ -48,3 +54,5 @@ private:
     bool cancel_pending_ TA_GUARDED(get_lock());
     timer_t timer_ TA_GUARDED(get_lock());
 };
+
+FWD_DECL_OBJECT_CACHE(TimerDispatcherCacheTraits);
@@ -6,8 +6,11 @@
 
 #include <object/message_packet.h>
 
+#include <debug.h>
 #include <err.h>
 #include <fbl/algorithm.h>
+#include <lib/counters.h>
+#include <lib/object_cache.h>
 #include <new>
 #include <stdint.h>
 #include <string.h>
@@ -21,6 +24,37 @@
 //
 // The first buffer in a MessagePacket's BufferChain contains the MessagePacket object, followed by
 // its handles (if any), and finally its payload data (if any).
+//
+// Most messages are far smaller than a page though, so packets whose MessagePacket object, handles
+// and payload all fit in kSmallPacketSize bytes are instead laid out the same way in a slot of a
+// dedicated object cache, and have no BufferChain at all.  The cache keeps freed slots per cpu, so
+// the common write/read cycle takes no global lock.  If a slot can't be allocated they fall back
+// to a BufferChain.
+
+KCOUNTER(channel_packet_inline, "channel.packet.inline")
+KCOUNTER(channel_packet_chain, "channel.packet.chain")
+KCOUNTER(small_packet_cache_hit, "object_cache.msg_packet.hit")
+KCOUNTER(small_packet_cache_miss, "object_cache.msg_packet.miss")
+KCOUNTER(small_packet_cache_reclaimed, "object_cache.msg_packet.reclaimed")
+
+namespace {
+
+constexpr size_t kSmallPacketSize = 256;
+
+// Up to 32 slots per cpu, and 256KiB worth shared between them.
+constexpr size_t kSmallPacketMagazineSize = object_cache::ObjectCache::kMaxMagazineSize;
+constexpr size_t kSmallPacketDepotMax = 1024;
+
+struct alignas(alignof(MessagePacket)) SmallPacketSlot {
+    char data[kSmallPacketSize];
+};
+
+object_cache::ObjectCache small_packet_cache("msg_packet", sizeof(SmallPacketSlot),
+                                             kSmallPacketMagazineSize, kSmallPacketDepotMax,
+                                             &small_packet_cache_hit, &small_packet_cache_miss,
+                                             &small_packet_cache_reclaimed);
+
+} // namespace
 
 // The MessagePacket object, its handles and zx_txid_t must all fit in the first buffer.
 static constexpr size_t kContiguousBytes =
@@ -50,6 +84,20 @@ inline zx_status_t MessagePacket::CreateCommon(uint32_t data_size, uint32_t num_
     }
 
     const uint32_t payload_offset = PayloadOffset(num_handles);
+    static_assert(kMaxMessageHandles <= UINT16_MAX, "");
+
+    if (payload_offset + data_size <= kSmallPacketSize) {
+        auto slot = static_cast<SmallPacketSlot*>(small_packet_cache.Alloc());
+        if (likely(slot)) {
+            char* const data = slot->data;
+            Handle** const handles = reinterpret_cast<Handle**>(data + kHandlesOffset);
+            MessagePacket* const packet = reinterpret_cast<MessagePacket*>(data);
+            msg->reset(new (packet) MessagePacket(nullptr, data_size, payload_offset,
+                                                  static_cast<uint16_t>(num_handles), handles));
+            kcounter_add(channel_packet_inline, 1);
+            return ZX_OK;
+        }
+    }
 
     // MessagePackets lives *inside* a list of buffers.  The first buffer holds the MessagePacket
     // object, followed by its handles (if any), and finally the payload data.
@@ -58,13 +106,13 @@ inline zx_status_t MessagePacket::CreateCommon(uint32_t data_size, uint32_t num_
         return ZX_ERR_NO_MEMORY;
     }
     DEBUG_ASSERT(!chain->buffers()->is_empty());
+    kcounter_add(channel_packet_chain, 1);
 
     char* const data = chain->buffers()->front().data();
     Handle** const handles = reinterpret_cast<Handle**>(data + kHandlesOffset);
 
     // Construct the MessagePacket into the first buffer.
     MessagePacket* const packet = reinterpret_cast<MessagePacket*>(data);
-    static_assert(kMaxMessageHandles <= UINT16_MAX, "");
     msg->reset(new (packet) MessagePacket(chain, data_size, payload_offset,
                                           static_cast<uint16_t>(num_handles), handles));
     // The MessagePacket now owns the BufferChain and msg owns the MessagePacket.
@@ -80,7 +128,11 @@ zx_status_t MessagePacket::Create(user_in_ptr<const void> data, uint32_t data_si
     if (unlikely(status != ZX_OK)) {
         return status;
     }
-    status = new_msg->buffer_chain_->CopyIn(data, PayloadOffset(num_handles), data_size);
+    if (new_msg->is_inline()) {
+        status = data.copy_array_from_user(new_msg->payload_start(), data_size);
+    } else {
+        status = new_msg->buffer_chain_->CopyIn(data, PayloadOffset(num_handles), data_size);
+    }
     if (unlikely(status != ZX_OK)) {
         return status;
     }
@@ -96,7 +148,12 @@ zx_status_t MessagePacket::Create(const void* data, uint32_t data_size, uint32_t
     if (unlikely(status != ZX_OK)) {
         return status;
     }
-    status = new_msg->buffer_chain_->CopyInKernel(data, PayloadOffset(num_handles), data_size);
+    if (new_msg->is_inline()) {
+        memcpy(new_msg->payload_start(), data, data_size);
+    } else {
+        status = new_msg->buffer_chain_->CopyInKernel(data, PayloadOffset(num_handles),
+                                                      data_size);
+    }
     if (unlikely(status != ZX_OK)) {
         return status;
     }
@@ -109,9 +166,13 @@ void MessagePacket::recycle(MessagePacket* packet) {
     BufferChain* chain = packet->buffer_chain_;
 
     // Manually destruct the packet.  Do not delete it; its memory did not come
-    // from new, it is contained as part of the buffer chain.
+    // from new, it is contained as part of the buffer chain or a small packet slot.
     packet->~MessagePacket();
 
-    // Now return the buffer chain to where it came from.
+    // Now return the memory to where it came from.
+    if (!chain) {
+        small_packet_cache.Free(packet);
+        return;
+    }
     BufferChain::Free(chain);
 }
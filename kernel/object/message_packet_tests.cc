@@ -141,6 +141,56 @@ static bool copy_bad_mem() {
     END_TEST;
 }
 
+// Small messages are stored inline, large ones in a BufferChain, and both
+// round trip their payload and txid the same way.
+static bool create_inline_and_chained() {
+    BEGIN_TEST;
+    constexpr size_t kMaxSize = 4096;
+    ktl::unique_ptr<UserMemory> mem = UserMemory::Create(kMaxSize);
+    auto mem_in = make_user_in_ptr(mem->in());
+    auto mem_out = make_user_out_ptr(mem->out());
+
+    fbl::AllocChecker ac;
+    auto buf = ktl::unique_ptr<char[]>(new (&ac) char[kMaxSize]);
+    ASSERT_TRUE(ac.check(), "");
+    auto result_buf = ktl::unique_ptr<char[]>(new (&ac) char[kMaxSize]);
+    ASSERT_TRUE(ac.check(), "");
+    for (size_t i = 0; i < kMaxSize; ++i) {
+        buf[i] = static_cast<char>(i);
+    }
+    ASSERT_EQ(ZX_OK, mem_out.copy_array_to_user(buf.get(), kMaxSize), "");
+
+    struct {
+        uint32_t size;
+        uint32_t num_handles;
+        bool is_inline;
+    } const kCases[] = {
+        {16, 0, true},
+        {64, 2, true},
+        {64, 64, false},
+        {kMaxSize, 0, false},
+    };
+    for (const auto& c : kCases) {
+        MessagePacketPtr mp;
+        ASSERT_EQ(ZX_OK, MessagePacket::Create(mem_in, c.size, c.num_handles, &mp), "");
+        EXPECT_EQ(c.is_inline, mp->is_inline(), "");
+        EXPECT_EQ(*reinterpret_cast<zx_txid_t*>(buf.get()), mp->get_txid(), "");
+        mp->set_txid(0x12345678);
+        EXPECT_EQ(0x12345678u, mp->get_txid(), "");
+
+        memset(result_buf.get(), 0, kMaxSize);
+        ASSERT_EQ(ZX_OK, mp->CopyDataTo(mem_out), "");
+        ASSERT_EQ(ZX_OK, mem_in.copy_array_from_user(result_buf.get(), c.size), "");
+        EXPECT_EQ(0x12345678u, *reinterpret_cast<zx_txid_t*>(result_buf.get()), "");
+        EXPECT_EQ(0, memcmp(buf.get() + sizeof(zx_txid_t), result_buf.get() + sizeof(zx_txid_t),
+                            c.size - sizeof(zx_txid_t)), "");
+
+        // restore the original txid for the next case
+        ASSERT_EQ(ZX_OK, mem_out.copy_array_to_user(buf.get(), kMaxSize), "");
+    }
+    END_TEST;
+}
+
 }  // namespace
 
 UNITTEST_START_TESTCASE(message_packet_tests)
@@ -150,4 +200,5 @@ UNITTEST("create_zero", create_zero)
 UNITTEST("create_too_many_handles", create_too_many_handles)
 UNITTEST("create_bad_mem", create_bad_mem)
 UNITTEST("copy_bad_mem", copy_bad_mem)
+UNITTEST("create_inline_and_chained", create_inline_and_chained)
 UNITTEST_END_TESTCASE(message_packet_tests, "message_packet", "MessagePacket tests");
@@ -40,6 +40,8 @@ KCOUNTER(port_full_count, "port.full.count")
 KCOUNTER(dispatcher_port_create_count, "dispatcher.port.create")
 KCOUNTER(dispatcher_port_destroy_count, "dispatcher.port.destroy")
 
+DECLARE_OBJECT_CACHE_STORAGE(PortObserverCacheTraits, port_observer_cache, "port_observer");
+
 class ArenaPortAllocator final : public PortAllocator {
 public:
     zx_status_t Init();
@@ -336,42 +338,8 @@ zx_status_t PortDispatcher::Dequeue(const Deadline& deadline,
     canary_.Assert();
 
     while (true) {
-        if (options_ == ZX_PORT_BIND_TO_INTERRUPT) {
-            Guard<SpinLock, IrqSave> guard{&spinlock_};
-            PortInterruptPacket* port_interrupt_packet = interrupt_packets_.pop_front();
-            if (port_interrupt_packet != nullptr) {
-                *out_packet = {};
-                out_packet->key = port_interrupt_packet->key;
-                out_packet->type = ZX_PKT_TYPE_INTERRUPT;
-                out_packet->status = ZX_OK;
-                out_packet->interrupt.timestamp = port_interrupt_packet->timestamp;
-                return ZX_OK;
-            }
-        }
-        {
-            Guard<fbl::Mutex> guard{get_lock()};
-            PortPacket* port_packet = packets_.pop_front();
-            if (port_packet != nullptr) {
-                if (IsDefaultAllocatedEphemeral(*port_packet)) {
-                    --num_ephemeral_packets_;
-                }
-                *out_packet = port_packet->packet;
-
-                bool is_ephemeral = port_packet->is_ephemeral();
-                // The reference to the port that the observer holds cannot be the last one
-                // because another reference was used to call Dequeue, so we don't need to
-                // worry about destroying ourselves.
-                port_packet->observer.reset();
-                guard.Release();
-
-                // If the packet is ephemeral, free it outside of the lock. We need to read
-                // is_ephemeral inside the lock because it's possible for a non-ephemeral packet
-                // to get deleted after a call to |MaybeReap| as soon as we release the lock.
-                if (is_ephemeral) {
-                    port_packet->Free();
-                }
-                return ZX_OK;
-            }
+        if (DequeueAvailable(out_packet, 1) != 0) {
+            return ZX_OK;
         }
 
         {
@@ -383,6 +351,63 @@ zx_status_t PortDispatcher::Dequeue(const Deadline& deadline,
     }
 }
 
+size_t PortDispatcher::DequeueAvailable(zx_port_packet_t* out_packets, size_t max_packets) {
+    canary_.Assert();
+
+    size_t count = 0;
+    if (options_ == ZX_PORT_BIND_TO_INTERRUPT) {
+        Guard<SpinLock, IrqSave> guard{&spinlock_};
+        while (count < max_packets) {
+            PortInterruptPacket* port_interrupt_packet = interrupt_packets_.pop_front();
+            if (port_interrupt_packet == nullptr) {
+                break;
+            }
+            zx_port_packet_t* out_packet = &out_packets[count++];
+            *out_packet = {};
+            out_packet->key = port_interrupt_packet->key;
+            out_packet->type = ZX_PKT_TYPE_INTERRUPT;
+            out_packet->status = ZX_OK;
+            out_packet->interrupt.timestamp = port_interrupt_packet->timestamp;
+        }
+    }
+    if (count == max_packets) {
+        return count;
+    }
+
+    // Ephemeral packets are freed outside of the lock.
+    fbl::DoublyLinkedList<PortPacket*> ephemeral_packets;
+    {
+        Guard<fbl::Mutex> guard{get_lock()};
+        while (count < max_packets) {
+            PortPacket* port_packet = packets_.pop_front();
+            if (port_packet == nullptr) {
+                break;
+            }
+            if (IsDefaultAllocatedEphemeral(*port_packet)) {
+                --num_ephemeral_packets_;
+            }
+            out_packets[count++] = port_packet->packet;
+
+            // We need to read is_ephemeral inside the lock, and before dropping the observer,
+            // because it's possible for a non-ephemeral packet to get deleted after a call to
+            // |MaybeReap| as soon as we release the lock.
+            bool is_ephemeral = port_packet->is_ephemeral();
+            // The reference to the port that the observer holds cannot be the last one
+            // because another reference was used to call Dequeue, so we don't need to
+            // worry about destroying ourselves.
+            port_packet->observer.reset();
+            if (is_ephemeral) {
+                ephemeral_packets.push_back(port_packet);
+            }
+        }
+    }
+
+    while (!ephemeral_packets.is_empty()) {
+        ephemeral_packets.pop_front()->Free();
+    }
+    return count;
+}
+
 void PortDispatcher::MaybeReap(PortObserver* observer, PortPacket* port_packet) {
     canary_.Assert();
 
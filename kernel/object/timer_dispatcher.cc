@@ -22,6 +22,8 @@
 KCOUNTER(dispatcher_timer_create_count, "dispatcher.timer.create")
 KCOUNTER(dispatcher_timer_destroy_count, "dispatcher.timer.destroy")
 
+DECLARE_OBJECT_CACHE_STORAGE(TimerDispatcherCacheTraits, timer_cache, "timer_dispatcher");
+
 static void timer_irq_callback(timer* timer, zx_time_t now, void* arg) {
     // We are in IRQ context and cannot touch the timer state_tracker, so we
     // schedule a DPC to do so. TODO(cpu): figure out ways to reduce the lag.
@@ -70,6 +70,7 @@ zx_status_t split_syscall_flags(
     vmar |= ExtractFlag<ZX_VM_CAN_MAP_EXECUTE, VMAR_FLAG_CAN_MAP_EXECUTE>(&flags);
     vmar |= ExtractFlag<ZX_VM_REQUIRE_NON_RESIZABLE, VMAR_FLAG_REQUIRE_NON_RESIZABLE>(&flags);
     vmar |= ExtractFlag<ZX_VM_ALLOW_FAULTS, VMAR_FLAG_ALLOW_FAULTS>(&flags);
+    vmar |= ExtractFlag<ZX_VM_FAULT_AROUND, VMAR_FLAG_FAULT_AROUND>(&flags);
 
     if (flags & ((1u << ZX_VM_ALIGN_BASE) - 1u)) {
         return ZX_ERR_INVALID_ARGS;
@@ -128,6 +128,22 @@ zx_status_t sys_ktrace_read(zx_handle_t handle, user_out_ptr<void> _data,
     return _actual.copy_to_user(static_cast<size_t>(result));
 }
 
+// zx_status_t zx_ktrace_read_stream
+zx_status_t sys_ktrace_read_stream(zx_handle_t handle, user_out_ptr<void> _data, size_t len,
+                                   user_out_ptr<size_t> _actual) {
+    // TODO(ZX-971): finer grained validation
+    zx_status_t status;
+    if ((status = validate_resource(handle, ZX_RSRC_KIND_ROOT)) < 0) {
+        return status;
+    }
+
+    ssize_t result = ktrace_read_stream_user(_data.get(), len);
+    if (result < 0)
+        return static_cast<zx_status_t>(result);
+
+    return _actual.copy_to_user(static_cast<size_t>(result));
+}
+
 // zx_status_t zx_ktrace_control
 zx_status_t sys_ktrace_control(
     zx_handle_t handle, uint32_t action, uint32_t options, user_inout_ptr<void> _ptr) {
@@ -162,14 +178,11 @@ zx_status_t sys_ktrace_write(zx_handle_t handle, uint32_t event_id, uint32_t arg
         return ZX_ERR_INVALID_ARGS;
     }
 
-    uint32_t* args = static_cast<uint32_t*>(ktrace_open(TAG_PROBE_24(event_id)));
-    if (!args) {
+    const uint32_t args[] = {arg0, arg1};
+    if (!ktrace_write(TAG_PROBE_24(event_id), args, sizeof(args))) {
         //  There is not a single reason for failure. Assume it reached the end.
         return ZX_ERR_UNAVAILABLE;
     }
-
-    args[0] = arg0;
-    args[1] = arg1;
     return ZX_OK;
 }
 
@@ -7,6 +7,7 @@
 #include <err.h>
 #include <kernel/stats.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <lib/userabi/vdso.h>
 #include <object/process_dispatcher.h>
@@ -23,6 +24,8 @@
 
 #define LOCAL_TRACE 0
 
+KCOUNTER_HISTOGRAM(syscall_latency, "syscall.latency_ns")
+
 int sys_invalid_syscall(uint64_t num, uint64_t pc,
                         uintptr_t vdso_code_address) {
     LTRACEF("invalid syscall %lu from PC %#lx vDSO code %#lx\n",
@@ -41,6 +44,7 @@ inline syscall_result do_syscall(uint64_t syscall_num, uint64_t pc,
     ktrace_tiny(TAG_SYSCALL_ENTER, (static_cast<uint32_t>(syscall_num) << 8) | arch_curr_cpu_num());
 
     CPU_STATS_INC(syscalls);
+    const zx_time_t start = current_time();
 
     /* re-enable interrupts to maintain kernel preemptiveness
        This must be done after the above ktrace_tiny call, and after the
@@ -67,6 +71,7 @@ inline syscall_result do_syscall(uint64_t syscall_num, uint64_t pc,
     arch_disable_ints();
 
     ktrace_tiny(TAG_SYSCALL_EXIT, (static_cast<uint32_t>(syscall_num << 8)) | arch_curr_cpu_num());
+    kcounter_histogram_add(syscall_latency, current_time() - start);
 
     // The assembler caller will re-disable interrupts at the appropriate time.
     return {ret, thread_is_signaled(get_current_thread())};
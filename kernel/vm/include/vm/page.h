@@ -13,6 +13,9 @@
 #include <vm/page_state.h>
 #include <zircon/compiler.h>
 
+// vm_page_t::flags
+#define VM_PAGE_FLAG_ZEROED (0x1) // free page known to be zero filled, owned by the pmm
+
 // core per page structure allocated at pmm arena creation time
 typedef struct vm_page {
     struct list_node queue_node;
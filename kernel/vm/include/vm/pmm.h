@@ -32,6 +32,7 @@ zx_status_t pmm_add_arena(const pmm_arena_info_t* arena) __NONNULL((1));
 // flags for allocation routines below
 #define PMM_ALLOC_FLAG_ANY (0x0)    // no restrictions on which arena to allocate from
 #define PMM_ALLOC_FLAG_LO_MEM (0x1) // allocate only from arenas marked LO_MEM
+#define PMM_ALLOC_FLAG_ZEROED (0x2) // return zero filled pages (pmm_alloc_page(s) only)
 
 // Allocate count pages of physical memory, adding to the tail of the passed list.
 // The list must be initialized.
@@ -63,6 +64,16 @@ uint64_t pmm_count_free_pages();
 // Return amount of physical memory in system, in bytes.
 uint64_t pmm_count_total_bytes();
 
+// Configure the per-cpu page caches that sit in front of the physical allocator.
+// Each cpu's cache is refilled from the free list |batch| pages at a time and is
+// drained back down to |low| pages once it holds more than |high| pages.
+// Passing a |high| of zero disables the caches.
+zx_status_t pmm_set_cpu_cache_watermarks(size_t high, size_t low, size_t batch);
+void pmm_get_cpu_cache_watermarks(size_t* high, size_t* low, size_t* batch) __NONNULL((1, 2, 3));
+
+// Return all pages held in per-cpu caches to the free list.
+void pmm_drain_cpu_caches();
+
 // virtual to physical
 paddr_t vaddr_to_paddr(const void* va);
 
@@ -46,6 +46,9 @@
 #define VMAR_FLAG_REQUIRE_NON_RESIZABLE (1 << 7)
 // Allow VMO backings that could result in faults.
 #define VMAR_FLAG_ALLOW_FAULTS (1 << 8)
+// On a read fault, also map the following pages of the VMO that are already
+// present, up to the fault-around window.
+#define VMAR_FLAG_FAULT_AROUND (1 << 9)
 
 #define VMAR_CAN_RWX_FLAGS (VMAR_FLAG_CAN_MAP_READ |  \
                             VMAR_FLAG_CAN_MAP_WRITE | \
@@ -468,7 +471,7 @@ protected:
     friend class VmObject;
 
     // unmap any pages that map the passed in vmo range. May not intersect with this range
-    zx_status_t UnmapVmoRangeLocked(uint64_t start, uint64_t size) const;
+    zx_status_t UnmapVmoRangeLocked(uint64_t start, uint64_t size);
 
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmMapping);
@@ -496,6 +499,21 @@ private:
     // Version of AllocatedPages() that does not acquire the aspace lock
     size_t AllocatedPagesLocked() const override;
 
+    // Returns true, with the block's base in |block_va|, if the large page
+    // sized block around |va| may be mapped with a single entry: the vmo is
+    // contiguous and the block is entirely inside the mapping.
+    bool LargePageBlockLocked(vaddr_t va, vaddr_t* block_va) const;
+
+    // Try to map the large page sized block around |va|, which faulted in
+    // physical page |pa|, with a single entry and |mmu_flags|. Returns false if
+    // the block is not entirely present, physically aligned and unmapped.
+    bool MapLargePageLocked(vaddr_t va, paddr_t pa, uint mmu_flags);
+
+    // Speculatively map the pages in the fault-around window containing |va|
+    // that are already present in the vmo, read-only. Called from PageFault()
+    // after a read fault on |va| has been resolved.
+    void FaultAroundLocked(vaddr_t va, uint mmu_flags);
+
     void Activate() override;
 
     // Version of Activate that does not take the object_ lock.
@@ -512,4 +530,14 @@ private:
 
     // used to detect recursions through the vmo fault path
     bool currently_faulting_ = false;
+
+    // base of the last block MapLargePageLocked() found could not be mapped
+    // whole, or 0. Reset whenever pages are unmapped or the mapping changes,
+    // as the block may then become mappable.
+    vaddr_t large_page_failed_block_ = 0;
+
+    // end of the last fault-around window and the number of pages mapped in it,
+    // used to tell when a reader has streamed through the window
+    vaddr_t fault_around_end_ = 0;
+    size_t fault_around_pages_ = 0;
 };
@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
 #include <kernel/timer.h>
 #include <lib/console.h>
@@ -47,6 +48,31 @@ static void pmm_enforce_fill(uint level) {
 LK_INIT_HOOK(pmm_fill, &pmm_enforce_fill, LK_INIT_LEVEL_VM);
 #endif
 
+static void pmm_init_cpu_caches(uint level) {
+    // Be sure to update kernel_cmdline.md if any of these defaults change.
+    const size_t high = cmdline_get_uint64("kernel.pmm.cpu-cache-high",
+                                           PMM_CPU_CACHE_DEFAULT_HIGH_WATERMARK);
+    const size_t low = cmdline_get_uint64("kernel.pmm.cpu-cache-low",
+                                          PMM_CPU_CACHE_DEFAULT_LOW_WATERMARK);
+    const size_t batch = cmdline_get_uint64("kernel.pmm.cpu-cache-batch",
+                                            PMM_CPU_CACHE_DEFAULT_BATCH);
+
+    zx_status_t status = pmm_node.SetCpuCacheWatermarks(high, low, batch);
+    if (status != ZX_OK) {
+        printf("PMM: invalid cpu cache watermarks (high %zu low %zu batch %zu), caches disabled\n",
+               high, low, batch);
+        pmm_node.SetCpuCacheWatermarks(0, 0, 0);
+    }
+}
+LK_INIT_HOOK(pmm_cpu_caches, &pmm_init_cpu_caches, LK_INIT_LEVEL_THREADING);
+
+static void pmm_init_zero_pool(uint level) {
+    // Be sure to update kernel_cmdline.md if this default changes.
+    pmm_node.StartZeroThread(cmdline_get_uint64("kernel.pmm.zero-pool-pages",
+                                                PMM_ZERO_POOL_DEFAULT_PAGES));
+}
+LK_INIT_HOOK(pmm_zero_pool, &pmm_init_zero_pool, LK_INIT_LEVEL_THREADING);
+
 vm_page_t* paddr_to_vm_page(paddr_t addr) {
     return pmm_node.PaddrToPage(addr);
 }
@@ -107,6 +133,18 @@ uint64_t pmm_count_total_bytes() {
     return pmm_node.CountTotalBytes();
 }
 
+zx_status_t pmm_set_cpu_cache_watermarks(size_t high, size_t low, size_t batch) {
+    return pmm_node.SetCpuCacheWatermarks(high, low, batch);
+}
+
+void pmm_get_cpu_cache_watermarks(size_t* high, size_t* low, size_t* batch) {
+    pmm_node.GetCpuCacheWatermarks(high, low, batch);
+}
+
+void pmm_drain_cpu_caches() {
+    pmm_node.DrainCpuCaches();
+}
+
 static void pmm_dump_timer(struct timer* t, zx_time_t now, void*) {
     zx_time_t deadline = zx_time_add_duration(now, ZX_SEC(1));
     timer_set_oneshot(t, deadline, &pmm_dump_timer, nullptr);
@@ -123,6 +161,8 @@ static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
         printf("%s dump\n", argv[0].str);
         if (!is_panic) {
             printf("%s free\n", argv[0].str);
+            printf("%s cache <high> <low> <batch>\n", argv[0].str);
+            printf("%s drain\n", argv[0].str);
         }
         return ZX_ERR_INTERNAL;
     }
@@ -149,6 +189,18 @@ static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
             timer_cancel(&timer);
             show_mem = false;
         }
+    } else if (!strcmp(argv[1].str, "cache")) {
+        if (argc < 5) {
+            printf("not enough arguments\n");
+            goto usage;
+        }
+        zx_status_t status = pmm_node.SetCpuCacheWatermarks(argv[2].u, argv[3].u, argv[4].u);
+        if (status != ZX_OK) {
+            printf("invalid watermarks: low and batch must not exceed high\n");
+            return status;
+        }
+    } else if (!strcmp(argv[1].str, "drain")) {
+        pmm_node.DrainCpuCaches();
     } else {
         printf("unknown command\n");
         goto usage;
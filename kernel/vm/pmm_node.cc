@@ -7,7 +7,10 @@
 
 #include <inttypes.h>
 #include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
 #include <new>
+#include <platform.h>
 #include <trace.h>
 #include <vm/bootalloc.h>
 #include <vm/physmap.h>
@@ -16,6 +19,15 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(pmm_cache_hit, "pmm.cpu_cache.hit")
+KCOUNTER(pmm_cache_miss, "pmm.cpu_cache.miss")
+KCOUNTER(pmm_cache_refill, "pmm.cpu_cache.refill")
+KCOUNTER(pmm_cache_drain, "pmm.cpu_cache.drain")
+KCOUNTER(pmm_zero_pool_hit, "pmm.zero_pool.hit")
+KCOUNTER(pmm_zero_pool_miss, "pmm.zero_pool.miss")
+KCOUNTER(pmm_zero_pool_pages_zeroed, "pmm.zero_pool.pages_zeroed")
+KCOUNTER(pmm_zero_pool_zero_time, "pmm.zero_pool.zero_time_usec")
+
 PmmNode::PmmNode() {
 }
 
@@ -92,18 +104,84 @@ static void alloc_page_helper(vm_page* page) {
 #endif
 }
 
+// pages going into a per-cpu cache look allocated to everyone but the cache
+static void cache_page_helper(vm_page* page) {
+    DEBUG_ASSERT(page->state() != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
+    DEBUG_ASSERT(!page->is_free());
+
+    page->set_state(VM_PAGE_STATE_ALLOC);
+}
+
+size_t PmmNode::TakeFreePagesLocked(size_t count, list_node* list) {
+    if (count > free_count_) {
+        count = free_count_;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    free_count_ -= count;
+
+    auto node = &free_list_;
+    for (size_t i = 0; i < count; i++) {
+        node = list_next(&free_list_, node);
+        alloc_page_helper(containerof(node, vm_page, queue_node));
+    }
+
+    list_node tmp_list = LIST_INITIAL_VALUE(tmp_list);
+    list_split_after(&free_list_, node, &tmp_list);
+    if (list_is_empty(list)) {
+        list_move(&free_list_, list);
+    } else {
+        list_splice_after(&free_list_, list_peek_tail(list));
+    }
+    list_move(&tmp_list, &free_list_);
+
+    return count;
+}
+
+zx_status_t PmmNode::AllocPagesFromNode(size_t count, list_node* list) {
+    for (bool drained = false;; drained = true) {
+        {
+            Guard<fbl::Mutex> guard{&lock_};
+            if (unlikely(count > free_count_) && count <= free_count_ + zeroed_count_) {
+                // dip into the zero pool rather than failing
+                ReturnZeroedPagesLocked();
+            }
+            if (likely(count <= free_count_)) {
+                TakeFreePagesLocked(count, list);
+                return ZX_OK;
+            }
+        }
+
+        // the free list came up short; pull back whatever is parked in the
+        // per-cpu caches and try once more before giving up
+        if (drained || CountCachedPages() == 0) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        DrainCpuCaches();
+    }
+}
+
 zx_status_t PmmNode::AllocPage(uint alloc_flags, vm_page_t** page_out, paddr_t* pa_out) {
-    Guard<fbl::Mutex> guard{&lock_};
+    list_node list = LIST_INITIAL_VALUE(list);
 
-    vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
-    if (!page) {
-        return ZX_ERR_NO_MEMORY;
+    const bool want_zeroed = alloc_flags & PMM_ALLOC_FLAG_ZEROED;
+    const bool zeroed = want_zeroed && AllocZeroedPage(&list);
+
+    if (!zeroed && !CpuCacheAlloc(1, &list)) {
+        zx_status_t status = AllocPagesFromNode(1, &list);
+        if (status != ZX_OK) {
+            return status;
+        }
     }
 
-    alloc_page_helper(page);
+    vm_page* page = list_remove_head_type(&list, vm_page, queue_node);
+    DEBUG_ASSERT(page);
 
-    DEBUG_ASSERT(free_count_ > 0);
-    free_count_--;
+    if (want_zeroed && !zeroed) {
+        // the pool was dry, do it the slow way
+        arch_zero_page(paddr_to_physmap(page->paddr()));
+    }
 
     if (pa_out) {
         *pa_out = page->paddr();
@@ -124,36 +202,32 @@ zx_status_t PmmNode::AllocPages(size_t count, uint alloc_flags, list_node* list)
 
     if (unlikely(count == 0)) {
         return ZX_OK;
-    } else if (count == 1) {
-        vm_page* page;
-        zx_status_t status = AllocPage(alloc_flags, &page, nullptr);
-        if (likely(status == ZX_OK)) {
-            list_add_tail(list, &page->queue_node);
-        }
-        return status;
     }
 
-    Guard<fbl::Mutex> guard{&lock_};
-
-    if (unlikely(count > free_count_)) {
-        return ZX_ERR_NO_MEMORY;
-    }
-    free_count_ -= count;
-
-    auto node = &free_list_;
-    while (count-- > 0) {
-        node = list_next(&free_list_, node);
-        alloc_page_helper(containerof(node, vm_page, queue_node));
+    list_node tmp_list = LIST_INITIAL_VALUE(tmp_list);
+    if (alloc_flags & PMM_ALLOC_FLAG_ZEROED) {
+        // zeroed pages come out of the pool one at a time
+        for (size_t i = 0; i < count; i++) {
+            vm_page* page;
+            zx_status_t status = AllocPage(alloc_flags, &page, nullptr);
+            if (status != ZX_OK) {
+                FreeList(&tmp_list);
+                return status;
+            }
+            list_add_tail(&tmp_list, &page->queue_node);
+        }
+    } else if (!CpuCacheAlloc(count, &tmp_list)) {
+        zx_status_t status = AllocPagesFromNode(count, &tmp_list);
+        if (status != ZX_OK) {
+            return status;
+        }
     }
 
-    list_node tmp_list = LIST_INITIAL_VALUE(tmp_list);
-    list_split_after(&free_list_, node, &tmp_list);
     if (list_is_empty(list)) {
-        list_move(&free_list_, list);
+        list_move(&tmp_list, list);
     } else {
-        list_splice_after(&free_list_, list_peek_tail(list));
+        list_splice_after(&tmp_list, list_peek_tail(list));
     }
-    list_move(&tmp_list, &free_list_);
 
     return ZX_OK;
 }
@@ -164,14 +238,30 @@ zx_status_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list)
     // list must be initialized prior to calling this
     DEBUG_ASSERT(list);
 
-    size_t allocated = 0;
     if (count == 0) {
         return ZX_OK;
     }
 
     address = ROUNDDOWN(address, PAGE_SIZE);
 
-    Guard<fbl::Mutex> guard{&lock_};
+    zx_status_t status;
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+        status = AllocRangeLocked(address, count, list);
+    }
+    if (status == ZX_ERR_NOT_FOUND && CountCachedPages() > 0) {
+        // part of the range may be parked in a per-cpu cache
+        DrainCpuCaches();
+
+        Guard<fbl::Mutex> guard{&lock_};
+        status = AllocRangeLocked(address, count, list);
+    }
+
+    return status;
+}
+
+zx_status_t PmmNode::AllocRangeLocked(paddr_t address, size_t count, list_node* list) {
+    size_t allocated = 0;
 
     // walk through the arenas, looking to see if the physical page belongs to it
     for (auto& a : arena_list_) {
@@ -185,7 +275,7 @@ zx_status_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list)
                 break;
             }
 
-            list_delete(&page->queue_node);
+            UnlinkFreePageLocked(page);
 
             page->set_state(VM_PAGE_STATE_ALLOC);
 
@@ -193,7 +283,6 @@ zx_status_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list)
 
             allocated++;
             address += PAGE_SIZE;
-            free_count_--;
         }
 
         if (allocated == count) {
@@ -225,8 +314,24 @@ zx_status_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8
     DEBUG_ASSERT(pa);
     DEBUG_ASSERT(list);
 
-    Guard<fbl::Mutex> guard{&lock_};
+    zx_status_t status;
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+        status = AllocContiguousLocked(count, alignment_log2, pa, list);
+    }
+    if (status == ZX_ERR_NOT_FOUND && CountCachedPages() > 0) {
+        // the run may be broken up by pages parked in per-cpu caches
+        DrainCpuCaches();
 
+        Guard<fbl::Mutex> guard{&lock_};
+        status = AllocContiguousLocked(count, alignment_log2, pa, list);
+    }
+
+    return status;
+}
+
+zx_status_t PmmNode::AllocContiguousLocked(size_t count, uint8_t alignment_log2, paddr_t* pa,
+                                           list_node* list) {
     for (auto& a : arena_list_) {
         vm_page_t* p = a.FindFreeContiguous(count, alignment_log2);
         if (!p) {
@@ -240,13 +345,9 @@ zx_status_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8
             DEBUG_ASSERT_MSG(p->is_free(), "p %p state %u\n", p, p->state());
             DEBUG_ASSERT(list_in_list(&p->queue_node));
 
-            list_delete(&p->queue_node);
+            UnlinkFreePageLocked(p);
             p->set_state(VM_PAGE_STATE_ALLOC);
 
-            DEBUG_ASSERT(free_count_ > 0);
-
-            free_count_--;
-
 #if PMM_ENABLE_FREE_FILL
             CheckFreeFill(p);
 #endif
@@ -276,11 +377,15 @@ void PmmNode::FreePageHelperLocked(vm_page* page) {
 }
 
 void PmmNode::FreePage(vm_page* page) {
-    Guard<fbl::Mutex> guard{&lock_};
-
     // pages freed individually shouldn't be in a queue
     DEBUG_ASSERT(!list_in_list(&page->queue_node));
 
+    if (CpuCacheFree(page)) {
+        return;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+
     FreePageHelperLocked(page);
 
     // add it to the free queue
@@ -307,14 +412,334 @@ void PmmNode::FreeListLocked(list_node* list) {
 }
 
 void PmmNode::FreeList(list_node* list) {
+    // top up the local cache first; whatever doesn't fit goes back to the node
+    CpuCacheFreeList(list);
+    if (list_is_empty(list)) {
+        return;
+    }
+
     Guard<fbl::Mutex> guard{&lock_};
 
     FreeListLocked(list);
 }
 
+bool PmmNode::CpuCacheAlloc(size_t count, list_node* list) {
+    // requests larger than a refill batch always go to the node
+    if (cpu_cache_high_.load(ktl::memory_order_relaxed) == 0 ||
+        count > cpu_cache_batch_.load(ktl::memory_order_relaxed)) {
+        return false;
+    }
+
+    // no need to pin ourselves to this cpu; if we migrate we simply end up
+    // using another cpu's cache, which its lock makes safe.
+    CpuCache& cache = cpu_cache_[arch_curr_cpu_num()];
+    for (bool refilled = false;; refilled = true) {
+        {
+            Guard<SpinLock, IrqSave> guard{&cache.lock};
+            if (cache.count >= count) {
+                for (size_t i = 0; i < count; i++) {
+                    list_add_tail(list, list_remove_head(&cache.free_list));
+                }
+                cache.count -= count;
+                if (!refilled) {
+                    kcounter_add(pmm_cache_hit, 1);
+                }
+                return true;
+            }
+        }
+
+        // someone else may have raced us for the refilled pages, in which case
+        // we let the node satisfy the request directly
+        if (refilled) {
+            return false;
+        }
+
+        kcounter_add(pmm_cache_miss, 1);
+        if (!CpuCacheRefill(&cache)) {
+            return false;
+        }
+    }
+}
+
+bool PmmNode::CpuCacheRefill(CpuCache* cache) {
+    list_node batch = LIST_INITIAL_VALUE(batch);
+    size_t count;
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+        count = TakeFreePagesLocked(cpu_cache_batch_.load(ktl::memory_order_relaxed), &batch);
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    kcounter_add(pmm_cache_refill, 1);
+
+    Guard<SpinLock, IrqSave> guard{&cache->lock};
+    list_splice_after(&batch, &cache->free_list);
+    cache->count += count;
+
+    return true;
+}
+
+bool PmmNode::CpuCacheFree(vm_page* page) {
+    const size_t high = cpu_cache_high_.load(ktl::memory_order_relaxed);
+    if (high == 0) {
+        return false;
+    }
+
+    cache_page_helper(page);
+
+    CpuCache& cache = cpu_cache_[arch_curr_cpu_num()];
+    bool over_high;
+    {
+        Guard<SpinLock, IrqSave> guard{&cache.lock};
+        list_add_head(&cache.free_list, &page->queue_node);
+        over_high = ++cache.count > high;
+    }
+
+    if (over_high) {
+        CpuCacheDrain(&cache, cpu_cache_low_.load(ktl::memory_order_relaxed));
+    }
+
+    return true;
+}
+
+void PmmNode::CpuCacheFreeList(list_node* list) {
+    const size_t high = cpu_cache_high_.load(ktl::memory_order_relaxed);
+    if (high == 0) {
+        return;
+    }
+
+    CpuCache& cache = cpu_cache_[arch_curr_cpu_num()];
+
+    // figure out how much room there is, then do the page state transitions
+    // outside of the spinlock. the cache may overshoot its high watermark by a
+    // little if we race with another free, the next free will trim it.
+    size_t room;
+    {
+        Guard<SpinLock, IrqSave> guard{&cache.lock};
+        room = cache.count < high ? high - cache.count : 0;
+    }
+
+    list_node cache_list = LIST_INITIAL_VALUE(cache_list);
+    size_t count = 0;
+    while (count < room) {
+        vm_page* page = list_remove_head_type(list, vm_page, queue_node);
+        if (!page) {
+            break;
+        }
+        cache_page_helper(page);
+        list_add_tail(&cache_list, &page->queue_node);
+        count++;
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    Guard<SpinLock, IrqSave> guard{&cache.lock};
+    list_splice_after(&cache_list, &cache.free_list);
+    cache.count += count;
+}
+
+void PmmNode::CpuCacheDrain(CpuCache* cache, size_t target) {
+    list_node drain_list = LIST_INITIAL_VALUE(drain_list);
+    {
+        Guard<SpinLock, IrqSave> guard{&cache->lock};
+        // the tail of the cache is the coldest end, so give that back first
+        while (cache->count > target) {
+            list_add_head(&drain_list, list_remove_tail(&cache->free_list));
+            cache->count--;
+        }
+    }
+
+    if (list_is_empty(&drain_list)) {
+        return;
+    }
+
+    kcounter_add(pmm_cache_drain, 1);
+
+    Guard<fbl::Mutex> guard{&lock_};
+    FreeListLocked(&drain_list);
+}
+
+void PmmNode::DrainCpuCaches() {
+    for (auto& cache : cpu_cache_) {
+        CpuCacheDrain(&cache, 0);
+    }
+}
+
+zx_status_t PmmNode::SetCpuCacheWatermarks(size_t high, size_t low, size_t batch) {
+    if (high != 0 && (low > high || batch == 0 || batch > high)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    // park the caches while the tunables change so nothing refills against a
+    // half updated configuration, then start everyone over from empty
+    cpu_cache_high_.store(0, ktl::memory_order_relaxed);
+    DrainCpuCaches();
+
+    cpu_cache_low_.store(low, ktl::memory_order_relaxed);
+    cpu_cache_batch_.store(batch, ktl::memory_order_relaxed);
+    cpu_cache_high_.store(high, ktl::memory_order_relaxed);
+
+    return ZX_OK;
+}
+
+void PmmNode::UnlinkFreePageLocked(vm_page* page) {
+    DEBUG_ASSERT(page->is_free());
+
+    list_delete(&page->queue_node);
+    if (page->flags & VM_PAGE_FLAG_ZEROED) {
+        page->flags &= ~VM_PAGE_FLAG_ZEROED;
+        DEBUG_ASSERT(zeroed_count_ > 0);
+        zeroed_count_--;
+    } else {
+        DEBUG_ASSERT(free_count_ > 0);
+        free_count_--;
+    }
+}
+
+void PmmNode::ReturnZeroedPagesLocked() {
+    vm_page* page;
+    list_for_every_entry (&zeroed_list_, page, vm_page, queue_node) {
+        page->flags &= ~VM_PAGE_FLAG_ZEROED;
+    }
+
+    // the zeroed pages are cold, put them at the back of the line
+    if (list_is_empty(&free_list_)) {
+        list_move(&zeroed_list_, &free_list_);
+    } else {
+        list_splice_after(&zeroed_list_, list_peek_tail(&free_list_));
+    }
+    free_count_ += zeroed_count_;
+    zeroed_count_ = 0;
+}
+
+bool PmmNode::AllocZeroedPage(list_node* list) {
+    vm_page* page;
+    bool wake_zero_thread = false;
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+
+        page = list_remove_head_type(&zeroed_list_, vm_page, queue_node);
+        if (page) {
+            DEBUG_ASSERT(page->flags & VM_PAGE_FLAG_ZEROED);
+            page->flags &= ~VM_PAGE_FLAG_ZEROED;
+            zeroed_count_--;
+            alloc_page_helper(page);
+            list_add_tail(list, &page->queue_node);
+        }
+
+        if (!zero_thread_busy_ && zeroed_count_ < zero_pool_target_ / 2) {
+            zero_thread_busy_ = true;
+            wake_zero_thread = true;
+        }
+    }
+
+    kcounter_add(page ? pmm_zero_pool_hit : pmm_zero_pool_miss, 1);
+
+    if (wake_zero_thread) {
+        event_signal(&zero_event_, false);
+    }
+
+    return page != nullptr;
+}
+
+bool PmmNode::ZeroOnePage() {
+    vm_page* page;
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+
+        // stop once the pool is full, and never zero the last few free pages
+        // since someone is about to need them for something more important
+        if (zeroed_count_ >= zero_pool_target_ || free_count_ <= PMM_ZERO_POOL_FREE_RESERVE) {
+            zero_thread_busy_ = false;
+            return false;
+        }
+
+        // take from the cold end of the free list
+        page = list_remove_tail_type(&free_list_, vm_page, queue_node);
+        DEBUG_ASSERT(page);
+        free_count_--;
+
+        // while it is being zeroed the page is allocated as far as anyone else
+        // is concerned, so the contiguous allocator won't go after it
+        page->set_state(VM_PAGE_STATE_ALLOC);
+    }
+
+    const zx_time_t start = current_time();
+    arch_zero_page(paddr_to_physmap(page->paddr()));
+    kcounter_add(pmm_zero_pool_zero_time, (current_time() - start) / ZX_USEC(1));
+    kcounter_add(pmm_zero_pool_pages_zeroed, 1);
+
+    Guard<fbl::Mutex> guard{&lock_};
+    page->set_state(VM_PAGE_STATE_FREE);
+    page->flags |= VM_PAGE_FLAG_ZEROED;
+    list_add_tail(&zeroed_list_, &page->queue_node);
+    zeroed_count_++;
+
+    return true;
+}
+
+int PmmNode::ZeroThread(void* arg) {
+    PmmNode* node = static_cast<PmmNode*>(arg);
+
+    for (;;) {
+        event_wait(&node->zero_event_);
+        while (node->ZeroOnePage()) {
+        }
+    }
+
+    return 0;
+}
+
+void PmmNode::StartZeroThread(size_t pool_pages) {
+#if PMM_ENABLE_FREE_FILL
+    // zeroed pages would trip the free fill checks
+    pool_pages = 0;
+#endif
+    if (pool_pages == 0) {
+        return;
+    }
+
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+        DEBUG_ASSERT(zero_pool_target_ == 0);
+        zero_pool_target_ = pool_pages;
+        zero_thread_busy_ = true;
+    }
+
+    // the pool only ever gets topped up when there is nothing better to do
+    thread_t* t = thread_create("pmm zero", &PmmNode::ZeroThread, this, LOWEST_PRIORITY + 1);
+    if (!t) {
+        printf("PMM: failed to create zero thread\n");
+        Guard<fbl::Mutex> guard{&lock_};
+        zero_pool_target_ = 0;
+        return;
+    }
+    event_signal(&zero_event_, false);
+    thread_detach_and_resume(t);
+}
+
+void PmmNode::GetCpuCacheWatermarks(size_t* high, size_t* low, size_t* batch) const {
+    *high = cpu_cache_high_.load(ktl::memory_order_relaxed);
+    *low = cpu_cache_low_.load(ktl::memory_order_relaxed);
+    *batch = cpu_cache_batch_.load(ktl::memory_order_relaxed);
+}
+
 // okay if accessed outside of a lock
 uint64_t PmmNode::CountFreePages() const TA_NO_THREAD_SAFETY_ANALYSIS {
-    return free_count_;
+    return free_count_ + zeroed_count_ + CountCachedPages();
+}
+
+// okay if accessed outside of the cache locks
+uint64_t PmmNode::CountCachedPages() const TA_NO_THREAD_SAFETY_ANALYSIS {
+    uint64_t count = 0;
+    for (const auto& cache : cpu_cache_) {
+        count += cache.count;
+    }
+    return count;
 }
 
 uint64_t PmmNode::CountTotalBytes() const TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -331,6 +756,10 @@ void PmmNode::Dump(bool is_panic) const {
     auto dump = [this]() TA_NO_THREAD_SAFETY_ANALYSIS {
         printf("pmm node %p: free_count %zu (%zu bytes), total size %zu\n",
                this, free_count_, free_count_ * PAGE_SIZE, arena_cumulative_size_);
+        printf("\tcpu caches: %" PRIu64 " pages, watermarks high %zu low %zu batch %zu\n",
+               CountCachedPages(), cpu_cache_high_.load(), cpu_cache_low_.load(),
+               cpu_cache_batch_.load());
+        printf("\tzero pool: %" PRIu64 " of %zu pages\n", zeroed_count_, zero_pool_target_);
         for (auto& a : arena_list_) {
             a.Dump(false, false);
         }
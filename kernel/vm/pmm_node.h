@@ -9,7 +9,11 @@
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
 
+#include <kernel/align.h>
+#include <kernel/event.h>
 #include <kernel/lockdep.h>
+#include <kernel/spinlock.h>
+#include <ktl/atomic.h>
 #include <vm/pmm.h>
 
 #include "pmm_arena.h"
@@ -17,6 +21,18 @@
 #define PMM_ENABLE_FREE_FILL 0
 #define PMM_FREE_FILL_BYTE 0x42
 
+// default per-cpu page cache watermarks, in pages. a cpu's cache is refilled from
+// the node in batches when it runs dry and drained back down to the low watermark
+// once it grows past the high watermark.
+#define PMM_CPU_CACHE_DEFAULT_HIGH_WATERMARK 64
+#define PMM_CPU_CACHE_DEFAULT_LOW_WATERMARK 16
+#define PMM_CPU_CACHE_DEFAULT_BATCH 32
+
+// default size of the pre-zeroed page pool, in pages
+#define PMM_ZERO_POOL_DEFAULT_PAGES 1024
+// the zero thread leaves at least this many pages on the free list alone
+#define PMM_ZERO_POOL_FREE_RESERVE 256
+
 // per numa node collection of pmm arenas and worker threads
 class PmmNode {
 public:
@@ -37,6 +53,7 @@ public:
     void FreeList(list_node* list);
 
     uint64_t CountFreePages() const;
+    uint64_t CountCachedPages() const;
     uint64_t CountTotalBytes() const;
 
     // printf free and overall state of the internal arenas
@@ -54,16 +71,74 @@ public:
     // add new pages to the free queue. used when boostrapping a PmmArena
     void AddFreePages(list_node* list);
 
+    // Configure the per-cpu page caches. A |high| watermark of zero disables the
+    // caches and returns all cached pages to the node.
+    zx_status_t SetCpuCacheWatermarks(size_t high, size_t low, size_t batch);
+    void GetCpuCacheWatermarks(size_t* high, size_t* low, size_t* batch) const;
+
+    // Return every page sitting in a per-cpu cache to the node's free list.
+    void DrainCpuCaches();
+
+    // Start the low priority thread that keeps up to |pool_pages| pre-zeroed
+    // pages around for PMM_ALLOC_FLAG_ZEROED allocations.
+    void StartZeroThread(size_t pool_pages);
+
 private:
+    // Small LIFO stash of pages in front of free_list_, one per cpu. Pages in a
+    // cache are in the VM_PAGE_STATE_ALLOC state as far as the rest of the system
+    // is concerned, but are counted as free by CountFreePages().
+    struct CpuCache {
+        DECLARE_SPINLOCK(CpuCache) lock;
+        list_node free_list TA_GUARDED(lock) = LIST_INITIAL_VALUE(free_list);
+        size_t count TA_GUARDED(lock) = 0;
+    } __CPU_ALIGN;
+
     void FreePageHelperLocked(vm_page* page) TA_REQ(lock_);
     void FreeListLocked(list_node* list) TA_REQ(lock_);
 
+    zx_status_t AllocRangeLocked(paddr_t address, size_t count, list_node* list) TA_REQ(lock_);
+    zx_status_t AllocContiguousLocked(size_t count, uint8_t alignment_log2, paddr_t* pa,
+                                      list_node* list) TA_REQ(lock_);
+
+    // Remove a free page from whichever free queue it is on.
+    void UnlinkFreePageLocked(vm_page* page) TA_REQ(lock_);
+
+    // Move the whole zero pool back onto free_list_.
+    void ReturnZeroedPagesLocked() TA_REQ(lock_);
+
+    // Pop a page off the zero pool. Returns false if the pool is empty.
+    bool AllocZeroedPage(list_node* list);
+
+    // Move one page from free_list_ into the zero pool. Returns false once
+    // there is nothing left to do.
+    bool ZeroOnePage();
+    static int ZeroThread(void* arg);
+
+    // Take up to |count| pages off the front of free_list_ and mark them allocated.
+    size_t TakeFreePagesLocked(size_t count, list_node* list) TA_REQ(lock_);
+
+    // Allocate exactly |count| pages from free_list_, bypassing the per-cpu caches.
+    zx_status_t AllocPagesFromNode(size_t count, list_node* list);
+
+    // Per-cpu cache helpers.
+    //
+    // CpuCacheAlloc and CpuCacheFree return false if the request has to be
+    // handled by the node instead. CpuCacheFreeList leaves behind in |list|
+    // whatever did not fit in the cache.
+    bool CpuCacheAlloc(size_t count, list_node* list);
+    bool CpuCacheRefill(CpuCache* cache);
+    bool CpuCacheFree(vm_page* page);
+    void CpuCacheFreeList(list_node* list);
+    void CpuCacheDrain(CpuCache* cache, size_t target);
+
     fbl::Canary<fbl::magic("PNOD")> canary_;
 
     mutable DECLARE_MUTEX(PmmNode) lock_;
 
     uint64_t arena_cumulative_size_ TA_GUARDED(lock_) = 0;
+    // number of pages on free_list_ and zeroed_list_ respectively
     uint64_t free_count_ TA_GUARDED(lock_) = 0;
+    uint64_t zeroed_count_ TA_GUARDED(lock_) = 0;
 
     fbl::DoublyLinkedList<PmmArena*> arena_list_ TA_GUARDED(lock_);
 
@@ -74,6 +149,19 @@ private:
     list_node modified_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(modified_list_);
     list_node wired_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(wired_list_);
 
+    // free pages known to be zero filled, marked with VM_PAGE_FLAG_ZEROED
+    list_node zeroed_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(zeroed_list_);
+    size_t zero_pool_target_ TA_GUARDED(lock_) = 0;
+    bool zero_thread_busy_ TA_GUARDED(lock_) = false;
+    event_t zero_event_ = EVENT_INITIAL_VALUE(zero_event_, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+    // per-cpu cache tunables; a high watermark of zero means the caches are off
+    ktl::atomic<size_t> cpu_cache_high_{0};
+    ktl::atomic<size_t> cpu_cache_low_{0};
+    ktl::atomic<size_t> cpu_cache_batch_{0};
+
+    CpuCache cpu_cache_[SMP_MAX_CPUS];
+
 #if PMM_ENABLE_FREE_FILL
     void FreeFill(vm_page_t* page);
     void CheckFreeFill(vm_page_t* page);
@@ -218,7 +218,8 @@ zx_status_t VmAddressRegion::CreateVmMapping(size_t mapping_offset, size_t size,
     LTRACEF("%p %#zx %#zx %x\n", this, mapping_offset, size, vmar_flags);
 
     // Check that only allowed flags have been set
-    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_SPECIFIC_OVERWRITE | VMAR_CAN_RWX_FLAGS)) {
+    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_SPECIFIC_OVERWRITE | VMAR_CAN_RWX_FLAGS |
+                       VMAR_FLAG_FAULT_AROUND)) {
         return ZX_ERR_INVALID_ARGS;
     }
 
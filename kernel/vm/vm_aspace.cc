@@ -18,9 +18,11 @@
 #include <kernel/cmdline.h>
 #include <kernel/thread.h>
 #include <kernel/thread_lock.h>
+#include <lib/counters.h>
 #include <lib/crypto/global_prng.h>
 #include <lib/crypto/prng.h>
 #include <lib/userabi/vdso.h>
+#include <platform.h>
 #include <stdlib.h>
 #include <string.h>
 #include <trace.h>
@@ -37,6 +39,8 @@
 #define GUEST_PHYSICAL_ASPACE_BASE 0UL
 #define GUEST_PHYSICAL_ASPACE_SIZE (1UL << MMU_GUEST_SIZE_SHIFT)
 
+KCOUNTER_HISTOGRAM(page_fault_latency, "vm.page_fault.latency_ns")
+
 // pointer to a singleton kernel address space
 VmAspace* VmAspace::kernel_aspace_ = nullptr;
 
@@ -549,6 +553,11 @@ zx_status_t VmAspace::PageFault(vaddr_t va, uint flags) {
         flags |= VMM_PF_FLAG_GUEST;
     }
 
+    const zx_time_t start = current_time();
+    auto record_latency = fbl::MakeAutoCall([start]() {
+        kcounter_histogram_add(page_fault_latency, current_time() - start);
+    });
+
     zx_status_t status = ZX_OK;
     PageRequest page_request;
     do {
@@ -11,8 +11,11 @@
 #include <err.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
+#include <kernel/cmdline.h>
 #include <ktl/move.h>
 #include <inttypes.h>
+#include <lib/counters.h>
+#include <lk/init.h>
 #include <trace.h>
 #include <vm/fault.h>
 #include <vm/vm.h>
@@ -22,6 +25,25 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(vm_fault_around_faults, "vm.fault_around.faults")
+KCOUNTER(vm_fault_around_pages_mapped, "vm.fault_around.pages_mapped")
+KCOUNTER(vm_fault_around_pages_streamed, "vm.fault_around.pages_streamed")
+KCOUNTER(vm_large_page_faults, "vm.large_page.faults")
+
+// The smallest block the MMU can map with a single entry above the page level,
+// which is the span of one full last level page table.
+static constexpr size_t kLargePageSize = PAGE_SIZE * (PAGE_SIZE / sizeof(uint64_t));
+
+// Size in pages of the window around a read fault that is considered for
+// fault-around.
+static size_t fault_around_window_pages;
+
+static void fault_around_init(uint level) {
+    // Be sure to update kernel_cmdline.md if this default changes.
+    fault_around_window_pages = cmdline_get_uint64("kernel.vm.fault-around-pages", 16);
+}
+LK_INIT_HOOK(vm_fault_around, &fault_around_init, LK_INIT_LEVEL_VM);
+
 VmMapping::VmMapping(VmAddressRegion& parent, vaddr_t base, size_t size, uint32_t vmar_flags,
                      fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset, uint arch_mmu_flags)
     : VmAddressRegionOrMapping(base, size, vmar_flags,
@@ -139,6 +161,8 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
         return ZX_OK;
     }
 
+    large_page_failed_block_ = 0;
+
     // TODO(teisenbe): deal with error mapping on arch_mmu_protect fail
 
     // If we're changing the whole mapping, just make the change.
@@ -273,6 +297,8 @@ zx_status_t VmMapping::UnmapLocked(vaddr_t base, size_t size) {
     DEBUG_ASSERT(object_);
     Guard<fbl::Mutex> guard{object_->lock()};
 
+    large_page_failed_block_ = 0;
+
     // Check if unmapping from one of the ends
     if (base_ == base || base + size == base_ + size_) {
         LTRACEF("unmapping base %#lx size %#zx\n", base, size);
@@ -322,7 +348,7 @@ zx_status_t VmMapping::UnmapLocked(vaddr_t base, size_t size) {
     return ZX_OK;
 }
 
-zx_status_t VmMapping::UnmapVmoRangeLocked(uint64_t offset, uint64_t len) const {
+zx_status_t VmMapping::UnmapVmoRangeLocked(uint64_t offset, uint64_t len) {
     canary_.Assert();
 
     LTRACEF("region %p obj_offset %#" PRIx64 " size %zu, offset %#" PRIx64 " len %#" PRIx64 "\n",
@@ -371,6 +397,8 @@ zx_status_t VmMapping::UnmapVmoRangeLocked(uint64_t offset, uint64_t len) const
 
     LTRACEF("intersection offset %#" PRIx64 ", len %#" PRIx64 "\n", offset_new, len_new);
 
+    large_page_failed_block_ = 0;
+
     // make sure the base + offset is within our address space
     // should be, according to the range stored in base_ + size_
     vaddr_t unmap_base;
@@ -397,7 +425,11 @@ namespace {
 
 class VmMappingCoalescer {
 public:
-    VmMappingCoalescer(VmMapping* mapping, vaddr_t base);
+    // |large_pages| allows physically contiguous runs to be mapped with large
+    // pages. Only pass true for vmos whose pages are never decommitted or
+    // replaced, as a large page that fails to split on a later partial unmap
+    // is dropped whole.
+    VmMappingCoalescer(VmMapping* mapping, vaddr_t base, uint mmu_flags, bool large_pages);
     ~VmMappingCoalescer();
 
     // Add a page to the mapping run.  If this fails, the VmMappingCoalescer is
@@ -405,14 +437,35 @@ public:
     zx_status_t Append(vaddr_t vaddr, paddr_t paddr) {
         DEBUG_ASSERT(!aborted_);
         // If this isn't the expected vaddr, flush the run we have first.
-        if (count_ >= fbl::count_of(phys_) || vaddr != base_ + count_ * PAGE_SIZE) {
+        if (vaddr != base_ + count_ * PAGE_SIZE) {
             zx_status_t status = Flush();
             if (status != ZX_OK) {
                 return status;
             }
             base_ = vaddr;
+        } else if (contiguous_ && count_ > 0 && paddr != phys_[0] + count_ * PAGE_SIZE) {
+            // A physically contiguous run that has outgrown |phys_| can't be
+            // continued as a page array, so it has to go out on its own.
+            if (count_ > fbl::count_of(phys_)) {
+                zx_status_t status = Flush();
+                if (status != ZX_OK) {
+                    return status;
+                }
+            } else {
+                contiguous_ = false;
+            }
+        }
+        if (!contiguous_ && count_ >= fbl::count_of(phys_)) {
+            zx_status_t status = Flush();
+            if (status != ZX_OK) {
+                return status;
+            }
+        }
+        // Physically contiguous runs keep growing past the end of |phys_|; only
+        // their first page is needed to map them.
+        if (count_ < fbl::count_of(phys_)) {
+            phys_[count_] = paddr;
         }
-        phys_[count_] = paddr;
         ++count_;
         return ZX_OK;
     }
@@ -432,13 +485,21 @@ private:
 
     VmMapping* mapping_;
     vaddr_t base_;
+    uint mmu_flags_;
     paddr_t phys_[16];
     size_t count_;
+    const bool large_pages_;
+    // True while the pages of the current run are physically contiguous and
+    // |large_pages_| is set, in which case it is mapped with MapContiguous so
+    // the arch layer can use large pages where the run is suitably aligned.
+    bool contiguous_;
     bool aborted_;
 };
 
-VmMappingCoalescer::VmMappingCoalescer(VmMapping* mapping, vaddr_t base)
-    : mapping_(mapping), base_(base), count_(0), aborted_(false) {}
+VmMappingCoalescer::VmMappingCoalescer(VmMapping* mapping, vaddr_t base, uint mmu_flags,
+                                       bool large_pages)
+    : mapping_(mapping), base_(base), mmu_flags_(mmu_flags), count_(0),
+      large_pages_(large_pages), contiguous_(large_pages), aborted_(false) {}
 
 VmMappingCoalescer::~VmMappingCoalescer() {
     // Make sure we've flushed or aborted
@@ -450,11 +511,16 @@ zx_status_t VmMappingCoalescer::Flush() {
         return ZX_OK;
     }
 
-    uint flags = mapping_->arch_mmu_flags();
-    if (flags & ARCH_MMU_FLAG_PERM_RWX_MASK) {
+    if (mmu_flags_ & ARCH_MMU_FLAG_PERM_RWX_MASK) {
         size_t mapped;
-        zx_status_t ret = mapping_->aspace()->arch_aspace().Map(base_, phys_, count_, flags,
-                                                                &mapped);
+        zx_status_t ret;
+        if (contiguous_) {
+            ret = mapping_->aspace()->arch_aspace().MapContiguous(base_, phys_[0], count_,
+                                                                  mmu_flags_, &mapped);
+        } else {
+            ret = mapping_->aspace()->arch_aspace().Map(base_, phys_, count_, mmu_flags_,
+                                                        &mapped);
+        }
         if (ret != ZX_OK) {
             TRACEF("error %d mapping %zu pages starting at va %#" PRIxPTR "\n", ret, count_, base_);
             aborted_ = true;
@@ -464,6 +530,7 @@ zx_status_t VmMappingCoalescer::Flush() {
     }
     base_ += count_ * PAGE_SIZE;
     count_ = 0;
+    contiguous_ = large_pages_;
     return ZX_OK;
 }
 
@@ -507,7 +574,8 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
     // iterate through the range, grabbing a page from the underlying object and
     // mapping it in
     size_t o;
-    VmMappingCoalescer coalescer(this, base_ + offset);
+    VmMappingCoalescer coalescer(this, base_ + offset, arch_mmu_flags_,
+                                 object_->is_contiguous());
     for (o = offset; o < offset + len; o += PAGE_SIZE) {
         uint64_t vmo_offset = object_offset_ + o;
 
@@ -691,8 +759,16 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* p
             // assert that we're not accidentally marking the zero page writable
             DEBUG_ASSERT((pa != vm_get_zero_page_paddr()) || !(mmu_flags & ARCH_MMU_FLAG_PERM_WRITE));
 
-            // same page, different permission
-            status = aspace_->arch_aspace().Protect(va, 1, mmu_flags);
+            // same page, different permission. A block mapped by
+            // MapLargePageLocked() on a read fault is upgraded as a whole, so
+            // that the first write doesn't split it.
+            vaddr_t block_va;
+            if (LargePageBlockLocked(va, &block_va)) {
+                status = aspace_->arch_aspace().Protect(block_va, kLargePageSize / PAGE_SIZE,
+                                                        mmu_flags);
+            } else {
+                status = aspace_->arch_aspace().Protect(va, 1, mmu_flags);
+            }
             if (status != ZX_OK) {
                 TRACEF("failed to modify permissions on existing mapping\n");
                 return ZX_ERR_NO_MEMORY;
@@ -731,6 +807,10 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* p
         // assert that we're not accidentally mapping the zero page writable
         DEBUG_ASSERT((new_pa != vm_get_zero_page_paddr()) || !(mmu_flags & ARCH_MMU_FLAG_PERM_WRITE));
 
+        if (MapLargePageLocked(va, new_pa, mmu_flags)) {
+            return ZX_OK;
+        }
+
         size_t mapped;
         status = aspace_->arch_aspace().MapContiguous(va, new_pa, 1, mmu_flags, &mapped);
         if (status != ZX_OK) {
@@ -738,6 +818,11 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* p
             return ZX_ERR_NO_MEMORY;
         }
         DEBUG_ASSERT(mapped == 1);
+
+        if ((flags_ & VMAR_FLAG_FAULT_AROUND) &&
+            !(pf_flags & (VMM_PF_FLAG_WRITE | VMM_PF_FLAG_GUEST))) {
+            FaultAroundLocked(va, mmu_flags);
+        }
     }
 
 // TODO: figure out what to do with this
@@ -751,6 +836,169 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* p
     return ZX_OK;
 }
 
+bool VmMapping::LargePageBlockLocked(vaddr_t va, vaddr_t* block_va) const {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(va));
+
+    if (!object_->is_contiguous()) {
+        return false;
+    }
+
+#if ARCH_ARM64
+    // leave executable mappings to the single page path, which syncs the
+    // icache for what it maps
+    if (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE) {
+        return false;
+    }
+#endif
+
+    // the whole block has to be inside the mapping
+    const vaddr_t block = ROUNDDOWN(va, kLargePageSize);
+    if (size_ < kLargePageSize || block < base_ || block - base_ > size_ - kLargePageSize) {
+        return false;
+    }
+    *block_va = block;
+    return true;
+}
+
+bool VmMapping::MapLargePageLocked(vaddr_t va, paddr_t pa, uint mmu_flags) {
+    vaddr_t block_va;
+    if (!LargePageBlockLocked(va, &block_va)) {
+        return false;
+    }
+
+    // Faults in a block that couldn't be mapped whole would otherwise check it
+    // again every time.
+    if (block_va == large_page_failed_block_) {
+        return false;
+    }
+
+    // the block has to line up physically
+    const size_t block_offset = va - block_va;
+    if (pa < block_offset || !IS_ALIGNED(pa - block_offset, kLargePageSize)) {
+        return false;
+    }
+    const paddr_t block_pa = pa - block_offset;
+
+    // Contiguous vmos can't be decommitted and always keep their original
+    // pages, and physical vmos are a fixed range, so the block is present and
+    // physically contiguous if its ends are where |pa| says they should be.
+    const uint64_t block_vmo_offset = block_va - base_ + object_offset_;
+    const uint64_t end_offsets[] = {0, kLargePageSize - PAGE_SIZE};
+    for (uint64_t off : end_offsets) {
+        paddr_t page_pa;
+        zx_status_t status = object_->GetPageLocked(block_vmo_offset + off, 0, nullptr, nullptr,
+                                                    nullptr, &page_pa);
+        if (status != ZX_OK || page_pa != block_pa + off) {
+            large_page_failed_block_ = block_va;
+            return false;
+        }
+    }
+
+    // The block may already be partially mapped, e.g. after an unmap split a
+    // large page.
+    for (size_t off = 0; off < kLargePageSize; off += PAGE_SIZE) {
+        if (block_va + off != va &&
+            aspace_->arch_aspace().Query(block_va + off, nullptr, nullptr) == ZX_OK) {
+            large_page_failed_block_ = block_va;
+            return false;
+        }
+    }
+
+    size_t mapped;
+    zx_status_t status = aspace_->arch_aspace().MapContiguous(
+        block_va, block_pa, kLargePageSize / PAGE_SIZE, mmu_flags, &mapped);
+    if (status != ZX_OK) {
+        return false;
+    }
+    DEBUG_ASSERT(mapped == kLargePageSize / PAGE_SIZE);
+
+    kcounter_add(vm_large_page_faults, 1);
+    return true;
+}
+
+void VmMapping::FaultAroundLocked(vaddr_t va, uint mmu_flags) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(va));
+
+#if ARCH_ARM64
+    // speculatively mapped code would need its icache synced up front, which
+    // defeats the purpose
+    if (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE) {
+        return;
+    }
+#endif
+
+    // If this fault landed right where the last window ended, a sequential
+    // reader walked off the end of it without faulting. This doesn't say which
+    // of the window's pages were touched on the way, only that its pages were
+    // mapped ahead of a reader that got that far.
+    if (fault_around_pages_ && va == fault_around_end_) {
+        kcounter_add(vm_fault_around_pages_streamed, fault_around_pages_);
+    }
+    fault_around_pages_ = 0;
+
+    const size_t window = fault_around_window_pages;
+    if (window == 0) {
+        return;
+    }
+
+    // Use the window aligned to its size within the mapping that contains the
+    // fault, so that a reader moving backwards benefits as well as one moving
+    // forwards.
+    const size_t window_size = window * PAGE_SIZE;
+    if (window_size / PAGE_SIZE != window) {
+        return;
+    }
+    const vaddr_t start = va - (va - base_) % window_size;
+    const vaddr_t mapping_end = base_ + size_;
+    vaddr_t end = start + window_size;
+    if (end < start || end > mapping_end) {
+        end = mapping_end;
+    }
+    if (end - start <= PAGE_SIZE) {
+        return;
+    }
+
+    kcounter_add(vm_fault_around_faults, 1);
+
+    // always map read-only, so that writes still go through the fault path and
+    // get a chance to break copy-on-write sharing
+    mmu_flags &= ~ARCH_MMU_FLAG_PERM_WRITE;
+
+    size_t mapped = 0;
+    VmMappingCoalescer coalescer(this, start, mmu_flags, object_->is_contiguous());
+    for (vaddr_t cur = start; cur < end; cur += PAGE_SIZE) {
+        if (cur == va) {
+            continue;
+        }
+
+        // only look for pages that are already there, never fault anything in
+        paddr_t pa;
+        zx_status_t status = object_->GetPageLocked(cur - base_ + object_offset_, 0, nullptr,
+                                                    nullptr, nullptr, &pa);
+        if (status != ZX_OK) {
+            continue;
+        }
+
+        // leave alone anything that has been mapped in the meantime
+        if (aspace_->arch_aspace().Query(cur, nullptr, nullptr) == ZX_OK) {
+            continue;
+        }
+
+        if (coalescer.Append(cur, pa) != ZX_OK) {
+            // Failing to map speculatively is fine; the real fault will retry.
+            return;
+        }
+        mapped++;
+    }
+    if (coalescer.Flush() != ZX_OK || mapped == 0) {
+        return;
+    }
+
+    kcounter_add(vm_fault_around_pages_mapped, mapped);
+    fault_around_end_ = end;
+    fault_around_pages_ = mapped;
+}
+
 // We disable thread safety analysis here because one of the common uses of this
 // function is for splitting one mapping object into several that will be backed
 // by the same VmObject.  In that case, object_->lock() gets aliased across all
@@ -261,8 +261,11 @@ void VmObject::RangeChangeUpdateLocked(uint64_t offset, uint64_t len) {
     const uint64_t aligned_len = ROUNDUP(offset + len, PAGE_SIZE) - aligned_offset;
 
     // other mappings may have covered this offset into the vmo, so unmap those ranges
+    // a failed unmap would leave translations to pages the caller may be
+    // about to free or replace
     for (auto& m : mapping_list_) {
-        m.UnmapVmoRangeLocked(aligned_offset, aligned_len);
+        __UNUSED zx_status_t status = m.UnmapVmoRangeLocked(aligned_offset, aligned_len);
+        DEBUG_ASSERT(status == ZX_OK);
     }
 
     // inform all our children this as well, so they can inform their mappings
@@ -54,6 +54,9 @@ void InitializeVmPage(vm_page_t* p) {
 // Allocates a new page and populates it with the data at |parent_paddr|.
 bool AllocateCopyPage(uint32_t pmm_alloc_flags, paddr_t parent_paddr,
                       list_node_t* free_list, vm_page_t** clone) {
+    const bool zero_fill = parent_paddr == vm_get_zero_page_paddr();
+    bool already_zeroed = false;
+
     paddr_t pa_clone;
     vm_page_t* p_clone = nullptr;
     if (free_list) {
@@ -63,12 +66,18 @@ bool AllocateCopyPage(uint32_t pmm_alloc_flags, paddr_t parent_paddr,
         }
     }
     if (!p_clone) {
+        // if we're going to zero the page anyway, let the pmm hand us one out of its
+        // pre-zeroed pool
+        if (zero_fill) {
+            pmm_alloc_flags |= PMM_ALLOC_FLAG_ZEROED;
+        }
         zx_status_t status = pmm_alloc_page(pmm_alloc_flags, &p_clone, &pa_clone);
         if (!p_clone) {
             DEBUG_ASSERT(status == ZX_ERR_NO_MEMORY);
             return false;
         }
         DEBUG_ASSERT(status == ZX_OK);
+        already_zeroed = zero_fill;
     }
 
     InitializeVmPage(p_clone);
@@ -76,12 +85,12 @@ bool AllocateCopyPage(uint32_t pmm_alloc_flags, paddr_t parent_paddr,
     void* dst = paddr_to_physmap(pa_clone);
     DEBUG_ASSERT(dst);
 
-    if (parent_paddr != vm_get_zero_page_paddr()) {
+    if (!zero_fill) {
         // do a direct copy of the two pages
         const void* src = paddr_to_physmap(parent_paddr);
         DEBUG_ASSERT(src);
         memcpy(dst, src, PAGE_SIZE);
-    } else {
+    } else if (!already_zeroed) {
         // avoid pointless fetches by directly zeroing dst
         arch_zero_page(dst);
     }
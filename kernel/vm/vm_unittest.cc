@@ -6,10 +6,20 @@
 
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
+#include <fbl/auto_call.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <ktl/atomic.h>
 #include <ktl/move.h>
 #include <lib/unittest/unittest.h>
+#include <platform.h>
+#include <pow2.h>
+#include <string.h>
 #include <vm/physmap.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
@@ -103,6 +113,237 @@ static bool pmm_alloc_contiguous_one_test() {
     END_TEST;
 }
 
+// Frees a page while pinned to one cpu and checks that the next allocation on
+// that cpu is served the same page out of the cpu's cache.
+static bool pmm_cpu_cache_reuse_test() {
+    BEGIN_TEST;
+
+    size_t high, low, batch;
+    pmm_get_cpu_cache_watermarks(&high, &low, &batch);
+    if (high == 0) {
+        unittest_printf("pmm cpu caches disabled, skipping\n");
+        END_TEST;
+    }
+
+    thread_t* current = get_current_thread();
+    const cpu_mask_t old_affinity = current->cpu_affinity;
+    thread_set_cpu_affinity(current, cpu_num_to_mask(arch_curr_cpu_num()));
+    auto restore_affinity = fbl::MakeAutoCall([current, old_affinity]() {
+        thread_set_cpu_affinity(current, old_affinity);
+    });
+
+    vm_page_t* page;
+    zx_status_t status = pmm_alloc_page(0, &page);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_page");
+
+    pmm_free_page(page);
+
+    vm_page_t* page2;
+    status = pmm_alloc_page(0, &page2);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_page");
+    EXPECT_EQ(page, page2, "page not reused from cpu cache");
+    EXPECT_EQ(VM_PAGE_STATE_ALLOC, page2->state(), "");
+    pmm_free_page(page2);
+    pmm_drain_cpu_caches();
+
+    END_TEST;
+}
+
+// Pushes a cpu cache past its high watermark a few times over and checks the
+// pages can all be allocated again afterwards.
+static bool pmm_cpu_cache_overflow_test() {
+    BEGIN_TEST;
+
+    size_t high, low, batch;
+    pmm_get_cpu_cache_watermarks(&high, &low, &batch);
+
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, pmm_set_cpu_cache_watermarks(16, 32, 8), "low > high");
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, pmm_set_cpu_cache_watermarks(16, 8, 32), "batch > high");
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, pmm_set_cpu_cache_watermarks(16, 8, 0), "zero batch");
+
+    const size_t alloc_count = 4 * (high + batch) + 1;
+    list_node list = LIST_INITIAL_VALUE(list);
+    for (size_t i = 0; i < alloc_count; i++) {
+        vm_page_t* page;
+        ASSERT_EQ(ZX_OK, pmm_alloc_page(0, &page), "pmm_alloc_page");
+        list_add_tail(&list, &page->queue_node);
+    }
+
+    while (vm_page_t* page = list_remove_head_type(&list, vm_page_t, queue_node)) {
+        pmm_free_page(page);
+    }
+
+    zx_status_t status = pmm_alloc_pages(alloc_count, 0, &list);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_pages");
+    EXPECT_EQ(alloc_count, list_length(&list), "pmm_alloc_pages list count");
+
+    vm_page_t* page;
+    list_for_every_entry (&list, page, vm_page_t, queue_node) {
+        EXPECT_EQ(VM_PAGE_STATE_ALLOC, page->state(), "");
+    }
+    pmm_free(&list);
+    EXPECT_TRUE(list_is_empty(&list), "");
+
+    END_TEST;
+}
+
+// Allocates pages with PMM_ALLOC_FLAG_ZEROED, dirtying and freeing them in
+// between, and checks that they always come back zero filled.
+static bool pmm_alloc_zeroed_test() {
+    BEGIN_TEST;
+
+    for (int i = 0; i < 32; i++) {
+        vm_page_t* page;
+        paddr_t pa;
+        zx_status_t status = pmm_alloc_page(PMM_ALLOC_FLAG_ZEROED, &page, &pa);
+        ASSERT_EQ(ZX_OK, status, "pmm_alloc_page zeroed");
+        EXPECT_EQ(0u, page->flags & VM_PAGE_FLAG_ZEROED, "pool flag leaked");
+
+        uint8_t* ptr = static_cast<uint8_t*>(paddr_to_physmap(pa));
+        ASSERT_NONNULL(ptr, "");
+        for (size_t j = 0; j < PAGE_SIZE; j++) {
+            if (ptr[j] != 0) {
+                UNITTEST_FAIL_TRACEF("page %p not zeroed at offset %zu\n", page, j);
+                all_ok = false;
+                break;
+            }
+        }
+
+        memset(ptr, 0xa5, PAGE_SIZE);
+        pmm_free_page(page);
+    }
+
+    list_node list = LIST_INITIAL_VALUE(list);
+    zx_status_t status = pmm_alloc_pages(8, PMM_ALLOC_FLAG_ZEROED, &list);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_pages zeroed");
+    vm_page_t* page;
+    list_for_every_entry (&list, page, vm_page_t, queue_node) {
+        const uint64_t* ptr = static_cast<const uint64_t*>(paddr_to_physmap(page->paddr()));
+        for (size_t j = 0; j < PAGE_SIZE / sizeof(*ptr); j++) {
+            if (ptr[j] != 0) {
+                UNITTEST_FAIL_TRACEF("page %p not zeroed at offset %zu\n", page, j);
+                all_ok = false;
+                break;
+            }
+        }
+    }
+    pmm_free(&list);
+
+    END_TEST;
+}
+
+namespace {
+
+struct PmmStressArgs {
+    ktl::atomic<bool> go{false};
+    ktl::atomic<bool> stop{false};
+    ktl::atomic<uint64_t> pages{0};
+};
+
+// Allocates and frees small bursts of pages until told to stop.
+int pmm_stress_worker(void* arg) {
+    auto args = static_cast<PmmStressArgs*>(arg);
+    constexpr size_t kBurst = 8;
+    vm_page_t* pages[kBurst];
+    uint64_t count = 0;
+
+    while (!args->go.load()) {
+        thread_yield();
+    }
+    while (!args->stop.load(ktl::memory_order_relaxed)) {
+        size_t allocated = 0;
+        for (; allocated < kBurst; allocated++) {
+            if (pmm_alloc_page(0, &pages[allocated]) != ZX_OK) {
+                break;
+            }
+        }
+        for (size_t i = 0; i < allocated; i++) {
+            pmm_free_page(pages[i]);
+        }
+        count += allocated;
+    }
+
+    args->pages.fetch_add(count);
+    return 0;
+}
+
+// Runs one worker pinned to each of the first |num_cpus| online cpus for
+// |duration| and returns the total number of pages they allocated and freed.
+uint64_t pmm_stress_run(uint num_cpus, zx_duration_t duration) {
+    PmmStressArgs args;
+    thread_t* threads[SMP_MAX_CPUS];
+    uint started = 0;
+
+    const cpu_mask_t online = mp_get_online_mask();
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS && started < num_cpus; cpu++) {
+        if (!(online & cpu_num_to_mask(cpu))) {
+            continue;
+        }
+        thread_t* t = thread_create("pmm stress", pmm_stress_worker, &args, DEFAULT_PRIORITY);
+        if (!t) {
+            break;
+        }
+        thread_set_cpu_affinity(t, cpu_num_to_mask(cpu));
+        thread_resume(t);
+        threads[started++] = t;
+    }
+
+    args.go.store(true);
+    thread_sleep_relative(duration);
+    args.stop.store(true);
+
+    for (uint i = 0; i < started; i++) {
+        thread_join(threads[i], nullptr, ZX_TIME_INFINITE);
+    }
+    return args.pages.load();
+}
+
+} // namespace
+
+// Measures page alloc/free throughput with the cpu caches on and off for an
+// increasing number of cpus. There is nothing much to assert on, the
+// interesting part is the printed table.
+static bool pmm_cpu_cache_scaling_benchmark() {
+    BEGIN_TEST;
+
+    size_t high, low, batch;
+    pmm_get_cpu_cache_watermarks(&high, &low, &batch);
+    auto restore_watermarks = fbl::MakeAutoCall([high, low, batch]() {
+        pmm_set_cpu_cache_watermarks(high, low, batch);
+    });
+    if (high == 0) {
+        high = 64;
+        low = 16;
+        batch = 32;
+    }
+
+    const zx_duration_t duration = ZX_MSEC(100);
+    uint max_cpus = 0;
+    const cpu_mask_t online = mp_get_online_mask();
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (online & cpu_num_to_mask(cpu)) {
+            max_cpus++;
+        }
+    }
+
+    unittest_printf("\n%6s %16s %16s\n", "cpus", "uncached pg/s", "cached pg/s");
+    for (uint cpus = 1;; cpus = fbl::min(cpus * 2, max_cpus)) {
+        ASSERT_EQ(ZX_OK, pmm_set_cpu_cache_watermarks(0, 0, 0), "");
+        const uint64_t uncached = pmm_stress_run(cpus, duration);
+        ASSERT_EQ(ZX_OK, pmm_set_cpu_cache_watermarks(high, low, batch), "");
+        const uint64_t cached = pmm_stress_run(cpus, duration);
+
+        EXPECT_GT(cached, 0u, "no progress with cpu caches enabled");
+        unittest_printf("%6u %16" PRIu64 " %16" PRIu64 "\n", cpus,
+                        uncached * ZX_SEC(1) / duration, cached * ZX_SEC(1) / duration);
+        if (cpus >= max_cpus) {
+            break;
+        }
+    }
+
+    END_TEST;
+}
+
 static uint32_t test_rand(uint32_t seed) {
     return (seed = seed * 1664525 + 1013904223);
 }
@@ -655,6 +896,111 @@ static bool vmo_demand_paged_map_test() {
     END_TEST;
 }
 
+// Creates a committed vm object, maps it with fault-around and checks that a
+// single read fault on either end maps the rest of the pages as well.
+static bool vmo_fault_around_test() {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+    ASSERT_EQ(ZX_OK, vmo->CommitRange(0, alloc_size), "committing vmo\n");
+
+    // touch the first page, then the last one
+    const size_t touched_offsets[] = {0, alloc_size - PAGE_SIZE};
+    for (size_t touched : touched_offsets) {
+        fbl::RefPtr<VmMapping> mapping;
+        status = VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+            0, alloc_size, 0, VMAR_FLAG_FAULT_AROUND, vmo, 0, ARCH_MMU_FLAG_PERM_READ,
+            "test", &mapping);
+        ASSERT_EQ(ZX_OK, status, "mapping object");
+
+        const vaddr_t base = mapping->base();
+        auto& arch_aspace = VmAspace::kernel_aspace()->arch_aspace();
+        EXPECT_NE(ZX_OK, arch_aspace.Query(base + PAGE_SIZE, nullptr, nullptr),
+                  "page mapped before fault");
+
+        volatile uint8_t* ptr = reinterpret_cast<volatile uint8_t*>(base + touched);
+        EXPECT_EQ(0u, ptr[0], "reading touched page");
+
+        if (cmdline_get_uint64("kernel.vm.fault-around-pages", 16) >= alloc_size / PAGE_SIZE) {
+            for (size_t off = 0; off < alloc_size; off += PAGE_SIZE) {
+                paddr_t pa;
+                uint flags;
+                ASSERT_EQ(ZX_OK, arch_aspace.Query(base + off, &pa, &flags),
+                          "page not faulted around");
+                if (off != touched) {
+                    EXPECT_FALSE(flags & ARCH_MMU_FLAG_PERM_WRITE, "faulted around page writable");
+                }
+            }
+        }
+
+        EXPECT_EQ(ZX_OK, mapping->Destroy(), "unmapping object");
+    }
+    END_TEST;
+}
+
+// Maps an aligned contiguous vm object, which lets the mapping use a large
+// page, and checks that faulting and partially unmapping it behave.
+static bool vmo_contiguous_large_page_test() {
+    BEGIN_TEST;
+    static const size_t large_page_size = PAGE_SIZE * (PAGE_SIZE / sizeof(uint64_t));
+    static const uint8_t large_page_shift = static_cast<uint8_t>(log2_uint_floor(large_page_size));
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::CreateContiguous(PMM_ALLOC_FLAG_ANY, large_page_size,
+                                                         large_page_shift, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+
+    paddr_t base_pa;
+    status = vmo->Lookup(0, PAGE_SIZE, [](void* ctx, size_t offset, size_t index, paddr_t pa) {
+        *static_cast<paddr_t*>(ctx) = pa;
+        return ZX_OK;
+    }, &base_pa);
+    ASSERT_EQ(ZX_OK, status, "vmo lookup\n");
+
+    auto ka = VmAspace::kernel_aspace();
+    const uint vmm_flags_list[] = {0u, VmAspace::VMM_FLAG_COMMIT};
+    for (uint vmm_flags : vmm_flags_list) {
+        void* ptr;
+        status = ka->MapObjectInternal(vmo, "test", 0, large_page_size, &ptr, large_page_shift,
+                                       vmm_flags, kArchRwFlags);
+        ASSERT_EQ(ZX_OK, status, "mapping object");
+        const vaddr_t base = reinterpret_cast<vaddr_t>(ptr);
+
+        // a single read maps the whole block when demand paged, read-only
+        __UNUSED uint8_t value = *static_cast<volatile uint8_t*>(ptr);
+        for (size_t off = 0; off < large_page_size; off += PAGE_SIZE) {
+            paddr_t pa;
+            uint flags;
+            ASSERT_EQ(ZX_OK, ka->arch_aspace().Query(base + off, &pa, &flags), "page not mapped");
+            EXPECT_EQ(base_pa + off, pa, "wrong physical address");
+            if (vmm_flags == 0) {
+                EXPECT_FALSE(flags & ARCH_MMU_FLAG_PERM_WRITE, "read fault mapped writable");
+            }
+        }
+
+        // and a write makes all of it writable
+        *static_cast<volatile uint8_t*>(ptr) = 0x5a;
+        for (size_t off = 0; off < large_page_size; off += PAGE_SIZE) {
+            uint flags;
+            ASSERT_EQ(ZX_OK, ka->arch_aspace().Query(base + off, nullptr, &flags), "page not mapped");
+            EXPECT_TRUE(flags & ARCH_MMU_FLAG_PERM_WRITE, "page not writable");
+        }
+
+        // unmapping one page has to leave the rest of the block alone
+        EXPECT_EQ(ZX_OK, ka->arch_aspace().Unmap(base + PAGE_SIZE, 1, nullptr), "unmap page");
+        EXPECT_NE(ZX_OK, ka->arch_aspace().Query(base + PAGE_SIZE, nullptr, nullptr),
+                  "page still mapped");
+        EXPECT_EQ(ZX_OK, ka->arch_aspace().Query(base, nullptr, nullptr), "page unmapped");
+        EXPECT_EQ(ZX_OK, ka->arch_aspace().Query(base + 2 * PAGE_SIZE, nullptr, nullptr),
+                  "page unmapped");
+        EXPECT_EQ(0x5a, *static_cast<volatile uint8_t*>(ptr), "lost contents");
+
+        EXPECT_EQ(ZX_OK, ka->FreeRegion(base), "unmapping object");
+    }
+    END_TEST;
+}
+
 // Creates a vm object, maps it, drops ref before unmapping.
 static bool vmo_dropped_ref_test() {
     BEGIN_TEST;
@@ -1686,8 +2032,10 @@ VM_UNITTEST(vmo_odd_size_commit_test)
 VM_UNITTEST(vmo_create_physical_test)
 VM_UNITTEST(vmo_create_contiguous_test)
 VM_UNITTEST(vmo_contiguous_decommit_test)
+VM_UNITTEST(vmo_contiguous_large_page_test)
 VM_UNITTEST(vmo_precommitted_map_test)
 VM_UNITTEST(vmo_demand_paged_map_test)
+VM_UNITTEST(vmo_fault_around_test)
 VM_UNITTEST(vmo_dropped_ref_test)
 VM_UNITTEST(vmo_remap_test)
 VM_UNITTEST(vmo_double_remap_test)
@@ -1706,6 +2054,10 @@ VM_UNITTEST(pmm_alloc_contiguous_one_test)
 VM_UNITTEST(pmm_multi_alloc_test)
 VM_UNITTEST(pmm_singleton_list_test)
 VM_UNITTEST(pmm_oversized_alloc_test)
+VM_UNITTEST(pmm_cpu_cache_reuse_test)
+VM_UNITTEST(pmm_cpu_cache_overflow_test)
+VM_UNITTEST(pmm_cpu_cache_scaling_benchmark)
+VM_UNITTEST(pmm_alloc_zeroed_test)
 UNITTEST_END_TESTCASE(pmm_tests, "pmm", "Physical memory manager tests");
 
 UNITTEST_START_TESTCASE(vm_page_list_tests)
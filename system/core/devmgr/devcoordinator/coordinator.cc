@@ -297,6 +297,14 @@ void Coordinator::DumpDrivers(VmoWriter* vmo) const {
     }
     first = false;
   }
+  vmo->Printf("\nBind programs evaluated: %lu (%ld us), skipped by index: %lu\n",
+              bind_stats_.evaluations, bind_stats_.evaluation_time.to_usecs(),
+              bind_stats_.skipped);
+}
+
+void Coordinator::LogBindStats() const {
+  log(INFO, "devcoordinator: evaluated %lu bind programs in %ld us, skipped %lu\n",
+      bind_stats_.evaluations, bind_stats_.evaluation_time.to_usecs(), bind_stats_.skipped);
 }
 
 static const char* get_devhost_bin(bool asan_drivers) {
@@ -1262,6 +1270,7 @@ void Coordinator::DriverAdded(Driver* drv, const char* version) {
   }
   async::PostTask(dispatcher(), [this, drv = driver.release()] {
     drivers_.push_back(drv);
+    driver_index_stale_ = true;
     zx_status_t status = BindDriver(drv);
     if (status != ZX_OK && status != ZX_ERR_UNAVAILABLE) {
       log(ERROR, "devcoordinator: failed to bind driver '%s': %s\n", drv->name.data(),
@@ -1297,6 +1306,7 @@ void Coordinator::DriverAddedInit(Driver* drv, const char* version) {
   } else {
     drivers_.push_back(driver.release());
   }
+  driver_index_stale_ = true;
 }
 
 // Drivers added during system scan (from the dedicated thread)
@@ -1328,7 +1338,11 @@ zx_status_t Coordinator::BindDriverToDevice(const fbl::RefPtr<Device>& dev, cons
   if (!dev->is_bindable() && !(dev->is_composite_bindable())) {
     return ZX_ERR_NEXT;
   }
-  if (!driver_is_bindable(drv, dev->protocol_id(), dev->props(), autobind)) {
+  zx::time start = zx::clock::get_monotonic();
+  bool bindable = driver_is_bindable(drv, dev->protocol_id(), dev->props(), autobind);
+  bind_stats_.evaluation_time += zx::clock::get_monotonic() - start;
+  bind_stats_.evaluations++;
+  if (!bindable) {
     return ZX_ERR_NEXT;
   }
 
@@ -1409,16 +1423,30 @@ zx_status_t Coordinator::BindDevice(const fbl::RefPtr<Device>& dev, fbl::StringP
     }
   }
 
-  // TODO: disallow if we're in the middle of enumeration, etc
-  for (const auto& drv : drivers_) {
-    if (!autobind && drvlibname.compare(drv.libname)) {
-      continue;
+  // Only evaluate the bind programs of drivers that could match the device.
+  fbl::Vector<const Driver*> candidates;
+  if (autobind) {
+    if (driver_index_stale_) {
+      driver_index_.Build(drivers_);
+      driver_index_stale_ = false;
     }
-    if (drv.never_autoselect) {
+    driver_index_.FindCandidates(dev->protocol_id(), dev->props(), autobind, &candidates);
+    bind_stats_.skipped += driver_index_.size() - candidates.size();
+  } else {
+    for (const auto& drv : drivers_) {
+      if (!drvlibname.compare(drv.libname)) {
+        candidates.push_back(&drv);
+      }
+    }
+  }
+
+  // TODO: disallow if we're in the middle of enumeration, etc
+  for (const Driver* drv : candidates) {
+    if (drv->never_autoselect) {
       continue;
     }
 
-    zx_status_t status = BindDriverToDevice(dev, &drv, autobind);
+    zx_status_t status = BindDriverToDevice(dev, drv, autobind);
     if (status == ZX_ERR_NEXT) {
       continue;
     }
@@ -1473,6 +1501,7 @@ void Coordinator::BindSystemDrivers() {
   // Bind system drivers.
   while ((drv = system_drivers_.pop_front()) != nullptr) {
     drivers_.push_back(drv);
+    driver_index_stale_ = true;
     zx_status_t status = BindDriver(drv);
     if (status != ZX_OK && status != ZX_ERR_UNAVAILABLE) {
       log(ERROR, "devcoordinator: failed to bind driver '%s': %s\n", drv->name.data(),
@@ -1483,12 +1512,14 @@ void Coordinator::BindSystemDrivers() {
   while ((drv = fallback_drivers_.pop_front()) != nullptr) {
     printf("devcoordinator: fallback driver '%s' is available\n", drv->name.data());
     drivers_.push_back(drv);
+    driver_index_stale_ = true;
     zx_status_t status = BindDriver(drv);
     if (status != ZX_OK && status != ZX_ERR_UNAVAILABLE) {
       log(ERROR, "devcoordinator: failed to bind driver '%s': %s\n", drv->name.data(),
           zx_status_get_string(status));
     }
   }
+  LogBindStats();
 }
 
 void Coordinator::BindDrivers() {
@@ -1501,7 +1532,10 @@ void Coordinator::BindDrivers() {
   }
 }
 
-void Coordinator::UseFallbackDrivers() { drivers_.splice(drivers_.end(), fallback_drivers_); }
+void Coordinator::UseFallbackDrivers() {
+  drivers_.splice(drivers_.end(), fallback_drivers_);
+  driver_index_stale_ = true;
+}
 
 void Coordinator::InitOutgoingServices() {
   const auto& svc_dir = outgoing_services_.svc_dir();
@@ -17,6 +17,7 @@
 #include <lib/zx/event.h>
 #include <lib/zx/job.h>
 #include <lib/zx/process.h>
+#include <lib/zx/time.h>
 #include <lib/zx/vmo.h>
 
 #include <utility>
@@ -25,6 +26,7 @@
 #include "composite-device.h"
 #include "devhost.h"
 #include "device.h"
+#include "driver-index.h"
 #include "driver.h"
 #include "metadata.h"
 #include "suspend-task.h"
@@ -203,7 +205,11 @@ class Coordinator {
     loader_service_ = loader_service;
   }
 
-  fbl::DoublyLinkedList<Driver*, Driver::Node>& drivers() { return drivers_; }
+  // The caller may modify the list, so the driver index is rebuilt before its next use.
+  fbl::DoublyLinkedList<Driver*, Driver::Node>& drivers() {
+    driver_index_stale_ = true;
+    return drivers_;
+  }
   const fbl::DoublyLinkedList<Driver*, Driver::Node>& drivers() const { return drivers_; }
   fbl::DoublyLinkedList<fbl::RefPtr<Device>, Device::AllDevicesNode>& devices() { return devices_; }
   const fbl::DoublyLinkedList<fbl::RefPtr<Device>, Device::AllDevicesNode>& devices() const {
@@ -249,6 +255,22 @@ class Coordinator {
   // All Drivers
   fbl::DoublyLinkedList<Driver*, Driver::Node> drivers_;
 
+  // Index of |drivers_| used to find the drivers worth trying against a new
+  // device.  Any change to |drivers_| must set |driver_index_stale_|.
+  DriverIndex driver_index_;
+  bool driver_index_stale_ = true;
+
+  // Bind program statistics, reported once system drivers have been bound
+  // and in the driver dump.
+  struct BindStats {
+    // Bind programs evaluated against a device.
+    uint64_t evaluations = 0;
+    // Drivers not evaluated against a new device because the index ruled them out.
+    uint64_t skipped = 0;
+    zx::duration evaluation_time;
+  };
+  BindStats bind_stats_;
+
   // Drivers to try last
   fbl::DoublyLinkedList<Driver*, Driver::Node> fallback_drivers_;
 
@@ -285,6 +307,7 @@ class Coordinator {
   void DumpDeviceProps(VmoWriter* vmo, const Device* dev) const;
   void DumpGlobalDeviceProps(VmoWriter* vmo) const;
   void DumpDrivers(VmoWriter* vmo) const;
+  void LogBindStats() const;
 
   void BuildSuspendList();
   void Suspend(SuspendContext ctx, std::function<void(zx_status_t)> callback);
@@ -0,0 +1,204 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "driver-index.h"
+
+#include <ddk/binding.h>
+#include <ddk/driver.h>
+#include <ddk/platform-defs.h>
+#include <fbl/array.h>
+#include <fbl/vector.h>
+#include <string.h>
+#include <zxtest/zxtest.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "coordinator.h"
+
+namespace {
+
+template <size_t N>
+void SetBindProgram(devmgr::Driver* drv, const zx_bind_inst_t (&insts)[N]) {
+  auto binding = new zx_bind_inst_t[N];
+  memcpy(binding, insts, sizeof(insts));
+  drv->binding.reset(binding);
+  drv->binding_size = sizeof(insts);
+}
+
+template <size_t N>
+bool FindBindKey(const zx_bind_inst_t (&insts)[N], uint32_t* out_id, uint32_t* out_value) {
+  return devmgr::FindBindKey(insts, N, out_id, out_value);
+}
+
+TEST(DriverIndexTestCase, BindKeyPrefersProtocol) {
+  const zx_bind_inst_t program[] = {
+      BI_ABORT_IF(NE, BIND_PCI_VID, 0x8086),
+      BI_ABORT_IF(NE, BIND_PROTOCOL, ZX_PROTOCOL_PCI),
+      BI_MATCH_IF(EQ, BIND_PCI_DID, 0x1234),
+  };
+  uint32_t id, value;
+  ASSERT_TRUE(FindBindKey(program, &id, &value));
+  EXPECT_EQ(BIND_PROTOCOL, id);
+  EXPECT_EQ(ZX_PROTOCOL_PCI, value);
+}
+
+TEST(DriverIndexTestCase, BindKeyOtherProperty) {
+  const zx_bind_inst_t program[] = {
+      BI_ABORT_IF(EQ, BIND_PLATFORM_DEV_DID, 1),
+      BI_ABORT_IF(NE, BIND_PLATFORM_DEV_VID, PDEV_VID_GOOGLE),
+      BI_ABORT_IF(NE, BIND_PLATFORM_DEV_PID, PDEV_PID_GAUSS),
+      BI_MATCH(),
+  };
+  uint32_t id, value;
+  ASSERT_TRUE(FindBindKey(program, &id, &value));
+  EXPECT_EQ(BIND_PLATFORM_DEV_VID, id);
+  EXPECT_EQ(PDEV_VID_GOOGLE, value);
+}
+
+TEST(DriverIndexTestCase, BindKeyStopsAtBranch) {
+  // The protocol is only required on one of the paths that can match.
+  const zx_bind_inst_t match_first[] = {
+      BI_MATCH_IF(EQ, BIND_PCI_VID, 0x8086),
+      BI_ABORT_IF(NE, BIND_PROTOCOL, ZX_PROTOCOL_PCI),
+      BI_MATCH(),
+  };
+  uint32_t id, value;
+  EXPECT_FALSE(FindBindKey(match_first, &id, &value));
+
+  const zx_bind_inst_t goto_first[] = {
+      BI_GOTO_IF(EQ, BIND_PCI_VID, 0x8086, 1),
+      BI_ABORT_IF(NE, BIND_PROTOCOL, ZX_PROTOCOL_PCI),
+      BI_LABEL(1),
+      BI_MATCH(),
+  };
+  EXPECT_FALSE(FindBindKey(goto_first, &id, &value));
+
+  const zx_bind_inst_t no_key[] = {
+      BI_ABORT_IF(EQ, BIND_PROTOCOL, ZX_PROTOCOL_PCI),
+      BI_MATCH(),
+  };
+  EXPECT_FALSE(FindBindKey(no_key, &id, &value));
+}
+
+class DriverIndexTest : public zxtest::Test {
+ protected:
+  void TearDown() override { drivers_.clear(); }
+
+  devmgr::Driver* AddDriver() {
+    owned_.push_back(std::make_unique<devmgr::Driver>());
+    devmgr::Driver* drv = owned_[owned_.size() - 1].get();
+    drivers_.push_back(drv);
+    return drv;
+  }
+
+  // Checks that the index returns, in list order, exactly the drivers that are not ruled out by
+  // their keys, and that it includes every driver that binds to the device.
+  void ExpectCandidates(uint32_t protocol_id, const fbl::Array<const zx_device_prop_t>& props,
+                        std::initializer_list<const devmgr::Driver*> expected) {
+    devmgr::DriverIndex index;
+    index.Build(drivers_);
+    fbl::Vector<const devmgr::Driver*> candidates;
+    index.FindCandidates(protocol_id, props, true /* autobind */, &candidates);
+
+    ASSERT_EQ(expected.size(), candidates.size());
+    size_t i = 0;
+    for (const devmgr::Driver* drv : expected) {
+      EXPECT_EQ(drv, candidates[i++]);
+    }
+
+    for (const auto& drv : drivers_) {
+      if (!drv.never_autoselect &&
+          devmgr::driver_is_bindable(&drv, protocol_id, props, true /* autobind */)) {
+        EXPECT_TRUE(std::find(candidates.begin(), candidates.end(), &drv) != candidates.end(),
+                    "%s", drv.name.c_str());
+      }
+    }
+  }
+
+  fbl::DoublyLinkedList<devmgr::Driver*, devmgr::Driver::Node> drivers_;
+
+ private:
+  fbl::Vector<std::unique_ptr<devmgr::Driver>> owned_;
+};
+
+TEST_F(DriverIndexTest, CandidatesInListOrder) {
+  devmgr::Driver* pci = AddDriver();
+  pci->name = "pci";
+  SetBindProgram(pci, {
+                          BI_ABORT_IF(NE, BIND_PROTOCOL, ZX_PROTOCOL_PCI),
+                          BI_MATCH_IF(EQ, BIND_PCI_VID, 0x8086),
+                      });
+  devmgr::Driver* any = AddDriver();
+  any->name = "any";
+  SetBindProgram(any, {
+                          BI_MATCH_IF(EQ, BIND_PROTOCOL, ZX_PROTOCOL_USB),
+                          BI_MATCH_IF(EQ, BIND_PROTOCOL, ZX_PROTOCOL_PCI),
+                      });
+  devmgr::Driver* usb = AddDriver();
+  usb->name = "usb";
+  SetBindProgram(usb, {
+                          BI_ABORT_IF(NE, BIND_PROTOCOL, ZX_PROTOCOL_USB),
+                          BI_MATCH(),
+                      });
+  devmgr::Driver* pci2 = AddDriver();
+  pci2->name = "pci2";
+  SetBindProgram(pci2, {
+                           BI_ABORT_IF(NE, BIND_PROTOCOL, ZX_PROTOCOL_PCI),
+                           BI_MATCH(),
+                       });
+  // Drivers which only bind on request never match during autobind.
+  devmgr::Driver* manual = AddDriver();
+  manual->name = "manual";
+  SetBindProgram(manual, {
+                             BI_ABORT_IF_AUTOBIND,
+                             BI_MATCH(),
+                         });
+  devmgr::Driver* component = AddDriver();
+  component->name = "component";
+  component->never_autoselect = true;
+  SetBindProgram(component, {
+                                BI_ABORT_IF(NE, BIND_PROTOCOL, ZX_PROTOCOL_PCI),
+                                BI_MATCH(),
+                            });
+
+  fbl::Array<const zx_device_prop_t> no_props;
+  ASSERT_NO_FATAL_FAILURES(ExpectCandidates(ZX_PROTOCOL_PCI, no_props, {pci, any, pci2}));
+  ASSERT_NO_FATAL_FAILURES(ExpectCandidates(ZX_PROTOCOL_USB, no_props, {any, usb}));
+  ASSERT_NO_FATAL_FAILURES(ExpectCandidates(ZX_PROTOCOL_BLOCK, no_props, {any}));
+
+  // A BIND_PROTOCOL property overrides the device's protocol id.
+  zx_device_prop_t* props = new zx_device_prop_t[1];
+  props[0] = {BIND_PROTOCOL, 0, ZX_PROTOCOL_USB};
+  fbl::Array<const zx_device_prop_t> usb_props(props, 1);
+  ASSERT_NO_FATAL_FAILURES(ExpectCandidates(ZX_PROTOCOL_PCI, usb_props, {any, usb}));
+}
+
+TEST_F(DriverIndexTest, CandidatesByProperty) {
+  devmgr::Driver* gauss = AddDriver();
+  gauss->name = "gauss";
+  SetBindProgram(gauss, {
+                            BI_ABORT_IF(NE, BIND_PLATFORM_DEV_VID, PDEV_VID_GOOGLE),
+                            BI_MATCH_IF(EQ, BIND_PLATFORM_DEV_PID, PDEV_PID_GAUSS),
+                        });
+  devmgr::Driver* pdev = AddDriver();
+  pdev->name = "pdev";
+  SetBindProgram(pdev, {
+                           BI_ABORT_IF(NE, BIND_PROTOCOL, ZX_PROTOCOL_PDEV),
+                           BI_ABORT_IF(NE, BIND_PLATFORM_DEV_VID, PDEV_VID_GOOGLE),
+                           BI_MATCH(),
+                       });
+
+  zx_device_prop_t* props = new zx_device_prop_t[2];
+  props[0] = {BIND_PLATFORM_DEV_VID, 0, PDEV_VID_GOOGLE};
+  props[1] = {BIND_PLATFORM_DEV_PID, 0, PDEV_PID_GAUSS};
+  fbl::Array<const zx_device_prop_t> google_props(props, 2);
+  ASSERT_NO_FATAL_FAILURES(ExpectCandidates(ZX_PROTOCOL_PDEV, google_props, {gauss, pdev}));
+  ASSERT_NO_FATAL_FAILURES(ExpectCandidates(ZX_PROTOCOL_MISC, google_props, {gauss}));
+
+  fbl::Array<const zx_device_prop_t> no_props;
+  ASSERT_NO_FATAL_FAILURES(ExpectCandidates(ZX_PROTOCOL_PDEV, no_props, {pdev}));
+}
+
+}  // namespace
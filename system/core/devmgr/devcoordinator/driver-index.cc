@@ -0,0 +1,100 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "driver-index.h"
+
+#include <algorithm>
+
+#include "binding-internal.h"
+
+namespace devmgr {
+
+bool FindBindKey(const zx_bind_inst_t* binding, size_t count, uint32_t* out_id,
+                 uint32_t* out_value) {
+  bool found = false;
+  // Until the first instruction that can match or jump, the program runs straight through, so
+  // every "abort unless equal" it executes is a requirement for matching.
+  for (size_t i = 0; i < count; i++) {
+    uint32_t inst = binding[i].op;
+    if (BINDINST_OP(inst) == OP_LABEL) {
+      continue;
+    }
+    if (BINDINST_OP(inst) != OP_ABORT) {
+      break;
+    }
+    uint32_t id = BINDINST_PB(inst);
+    if (BINDINST_CC(inst) != COND_NE || id == BIND_FLAGS) {
+      continue;
+    }
+    if (!found || id == BIND_PROTOCOL) {
+      found = true;
+      *out_id = id;
+      *out_value = binding[i].arg;
+      if (id == BIND_PROTOCOL) {
+        break;
+      }
+    }
+  }
+  return found;
+}
+
+void DriverIndex::Build(const fbl::DoublyLinkedList<Driver*, Driver::Node>& drivers) {
+  keyed_.clear();
+  key_ids_.reset();
+  unkeyed_.reset();
+  size_ = 0;
+
+  size_t position = 0;
+  for (const auto& drv : drivers) {
+    if (drv.never_autoselect) {
+      continue;
+    }
+    Entry entry = {position++, &drv};
+    uint32_t id, value;
+    if (FindBindKey(drv.binding.get(), drv.binding_size / sizeof(drv.binding[0]), &id, &value)) {
+      if (std::find(key_ids_.begin(), key_ids_.end(), id) == key_ids_.end()) {
+        key_ids_.push_back(id);
+      }
+      keyed_[Key(id, value)].push_back(entry);
+    } else {
+      unkeyed_.push_back(entry);
+    }
+  }
+  size_ = position;
+}
+
+void DriverIndex::FindCandidates(uint32_t protocol_id,
+                                 const fbl::Array<const zx_device_prop_t>& props, bool autobind,
+                                 fbl::Vector<const Driver*>* out) const {
+  internal::BindProgramContext ctx;
+  ctx.props = &props;
+  ctx.protocol_id = protocol_id;
+  ctx.binding = nullptr;
+  ctx.binding_size = 0;
+  ctx.name = nullptr;
+  ctx.autobind = autobind ? 1 : 0;
+
+  fbl::Vector<Entry> candidates;
+  for (const auto& entry : unkeyed_) {
+    candidates.push_back(entry);
+  }
+  for (uint32_t id : key_ids_) {
+    auto it = keyed_.find(Key(id, internal::LookupBindProperty(&ctx, id)));
+    if (it == keyed_.end()) {
+      continue;
+    }
+    for (const auto& entry : it->second) {
+      candidates.push_back(entry);
+    }
+  }
+
+  // Each driver is filed only once, so sorting restores the list order without duplicates.
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Entry& a, const Entry& b) { return a.position < b.position; });
+  for (const auto& entry : candidates) {
+    out->push_back(entry.driver);
+  }
+}
+
+}  // namespace devmgr
@@ -0,0 +1,64 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ZIRCON_SYSTEM_CORE_DEVMGR_DEVCOORDINATOR_DRIVER_INDEX_H_
+#define ZIRCON_SYSTEM_CORE_DEVMGR_DEVCOORDINATOR_DRIVER_INDEX_H_
+
+#include <ddk/binding.h>
+#include <fbl/array.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/vector.h>
+
+#include <unordered_map>
+
+#include "driver.h"
+
+namespace devmgr {
+
+// If every path through |binding| that matches first aborts unless property |*out_id| equals
+// |*out_value|, stores them and returns true. BIND_PROTOCOL is preferred when a program requires
+// more than one property value.
+bool FindBindKey(const zx_bind_inst_t* binding, size_t count, uint32_t* out_id,
+                 uint32_t* out_value);
+
+// Finds the drivers that might bind to a device without evaluating every bind program.
+//
+// Most bind programs start by aborting unless the device has a particular protocol, so they can
+// only match devices with that protocol. The index files each such driver under the property
+// value it requires, and a lookup returns the drivers filed under the device's values along with
+// those whose programs require no particular value. Candidates are returned in the order of the
+// driver list the index was built from, which is the order in which they should be tried.
+class DriverIndex {
+ public:
+  // Rebuilds the index from |drivers|. Drivers which are never autoselected are left out.
+  void Build(const fbl::DoublyLinkedList<Driver*, Driver::Node>& drivers);
+
+  // Appends the drivers whose bind programs might match a device with the given properties to
+  // |out|.
+  void FindCandidates(uint32_t protocol_id, const fbl::Array<const zx_device_prop_t>& props,
+                      bool autobind, fbl::Vector<const Driver*>* out) const;
+
+  // The number of drivers in the index.
+  size_t size() const { return size_; }
+
+ private:
+  struct Entry {
+    size_t position;
+    const Driver* driver;
+  };
+
+  static uint64_t Key(uint32_t id, uint32_t value) {
+    return static_cast<uint64_t>(id) << 32 | value;
+  }
+
+  std::unordered_map<uint64_t, fbl::Vector<Entry>> keyed_;
+  // The distinct property ids that drivers are filed under.
+  fbl::Vector<uint32_t> key_ids_;
+  fbl::Vector<Entry> unkeyed_;
+  size_t size_ = 0;
+};
+
+}  // namespace devmgr
+
+#endif  // ZIRCON_SYSTEM_CORE_DEVMGR_DEVCOORDINATOR_DRIVER_INDEX_H_
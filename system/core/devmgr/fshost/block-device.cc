@@ -360,6 +360,7 @@ zx_status_t BlockDevice::MountFilesystem() {
         fprintf(stderr, "fshost: BlockDevice::MountFilesystem(blobfs)\n");
         mount_options_t options = default_mount_options;
         options.enable_journal = true;
+        options.enable_pager = true;
         options.collect_metrics = true;
         zx_status_t status = mounter_->MountBlob(std::move(cloned_fd), &options);
         if (status != ZX_OK) {
@@ -106,6 +106,8 @@ zx_status_t FsManager::Initialize() {
     if ((status = global_root_->Create(&vn, "tmp", S_IFDIR)) != ZX_OK) {
         return status;
     }
+    // From here on, names are only added through |root_vfs_|.
+    root_vfs_->EnableDentryCache(fs::DentryCacheOptions());
     for (unsigned n = 0; n < fbl::count_of(kMountPoints); n++) {
         fbl::StringPiece pathout;
         status = root_vfs_->Open(global_root_, &mount_nodes[n], fbl::StringPiece(kMountPoints[n]),
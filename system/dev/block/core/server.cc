@@ -12,7 +12,6 @@
 #include <ddk/protocol/block.h>
 #include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
-#include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <fbl/ref_ptr.h>
 #include <lib/zx/fifo.h>
@@ -27,8 +26,8 @@ namespace {
 // This signal is set on the FIFO when the server should be instructed
 // to terminate.
 constexpr zx_signals_t kSignalFifoTerminate   = ZX_USER_SIGNAL_0;
-// This signal is set on the FIFO when, after the thread enqueueing operations
-// has encountered a barrier, all prior operations have completed.
+// This signal is set on the FIFO when completed operations allow operations
+// held back by a barrier to be issued.
 constexpr zx_signals_t kSignalFifoOpsComplete = ZX_USER_SIGNAL_1;
 // Signalled on the fifo when it has finished terminating.
 // (If we need to free up user signals, this could easily be transformed
@@ -39,6 +38,16 @@ constexpr zx_signals_t kSignalFifoTerminated  = ZX_USER_SIGNAL_2;
 // has no accompanying group.
 constexpr groupid_t kNoGroup = MAX_TXN_GROUP_COUNT;
 
+// All requests on the FIFO belong to a single scheduler stream.
+constexpr uint32_t kStreamId = 0;
+
+// Reads may be issued ahead of earlier operations, notably writes held back by a
+// barrier, when they do not overlap them. Writes are issued in order.
+constexpr uint32_t kSchedulerOptions = ioscheduler::kOptionReorderReads |
+                                       ioscheduler::kOptionReorderReadsAheadOfWrites;
+
+constexpr uint32_t kBarrierFlags = BLOCK_FL_BARRIER_BEFORE | BLOCK_FL_BARRIER_AFTER;
+
 void OutOfBandRespond(const fzl::fifo<block_fifo_response_t, block_fifo_request_t>& fifo,
                       zx_status_t status, reqid_t reqid, groupid_t group) {
     block_fifo_response_t response;
@@ -53,10 +62,55 @@ void OutOfBandRespond(const fzl::fifo<block_fifo_response_t, block_fifo_request_
     }
 }
 
+bool IsRead(block_op_t* op) {
+    return (op->command & BLOCK_OP_MASK) == BLOCK_OP_READ;
+}
+
+// Does |op| modify the blocks it addresses?
+bool IsWrite(block_op_t* op) {
+    uint32_t opcode = op->command & BLOCK_OP_MASK;
+    return (opcode == BLOCK_OP_WRITE) || (opcode == BLOCK_OP_TRIM);
+}
+
+// Do |a| and |b| address any of the same blocks? Flushes address none.
+bool Overlaps(block_op_t* a, block_op_t* b) {
+    if ((a->command & BLOCK_OP_MASK) == BLOCK_OP_FLUSH ||
+        (b->command & BLOCK_OP_MASK) == BLOCK_OP_FLUSH) {
+        return false;
+    }
+    // Trims share the layout of reads and writes.
+    return (a->rw.offset_dev < b->rw.offset_dev + b->rw.length) &&
+           (b->rw.offset_dev < a->rw.offset_dev + a->rw.length);
+}
+
+ioscheduler::OpType OpTypeForCommand(uint32_t command) {
+    if (command & BLOCK_FL_BARRIER_BEFORE) {
+        // A barrier waits for all earlier operations to complete. Writes only
+        // wait for earlier writes to complete in the scheduler, and for
+        // overlapping reads in Issue(), so that later reads can still pass them.
+        return ((command & BLOCK_OP_MASK) == BLOCK_OP_READ) ?
+               ioscheduler::OpType::kOpTypeFullCompleteBarrier :
+               ioscheduler::OpType::kOpTypeWriteCompleteBarrier;
+    }
+    switch (command & BLOCK_OP_MASK) {
+    case BLOCK_OP_READ:
+        return ioscheduler::OpType::kOpTypeRead;
+    case BLOCK_OP_WRITE:
+        return ioscheduler::OpType::kOpTypeWrite;
+    case BLOCK_OP_FLUSH:
+        return ioscheduler::OpType::kOpTypeSync;
+    case BLOCK_OP_TRIM:
+        return ioscheduler::OpType::kOpTypeDiscard;
+    default:
+        return ioscheduler::OpType::kOpTypeOrderedUnknown;
+    }
+}
+
 void BlockCompleteCb(void* cookie, zx_status_t status, block_op_t* bop) {
     ZX_DEBUG_ASSERT(bop != nullptr);
-    fbl::unique_ptr<BlockMessage> msg(static_cast<BlockMessage*>(cookie));
-    msg->Complete(status);
+    BlockMessage* msg = static_cast<BlockMessage*>(cookie);
+    msg->Sop()->set_result(status);
+    msg->server()->OpComplete(msg);
 }
 
 uint32_t OpcodeToCommand(uint32_t opcode) {
@@ -72,14 +126,13 @@ uint32_t OpcodeToCommand(uint32_t opcode) {
     return opcode & shared;
 }
 
-void InQueueAdd(zx_handle_t vmo, uint64_t length, uint64_t vmo_offset,
-                uint64_t dev_offset, BlockMessage* msg, BlockMessageQueue* queue) {
+void SetRange(zx_handle_t vmo, uint64_t length, uint64_t vmo_offset,
+              uint64_t dev_offset, BlockMessage* msg) {
     block_op_t* bop = msg->Op();
     bop->rw.length = (uint32_t) length;
     bop->rw.vmo = vmo;
     bop->rw.offset_dev = dev_offset;
     bop->rw.offset_vmo = vmo_offset;
-    queue->push_back(msg);
 }
 
 }  // namespace
@@ -89,16 +142,81 @@ IoBuffer::IoBuffer(zx::vmo vmo, vmoid_t id) : io_vmo_(std::move(vmo)), vmoid_(id
 IoBuffer::~IoBuffer() {}
 
 zx_status_t IoBuffer::ValidateVmoHack(uint64_t length, uint64_t vmo_offset) {
-    uint64_t vmo_size;
+    if ((vmo_offset <= vmo_size_) && (vmo_size_ - vmo_offset >= length)) {
+        return ZX_OK;
+    }
+    // The VMO may have grown since its size was last read.
     zx_status_t status;
-    if ((status = io_vmo_.get_size(&vmo_size)) != ZX_OK) {
+    if ((status = io_vmo_.get_size(&vmo_size_)) != ZX_OK) {
+        vmo_size_ = 0;
         return status;
-    } else if ((vmo_offset > vmo_size) || (vmo_size - vmo_offset < length)) {
+    } else if ((vmo_offset > vmo_size_) || (vmo_size_ - vmo_offset < length)) {
         return ZX_ERR_OUT_OF_RANGE;
     }
     return ZX_OK;
 }
 
+IoBufferTable::~IoBufferTable() {
+    for (auto& page_ptr : pages_) {
+        Page* page = page_ptr.load(std::memory_order_relaxed);
+        if (page == nullptr) {
+            continue;
+        }
+        for (auto& entry : page->entries) {
+            IoBuffer* iobuf = entry.load(std::memory_order_relaxed);
+            if (iobuf != nullptr) {
+                // Drops the table's reference.
+                fbl::internal::MakeRefPtrNoAdopt(iobuf);
+            }
+        }
+        delete page;
+    }
+}
+
+fbl::RefPtr<IoBuffer> IoBufferTable::Get(vmoid_t vmoid) const {
+    Page* page = pages_[vmoid / kPageSize].load(std::memory_order_acquire);
+    if (page == nullptr) {
+        return nullptr;
+    }
+    return fbl::RefPtr<IoBuffer>(page->entries[vmoid % kPageSize].load(std::memory_order_acquire));
+}
+
+bool IoBufferTable::Contains(vmoid_t vmoid) const {
+    Page* page = pages_[vmoid / kPageSize].load(std::memory_order_acquire);
+    return (page != nullptr) &&
+           (page->entries[vmoid % kPageSize].load(std::memory_order_relaxed) != nullptr);
+}
+
+zx_status_t IoBufferTable::Insert(fbl::RefPtr<IoBuffer> iobuf) {
+    const vmoid_t vmoid = iobuf->GetKey();
+    Page* page = pages_[vmoid / kPageSize].load(std::memory_order_relaxed);
+    if (page == nullptr) {
+        fbl::AllocChecker ac;
+        page = new (&ac) Page();
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        pages_[vmoid / kPageSize].store(page, std::memory_order_release);
+    }
+    auto& entry = page->entries[vmoid % kPageSize];
+    ZX_DEBUG_ASSERT(entry.load(std::memory_order_relaxed) == nullptr);
+    entry.store(iobuf.leak_ref(), std::memory_order_release);
+    return ZX_OK;
+}
+
+fbl::RefPtr<IoBuffer> IoBufferTable::Remove(vmoid_t vmoid) {
+    Page* page = pages_[vmoid / kPageSize].load(std::memory_order_relaxed);
+    if (page == nullptr) {
+        return nullptr;
+    }
+    IoBuffer* iobuf = page->entries[vmoid % kPageSize].exchange(nullptr,
+                                                                 std::memory_order_relaxed);
+    if (iobuf == nullptr) {
+        return nullptr;
+    }
+    return fbl::internal::MakeRefPtrNoAdopt(iobuf);
+}
+
 zx_status_t BlockMessage::Create(size_t block_op_size, fbl::unique_ptr<BlockMessage>* out) {
     BlockMessage* msg = new (block_op_size) BlockMessage();
     if (msg == nullptr) {
@@ -106,11 +224,68 @@ zx_status_t BlockMessage::Create(size_t block_op_size, fbl::unique_ptr<BlockMess
     }
     msg->iobuf_ = nullptr;
     msg->server_ = nullptr;
+    msg->merged_ = 0;
     msg->op_size_ = block_op_size;
+    msg->next_free_ = nullptr;
     *out = fbl::unique_ptr<BlockMessage>(msg);
     return ZX_OK;
 }
 
+BlockMessagePool::~BlockMessagePool() {
+    for (size_t i = 0; i < count_; i++) {
+        reinterpret_cast<BlockMessage*>(storage_.get() + i * stride_)->~BlockMessage();
+    }
+}
+
+zx_status_t BlockMessagePool::Init(size_t block_op_size, size_t count) {
+    // Each message is followed by the rest of its block op.
+    stride_ = fbl::round_up(sizeof(BlockMessage) + block_op_size - sizeof(block_op_t),
+                            alignof(BlockMessage));
+    fbl::AllocChecker ac;
+    storage_.reset(new (&ac) uint8_t[stride_ * count]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    count_ = count;
+    for (size_t i = count; i > 0; i--) {
+        BlockMessage* msg = ::new (storage_.get() + (i - 1) * stride_) BlockMessage();
+        msg->iobuf_ = nullptr;
+        msg->server_ = nullptr;
+        msg->merged_ = 0;
+        msg->op_size_ = block_op_size;
+        msg->next_free_ = free_;
+        free_ = msg;
+    }
+    return ZX_OK;
+}
+
+BlockMessage* BlockMessagePool::Alloc() {
+    if (free_ == nullptr) {
+        free_ = freed_.exchange(nullptr, std::memory_order_acquire);
+        if (free_ == nullptr) {
+            return nullptr;
+        }
+    }
+    BlockMessage* msg = free_;
+    free_ = msg->next_free_;
+    return msg;
+}
+
+void BlockMessagePool::Free(BlockMessage* msg) {
+    ZX_DEBUG_ASSERT(Contains(msg));
+    msg->iobuf_ = nullptr;
+    BlockMessage* head = freed_.load(std::memory_order_relaxed);
+    do {
+        msg->next_free_ = head;
+    } while (!freed_.compare_exchange_weak(head, msg, std::memory_order_release,
+                                           std::memory_order_relaxed));
+}
+
+bool BlockMessagePool::Contains(const BlockMessage* msg) const {
+    auto addr = reinterpret_cast<const uint8_t*>(msg);
+    return (addr >= storage_.get()) && (addr < storage_.get() + stride_ * count_);
+}
+
 void BlockMessage::Init(fbl::RefPtr<IoBuffer> iobuf, BlockServer* server,
                         block_fifo_request_t* req) {
     memset(_op_raw_, 0, op_size_);
@@ -118,37 +293,43 @@ void BlockMessage::Init(fbl::RefPtr<IoBuffer> iobuf, BlockServer* server,
     server_ = server;
     reqid_ = req->reqid;
     group_ = req->group;
+    merged_ = 0;
+    sop_.set_stream(kStreamId);
+    sop_.set_group(ioscheduler::kOpGroupNone);
+    sop_.set_members(0);
+    sop_.set_result(ZX_OK);
+    sop_.set_cookie(this);
 }
 
 void BlockMessage::Complete(zx_status_t status) {
-    server_->TxnComplete(status, reqid_, group_);
-    server_->TxnEnd();
+    for (uint32_t i = 0; i <= merged_; i++) {
+        server_->TxnComplete(status, reqid_, group_);
+    }
     iobuf_ = nullptr;
 }
 
-void BlockServer::BarrierComplete() {
-    // This is the only location that unsets the OpsComplete
-    // signal. We'll never "miss" a signal, because we process
-    // the queue AFTER unsetting it.
-    barrier_in_progress_.store(false);
-    fifo_.signal(kSignalFifoOpsComplete, 0);
-    InQueueDrainer();
-}
-
-void BlockServer::TerminateQueue() {
-    InQueueDrainer();
-    while (true) {
-        if (pending_count_.load() == 0 && in_queue_.is_empty()) {
-            return;
-        }
-        zx_signals_t signals = kSignalFifoOpsComplete;
-        zx_signals_t seen = 0;
-        fifo_.wait_one(signals, zx::deadline_after(zx::msec(10)), &seen);
-        if (seen & kSignalFifoOpsComplete) {
-            BarrierComplete();
-        }
+bool BlockMessage::TryMerge(BlockMessage* next, uint32_t max_length) {
+    block_op_t* op = Op();
+    block_op_t* next_op = next->Op();
+    // Only members of the same group may be merged, since their completions are
+    // counted rather than individually reported.
+    if ((group_ == kNoGroup) || (next->group_ != group_) ||
+        (op->command != next_op->command) || (op->command & kBarrierFlags) ||
+        (!IsRead(op) && ((op->command & BLOCK_OP_MASK) != BLOCK_OP_WRITE))) {
+        return false;
+    }
+    if ((next_op->rw.vmo != op->rw.vmo) ||
+        (next_op->rw.offset_vmo != op->rw.offset_vmo + op->rw.length) ||
+        (next_op->rw.offset_dev != op->rw.offset_dev + op->rw.length) ||
+        (next_op->rw.length > max_length - op->rw.length)) {
+        return false;
     }
+    op->rw.length += next_op->rw.length;
+    merged_ += next->merged_ + 1;
+    next->iobuf_ = nullptr;
+    return true;
 }
+
 void BlockServer::TxnComplete(zx_status_t status, reqid_t reqid, groupid_t group) {
     if (group == kNoGroup) {
         OutOfBandRespond(fifo_, status, reqid, group);
@@ -158,56 +339,161 @@ void BlockServer::TxnComplete(zx_status_t status, reqid_t reqid, groupid_t group
     }
 }
 
-zx_status_t BlockServer::Read(block_fifo_request_t* requests, size_t* count) {
-    auto cleanup = fbl::MakeAutoCall([this]() {
-        TerminateQueue();
-        ZX_ASSERT(pending_count_.load() == 0);
-        ZX_ASSERT(in_queue_.is_empty());
-        fifo_.signal(0, kSignalFifoTerminated);
-    });
+bool BlockServer::CanReorder(ioscheduler::StreamOp* first, ioscheduler::StreamOp* second) {
+    block_op_t* earlier = static_cast<BlockMessage*>(first->cookie())->Op();
+    BlockMessage* later = static_cast<BlockMessage*>(second->cookie());
+    if ((IsWrite(earlier) || IsWrite(later->Op())) && Overlaps(earlier, later->Op())) {
+        return false;
+    }
+    if (first->type() >= ioscheduler::OpType::kOpTypeReadBarrier) {
+        // Passing a barrier also passes the writes it is waiting for.
+        fbl::AutoLock lock(&inflight_lock_);
+        return !ConflictsInFlightLocked(later);
+    }
+    return true;
+}
 
-    // Keep trying to read messages from the fifo until we have a reason to
-    // terminate
-    zx_status_t status;
-    while (true) {
-        status = fifo_.read(requests, BLOCK_FIFO_MAX_DEPTH, count);
-        zx_signals_t signals;
-        zx_signals_t seen;
-        switch (status) {
-        case ZX_ERR_SHOULD_WAIT:
-            signals = ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED |
-                    kSignalFifoTerminate | kSignalFifoOpsComplete;
-            if ((status = fifo_.wait_one(signals, zx::time::infinite(), &seen)) != ZX_OK) {
-                return status;
+zx_status_t BlockServer::Acquire(ioscheduler::StreamOp** sop_list, size_t list_count,
+                                 size_t* actual_count, bool wait) {
+    fbl::AutoLock lock(&acquire_lock_);
+    while (in_queue_.is_empty()) {
+        size_t count;
+        zx_status_t status = fifo_.read(requests_, BLOCK_FIFO_MAX_DEPTH, &count);
+        if (status == ZX_OK) {
+            ProcessRequests(requests_, count);
+            continue;
+        }
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            if (!wait) {
+                return ZX_ERR_SHOULD_WAIT;
             }
-            if (seen & kSignalFifoOpsComplete) {
-                BarrierComplete();
-                continue;
+            zx_signals_t signals = ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED |
+                    kSignalFifoTerminate | kSignalFifoOpsComplete;
+            zx_signals_t seen;
+            status = fifo_.wait_one(signals, zx::time::infinite(), &seen);
+            if (status == ZX_OK) {
+                if (seen & kSignalFifoOpsComplete) {
+                    // Held back operations may be issued.
+                    fifo_.signal(kSignalFifoOpsComplete, 0);
+                    *actual_count = 0;
+                    return ZX_OK;
+                }
+                if (!(seen & ZX_FIFO_PEER_CLOSED) && !(seen & kSignalFifoTerminate)) {
+                    // Try reading again...
+                    continue;
+                }
             }
-            if ((seen & ZX_FIFO_PEER_CLOSED) || (seen & kSignalFifoTerminate)) {
-                return ZX_ERR_PEER_CLOSED;
+        }
+        sync_completion_signal(&acquire_done_);
+        return ZX_ERR_CANCELED;
+    }
+
+    const uint32_t max_xfer = (info_.max_transfer_size / info_.block_size) != 0 ?
+            info_.max_transfer_size / info_.block_size : std::numeric_limits<uint32_t>::max();
+    size_t count = 0;
+    while ((count < list_count) && !in_queue_.is_empty()) {
+        BlockMessage* msg = in_queue_.pop_front();
+        // Coalesce adjacent requests of a transaction into a single device operation.
+        while (!in_queue_.is_empty() && msg->TryMerge(&in_queue_.front(), max_xfer)) {
+            FreeMessage(in_queue_.pop_front());
+        }
+        sop_list[count++] = msg->Sop();
+    }
+    *actual_count = count;
+    return ZX_OK;
+}
+
+bool BlockServer::ConflictsInFlightLocked(BlockMessage* msg) {
+    for (auto& other : in_flight_) {
+        if ((IsWrite(other.Op()) || IsWrite(msg->Op())) && Overlaps(other.Op(), msg->Op())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+zx_status_t BlockServer::Issue(ioscheduler::StreamOp* sop) {
+    BlockMessage* msg = static_cast<BlockMessage*>(sop->cookie());
+    block_op_t* op = msg->Op();
+    {
+        fbl::AutoLock lock(&inflight_lock_);
+        if (op->command & BLOCK_FL_BARRIER_BEFORE) {
+            // The scheduler has only waited for earlier writes. Earlier reads of
+            // the blocks being modified must also complete.
+            while (ConflictsInFlightLocked(msg)) {
+                inflight_done_.Wait(&inflight_lock_);
             }
-            // Try reading again...
-            break;
-        case ZX_OK:
-            cleanup.cancel();
-            return ZX_OK;
-        default:
-            return status;
         }
+        // Underlying block device drivers should not see block barriers
+        // which are already handled by the block midlayer.
+        //
+        // This may be altered in the future if block devices
+        // are capable of implementing hardware barriers.
+        op->command &= ~kBarrierFlags;
+        in_flight_.push_back(msg);
+    }
+    bp_->Queue(op, BlockCompleteCb, msg);
+    return ZX_ERR_ASYNC;
+}
+
+void BlockServer::OpComplete(BlockMessage* msg) {
+    {
+        fbl::AutoLock lock(&inflight_lock_);
+        in_flight_.erase(*msg);
+        inflight_done_.Broadcast();
+    }
+    scheduler_.AsyncComplete(msg->Sop());
+}
+
+void BlockServer::Release(ioscheduler::StreamOp* sop) {
+    BlockMessage* msg = static_cast<BlockMessage*>(sop->cookie());
+    msg->Complete(sop->result());
+    FreeMessage(msg);
+}
+
+void BlockServer::Wake() {
+    fifo_.signal(0, kSignalFifoOpsComplete);
+}
+
+void BlockServer::CancelAcquire() {
+    fifo_.signal(0, kSignalFifoTerminate);
+}
+
+void BlockServer::Fatal() {
+    fprintf(stderr, "Block Server: fatal scheduler error\n");
+    CancelAcquire();
+}
+
+BlockMessage* BlockServer::AllocMessage() {
+    BlockMessage* msg = pool_.Alloc();
+    if (msg == nullptr) {
+        fbl::unique_ptr<BlockMessage> heap_msg;
+        if (BlockMessage::Create(block_op_size_, &heap_msg) != ZX_OK) {
+            return nullptr;
+        }
+        msg = heap_msg.release();
+    }
+    return msg;
+}
+
+void BlockServer::FreeMessage(BlockMessage* msg) {
+    if (pool_.Contains(msg)) {
+        pool_.Free(msg);
+    } else {
+        delete msg;
     }
 }
 
 zx_status_t BlockServer::FindVmoIDLocked(vmoid_t* out) {
     for (vmoid_t i = last_id_; i < std::numeric_limits<vmoid_t>::max(); i++) {
-        if (!tree_.find(i).IsValid()) {
+        if (!iobufs_.Contains(i)) {
             *out = i;
             last_id_ = static_cast<vmoid_t>(i + 1);
             return ZX_OK;
         }
     }
     for (vmoid_t i = VMOID_INVALID + 1; i < last_id_; i++) {
-        if (!tree_.find(i).IsValid()) {
+        if (!iobufs_.Contains(i)) {
             *out = i;
             last_id_ = static_cast<vmoid_t>(i + 1);
             return ZX_OK;
@@ -229,56 +515,29 @@ zx_status_t BlockServer::AttachVmo(zx::vmo vmo, vmoid_t* out) {
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
-    tree_.insert(std::move(ibuf));
+    if ((status = iobufs_.Insert(std::move(ibuf))) != ZX_OK) {
+        return status;
+    }
     *out = id;
     return ZX_OK;
 }
 
-void BlockServer::TxnEnd() {
-    size_t old_count = pending_count_.fetch_sub(1);
-    ZX_ASSERT(old_count > 0);
-    if ((old_count == 1) && barrier_in_progress_.load()) {
-        // Since we're avoiding locking, and there is a gap between
-        // "pending count decremented" and "FIFO signalled", it's possible
-        // that we'll receive spurious wakeup requests.
-        fifo_.signal(0, kSignalFifoOpsComplete);
+void BlockServer::InQueueAdd(BlockMessage* msg) {
+    block_op_t* op = msg->Op();
+    if (deferred_barrier_before_) {
+        op->command |= BLOCK_FL_BARRIER_BEFORE;
+        deferred_barrier_before_ = false;
+    }
+    if (op->command & BLOCK_FL_BARRIER_AFTER) {
+        deferred_barrier_before_ = true;
     }
+    msg->Sop()->set_type(OpTypeForCommand(op->command));
+    in_queue_.push_back(msg);
 }
 
-void BlockServer::InQueueDrainer() {
-    while (true) {
-        if (in_queue_.is_empty()) {
-            return;
-        }
-
-        auto msg = in_queue_.begin();
-        block_op_t* op = msg->Op();
-        if (deferred_barrier_before_) {
-            op->command |= BLOCK_FL_BARRIER_BEFORE;
-            deferred_barrier_before_ = false;
-        }
-
-        if (op->command & BLOCK_FL_BARRIER_BEFORE) {
-            barrier_in_progress_.store(true);
-            if (pending_count_.load() > 0) {
-                return;
-            }
-            // Since we're the only thread that could add to pending
-            // count, we reliably know it has terminated.
-            barrier_in_progress_.store(false);
-        }
-        if (op->command & BLOCK_FL_BARRIER_AFTER) {
-            deferred_barrier_before_ = true;
-        }
-        pending_count_.fetch_add(1);
-        in_queue_.pop_front();
-        // Underlying block device drivers should not see block barriers
-        // which are already handled by the block midlayer.
-        //
-        // This may be altered in the future if block devices
-        // are capable of implementing hardware barriers.
-        op->command &= ~(BLOCK_FL_BARRIER_BEFORE | BLOCK_FL_BARRIER_AFTER);
-        bp_->Queue(op, BlockCompleteCb, &*msg);
+void BlockServer::InQueueAdd(BlockMessageQueue* msgs) {
+    while (!msgs->is_empty()) {
+        InQueueAdd(msgs->pop_front());
     }
 }
 
@@ -311,7 +570,10 @@ zx_status_t BlockServer::Create(ddk::BlockProtocolClient* bp, fzl::fifo<block_fi
 
     bp->Query(&bs->info_, &bs->block_op_size_);
 
-    // TODO(ZX-1583): Allocate BlockMsg arena based on block_op_size_.
+    if ((status = bs->pool_.Init(bs->block_op_size_, BLOCK_FIFO_MAX_DEPTH)) != ZX_OK) {
+        delete bs;
+        return status;
+    }
 
     *out = bs;
     return ZX_OK;
@@ -320,12 +582,8 @@ zx_status_t BlockServer::Create(ddk::BlockProtocolClient* bp, fzl::fifo<block_fi
 zx_status_t BlockServer::ProcessReadWriteRequest(block_fifo_request_t* request) {
     groupid_t group = request->group;
 
-    // TODO(ZX-1586): Reduce the usage of this lock (only used to protect
-    // IoBuffers).
-    fbl::AutoLock server_lock(&server_lock_);
-
-    auto iobuf = tree_.find(request->vmoid);
-    if (!iobuf.IsValid()) {
+    fbl::RefPtr<IoBuffer> iobuf = iobufs_.Get(request->vmoid);
+    if (iobuf == nullptr) {
         // Operation which is not accessing a valid vmo.
         return ZX_ERR_IO;
     }
@@ -344,11 +602,11 @@ zx_status_t BlockServer::ProcessReadWriteRequest(block_fifo_request_t* request)
         return status;
     }
 
-    fbl::unique_ptr<BlockMessage> msg;
-    if ((status = BlockMessage::Create(block_op_size_, &msg)) != ZX_OK) {
-        return status;
+    BlockMessage* msg = AllocMessage();
+    if (msg == nullptr) {
+        return ZX_ERR_NO_MEMORY;
     }
-    msg->Init(iobuf.CopyPointer(), this, request);
+    msg->Init(iobuf, this, request);
     msg->Op()->command = OpcodeToCommand(request->opcode);
 
     const uint32_t max_xfer = info_.max_transfer_size / bsz;
@@ -368,10 +626,13 @@ zx_status_t BlockServer::ProcessReadWriteRequest(block_fifo_request_t* request)
         while (sub_txn_idx != sub_txns) {
             // We'll be using a new BlockMsg for each sub-component.
             if (msg == nullptr) {
-                if ((status = BlockMessage::Create(block_op_size_, &msg)) != ZX_OK) {
-                    return status;
+                if ((msg = AllocMessage()) == nullptr) {
+                    while (!sub_txns_queue.is_empty()) {
+                        FreeMessage(sub_txns_queue.pop_front());
+                    }
+                    return ZX_ERR_NO_MEMORY;
                 }
-                msg->Init(iobuf.CopyPointer(), this, request);
+                msg->Init(iobuf, this, request);
                 msg->Op()->command = OpcodeToCommand(request->opcode);
             }
 
@@ -384,8 +645,9 @@ zx_status_t BlockServer::ProcessReadWriteRequest(block_fifo_request_t* request)
             // Only set the "BEFORE" barrier on the first sub-txn.
             msg->Op()->command &= ~(sub_txn_idx == 0 ? 0 :
                                    BLOCK_FL_BARRIER_BEFORE);
-            InQueueAdd(iobuf->vmo(), length, vmo_offset, dev_offset, msg.release(),
-                       &sub_txns_queue);
+            SetRange(iobuf->vmo(), length, vmo_offset, dev_offset, msg);
+            sub_txns_queue.push_back(msg);
+            msg = nullptr;
             vmo_offset += length;
             dev_offset += length;
             sub_txn_idx++;
@@ -393,10 +655,11 @@ zx_status_t BlockServer::ProcessReadWriteRequest(block_fifo_request_t* request)
         groups_[group].CtrAdd(sub_txns - 1);
         ZX_DEBUG_ASSERT(len_remaining == 0);
 
-        in_queue_.splice(in_queue_.end(), sub_txns_queue);
+        InQueueAdd(&sub_txns_queue);
     } else {
-        InQueueAdd(iobuf->vmo(), request->length, request->vmo_offset,
-                   request->dev_offset, msg.release(), &in_queue_);
+        SetRange(iobuf->vmo(), request->length, request->vmo_offset,
+                 request->dev_offset, msg);
+        InQueueAdd(msg);
     }
     return ZX_OK;
 }
@@ -404,28 +667,24 @@ zx_status_t BlockServer::ProcessReadWriteRequest(block_fifo_request_t* request)
 zx_status_t BlockServer::ProcessCloseVmoRequest(block_fifo_request_t* request) {
     fbl::AutoLock server_lock(&server_lock_);
 
-    auto iobuf = tree_.find(request->vmoid);
-    if (!iobuf.IsValid()) {
+    // TODO(smklein): Ensure that "iobuf" is not being used by
+    // any in-flight txns.
+    if (iobufs_.Remove(request->vmoid) == nullptr) {
         // Operation which is not accessing a valid vmo
         return ZX_ERR_IO;
     }
-
-    // TODO(smklein): Ensure that "iobuf" is not being used by
-    // any in-flight txns.
-    tree_.erase(*iobuf);
     return ZX_OK;
 }
 
 zx_status_t BlockServer::ProcessFlushRequest(block_fifo_request_t* request) {
-    zx_status_t status;
-
-    fbl::unique_ptr<BlockMessage> msg;
-    if ((status = BlockMessage::Create(block_op_size_, &msg)) != ZX_OK) {
-        return status;
+    BlockMessage* msg = AllocMessage();
+    if (msg == nullptr) {
+        return ZX_ERR_NO_MEMORY;
     }
     msg->Init(nullptr, this, request);
     msg->Op()->command = OpcodeToCommand(request->opcode);
-    InQueueAdd(ZX_HANDLE_INVALID, 0, 0, 0, msg.release(), &in_queue_);
+    SetRange(ZX_HANDLE_INVALID, 0, 0, 0, msg);
+    InQueueAdd(msg);
     return ZX_OK;
 }
 
@@ -434,15 +693,14 @@ zx_status_t BlockServer::ProcessTrimRequest(block_fifo_request_t* request) {
         return ZX_ERR_INVALID_ARGS;
     }
 
-    fbl::unique_ptr<BlockMessage> msg;
-    zx_status_t status = BlockMessage::Create(block_op_size_, &msg);
-    if (status != ZX_OK) {
-        return status;
+    BlockMessage* msg = AllocMessage();
+    if (msg == nullptr) {
+        return ZX_ERR_NO_MEMORY;
     }
     msg->Init(nullptr, this, request);
     msg->Op()->command = OpcodeToCommand(request->opcode);
-    InQueueAdd(ZX_HANDLE_INVALID, request->length, 0, request->dev_offset,
-               msg.release(), &in_queue_);
+    SetRange(ZX_HANDLE_INVALID, request->length, 0, request->dev_offset, msg);
+    InQueueAdd(msg);
     return ZX_OK;
 }
 
@@ -476,60 +734,60 @@ void BlockServer::ProcessRequest(block_fifo_request_t* request) {
     }
 }
 
-zx_status_t BlockServer::Serve() {
-    zx_status_t status;
-    block_fifo_request_t requests[BLOCK_FIFO_MAX_DEPTH];
-    size_t count;
-    while (true) {
-        // Attempt to drain as much of the input queue as possible
-        // before (potentially) blocking in Read.
-        InQueueDrainer();
-
-        if ((status = Read(requests, &count) != ZX_OK)) {
-            return status;
-        }
+void BlockServer::ProcessRequests(block_fifo_request_t* requests, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        bool wants_reply = requests[i].opcode & BLOCKIO_GROUP_LAST;
+        bool use_group = requests[i].opcode & BLOCKIO_GROUP_ITEM;
 
-        for (size_t i = 0; i < count; i++) {
-            bool wants_reply = requests[i].opcode & BLOCKIO_GROUP_LAST;
-            bool use_group = requests[i].opcode & BLOCKIO_GROUP_ITEM;
+        reqid_t reqid = requests[i].reqid;
 
-            reqid_t reqid = requests[i].reqid;
-
-            if (use_group) {
-                groupid_t group = requests[i].group;
-                if (group >= MAX_TXN_GROUP_COUNT) {
-                    // Operation which is not accessing a valid group.
-                    if (wants_reply) {
-                        OutOfBandRespond(fifo_, ZX_ERR_IO, reqid, group);
-                    }
-                    continue;
+        if (use_group) {
+            groupid_t group = requests[i].group;
+            if (group >= MAX_TXN_GROUP_COUNT) {
+                // Operation which is not accessing a valid group.
+                if (wants_reply) {
+                    OutOfBandRespond(fifo_, ZX_ERR_IO, reqid, group);
                 }
-
-                // Enqueue the message against the transaction group.
-                status = groups_[group].Enqueue(wants_reply, reqid);
-                if (status != ZX_OK) {
-                    TxnComplete(status, reqid, group);
-                    continue;
-                }
-            } else {
-                requests[i].group = kNoGroup;
+                continue;
             }
 
-            ProcessRequest(&requests[i]);
+            // Enqueue the message against the transaction group.
+            zx_status_t status = groups_[group].Enqueue(wants_reply, reqid);
+            if (status != ZX_OK) {
+                TxnComplete(status, reqid, group);
+                continue;
+            }
+        } else {
+            requests[i].group = kNoGroup;
         }
+
+        ProcessRequest(&requests[i]);
+    }
+}
+
+zx_status_t BlockServer::Serve() {
+    zx_status_t status;
+    if ((status = scheduler_.Init(this, kSchedulerOptions)) == ZX_OK &&
+        (status = scheduler_.StreamOpen(kStreamId, ioscheduler::kDefaultPriority)) == ZX_OK &&
+        (status = scheduler_.Serve()) == ZX_OK) {
+        // Requests are served by the scheduler's worker until the FIFO closes.
+        sync_completion_wait(&acquire_done_, ZX_TIME_INFINITE);
     }
+    // Waits for all outstanding operations to complete.
+    scheduler_.Shutdown();
+    fifo_.signal(0, kSignalFifoTerminated);
+    return status;
 }
 
 BlockServer::BlockServer(ddk::BlockProtocolClient* bp) :
-    bp_(bp), block_op_size_(0), pending_count_(0), barrier_in_progress_(false),
-    last_id_(VMOID_INVALID + 1) {
+    bp_(bp), block_op_size_(0), last_id_(VMOID_INVALID + 1) {
     size_t block_op_size;
     bp->Query(&info_, &block_op_size);
 }
 
 BlockServer::~BlockServer() {
-    ZX_ASSERT(pending_count_.load() == 0);
     ZX_ASSERT(in_queue_.is_empty());
+    ZX_ASSERT(in_flight_.is_empty());
 }
 
 void BlockServer::ShutDown() {
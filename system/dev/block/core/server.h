@@ -8,18 +8,20 @@
 #include <stdlib.h>
 
 #include <atomic>
+#include <limits>
 #include <new>
 #include <utility>
 
 #include <ddk/protocol/block.h>
 #include <ddktl/device.h>
 #include <ddktl/protocol/block.h>
+#include <fbl/condition_variable.h>
 #include <fbl/intrusive_double_list.h>
-#include <fbl/intrusive_wavl_tree.h>
 #include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <io-scheduler/io-scheduler.h>
 #include <lib/fzl/fifo.h>
 #include <lib/sync/completion.h>
 #include <lib/zx/vmo.h>
@@ -30,8 +32,7 @@
 #include "txn-group.h"
 
 // Represents the mapping of "vmoid --> VMO"
-class IoBuffer : public fbl::WAVLTreeContainable<fbl::RefPtr<IoBuffer>>,
-                 public fbl::RefCounted<IoBuffer> {
+class IoBuffer : public fbl::RefCounted<IoBuffer> {
 public:
     vmoid_t GetKey() const { return vmoid_; }
 
@@ -39,6 +40,9 @@ public:
     // no way to ensure that the size of the VMO won't change in between
     // checking it and using it.  This will require a mechanism to "pin" VMO pages.
     // The units of length and vmo_offset is bytes.
+    //
+    // The size of the VMO is only re-read when a request doesn't fit the size
+    // last seen. Only the thread processing requests may call this.
     zx_status_t ValidateVmoHack(uint64_t length, uint64_t vmo_offset);
 
     zx_handle_t vmo() const { return io_vmo_.get(); }
@@ -47,15 +51,44 @@ public:
     ~IoBuffer();
 
 private:
-    friend struct TypeWAVLTraits;
     DISALLOW_COPY_ASSIGN_AND_MOVE(IoBuffer);
 
     const zx::vmo io_vmo_;
     const vmoid_t vmoid_;
+    uint64_t vmo_size_ = 0;
+};
+
+// Maps vmoids to IoBuffers.
+//
+// Lookups take no locks. Entries are only removed by the thread which
+// processes requests, which is also the only thread which looks them up, so
+// an entry stays valid while it is in use. Insertions and removals must be
+// serialized by the caller.
+class IoBufferTable {
+public:
+    IoBufferTable() = default;
+    ~IoBufferTable();
+
+    fbl::RefPtr<IoBuffer> Get(vmoid_t vmoid) const;
+    bool Contains(vmoid_t vmoid) const;
+    zx_status_t Insert(fbl::RefPtr<IoBuffer> iobuf);
+    fbl::RefPtr<IoBuffer> Remove(vmoid_t vmoid);
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(IoBufferTable);
+
+    // Pages of entries are allocated as they are first used, and never freed
+    // until the table is destroyed.
+    static constexpr size_t kPageSize = 256;
+    struct Page {
+        std::atomic<IoBuffer*> entries[kPageSize] = {};
+    };
+    std::atomic<Page*> pages_[(std::numeric_limits<vmoid_t>::max() + 1) / kPageSize] = {};
 };
 
 class BlockServer;
 class BlockMessage;
+class BlockMessagePool;
 
 // A single unit of work transmitted to the underlying block layer.
 // BlockMessage contains a block_op_t, which is dynamically sized. Therefore, it implements its
@@ -79,18 +112,32 @@ public:
     // Initialize the contents of this from the supplied args. block_op op_ is cleared.
     void Init(fbl::RefPtr<IoBuffer> iobuf, BlockServer* server, block_fifo_request_t* req);
 
-    // End the transaction specified by reqid and group, and release iobuf.
+    // End the transaction specified by reqid and group, and of any messages merged
+    // into this one, and release iobuf.
     // BlockMessage can be reused with another call to Init().
     void Complete(zx_status_t status);
 
+    // Extends this read or write by |next|, which must directly follow it on both the
+    // VMO and the device, if both belong to the same transaction group and the result
+    // is no longer than |max_length| blocks. On success |next| is absorbed and may be
+    // deleted.
+    bool TryMerge(BlockMessage* next, uint32_t max_length);
+
     block_op_t* Op() { return &op_; }
+    ioscheduler::StreamOp* Sop() { return &sop_; }
+    BlockServer* server() { return server_; }
 
 private:
+    friend class BlockMessagePool;
+
     fbl::RefPtr<IoBuffer> iobuf_;
     BlockServer* server_;
     reqid_t reqid_;
     groupid_t group_;
+    uint32_t merged_;   // Number of requests merged into this one.
     size_t op_size_;
+    BlockMessage* next_free_;   // Next message in a BlockMessagePool's free list.
+    ioscheduler::StreamOp sop_;
     // Must be at the end of structure.
     union {
         block_op_t op_;
@@ -100,7 +147,37 @@ private:
 
 using BlockMessageQueue = fbl::DoublyLinkedList<BlockMessage*>;
 
-class BlockServer {
+// A preallocated set of BlockMessages, enough for a full FIFO of requests.
+//
+// Messages are only allocated by the thread processing requests, but may be
+// freed by any thread. Freed messages are pushed onto a lock-free stack, which
+// the allocating thread takes as a whole once it has used up its own list.
+class BlockMessagePool {
+public:
+    BlockMessagePool() = default;
+    ~BlockMessagePool();
+
+    zx_status_t Init(size_t block_op_size, size_t count);
+
+    // Returns nullptr if every message is in use.
+    BlockMessage* Alloc();
+    void Free(BlockMessage* msg);
+
+    // Was |msg| allocated from this pool?
+    bool Contains(const BlockMessage* msg) const;
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(BlockMessagePool);
+
+    fbl::unique_ptr<uint8_t[]> storage_;
+    size_t stride_ = 0;
+    size_t count_ = 0;
+    // Only used by Alloc().
+    BlockMessage* free_ = nullptr;
+    std::atomic<BlockMessage*> freed_{nullptr};
+};
+
+class BlockServer : public ioscheduler::SchedulerClient {
 public:
     // Creates a new BlockServer.
     static zx_status_t Create(
@@ -108,17 +185,13 @@ public:
         fzl::fifo<block_fifo_request_t, block_fifo_response_t>* fifo_out,
         BlockServer** out);
 
-    // Starts the BlockServer using the current thread
+    // Starts the BlockServer, blocking the current thread until the FIFO
+    // is closed and all outstanding requests have completed.
     zx_status_t Serve() TA_EXCL(server_lock_);
     zx_status_t AttachVmo(zx::vmo vmo, vmoid_t* out) TA_EXCL(server_lock_);
 
-    // Updates the total number of pending txns, possibly signals
-    // the queue-draining thread to wake up if they are waiting
-    // for all pending operations to complete.
-    //
-    // Should only be called for transactions which have been placed
-    // on (and removed from) in_queue_.
-    void TxnEnd();
+    // Called when the underlying device has completed |msg|.
+    void OpComplete(BlockMessage* msg) TA_EXCL(inflight_lock_);
 
     // Wrapper around "Completed Transaction", as a convenience
     // both both one-shot and group-based transactions.
@@ -128,49 +201,73 @@ public:
 
     void ShutDown();
     ~BlockServer();
+
+    // ioscheduler::SchedulerClient interface.
+    bool CanReorder(ioscheduler::StreamOp* first, ioscheduler::StreamOp* second) final;
+    zx_status_t Acquire(ioscheduler::StreamOp** sop_list, size_t list_count,
+                        size_t* actual_count, bool wait) final TA_EXCL(acquire_lock_);
+    zx_status_t Issue(ioscheduler::StreamOp* sop) final TA_EXCL(inflight_lock_);
+    void Release(ioscheduler::StreamOp* sop) final;
+    void Wake() final;
+    void CancelAcquire() final;
+    void Fatal() final;
+
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(BlockServer);
     BlockServer(ddk::BlockProtocolClient* bp);
 
-    // Helper for processing a single message read from the FIFO.
-    void ProcessRequest(block_fifo_request_t* request);
-    zx_status_t ProcessReadWriteRequest(block_fifo_request_t* request) TA_EXCL(server_lock_);
-    zx_status_t ProcessCloseVmoRequest(block_fifo_request_t* request) TA_EXCL(server_lock_);
-    zx_status_t ProcessFlushRequest(block_fifo_request_t* request);
-    zx_status_t ProcessTrimRequest(block_fifo_request_t* request);
-
-    // Helper for the server to react to a signal that a barrier
-    // operation has completed. Unsets the local "waiting for barrier"
-    // signal, and enqueues any further operations that might be
-    // pending.
-    void BarrierComplete();
-
-    // Functions that read from the fifo and invoke the queue drainer.
-    // Should not be invoked concurrently.
-    zx_status_t Read(block_fifo_request_t* requests, size_t* count);
-    void TerminateQueue();
-
-    // Attempts to enqueue all operations on the |in_queue_|. Stops
-    // when either the queue is empty, or a BARRIER_BEFORE is reached and
-    // operations are in-flight.
-    void InQueueDrainer();
+    // Helpers for processing messages read from the FIFO.
+    void ProcessRequests(block_fifo_request_t* requests, size_t count) TA_REQ(acquire_lock_);
+    void ProcessRequest(block_fifo_request_t* request) TA_REQ(acquire_lock_);
+    zx_status_t ProcessReadWriteRequest(block_fifo_request_t* request) TA_REQ(acquire_lock_);
+    zx_status_t ProcessCloseVmoRequest(block_fifo_request_t* request)
+        TA_REQ(acquire_lock_) TA_EXCL(server_lock_);
+    zx_status_t ProcessFlushRequest(block_fifo_request_t* request) TA_REQ(acquire_lock_);
+    zx_status_t ProcessTrimRequest(block_fifo_request_t* request) TA_REQ(acquire_lock_);
+
+    // Adds messages to |in_queue_|, classifying them for the scheduler by their
+    // barrier flags.
+    void InQueueAdd(BlockMessage* msg) TA_REQ(acquire_lock_);
+    void InQueueAdd(BlockMessageQueue* msgs) TA_REQ(acquire_lock_);
+
+    // Does |msg| access a range of blocks written by an op currently in flight on
+    // the device, or, if |msg| writes, accessed by any op in flight?
+    bool ConflictsInFlightLocked(BlockMessage* msg) TA_REQ(inflight_lock_);
 
     zx_status_t FindVmoIDLocked(vmoid_t* out) TA_REQ(server_lock_);
 
+    // Messages come from |pool_| unless it is exhausted, e.g. by requests split
+    // into several messages, in which case they come from the heap.
+    BlockMessage* AllocMessage() TA_REQ(acquire_lock_);
+    void FreeMessage(BlockMessage* msg);
+
     fzl::fifo<block_fifo_response_t, block_fifo_request_t> fifo_;
     block_info_t info_;
     ddk::BlockProtocolClient* bp_;
     size_t block_op_size_;
 
+    // All requests from the FIFO are scheduled as a single stream.
+    ioscheduler::Scheduler scheduler_;
+    // Signalled once Acquire() has observed the FIFO closing.
+    sync_completion_t acquire_done_;
+
+    fbl::Mutex acquire_lock_;
     // BARRIER_AFTER is implemented by sticking "BARRIER_BEFORE" on the
     // next operation that arrives.
-    bool deferred_barrier_before_ = false;
-    BlockMessageQueue in_queue_;
-    std::atomic<size_t> pending_count_;
-    std::atomic<bool> barrier_in_progress_;
+    bool deferred_barrier_before_ TA_GUARDED(acquire_lock_) = false;
+    // Messages read from the FIFO but not yet handed to the scheduler.
+    BlockMessageQueue in_queue_ TA_GUARDED(acquire_lock_);
+    block_fifo_request_t requests_[BLOCK_FIFO_MAX_DEPTH] TA_GUARDED(acquire_lock_);
     TransactionGroup groups_[MAX_TXN_GROUP_COUNT];
+    BlockMessagePool pool_;
+
+    fbl::Mutex inflight_lock_;
+    // Messages queued to the device and not yet completed.
+    BlockMessageQueue in_flight_ TA_GUARDED(inflight_lock_);
+    fbl::ConditionVariable inflight_done_ TA_GUARDED(inflight_lock_);
 
+    // Serializes changes to |iobufs_|.
     fbl::Mutex server_lock_;
-    fbl::WAVLTree<vmoid_t, fbl::RefPtr<IoBuffer>> tree_ TA_GUARDED(server_lock_);
+    IoBufferTable iobufs_;
     vmoid_t last_id_ TA_GUARDED(server_lock_);
 };
@@ -100,6 +100,13 @@ static zx_status_t fidl_Start(void* ctx, uint32_t group_mask, fidl_txn_t* txn) {
     return fuchsia_tracing_kernel_ControllerStart_reply(txn, status);
 }
 
+static zx_status_t fidl_StartCircular(void* ctx, uint32_t group_mask, fidl_txn_t* txn) {
+    zx_status_t status =
+        // Please do not use get_root_resource() in new code. See ZX-1467.
+        zx_ktrace_control(get_root_resource(), KTRACE_ACTION_START_CIRCULAR, group_mask, NULL);
+    return fuchsia_tracing_kernel_ControllerStartCircular_reply(txn, status);
+}
+
 static zx_status_t fidl_Stop(void* ctx, fidl_txn_t* txn) {
     zx_status_t status =
         // Please do not use get_root_resource() in new code. See ZX-1467.
@@ -123,6 +130,7 @@ static zx_status_t fidl_GetBytesWritten(void* ctx, fidl_txn_t* txn) {
 
 static const fuchsia_tracing_kernel_Controller_ops_t fidl_ops = {
     .Start = fidl_Start,
+    .StartCircular = fidl_StartCircular,
     .Stop = fidl_Stop,
     .Rewind = fidl_Rewind,
     .GetBytesWritten = fidl_GetBytesWritten,
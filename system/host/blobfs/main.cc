@@ -9,6 +9,7 @@
 #include <vector>
 
 #include <blobfs/fsck.h>
+#include <digest/thread-pool.h>
 #include <fbl/auto_call.h>
 #include <sys/stat.h>
 
@@ -125,6 +126,8 @@ zx_status_t BlobfsCreator::CalculateRequiredSize(off_t* out) {
     if (!n_threads) {
         n_threads = 4;
     }
+    // Lets a few large blobs use the CPUs left idle once the small blobs are done.
+    digest::ThreadPool merkle_pool;
     zx_status_t status = ZX_OK;
     std::mutex mtx;
     for (unsigned j = n_threads; j > 0; j--) {
@@ -153,7 +156,8 @@ zx_status_t BlobfsCreator::CalculateRequiredSize(off_t* out) {
                 blobfs::MerkleInfo info;
                 fbl::unique_fd data_fd(open(path, O_RDONLY, 0644));
 
-                if ((res = blobfs::blobfs_preprocess(data_fd.get(), ShouldCompress(), &info))
+                if ((res = blobfs::blobfs_preprocess(data_fd.get(), ShouldCompress(), &info,
+                                                     &merkle_pool))
                     != ZX_OK) {
                     mtx.lock();
                     status = res;
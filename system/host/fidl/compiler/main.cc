@@ -33,6 +33,7 @@ void Usage() {
          "             [--c-client CLIENT_PATH]\n"
          "             [--c-server SERVER_PATH]\n"
          "             [--tables TABLES_PATH]\n"
+         "             [--specialized-coders]\n"
          "             [--json JSON_PATH]\n"
          "             [--name LIBRARY_NAME]\n"
          "             [--werror]\n"
@@ -52,6 +53,11 @@ void Usage() {
          "   coding tables at the given path. The coding tables are required to encode and\n"
          "   decode messages from the C and C++ bindings.\n"
          "\n"
+         " * `--specialized-coders`. If present, this flag instructs `fidlc` to also emit\n"
+         "   specialized encode, decode, and validate functions into the coding tables, for\n"
+         "   messages and structs without out-of-line data. The runtime uses them instead\n"
+         "   of interpreting the coding tables, which is faster but produces larger code.\n"
+         "\n"
          " * `--json JSON_PATH`. If present, this flag instructs `fidlc` to output the\n"
          "   library's intermediate representation at the given path. The intermediate\n"
          "   representation is JSON that conforms to the schema available via --json-schema.\n"
@@ -257,7 +263,7 @@ void Write(std::ostringstream output_stream, const std::string file_path) {
 // reduce diff size while breaking things up.
 int compile(fidl::ErrorReporter* error_reporter, fidl::flat::Typespace* typespace,
             std::string library_name, std::vector<std::pair<Behavior, std::string>> outputs,
-            std::vector<fidl::SourceManager> source_managers);
+            std::vector<fidl::SourceManager> source_managers, bool specialized_coders);
 
 int main(int argc, char* argv[]) {
   auto argv_args = std::make_unique<ArgvArguments>(argc, argv);
@@ -289,6 +295,7 @@ int main(int argc, char* argv[]) {
   std::string library_name;
 
   bool warnings_as_errors = false;
+  bool specialized_coders = false;
   std::vector<std::pair<Behavior, std::string>> outputs;
   while (args->Remaining()) {
     // Try to parse an output type.
@@ -302,6 +309,8 @@ int main(int argc, char* argv[]) {
       exit(0);
     } else if (behavior_argument == "--werror") {
       warnings_as_errors = true;
+    } else if (behavior_argument == "--specialized-coders") {
+      specialized_coders = true;
     } else if (behavior_argument == "--c-header") {
       std::string path = args->Claim();
       outputs.emplace_back(std::make_pair(Behavior::kCHeader, path));
@@ -349,14 +358,14 @@ int main(int argc, char* argv[]) {
   fidl::ErrorReporter error_reporter(warnings_as_errors);
   auto typespace = fidl::flat::Typespace::RootTypes(&error_reporter);
   auto status = compile(&error_reporter, &typespace, library_name, std::move(outputs),
-                        std::move(source_managers));
+                        std::move(source_managers), specialized_coders);
   error_reporter.PrintReports();
   return status;
 }
 
 int compile(fidl::ErrorReporter* error_reporter, fidl::flat::Typespace* typespace,
             std::string library_name, std::vector<std::pair<Behavior, std::string>> outputs,
-            std::vector<fidl::SourceManager> source_managers) {
+            std::vector<fidl::SourceManager> source_managers, bool specialized_coders) {
   fidl::flat::Libraries all_libraries;
   const fidl::flat::Library* final_library = nullptr;
   for (const auto& source_manager : source_managers) {
@@ -431,7 +440,7 @@ int compile(fidl::ErrorReporter* error_reporter, fidl::flat::Typespace* typespac
         break;
       }
       case Behavior::kTables: {
-        fidl::TablesGenerator generator(final_library);
+        fidl::TablesGenerator generator(final_library, specialized_coders);
         Write(generator.Produce(), file_path);
         break;
       }
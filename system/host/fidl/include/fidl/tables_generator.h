@@ -7,6 +7,7 @@
 
 #include <map>
 #include <memory>
+#include <set>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -31,8 +32,11 @@ namespace fidl {
 
 class TablesGenerator {
  public:
-  explicit TablesGenerator(const flat::Library* library)
-      : coded_types_generator_(library) {}
+  // If |specialized_coders| is set, message and struct types whose wire format is entirely
+  // inline also get straight-line encode, decode, and validate functions, which the runtime
+  // uses instead of walking their coding tables.
+  explicit TablesGenerator(const flat::Library* library, bool specialized_coders = false)
+      : coded_types_generator_(library), specialized_coders_(specialized_coders) {}
 
   ~TablesGenerator() = default;
 
@@ -67,6 +71,18 @@ class TablesGenerator {
   void Generate(const coded::TableField& field);
   void Generate(const coded::XUnionField& field);
 
+  // Returns true if |type| can be coded by a specialized coder, and stores the number of walker
+  // frames it would need in |out_depth|.
+  bool CanSpecialize(const coded::Type* type, uint32_t* out_depth) const;
+  bool CanSpecialize(const std::vector<coded::StructField>& fields, uint32_t* out_depth) const;
+  // Generates the specialized coders for a message or struct, if it qualifies, and returns the
+  // expression to store in its FidlCodedStruct.
+  std::string GenerateSpecializedCoders(std::string_view coded_name,
+                                        const std::vector<coded::StructField>& fields);
+  void GenerateSpecialized(const std::vector<coded::StructField>& fields, std::string_view base,
+                           uint32_t offset);
+  void GenerateSpecialized(const coded::Type* type, std::string_view base, uint32_t offset);
+
   void GenerateForward(const coded::EnumType& enum_type);
   void GenerateForward(const coded::BitsType& bits_type);
   void GenerateForward(const coded::StructType& struct_type);
@@ -75,6 +91,11 @@ class TablesGenerator {
   void GenerateForward(const coded::XUnionType& xunion_type);
 
   CodedTypesGenerator coded_types_generator_;
+  const bool specialized_coders_;
+
+  // Struct types declared in this library. Only these have their fields compiled.
+  std::set<const coded::Type*> library_struct_types_;
+  uint32_t loop_depth_ = 0u;
 
   std::ostringstream tables_file_;
   size_t indent_level_ = 0u;
@@ -4,6 +4,8 @@
 
 #include "fidl/tables_generator.h"
 
+#include <algorithm>
+
 #include "fidl/names.h"
 
 namespace fidl {
@@ -58,6 +60,9 @@ std::string CodedNameForEnvelope(const fidl::coded::Type* type) {
 
 constexpr auto kIndent = "    ";
 
+// FIDL_RECURSION_DEPTH in lib/fidl/coding.h.
+constexpr uint32_t kMaxWalkerDepth = 32u;
+
 void Emit(std::ostream* file, std::string_view data) { *file << data; }
 
 void EmitNewlineAndIndent(std::ostream* file, size_t indent_level) {
@@ -116,6 +121,8 @@ void TablesGenerator::GenerateInclude(std::string_view filename) {
 void TablesGenerator::GenerateFilePreamble() {
   Emit(&tables_file_, "// WARNING: This file is machine generated by fidlc.\n\n");
   GenerateInclude("<lib/fidl/internal.h>");
+  if (specialized_coders_)
+    GenerateInclude("<lib/fidl/specialized_coders.h>");
   Emit(&tables_file_, "\nextern \"C\" {\n");
   Emit(&tables_file_, "\n");
 }
@@ -174,6 +181,9 @@ void TablesGenerator::Generate(const coded::BitsType& bits_type) {
 }
 
 void TablesGenerator::Generate(const coded::StructType& struct_type) {
+  std::string specialized_coders =
+      GenerateSpecializedCoders(struct_type.coded_name, struct_type.fields);
+
   Emit(&tables_file_, "static const ::fidl::FidlStructField ");
   Emit(&tables_file_, NameFields(struct_type.coded_name));
   Emit(&tables_file_, "[] = ");
@@ -190,7 +200,9 @@ void TablesGenerator::Generate(const coded::StructType& struct_type) {
   Emit(&tables_file_, struct_type.size);
   Emit(&tables_file_, ", \"");
   Emit(&tables_file_, struct_type.qname);
-  Emit(&tables_file_, "\"));\n\n");
+  Emit(&tables_file_, "\"");
+  Emit(&tables_file_, specialized_coders);
+  Emit(&tables_file_, "));\n\n");
 }
 
 void TablesGenerator::Generate(const coded::TableType& table_type) {
@@ -282,6 +294,9 @@ void TablesGenerator::Generate(const coded::MessageType& message_type) {
   Emit(&tables_file_, NameTable(message_type.coded_name));
   Emit(&tables_file_, ";\n");
 
+  std::string specialized_coders =
+      GenerateSpecializedCoders(message_type.coded_name, message_type.fields);
+
   Emit(&tables_file_, "static const ::fidl::FidlStructField ");
   Emit(&tables_file_, NameFields(message_type.coded_name));
   Emit(&tables_file_, "[] = ");
@@ -298,7 +313,9 @@ void TablesGenerator::Generate(const coded::MessageType& message_type) {
   Emit(&tables_file_, message_type.size);
   Emit(&tables_file_, ", \"");
   Emit(&tables_file_, message_type.qname);
-  Emit(&tables_file_, "\"));\n\n");
+  Emit(&tables_file_, "\"");
+  Emit(&tables_file_, specialized_coders);
+  Emit(&tables_file_, "));\n\n");
 }
 
 void TablesGenerator::Generate(const coded::HandleType& handle_type) {
@@ -414,6 +431,192 @@ void TablesGenerator::Generate(const coded::XUnionField& field) {
   Emit(&tables_file_, ")");
 }
 
+bool TablesGenerator::CanSpecialize(const coded::Type* type, uint32_t* out_depth) const {
+  // Types without coding information are skipped by the walker.
+  if (!type || type->coding_needed != coded::CodingNeeded::kAlways) {
+    *out_depth = 0u;
+    return true;
+  }
+  switch (type->kind) {
+    case coded::Type::Kind::kEnum:
+    case coded::Type::Kind::kBits:
+    case coded::Type::Kind::kHandle:
+    case coded::Type::Kind::kProtocolHandle:
+    case coded::Type::Kind::kRequestHandle:
+      *out_depth = 1u;
+      return true;
+    case coded::Type::Kind::kStruct: {
+      if (library_struct_types_.count(type) == 0)
+        return false;
+      const auto& struct_type = *static_cast<const coded::StructType*>(type);
+      uint32_t fields_depth;
+      if (!CanSpecialize(struct_type.fields, &fields_depth))
+        return false;
+      *out_depth = 1u + fields_depth;
+      return true;
+    }
+    case coded::Type::Kind::kArray: {
+      uint32_t element_depth;
+      if (!CanSpecialize(static_cast<const coded::ArrayType*>(type)->element_type, &element_depth))
+        return false;
+      *out_depth = 1u + element_depth;
+      return true;
+    }
+    default:
+      // Anything with out-of-line data, and unions, whose layout depends on their tag.
+      return false;
+  }
+}
+
+bool TablesGenerator::CanSpecialize(const std::vector<coded::StructField>& fields,
+                                    uint32_t* out_depth) const {
+  uint32_t depth = 0u;
+  for (const auto& field : fields) {
+    uint32_t field_depth;
+    if (!CanSpecialize(field.type, &field_depth))
+      return false;
+    depth = std::max(depth, field_depth);
+  }
+  *out_depth = depth;
+  return true;
+}
+
+std::string TablesGenerator::GenerateSpecializedCoders(
+    std::string_view coded_name, const std::vector<coded::StructField>& fields) {
+  if (!specialized_coders_)
+    return "";
+  uint32_t fields_depth;
+  if (!CanSpecialize(fields, &fields_depth))
+    return "";
+  // The walker needs a frame for its sentinel, one for the message, and one for each level of
+  // nesting. Leave messages it would reject as too deep to it, so that the error is the same.
+  if (2u + fields_depth > kMaxWalkerDepth)
+    return "";
+
+  std::string function_name = "SpecializedCode_" + std::string(coded_name);
+  std::string coders_name = std::string(coded_name) + "SpecializedCoders";
+
+  Emit(&tables_file_, "extern \"C++\" {\n");
+  Emit(&tables_file_, "template <typename Coder>\n");
+  Emit(&tables_file_, "static void ");
+  Emit(&tables_file_, function_name);
+  Emit(&tables_file_, "(Coder* coder) {");
+  indent_level_++;
+  GenerateSpecialized(fields, "", 0u);
+  indent_level_--;
+  Emit(&tables_file_, "\n}\n");
+  Emit(&tables_file_, "static const ::fidl::FidlSpecializedCoders ");
+  Emit(&tables_file_, coders_name);
+  Emit(&tables_file_, "(");
+  Emit(&tables_file_, "&" + function_name + "<::fidl::internal::SpecializedEncoder>, ");
+  Emit(&tables_file_, "&" + function_name + "<::fidl::internal::SpecializedDecoder>, ");
+  Emit(&tables_file_, "&" + function_name + "<::fidl::internal::SpecializedValidator>);\n");
+  Emit(&tables_file_, "} // extern \"C++\"\n");
+
+  return ", &" + coders_name;
+}
+
+// Emits the operations of a struct in the order the walker visits them: the padding after each
+// field, then the field itself. |base| is a runtime offset expression (from enclosing arrays),
+// to which the constant |offset| is added.
+void TablesGenerator::GenerateSpecialized(const std::vector<coded::StructField>& fields,
+                                          std::string_view base, uint32_t offset) {
+  for (const auto& field : fields) {
+    if (field.padding > 0) {
+      EmitNewlineAndIndent(&tables_file_, indent_level_);
+      Emit(&tables_file_, "coder->Padding(");
+      Emit(&tables_file_, base);
+      Emit(&tables_file_, offset + field.offset + field.size);
+      Emit(&tables_file_, ", ");
+      Emit(&tables_file_, field.padding);
+      Emit(&tables_file_, ");");
+    }
+    GenerateSpecialized(field.type, base, offset + field.offset);
+  }
+}
+
+void TablesGenerator::GenerateSpecialized(const coded::Type* type, std::string_view base,
+                                          uint32_t offset) {
+  if (!type || type->coding_needed != coded::CodingNeeded::kAlways)
+    return;
+
+  auto emit_offset = [&]() {
+    Emit(&tables_file_, base);
+    Emit(&tables_file_, offset);
+  };
+
+  switch (type->kind) {
+    case coded::Type::Kind::kEnum: {
+      const auto& enum_type = *static_cast<const coded::EnumType*>(type);
+      EmitNewlineAndIndent(&tables_file_, indent_level_);
+      Emit(&tables_file_, "coder->template Enum<");
+      Emit(&tables_file_, NamePrimitiveCType(enum_type.subtype));
+      Emit(&tables_file_, ">(");
+      emit_offset();
+      Emit(&tables_file_, ", &");
+      Emit(&tables_file_, NameTable(enum_type.coded_name));
+      Emit(&tables_file_, ");");
+      break;
+    }
+    case coded::Type::Kind::kBits: {
+      const auto& bits_type = *static_cast<const coded::BitsType*>(type);
+      EmitNewlineAndIndent(&tables_file_, indent_level_);
+      Emit(&tables_file_, "coder->template Bits<");
+      Emit(&tables_file_, NamePrimitiveCType(bits_type.subtype));
+      Emit(&tables_file_, ">(");
+      emit_offset();
+      Emit(&tables_file_, ", ");
+      // The mask is 64 bits wide even where long is not.
+      Emit(&tables_file_, std::to_string(bits_type.mask) + "ull");
+      Emit(&tables_file_, ");");
+      break;
+    }
+    case coded::Type::Kind::kHandle:
+    case coded::Type::Kind::kProtocolHandle:
+    case coded::Type::Kind::kRequestHandle: {
+      types::Nullability nullability;
+      if (type->kind == coded::Type::Kind::kHandle) {
+        nullability = static_cast<const coded::HandleType*>(type)->nullability;
+      } else if (type->kind == coded::Type::Kind::kProtocolHandle) {
+        nullability = static_cast<const coded::ProtocolHandleType*>(type)->nullability;
+      } else {
+        nullability = static_cast<const coded::RequestHandleType*>(type)->nullability;
+      }
+      EmitNewlineAndIndent(&tables_file_, indent_level_);
+      Emit(&tables_file_, "coder->Handle(");
+      emit_offset();
+      Emit(&tables_file_, ", ");
+      Emit(&tables_file_, nullability);
+      Emit(&tables_file_, ");");
+      break;
+    }
+    case coded::Type::Kind::kStruct:
+      GenerateSpecialized(static_cast<const coded::StructType*>(type)->fields, base, offset);
+      break;
+    case coded::Type::Kind::kArray: {
+      const auto& array_type = *static_cast<const coded::ArrayType*>(type);
+      std::string index = "i" + std::to_string(loop_depth_++);
+      EmitNewlineAndIndent(&tables_file_, indent_level_);
+      Emit(&tables_file_, "for (uint32_t " + index + " = 0u; " + index + " < ");
+      Emit(&tables_file_, array_type.size / array_type.element_size);
+      Emit(&tables_file_, "; " + index + "++) {");
+      indent_level_++;
+      std::ostringstream element_base;
+      element_base << base << offset << "u + " << index << " * " << array_type.element_size
+                   << "u + ";
+      GenerateSpecialized(array_type.element_type, element_base.str(), 0u);
+      indent_level_--;
+      EmitNewlineAndIndent(&tables_file_, indent_level_);
+      Emit(&tables_file_, "}");
+      loop_depth_--;
+      break;
+    }
+    default:
+      assert(false && "Type cannot be specialized.");
+      break;
+  }
+}
+
 void TablesGenerator::GenerateForward(const coded::EnumType& enum_type) {
   Emit(&tables_file_, "extern const fidl_type_t ");
   Emit(&tables_file_, NameTable(enum_type.coded_name));
@@ -453,6 +656,14 @@ void TablesGenerator::GenerateForward(const coded::XUnionType& xunion_type) {
 std::ostringstream TablesGenerator::Produce() {
   coded_types_generator_.CompileCodedTypes();
 
+  for (const auto& decl : coded_types_generator_.library()->declaration_order_) {
+    if (decl->name.library() != coded_types_generator_.library())
+      continue;
+    auto coded_type = coded_types_generator_.CodedTypeFor(&decl->name);
+    if (coded_type && coded_type->kind == coded::Type::Kind::kStruct)
+      library_struct_types_.insert(coded_type);
+  }
+
   GenerateFilePreamble();
 
   // Generate forward declarations of coding tables for named declarations.
@@ -17,6 +17,7 @@
 
 #include <digest/digest.h>
 #include <digest/merkle-tree.h>
+#include <digest/thread-pool.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/unique_fd.h>
 #include <fbl/unique_ptr.h>
@@ -68,7 +69,7 @@ int handle_argument(char** argv, const char* arg,
     }
 }
 
-void handle_entry(FileEntry* entry) {
+void handle_entry(FileEntry* entry, digest::ThreadPool* pool) {
     fbl::unique_fd fd{open(entry->filename.c_str(), O_RDONLY)};
     if (!fd) {
         perror(entry->filename.c_str());
@@ -103,7 +104,7 @@ void handle_entry(FileEntry* entry) {
         exit(1);
     }
     zx_status_t rc =
-        MerkleTree::Create(data, info.st_size, tree.get(), len, &digest);
+        MerkleTree::Create(data, info.st_size, tree.get(), len, &digest, pool);
     if (info.st_size != 0 && munmap(data, info.st_size) != 0) {
         perror("munmap");
         exit(1);
@@ -149,6 +150,8 @@ int main(int argc, char** argv) {
             return 1;
     }
 
+    // A single large file would otherwise be hashed on a single CPU.
+    digest::ThreadPool pool;
     std::vector<std::thread> threads;
     std::mutex mtx;
     size_t next_entry = 0;
@@ -168,7 +171,7 @@ int main(int argc, char** argv) {
                 if (j >= entries.size()) {
                     return;
                 }
-                handle_entry(&entries[j]);
+                handle_entry(&entries[j], &pool);
             }
         }));
     }
@@ -11,6 +11,9 @@
 #include <threads.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <fuchsia/hardware/block/c/fidl.h>
 #include <lib/fit/defer.h>
 #include <lib/fzl/fdio.h>
@@ -138,13 +141,25 @@ typedef struct {
     int max_pending;
     bool write;
     bool linear;
+    bool mixed;
 
     std::atomic<int> pending;
     sync_completion_t signal;
+
+    // For mixed workloads, the time each read was submitted, indexed by
+    // reqid from |first_reqid|, or zero for writes.
+    reqid_t first_reqid;
+    std::vector<zx_time_t> submit_times;
+    // Latencies of completed reads.
+    std::vector<zx_duration_t> read_latencies;
 } bio_random_args_t;
 
 std::atomic<reqid_t> next_reqid(0);
 
+// In mixed workloads, every Nth request is a write ordered behind all earlier
+// requests by a barrier, as a filesystem journal would issue them.
+constexpr size_t kMixedWriteInterval = 8;
+
 static int bio_random_thread(void* arg) {
     auto* a = reinterpret_cast<bio_random_args_t*>(arg);
 
@@ -173,7 +188,21 @@ static int bio_random_thread(void* arg) {
         req.length = static_cast<uint32_t>(xfer);
         req.vmo_offset = off;
 
-        if (a->linear) {
+        if (a->mixed) {
+            // Reads target the first half of the range and writes the second,
+            // so that reads never depend on the writes.
+            const size_t index = req.reqid - a->first_reqid;
+            const size_t half = std::max(blkcount / 2, size_t{1});
+            if ((index % kMixedWriteInterval) == (kMixedWriteInterval - 1)) {
+                req.opcode = BLOCKIO_WRITE | BLOCKIO_BARRIER_BEFORE;
+                req.dev_offset = (half + rand64(&r64) % half) * blksize;
+                a->submit_times[index] = 0;
+            } else {
+                req.opcode = BLOCKIO_READ;
+                req.dev_offset = (rand64(&r64) % half) * blksize;
+                a->submit_times[index] = zx_clock_get_monotonic();
+            }
+        } else if (a->linear) {
             req.dev_offset = dev_off;
             dev_off += xfer;
         } else {
@@ -192,8 +221,10 @@ static int bio_random_thread(void* arg) {
         fprintf(stderr, "IO tid=%u vid=%u op=%x len=%zu vof=%zu dof=%zu\n",
                 req.reqid, req.vmoid.id, req.opcode, req.length, req.vmo_offset, req.dev_offset);
 #endif
-        zx_status_t r = zx_fifo_write(fifo, sizeof(req), &req, 1, NULL);
-        if (r == ZX_ERR_SHOULD_WAIT) {
+        // Retry the same request when the fifo is full, so that reqids are
+        // consumed in submission order.
+        zx_status_t r;
+        while ((r = zx_fifo_write(fifo, sizeof(req), &req, 1, NULL)) == ZX_ERR_SHOULD_WAIT) {
             r = zx_object_wait_one(fifo, ZX_FIFO_WRITABLE | ZX_FIFO_PEER_CLOSED,
                                    ZX_TIME_INFINITE, NULL);
             if (r != ZX_OK) {
@@ -201,8 +232,8 @@ static int bio_random_thread(void* arg) {
                 zx_handle_close(fifo);
                 return -1;
             }
-            continue;
-        } else if (r < 0) {
+        }
+        if (r < 0) {
             fprintf(stderr, "error: failed writing fifo\n");
             zx_handle_close(fifo);
             return -1;
@@ -223,6 +254,13 @@ static zx_status_t bio_random(bio_random_args_t* a, uint64_t* _total, zx_duratio
     size_t count = a->count;
     zx_handle_t fifo = a->blk->fifo;
 
+    if (a->mixed) {
+        a->first_reqid = next_reqid.load();
+        a->submit_times.assign(count, 0);
+        a->read_latencies.clear();
+        a->read_latencies.reserve(count);
+    }
+
     zx_time_t t0 = zx_clock_get_monotonic();
     thrd_create(&t, bio_random_thread, a);
 
@@ -252,6 +290,12 @@ static zx_status_t bio_random(bio_random_args_t* a, uint64_t* _total, zx_duratio
                     resp.status, count);
             return resp.status;
         }
+        if (a->mixed) {
+            zx_time_t submitted = a->submit_times[resp.reqid - a->first_reqid];
+            if (submitted != 0) {
+                a->read_latencies.push_back(zx_clock_get_monotonic() - submitted);
+            }
+        }
         count--;
         if (a->pending.fetch_sub(1) == a->max_pending) {
             sync_completion_signal(&a->signal);
@@ -283,6 +327,8 @@ void usage(void) {
                     "       -live-dangerously  required if using \"-write\"\n"
                     "       -linear       transfers in linear order (default)\n"
                     "       -random       random transfers across total range\n"
+                    "       -mixed        random reads interleaved with barrier writes,\n"
+                    "                     reporting read latency (requires \"-live-dangerously\")\n"
                     "       -output-file <filename>  destination file for "
                     "writing results in JSON format\n"
                     );
@@ -304,6 +350,7 @@ int main(int argc, char** argv) {
     bio_random_args_t a = {};
     bool opt_write = false;
     bool opt_linear = true;
+    bool opt_mixed = false;
     int opt_max_pending = 128;
     size_t opt_xfer_size = 32768;
     uint64_t opt_num_iter = 1;
@@ -346,6 +393,8 @@ int main(int argc, char** argv) {
             opt_linear = true;
         } else if (!strcmp(argv[0], "-random")) {
             opt_linear = false;
+        } else if (!strcmp(argv[0], "-mixed")) {
+            opt_mixed = true;
         } else if (!strcmp(argv[0], "-output-file")) {
             needparam();
             output_file = argv[0];
@@ -368,9 +417,9 @@ int main(int argc, char** argv) {
     if (argc > 1) {
         error("error: unexpected arguments\n");
     }
-    if (a.write && !live_dangerously) {
+    if ((opt_write || opt_mixed) && !live_dangerously) {
         error("error: the option \"-live-dangerously\" is required when using"
-              " \"-write\"\n");
+              " \"-write\" or \"-mixed\"\n");
     }
     const char* device_filename = argv[0];
 
@@ -380,6 +429,7 @@ int main(int argc, char** argv) {
         a.max_pending = opt_max_pending;
         a.write = opt_write;
         a.linear = opt_linear;
+        a.mixed = opt_mixed;
         if ((fd = open(device_filename, O_RDONLY)) < 0) {
             fprintf(stderr, "error: cannot open '%s'\n", device_filename);
             return -1;
@@ -407,12 +457,27 @@ int main(int argc, char** argv) {
         fprintf(stderr, "%zu ops in %zu ns: ", a.count, res);
         ops_per_second(a.count, res);
 
+        std::vector<zx_duration_t>& latencies = a.read_latencies;
+        if (a.mixed && !latencies.empty()) {
+            std::sort(latencies.begin(), latencies.end());
+            fprintf(stderr, "read latency: p50 %zu ns, p99 %zu ns, max %zu ns\n",
+                    latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100],
+                    latencies.back());
+        }
+
         if (output_file) {
             perftest::ResultsSet results;
             auto* test_case = results.AddTestCase(
                 "fuchsia.zircon", "BlockDeviceThroughput", "bytes/second");
             double time_in_seconds = static_cast<double>(res) / 1e9;
             test_case->AppendValue(static_cast<double>(total) / time_in_seconds);
+            if (a.mixed) {
+                test_case = results.AddTestCase(
+                    "fuchsia.zircon", "BlockDeviceReadLatency", "nanoseconds");
+                for (zx_duration_t latency : latencies) {
+                    test_case->AppendValue(static_cast<double>(latency));
+                }
+            }
             if (!results.WriteJSONFile(output_file)) {
                 return 1;
             }
@@ -48,6 +48,13 @@ int Mount(std::unique_ptr<BlockDevice> device, blobfs::MountOptions* options) {
                       std::move(loop_quit)) != ZX_OK) {
         return -1;
     }
+    // This thread runs the loop as well.
+    for (uint32_t i = 1; i < options->dispatch_threads; i++) {
+        if (loop.StartThread("blobfs-dispatch") != ZX_OK) {
+            FS_TRACE_WARN("blobfs: Could not start dispatch thread\n");
+            break;
+        }
+    }
     loop.Run();
     return ZX_OK;
 }
@@ -87,12 +94,15 @@ int usage() {
             "         -m|--metrics   Collect filesystem metrics\n"
             "         -j|--journal   Utilize the blobfs journal\n"
             "                        For fsck, the journal is replayed before verification\n"
+            "         -p|--pager     Page in uncompressed blobs on demand\n"
+            "         -t|--threads N Service connections on N threads (at most %u)\n"
             "         -h|--help      Display this message\n"
             "\n"
             "On Fuchsia, blobfs takes the block device argument by handle.\n"
             "This can make 'blobfs' commands hard to invoke from command line.\n"
             "Try using the [mkfs,fsck,mount,umount] commands instead\n"
-            "\n");
+            "\n",
+            blobfs::kMaxDispatchThreads);
     for (unsigned n = 0; n < (sizeof(kCmds) / sizeof(kCmds[0])); n++) {
         fprintf(stderr, "%9s %-10s %s\n", n ? "" : "commands:",
                 kCmds[n].name, kCmds[n].help);
@@ -108,11 +118,13 @@ zx_status_t ProcessArgs(int argc, char** argv, CommandFunction* func,
             {"readonly", no_argument, nullptr, 'r'},
             {"metrics", no_argument, nullptr, 'm'},
             {"journal", no_argument, nullptr, 'j'},
+            {"pager", no_argument, nullptr, 'p'},
+            {"threads", required_argument, nullptr, 't'},
             {"help", no_argument, nullptr, 'h'},
             {nullptr, 0, nullptr, 0},
         };
         int opt_index;
-        int c = getopt_long(argc, argv, "rmjh", opts, &opt_index);
+        int c = getopt_long(argc, argv, "rmjpt:h", opts, &opt_index);
         if (c < 0) {
             break;
         }
@@ -126,6 +138,19 @@ zx_status_t ProcessArgs(int argc, char** argv, CommandFunction* func,
         case 'j':
             options->journal = true;
             break;
+        case 'p':
+            options->pager = true;
+            break;
+        case 't': {
+            char* end;
+            unsigned long threads = strtoul(optarg, &end, 10);
+            if (*end != '\0' || threads < 1 || threads > blobfs::kMaxDispatchThreads) {
+                fprintf(stderr, "Invalid thread count: %s\n", optarg);
+                return usage();
+            }
+            options->dispatch_threads = static_cast<uint32_t>(threads);
+            break;
+        }
         case 'h':
         default:
             return usage();
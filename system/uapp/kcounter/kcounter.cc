@@ -42,7 +42,9 @@ With --list or -l, show names and types rather than values.\n\
 With --terse or -t, show only values and no names.\n\
 With --verbose or -v, show space-separated lists of per-CPU values.\n\
 With --watch or -w, keep showing the values every [period] seconds, default is %d seconds.\n\
+Histograms then show only the values added since they were last shown.\n\
 Otherwise values are aggregated summaries across all CPUs.\n\
+Histograms show the count and range of each non-empty bucket.\n\
 If PREFIX arguments are given, only matching names are shown.\n\
 Results are always sorted by name.\n\
 ",
@@ -51,6 +53,87 @@ Results are always sorted by name.\n\
 
 constexpr char kVmoFileDir[] = "/boot/kernel";
 
+// Returns the number of histogram buckets starting at |first|, which is zero
+// if |first| isn't the first bucket of a histogram.
+size_t HistogramLength(const counters::DescriptorVmo* desc, size_t first) {
+    const auto& entry = desc->descriptor_table[first];
+    const size_t name_length = strlen(entry.name);
+    if (entry.type != counters::Type::kHistogram || name_length < 3 ||
+        strcmp(entry.name + name_length - 3, ".00") != 0) {
+        return 0;
+    }
+    size_t length = 1;
+    while (length < counters::kHistogramBuckets && first + length < desc->num_counters()) {
+        const auto& bucket = desc->descriptor_table[first + length];
+        if (bucket.type != counters::Type::kHistogram ||
+            strncmp(bucket.name, entry.name, name_length - 2) != 0) {
+            break;
+        }
+        ++length;
+    }
+    return length;
+}
+
+// Bucket 0 holds values of 0 and bucket n holds values in [2^(n-1), 2^n).
+uint64_t BucketStart(size_t bucket) {
+    return bucket == 0 ? 0 : uint64_t{1} << (bucket - 1);
+}
+
+// Returns the bucket holding the value at |percent| of |counts|.
+size_t Percentile(const int64_t* counts, size_t length, int64_t total, int percent) {
+    const int64_t rank = (total * percent + 99) / 100;
+    int64_t seen = 0;
+    for (size_t bucket = 0; bucket < length; ++bucket) {
+        seen += counts[bucket];
+        if (seen >= rank) {
+            return bucket;
+        }
+    }
+    return length - 1;
+}
+
+void PrintHistogram(const char* name, size_t name_length, const int64_t* counts,
+                    size_t length, bool terse) {
+    if (terse) {
+        for (size_t bucket = 0; bucket < length; ++bucket) {
+            printf("%s%" PRId64, bucket == 0 ? "" : " ", counts[bucket]);
+        }
+        printf("\n");
+        return;
+    }
+
+    int64_t total = 0;
+    for (size_t bucket = 0; bucket < length; ++bucket) {
+        total += counts[bucket];
+    }
+    printf("%.*s = %" PRId64, static_cast<int>(name_length), name, total);
+    if (total == 0) {
+        printf("\n");
+        return;
+    }
+    for (int percent : {50, 99}) {
+        // The last bucket has no upper bound.
+        const size_t bucket = Percentile(counts, length, total, percent);
+        if (bucket == length - 1) {
+            printf(" [p%d >= %" PRIu64 "]", percent, BucketStart(bucket));
+        } else {
+            printf(" [p%d < %" PRIu64 "]", percent, BucketStart(bucket + 1));
+        }
+    }
+    printf("\n");
+    for (size_t bucket = 0; bucket < length; ++bucket) {
+        if (counts[bucket] == 0) {
+            continue;
+        }
+        if (bucket == length - 1) {
+            printf("  [%" PRIu64 ", ...) %" PRId64 "\n", BucketStart(bucket), counts[bucket]);
+        } else {
+            printf("  [%" PRIu64 ", %" PRIu64 ") %" PRId64 "\n",
+                   BucketStart(bucket), BucketStart(bucket + 1), counts[bucket]);
+        }
+    }
+}
+
 }  // anonymous namespace
 
 int main(int argc, char** argv) {
@@ -228,6 +311,9 @@ int main(int argc, char** argv) {
         return false;
     };
 
+    // The histogram values last shown, for --watch.
+    fbl::Array<int64_t> previous(new int64_t[desc->num_counters()](), desc->num_counters());
+
     size_t times = 1;
     zx_time_t deadline = 0;
     bool match_failed = false;
@@ -240,6 +326,35 @@ int main(int argc, char** argv) {
 
         for (size_t i = 0; i < desc->num_counters(); ++i) {
             const auto& entry = desc->descriptor_table[i];
+            const size_t histogram_length = HistogramLength(desc, i);
+            if (histogram_length > 0) {
+                // Show all the buckets as one histogram, named without the
+                // bucket suffix.
+                const size_t name_length = strlen(entry.name) - 3;
+                if (matches(entry.name)) {
+                    if (list) {
+                        printf("%.*s histogram\n", static_cast<int>(name_length), entry.name);
+                    } else {
+                        int64_t counts[counters::kHistogramBuckets] = {};
+                        for (size_t bucket = 0; bucket < histogram_length; ++bucket) {
+                            int64_t value = 0;
+                            for (uint64_t cpu = 0; cpu < desc->max_cpus; ++cpu) {
+                                value += arena[(cpu * desc->num_counters()) + i + bucket];
+                            }
+                            if (period != 0) {
+                                counts[bucket] = value - previous[i + bucket];
+                                previous[i + bucket] = value;
+                            } else {
+                                counts[bucket] = value;
+                            }
+                        }
+                        PrintHistogram(entry.name, name_length, counts, histogram_length,
+                                       terse);
+                    }
+                }
+                i += histogram_length - 1;
+                continue;
+            }
             if (matches(entry.name)) {
                 if (list) {
                     fputs(entry.name, stdout);
@@ -253,6 +368,9 @@ int main(int argc, char** argv) {
                     case counters::Type::kMax:
                         puts(" max");
                         break;
+                    case counters::Type::kHistogram:
+                        puts(" histogram");
+                        break;
                     default:
                         printf(" ??? unknown type %" PRIu64 " ???\n",
                                static_cast<uint64_t>(entry.type));
@@ -14,6 +14,8 @@
 #include <fuchsia/tracing/kernel/c/fidl.h>
 #include <lib/fdio/fdio.h>
 #include <lib/zx/channel.h>
+#include <lib/zx/handle.h>
+#include <lib/zx/time.h>
 
 #include <zircon/device/ktrace.h>
 #include <zircon/status.h>
@@ -24,12 +26,18 @@ static const char kUsage[] = "\
 Usage: ktrace [options] <control>\n\
 Where <control> is one of:\n\
   start <group_mask>  - start tracing\n\
+  start-circular <group_mask>\n\
+                      - start tracing, overwriting the oldest records\n\
+                        when the buffer is full\n\
   stop                - stop tracing\n\
   rewind              - rewind trace buffer\n\
   written             - print bytes written to trace buffer\n\
     Note: This value doesn't reset on \"rewind\". Instead, the rewind\n\
     takes effect on the next \"start\".\n\
   save <path>         - save contents of trace buffer to <path>\n\
+  stream <path> <seconds>\n\
+                      - save records to <path> as they are written,\n\
+                        for <seconds>, consuming them from the buffer\n\
 \n\
 Options:\n\
   --help  - Duh.\n\
@@ -72,11 +80,12 @@ static int LogFidlError(zx_status_t status) {
     return EXIT_FAILURE;
 }
 
-static int DoStart(uint32_t group_mask) {
+static int DoStart(uint32_t group_mask, bool circular) {
     zx::channel channel{OpenKtraceDeviceAsChannel()};
     zx_status_t start_status;
-    zx_status_t status = fuchsia_tracing_kernel_ControllerStart(
-        channel.get(), group_mask, &start_status);
+    zx_status_t status = circular
+        ? fuchsia_tracing_kernel_ControllerStartCircular(channel.get(), group_mask, &start_status)
+        : fuchsia_tracing_kernel_ControllerStart(channel.get(), group_mask, &start_status);
     if (status != ZX_OK) {
         return LogFidlError(status);
     }
@@ -165,6 +174,47 @@ static int DoSave(const char* path) {
     return EXIT_SUCCESS;
 }
 
+static int DoStream(const char* path, uint32_t seconds) {
+    fbl::unique_fd in_fd{OpenKtraceDeviceAsFd()};
+    zx::handle resource;
+    if (ioctl_ktrace_get_handle(in_fd.get(), resource.reset_and_get_address()) < 0) {
+        fprintf(stderr, "Unable to obtain ktrace handle\n");
+        return EXIT_FAILURE;
+    }
+    fbl::unique_fd out_fd(open(path, O_CREAT | O_TRUNC | O_WRONLY, 0666));
+    if (!out_fd.is_valid()) {
+        fprintf(stderr, "Unable to open file for writing: %s, %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // Poll for new records, backing off while there are none.
+    static char buf[65536];
+    const zx::time deadline = zx::deadline_after(zx::sec(seconds));
+    size_t total = 0;
+    while (zx::clock::get_monotonic() < deadline) {
+        size_t actual;
+        zx_status_t status = zx_ktrace_read_stream(resource.get(), buf, sizeof(buf), &actual);
+        if (status != ZX_OK) {
+            fprintf(stderr, "Error reading trace: %s(%d)\n", zx_status_get_string(status),
+                    status);
+            return EXIT_FAILURE;
+        }
+        if (actual == 0) {
+            zx::nanosleep(zx::deadline_after(zx::msec(10)));
+            continue;
+        }
+        ssize_t bytes_written = write(out_fd.get(), buf, actual);
+        if (bytes_written != static_cast<ssize_t>(actual)) {
+            fprintf(stderr, "I/O error saving trace: %s\n", strerror(errno));
+            return EXIT_FAILURE;
+        }
+        total += actual;
+    }
+
+    printf("Streamed %zu bytes\n", total);
+    return EXIT_SUCCESS;
+}
+
 static void EnsureNArgs(const fbl::String& cmd, int argc, int expected_argc) {
     if (argc != expected_argc) {
         fprintf(stderr, "Unexpected number of args for command %s\n", cmd.c_str());
@@ -192,7 +242,15 @@ int main(int argc, char** argv) {
             fprintf(stderr, "Invalid group mask\n");
             return EXIT_FAILURE;
         }
-        return DoStart(group_mask);
+        return DoStart(group_mask, false);
+    } else if (cmd == "start-circular") {
+        EnsureNArgs(cmd, argc, 3);
+        int group_mask = atoi(argv[2]);
+        if (group_mask < 0) {
+            fprintf(stderr, "Invalid group mask\n");
+            return EXIT_FAILURE;
+        }
+        return DoStart(group_mask, true);
     } else if (cmd == "stop") {
         EnsureNArgs(cmd, argc, 2);
         return DoStop();
@@ -206,6 +264,15 @@ int main(int argc, char** argv) {
         EnsureNArgs(cmd, argc, 3);
         const char* path = argv[2];
         return DoSave(path);
+    } else if (cmd == "stream") {
+        EnsureNArgs(cmd, argc, 4);
+        const char* path = argv[2];
+        int seconds = atoi(argv[3]);
+        if (seconds <= 0) {
+            fprintf(stderr, "Invalid duration\n");
+            return EXIT_FAILURE;
+        }
+        return DoStream(path, seconds);
     }
 
     PrintUsage(stderr);
@@ -7,7 +7,11 @@
 #include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <threads.h>
 
+#include <atomic>
+
+#include <fbl/array.h>
 #include <fbl/function.h>
 #include <lib/async/cpp/task.h>
 #include <trace-engine/buffer_internal.h>
@@ -234,3 +238,80 @@ void RunTracingDisabledBenchmarks() {
 void RunTracingEnabledBenchmarks(const BenchmarkSpec* spec) {
     RunBenchmarks(true, spec);
 }
+
+namespace {
+
+struct ContentionState {
+    unsigned num_iterations;
+    std::atomic<bool> go{false};
+};
+
+int ContentionThread(void* arg) {
+    auto state = static_cast<ContentionState*>(arg);
+    while (!state->go.load(std::memory_order_acquire)) {
+        thrd_yield();
+    }
+    for (unsigned i = 0; i < state->num_iterations; ++i) {
+        TRACE_DURATION_BEGIN("+enabled", "name");
+    }
+    return 0;
+}
+
+// Returns the time in microseconds for |num_threads| threads to each write
+// |spec->num_iterations| records.
+float MeasureContention(const BenchmarkSpec* spec, unsigned num_threads) {
+    ContentionState state;
+    state.num_iterations = spec->num_iterations;
+
+    fbl::Array<thrd_t> threads(new thrd_t[num_threads], num_threads);
+    for (unsigned i = 0; i < num_threads; ++i) {
+        int rc = thrd_create_with_name(&threads[i], ContentionThread, &state,
+                                       "trace-benchmark writer");
+        ZX_ASSERT(rc == thrd_success);
+    }
+
+    zx_ticks_t start = zx_ticks_get();
+    state.go.store(true, std::memory_order_release);
+    for (unsigned i = 0; i < num_threads; ++i) {
+        thrd_join(threads[i], nullptr);
+    }
+    zx_ticks_t stop = zx_ticks_get();
+    return (static_cast<float>(stop - start) * 1000000.f /
+            static_cast<float>(zx_ticks_per_second()));
+}
+
+} // namespace
+
+void RunContentionBenchmark(const BenchmarkSpec* spec,
+                            trace_allocation_mode_t allocation_mode,
+                            unsigned num_threads) {
+    const char* allocation_mode_name =
+        allocation_mode == TRACE_ALLOCATION_MODE_PER_THREAD ? "per-thread" : "shared";
+    printf("\n* %s: TRACE_DURATION_BEGIN from %u threads, %s allocation ...\n",
+           spec->name, num_threads, allocation_mode_name);
+
+    async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+    BenchmarkHandler handler(&loop, spec->mode, spec->buffer_size, allocation_mode);
+    loop.StartThread("trace-engine loop", nullptr);
+
+    float min = 0;
+    for (unsigned i = 0; i < kNumTestRuns; ++i) {
+        handler.Start();
+        float run_time = MeasureContention(spec, num_threads);
+        handler.Stop();
+        if (min == 0 || min > run_time)
+            min = run_time;
+        zx::nanosleep(zx::deadline_after(zx::msec(10)));
+    }
+
+    loop.Quit();
+    loop.JoinThreads();
+
+    unsigned num_records = spec->num_iterations * num_threads;
+    printf("%srun: %u test runs, %u records per run\n",
+           kTestOutputPrefix, kNumTestRuns, num_records);
+    printf("%stotal (usec): min: %.3f\n", kTestOutputPrefix, min);
+    printf("%sper-record (usec): min: %.3f\n",
+           // The static cast is to avoid a "may change value" warning.
+           kTestOutputPrefix, min / static_cast<float>(num_records));
+}
@@ -25,3 +25,9 @@ void RunTracingEnabledBenchmarks(const BenchmarkSpec* spec);
 
 // Runs benchmarks with NTRACE macro defined.
 void RunNoTraceBenchmarks();
+
+// Runs a benchmark where |num_threads| threads write records at the same
+// time, to measure contention between writers.
+void RunContentionBenchmark(const BenchmarkSpec* spec,
+                            trace_allocation_mode_t allocation_mode,
+                            unsigned num_threads);
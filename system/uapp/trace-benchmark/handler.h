@@ -19,9 +19,11 @@ public:
     static constexpr int kWaitStoppedTimeoutSeconds = 10;
 
     BenchmarkHandler(async::Loop* loop, trace_buffering_mode_t mode,
-                     size_t buffer_size)
+                     size_t buffer_size,
+                     trace_allocation_mode_t allocation_mode = TRACE_ALLOCATION_MODE_SHARED)
         : loop_(loop),
           mode_(mode),
+          allocation_mode_(allocation_mode),
           buffer_(new uint8_t[buffer_size], buffer_size) {
         auto status = zx::event::create(0u, &observer_event_);
         ZX_DEBUG_ASSERT_MSG(status == ZX_OK,
@@ -43,7 +45,11 @@ public:
     trace_buffering_mode_t mode() const { return mode_; }
 
     void Start() {
-        zx_status_t status = trace_engine_initialize(loop_->dispatcher(),
+        zx_status_t status = trace_engine_set_allocation_mode(allocation_mode_);
+        ZX_DEBUG_ASSERT_MSG(status == ZX_OK,
+                            "trace_engine_set_allocation_mode returned %s\n",
+                            zx_status_get_string(status));
+        status = trace_engine_initialize(loop_->dispatcher(),
                                                      this, mode_,
                                                      buffer_.get(), buffer_.size());
         ZX_DEBUG_ASSERT_MSG(status == ZX_OK,
@@ -87,6 +93,9 @@ public:
         if (mode_ == TRACE_BUFFERING_MODE_ONESHOT) {
             ZX_DEBUG_ASSERT(header.wrapped_count == 0);
         }
+
+        // Don't leak our allocation mode into later sessions.
+        trace_engine_set_allocation_mode(TRACE_ALLOCATION_MODE_SHARED);
     }
 
 private:
@@ -130,6 +139,7 @@ private:
 
     async::Loop* const loop_;
     const trace_buffering_mode_t mode_;
+    const trace_allocation_mode_t allocation_mode_;
     fbl::Array<uint8_t> const buffer_;
     zx::event observer_event_;
 };
@@ -62,6 +62,25 @@ int main(int argc, char** argv) {
         RunTracingEnabledBenchmarks(&spec);
     }
 
+    // Circular mode so that records are never dropped however many threads
+    // are writing.
+    static const BenchmarkSpec contention_spec = {
+        "circular, 16MB buffer",
+        TRACE_BUFFERING_MODE_CIRCULAR,
+        kLargeBufferSizeBytes,
+        kDefaultRunIterations,
+    };
+    static const trace_allocation_mode_t kContentionAllocationModes[] = {
+        TRACE_ALLOCATION_MODE_SHARED,
+        TRACE_ALLOCATION_MODE_PER_THREAD,
+    };
+    static const unsigned kContentionThreadCounts[] = {1, 4, 16};
+    for (auto allocation_mode : kContentionAllocationModes) {
+        for (unsigned num_threads : kContentionThreadCounts) {
+            RunContentionBenchmark(&contention_spec, allocation_mode, num_threads);
+        }
+    }
+
     printf("\nTracing benchmarks completed.\n");
     return 0;
 }
@@ -26,6 +26,12 @@
 // The port wait key associated with the dispatcher's control messages.
 #define KEY_CONTROL (0u)
 
+// Maximum number of packets read from the port per zx_port_wait_many() call.
+#define PACKET_BATCH_SIZE (16u)
+
+// Matches packets of every type in async_loop_cancel_pending_locked().
+#define PACKET_TYPE_ANY (UINT32_MAX)
+
 static zx_time_t async_loop_now(async_dispatcher_t* dispatcher);
 static zx_status_t async_loop_begin_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
 static zx_status_t async_loop_cancel_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
@@ -91,9 +97,20 @@ typedef struct async_loop {
     list_node_t thread_list; // earliest created thread first
     list_node_t exception_list; // most recently added first
     bool timer_armed; // true if timer has been set and has not fired yet
+
+    // Packets read from the port in a batch but not dispatched yet, oldest
+    // first, kept in a ring buffer.  |pending_reserved| slots have been
+    // promised to threads that are currently reading a batch.
+    zx_port_packet_t pending_packets[PACKET_BATCH_SIZE];
+    size_t pending_head;
+    size_t pending_count;
+    size_t pending_reserved;
 } async_loop_t;
 
 static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline);
+static zx_status_t async_loop_read_packet(async_loop_t* loop, zx_time_t deadline,
+                                          zx_port_packet_t* out_packet);
+static bool async_loop_cancel_pending_locked(async_loop_t* loop, uint64_t key, uint32_t type);
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal);
 static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop);
@@ -203,6 +220,9 @@ void async_loop_shutdown(async_loop_t* loop) {
     async_loop_wake_threads(loop);
     async_loop_join_threads(loop);
 
+    // Anything left over from a batch is covered by the cancellations below.
+    loop->pending_count = 0u;
+
     list_node_t* node;
     while ((node = list_remove_head(&loop->wait_list))) {
         async_wait_t* wait = node_to_wait(node);
@@ -255,7 +275,7 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
         return ZX_ERR_CANCELED;
 
     zx_port_packet_t packet;
-    zx_status_t status = zx_port_wait(loop->port, deadline, &packet);
+    zx_status_t status = async_loop_read_packet(loop, deadline, &packet);
     if (status != ZX_OK)
         return status;
 
@@ -304,6 +324,70 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
     return ZX_ERR_INTERNAL;
 }
 
+// Returns the next packet to dispatch: one left over from an earlier batch if
+// there is one, otherwise the first of a new batch read from the port.
+static zx_status_t async_loop_read_packet(async_loop_t* loop, zx_time_t deadline,
+                                          zx_port_packet_t* out_packet) {
+    mtx_lock(&loop->lock);
+    if (loop->pending_count) {
+        *out_packet = loop->pending_packets[loop->pending_head];
+        loop->pending_head = (loop->pending_head + 1) % PACKET_BATCH_SIZE;
+        loop->pending_count--;
+        mtx_unlock(&loop->lock);
+        return ZX_OK;
+    }
+
+    // With several threads servicing the loop, leave the packets in the port
+    // so that the kernel spreads them across the threads.
+    size_t room = 0u;
+    if (atomic_load_explicit(&loop->active_threads, memory_order_acquire) == 1u) {
+        room = PACKET_BATCH_SIZE - loop->pending_count - loop->pending_reserved;
+        loop->pending_reserved += room;
+    }
+    mtx_unlock(&loop->lock);
+
+    if (room == 0u)
+        return zx_port_wait(loop->port, deadline, out_packet);
+
+    // One more than |room|, since the first packet is returned directly.
+    zx_port_packet_t packets[PACKET_BATCH_SIZE + 1];
+    size_t actual = 0u;
+    zx_status_t status = zx_port_wait_many(loop->port, deadline, packets, room + 1, &actual);
+
+    mtx_lock(&loop->lock);
+    loop->pending_reserved -= room;
+    if (status == ZX_OK) {
+        *out_packet = packets[0];
+        for (size_t i = 1; i < actual; i++) {
+            size_t tail = (loop->pending_head + loop->pending_count) % PACKET_BATCH_SIZE;
+            loop->pending_packets[tail] = packets[i];
+            loop->pending_count++;
+        }
+    }
+    mtx_unlock(&loop->lock);
+    return status;
+}
+
+// Drops any packets of |type|, or of any type if PACKET_TYPE_ANY, for |key|
+// that were read from the port but have not been dispatched yet.  Returns true
+// if there were any.
+static bool async_loop_cancel_pending_locked(async_loop_t* loop, uint64_t key, uint32_t type) {
+    size_t kept = 0u;
+    for (size_t i = 0u; i < loop->pending_count; i++) {
+        const zx_port_packet_t* packet =
+            &loop->pending_packets[(loop->pending_head + i) % PACKET_BATCH_SIZE];
+        if (packet->key == key && (type == PACKET_TYPE_ANY || packet->type == type))
+            continue;
+        if (kept != i) {
+            loop->pending_packets[(loop->pending_head + kept) % PACKET_BATCH_SIZE] = *packet;
+        }
+        kept++;
+    }
+    bool found = kept != loop->pending_count;
+    loop->pending_count = kept;
+    return found;
+}
+
 async_dispatcher_t* async_loop_get_dispatcher(async_loop_t* loop) {
     // Note: The loop's implementation inherits from async_t so we can upcast to it.
     return (async_dispatcher_t*)loop;
@@ -525,6 +609,11 @@ static zx_status_t async_loop_cancel_wait(async_dispatcher_t* async, async_wait_
     // to cancel then we assume we lost the race.
     zx_status_t status = zx_port_cancel(loop->port, wait->object,
                                         (uintptr_t)wait);
+    if (status == ZX_ERR_NOT_FOUND &&
+        async_loop_cancel_pending_locked(loop, (uintptr_t)wait, ZX_PKT_TYPE_SIGNAL_ONE)) {
+        // The packet had been read as part of a batch but not dispatched.
+        status = ZX_OK;
+    }
     if (status == ZX_OK) {
         list_delete(node);
     } else {
@@ -678,6 +767,7 @@ static zx_status_t async_loop_unbind_exception_port(async_dispatcher_t* async,
                                                      exception->options);
 
     if (status == ZX_OK) {
+        async_loop_cancel_pending_locked(loop, key, PACKET_TYPE_ANY);
         list_delete(node);
     }
 
@@ -743,6 +833,10 @@ static void async_loop_restart_timer_locked(async_loop_t* loop) {
             status = zx_port_cancel(loop->port, loop->timer, KEY_CONTROL);
             ZX_ASSERT_MSG(status == ZX_OK || status == ZX_ERR_NOT_FOUND,
                           "zx_port_cancel: status=%d", status);
+            // The packet may also have been read as part of a batch.  Left
+            // there, it would be dispatched after the timer is armed again and
+            // register a second wait for it.
+            async_loop_cancel_pending_locked(loop, KEY_CONTROL, ZX_PKT_TYPE_SIGNAL_ONE);
             loop->timer_armed = false;
         }
 
@@ -753,6 +847,9 @@ static void async_loop_restart_timer_locked(async_loop_t* loop) {
     ZX_ASSERT_MSG(status == ZX_OK, "zx_timer_set: status=%d", status);
 
     if (!loop->timer_armed) {
+        // Any timer packet still waiting in the batch belongs to a wait that
+        // is being replaced.
+        async_loop_cancel_pending_locked(loop, KEY_CONTROL, ZX_PKT_TYPE_SIGNAL_ONE);
         loop->timer_armed = true;
         status = zx_object_wait_async(loop->timer, loop->port, KEY_CONTROL,
                                       ZX_TIMER_SIGNALED,
@@ -110,6 +110,21 @@ protected:
     }
 };
 
+class CallbackWait : public TestWait {
+public:
+    CallbackWait(zx_handle_t object, zx_signals_t trigger, fbl::Closure callback)
+        : TestWait(object, trigger), callback_(std::move(callback)) {}
+
+protected:
+    fbl::Closure callback_;
+
+    void Handle(async_dispatcher_t* dispatcher, zx_status_t status,
+                const zx_packet_signal_t* signal) override {
+        TestWait::Handle(dispatcher, status, signal);
+        callback_();
+    }
+};
+
 class TestTask : public async_task_t {
 public:
     TestTask()
@@ -752,6 +767,39 @@ bool task_test() {
     END_TEST;
 }
 
+bool task_rearm_batched_timer_test() {
+    BEGIN_TEST;
+
+    async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+    zx::event event;
+    EXPECT_EQ(ZX_OK, zx::event::create(0u, &event), "create event");
+    EXPECT_EQ(ZX_OK, event.signal(0u, ZX_USER_SIGNAL_0), "signal");
+
+    // Queue the wait's packet ahead of the timer's so that both are read in
+    // one batch and the timer packet is left pending.
+    TestTask task1;
+    TestTask task2;
+    CallbackWait wait(event.get(), ZX_USER_SIGNAL_0, [&loop, &task1, &task2] {
+        task1.Cancel(loop.dispatcher());
+        task2.PostForTime(loop.dispatcher(), async::Now(loop.dispatcher()) + zx::hour(1));
+    });
+    EXPECT_EQ(ZX_OK, wait.Begin(loop.dispatcher()), "wait");
+    EXPECT_EQ(ZX_OK, task1.PostForTime(loop.dispatcher(), async::Now(loop.dispatcher())),
+              "post 1");
+    zx::nanosleep(zx::deadline_after(zx::msec(10)));
+
+    // Cancelling task 1 and posting task 2 re-arms the timer; the batched
+    // timer packet for the old deadline must not be dispatched.
+    EXPECT_EQ(ZX_OK, loop.Run(zx::time(0), true /*once*/), "run wait");
+    EXPECT_EQ(1u, wait.run_count, "run count wait");
+    EXPECT_EQ(ZX_ERR_TIMED_OUT, loop.Run(zx::time(0), true /*once*/), "run timer");
+    EXPECT_EQ(0u, task1.run_count, "run count 1");
+
+    loop.Shutdown();
+
+    END_TEST;
+}
+
 bool task_shutdown_test() {
     BEGIN_TEST;
 
@@ -1379,6 +1427,7 @@ RUN_TEST(wait_test)
 RUN_TEST(wait_unwaitable_handle_test)
 RUN_TEST(wait_shutdown_test)
 RUN_TEST(task_test)
+RUN_TEST(task_rearm_batched_timer_test)
 RUN_TEST(task_shutdown_test)
 RUN_TEST(receiver_test)
 RUN_TEST(receiver_shutdown_test)
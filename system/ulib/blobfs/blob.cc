@@ -8,6 +8,7 @@
 #include <string.h>
 
 #include <blobfs/blobfs.h>
+#include <blobfs/compression/chunked.h>
 #include <blobfs/compression/lz4.h>
 #include <blobfs/compression/zstd.h>
 #include <blobfs/iterator/allocated-extent-iterator.h>
@@ -16,9 +17,12 @@
 #include <blobfs/iterator/node-populator.h>
 #include <blobfs/iterator/vector-extent-iterator.h>
 #include <blobfs/metrics.h>
+#include <blobfs/user-pager.h>
 #include <blobfs/writeback.h>
 #include <digest/digest.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
+#include <fbl/auto_lock.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/string_buffer.h>
 #include <fbl/string_piece.h>
@@ -42,12 +46,276 @@ using digest::MerkleTree;
 // "blob-1abc8" or "compressedBlob-5c"
 constexpr char kBlobVmoNamePrefix[] = "blob";
 constexpr char kCompressedBlobVmoNamePrefix[] = "compressedBlob";
+constexpr char kPagedBlobTransferVmoNamePrefix[] = "blobTransfer";
 
 void FormatVmoName(const char* prefix, fbl::StringBuffer<ZX_MAX_NAME_LEN>* vmo_name, size_t index) {
     vmo_name->Clear();
     vmo_name->AppendPrintf("%s-%lx", prefix, index);
 }
 
+// Data is verified, and therefore read, in whole Merkle tree nodes.
+static_assert(MerkleTree::kNodeSize % kBlobfsBlockSize == 0,
+              "Merkle tree nodes must be made of whole blocks");
+
+// A contiguous run of a blob's blocks on disk.
+struct BlockRun {
+    uint64_t blob_block;
+    uint64_t dev_block;
+    uint32_t length;
+};
+
+// Populates the pager-owned VMO of a blob which is either uncompressed or
+// chunk-compressed.
+//
+// Blocks are read into |transfer_|, which shares the layout of the blob's VMO:
+// the Merkle tree, which is read once and stays resident, followed by the data,
+// which is moved into the paged VMO once it has been verified. Chunk-compressed
+// blobs additionally stage their compressed blocks after the data, from which
+// only the chunks covering a request are read and decompressed, and which are
+// decommitted again once decompressed.
+class BlobPageSource final : public PageSource {
+public:
+    BlobPageSource(Blobfs* blobfs, const uint8_t* digest, uint64_t blob_size,
+                   uint32_t merkle_blocks, bool chunked)
+        : blobfs_(blobfs), digest_(digest), blob_size_(blob_size),
+          merkle_blocks_(merkle_blocks), chunked_(chunked) {}
+
+    ~BlobPageSource() final {
+        if (vmoid_ != VMOID_INVALID) {
+            blobfs_->DetachVmo(vmoid_);
+        }
+    }
+
+    // Locates the |block_count| on-disk blocks of the blob at |node_index|, and
+    // reads its Merkle tree and, if chunk-compressed, its chunk table.
+    zx_status_t Init(uint32_t node_index, uint32_t block_count, const char* vmo_name);
+
+    zx_status_t PopulateRange(UserPager* pager, const zx::vmo& vmo, uint64_t offset,
+                              uint64_t length) final;
+
+private:
+    // Reads blocks [start, start + count) of the blob into |transfer_|, starting
+    // at block |vmo_block|.
+    zx_status_t ReadBlocks(uint64_t start, uint64_t count, uint64_t vmo_block);
+
+    // Releases the pages backing blocks [vmo_block, vmo_block + count) of |transfer_|.
+    void DecommitBlocks(uint64_t vmo_block, uint64_t count);
+
+    // Reads the chunk table from the start of the compressed blocks.
+    zx_status_t ReadChunkTable(uint32_t compressed_blocks);
+
+    // Reads and decompresses the chunks covering [start, end) of the data into
+    // the data region of |transfer_|.
+    zx_status_t ReadChunks(uint64_t start, uint64_t end);
+
+    Blobfs* const blobfs_;
+    const Digest digest_;
+    const uint64_t blob_size_;
+    const uint32_t merkle_blocks_;
+    const bool chunked_;
+
+    fbl::Vector<BlockRun> runs_;
+    fzl::OwnedVmoMapper transfer_;
+    vmoid_t vmoid_ = VMOID_INVALID;
+
+    // The block of |transfer_| holding the first compressed block, and the
+    // table locating each chunk within the compressed blocks.
+    uint64_t compressed_start_ = 0;
+    ChunkTable table_;
+};
+
+zx_status_t BlobPageSource::Init(uint32_t node_index, uint32_t block_count,
+                                 const char* vmo_name) {
+    AllocatedExtentIterator extent_iter(blobfs_->GetAllocator(), node_index);
+    BlockIterator block_iter(&extent_iter);
+    const uint64_t data_start = blobfs_->DataStart();
+    zx_status_t status = StreamBlocks(
+        &block_iter, block_count, [&](uint64_t blob_offset, uint64_t dev_offset, uint32_t length) {
+            fbl::AllocChecker ac;
+            runs_.push_back({blob_offset, dev_offset + data_start, length}, &ac);
+            return ac.check() ? ZX_OK : ZX_ERR_NO_MEMORY;
+        });
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (block_count < merkle_blocks_) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    uint64_t transfer_blocks = block_count;
+    if (chunked_) {
+        compressed_start_ =
+            merkle_blocks_ + fbl::round_up(blob_size_, kBlobfsBlockSize) / kBlobfsBlockSize;
+        transfer_blocks = compressed_start_ + (block_count - merkle_blocks_);
+    }
+    status = transfer_.CreateAndMap(transfer_blocks * kBlobfsBlockSize, vmo_name);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if ((status = blobfs_->AttachVmo(transfer_.vmo(), &vmoid_)) != ZX_OK) {
+        vmoid_ = VMOID_INVALID;
+        return status;
+    }
+    if (merkle_blocks_ > 0 && (status = ReadBlocks(0, merkle_blocks_, 0)) != ZX_OK) {
+        return status;
+    }
+    if (chunked_) {
+        return ReadChunkTable(block_count - merkle_blocks_);
+    }
+    return ZX_OK;
+}
+
+zx_status_t BlobPageSource::ReadBlocks(uint64_t start, uint64_t count, uint64_t vmo_block) {
+    fs::ReadTxn txn(blobfs_);
+    const uint64_t end = start + count;
+    for (const BlockRun& run : runs_) {
+        const uint64_t run_start = fbl::max(start, run.blob_block);
+        const uint64_t run_end = fbl::min(end, run.blob_block + run.length);
+        if (run_start < run_end) {
+            txn.Enqueue(vmoid_, vmo_block + (run_start - start),
+                        run.dev_block + (run_start - run.blob_block), run_end - run_start);
+        }
+    }
+    return txn.Transact();
+}
+
+void BlobPageSource::DecommitBlocks(uint64_t vmo_block, uint64_t count) {
+    __UNUSED zx_status_t status =
+        transfer_.vmo().op_range(ZX_VMO_OP_DECOMMIT, vmo_block * kBlobfsBlockSize,
+                                 count * kBlobfsBlockSize, nullptr, 0);
+    ZX_DEBUG_ASSERT(status == ZX_OK);
+}
+
+zx_status_t BlobPageSource::ReadChunkTable(uint32_t compressed_blocks) {
+    if (compressed_blocks == 0) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    zx_status_t status = ReadBlocks(merkle_blocks_, 1, compressed_start_);
+    if (status != ZX_OK) {
+        return status;
+    }
+    // The table is copied out by ChunkTable::Create().
+    uint64_t table_blocks = 1;
+    auto decommit = fbl::MakeAutoCall([this, &table_blocks]() {
+        DecommitBlocks(compressed_start_, table_blocks);
+    });
+    const uint8_t* compressed =
+        static_cast<const uint8_t*>(transfer_.start()) + compressed_start_ * kBlobfsBlockSize;
+    const size_t compressed_size = compressed_blocks * kBlobfsBlockSize;
+    size_t table_size;
+    status = ChunkTable::TableSize(compressed, kBlobfsBlockSize, blob_size_, &table_size);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (table_size > compressed_size) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    table_blocks = fbl::round_up(table_size, kBlobfsBlockSize) / kBlobfsBlockSize;
+    if (table_blocks > 1 &&
+        (status = ReadBlocks(merkle_blocks_ + 1, table_blocks - 1, compressed_start_ + 1)) !=
+            ZX_OK) {
+        return status;
+    }
+    if ((status = ChunkTable::Create(compressed, table_size, compressed_size, blob_size_,
+                                     &table_)) != ZX_OK) {
+        return status;
+    }
+
+    // Chunks are verified as a whole, so must be made of whole Merkle tree nodes.
+    if (table_.chunk_size() % MerkleTree::kNodeSize != 0) {
+        FS_TRACE_ERROR("blobfs: Unsupported chunk size %u\n", table_.chunk_size());
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    return ZX_OK;
+}
+
+zx_status_t BlobPageSource::ReadChunks(uint64_t start, uint64_t end) {
+    const uint32_t first = static_cast<uint32_t>(start / table_.chunk_size());
+    const uint32_t last = static_cast<uint32_t>((end - 1) / table_.chunk_size());
+
+    // Frames of adjacent chunks are adjacent, so one read covers them all.
+    const uint64_t frame_block = table_.FrameStart(first) / kBlobfsBlockSize;
+    const uint64_t frame_end_block =
+        fbl::round_up(table_.FrameEnd(last), kBlobfsBlockSize) / kBlobfsBlockSize;
+    auto decommit = fbl::MakeAutoCall([this, frame_block, frame_end_block]() {
+        DecommitBlocks(compressed_start_ + frame_block, frame_end_block - frame_block);
+    });
+    zx_status_t status = ReadBlocks(merkle_blocks_ + frame_block, frame_end_block - frame_block,
+                                    compressed_start_ + frame_block);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    const uint8_t* compressed =
+        static_cast<const uint8_t*>(transfer_.start()) + compressed_start_ * kBlobfsBlockSize;
+    uint8_t* data = static_cast<uint8_t*>(transfer_.start()) + merkle_blocks_ * kBlobfsBlockSize;
+    for (uint32_t i = first; i <= last; i++) {
+        status = ChunkedDecompressChunk(table_, i, compressed + table_.FrameStart(i),
+                                        data + uint64_t{i} * table_.chunk_size());
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t BlobPageSource::PopulateRange(UserPager* pager, const zx::vmo& vmo, uint64_t offset,
+                                          uint64_t length) {
+    TRACE_DURATION("blobfs", "BlobPageSource::PopulateRange", "offset", offset, "length",
+                   length);
+    // Clients are only ever given access to the data, never the Merkle tree.
+    const uint64_t data_offset = merkle_blocks_ * kBlobfsBlockSize;
+    const uint64_t data_size = fbl::round_up(blob_size_, kBlobfsBlockSize);
+    if (offset < data_offset || length > data_size ||
+        offset - data_offset > data_size - length) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // Widen the request to whole Merkle tree nodes, the granularity at which
+    // the data can be verified, or to whole chunks, the granularity at which
+    // it can be decompressed.
+    const uint64_t granularity = chunked_ ? table_.chunk_size() : MerkleTree::kNodeSize;
+    const uint64_t start = fbl::round_down(offset - data_offset, granularity);
+    const uint64_t end =
+        fbl::min(fbl::round_up(offset - data_offset + length, granularity), data_size);
+
+    fs::Ticker ticker(blobfs_->Metrics().Collecting());
+    zx_status_t status;
+    if (chunked_) {
+        status = ReadChunks(start, fbl::min(end, blob_size_));
+    } else {
+        const uint64_t block = merkle_blocks_ + start / kBlobfsBlockSize;
+        status = ReadBlocks(block, (end - start) / kBlobfsBlockSize, block);
+    }
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("blobfs: Failed to read blocks for paging: %d\n", status);
+        return status;
+    }
+    fs::Duration read_time = ticker.End();
+    ticker.Reset();
+
+    uint8_t* data = static_cast<uint8_t*>(transfer_.start()) + data_offset;
+    status = MerkleTree::Verify(data, blob_size_, transfer_.start(),
+                                MerkleTree::GetTreeLength(blob_size_), start,
+                                fbl::min(end, blob_size_) - start, digest_,
+                                blobfs_->MerklePool());
+    if (status != ZX_OK) {
+        char name[Digest::kLength * 2 + 1];
+        ZX_ASSERT(digest_.ToString(name, sizeof(name)) == ZX_OK);
+        FS_TRACE_ERROR("blobfs verify(%s) [%lu, %lu) Failure: %s\n", name, start, end,
+                       zx_status_get_string(status));
+        return status;
+    }
+    // The tail of the last block is not covered by the Merkle tree.
+    if (end > blob_size_) {
+        memset(data + blob_size_, 0, end - blob_size_);
+    }
+    blobfs_->Metrics().UpdatePageIn(end - start, read_time, ticker.End());
+
+    return pager->SupplyPages(vmo, data_offset + start, end - start, transfer_.vmo(),
+                              data_offset + start);
+}
+
 } // namespace
 
 zx_status_t Blob::Verify() const {
@@ -64,7 +332,8 @@ zx_status_t Blob::Verify() const {
     // For now, we aggressively verify the entire VMO up front.
     Digest digest(GetKey());
     zx_status_t status =
-        MerkleTree::Verify(data, data_size, tree, merkle_size, 0, data_size, digest);
+        MerkleTree::Verify(data, data_size, tree, merkle_size, 0, data_size, digest,
+                           blobfs_->MerklePool());
     blobfs_->Metrics().UpdateMerkleVerify(data_size, merkle_size, ticker.End());
 
     if (status != ZX_OK) {
@@ -77,7 +346,62 @@ zx_status_t Blob::Verify() const {
 }
 
 zx_status_t Blob::InitVmos() {
-    TRACE_DURATION("blobfs", "Blobfs::InitVmos");
+    if (mapping_.vmo() || paged_vmo_) {
+        return ZX_OK;
+    }
+
+    // Only chunk-compressed blobs can be decompressed piecemeal.
+    constexpr uint16_t kStreamCompressedFlags = kBlobFlagLZ4Compressed | kBlobFlagZSTDCompressed;
+    if (blobfs_->Pager() != nullptr && inode_.blob_size > 0 &&
+        (inode_.header.flags & kStreamCompressedFlags) == 0) {
+        return InitPagedVmo();
+    }
+    return ReadVmos();
+}
+
+zx_status_t Blob::InitPagedVmo() {
+    TRACE_DURATION("blobfs", "Blobfs::InitPagedVmo", "size", inode_.blob_size, "blocks",
+                   inode_.block_count);
+    fs::Ticker ticker(blobfs_->Metrics().Collecting());
+
+    const uint32_t merkle_blocks = MerkleTreeBlocks(inode_);
+    const uint64_t num_blocks = BlobDataBlocks(inode_) + merkle_blocks;
+    if (num_blocks > std::numeric_limits<uint32_t>::max()) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::RefPtr<BlobPageSource> source = fbl::AdoptRef(
+        new (&ac) BlobPageSource(blobfs_, GetKey(), inode_.blob_size, merkle_blocks,
+                                 (inode_.header.flags & kBlobFlagChunkCompressed) != 0));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    fbl::StringBuffer<ZX_MAX_NAME_LEN> vmo_name;
+    FormatVmoName(kPagedBlobTransferVmoNamePrefix, &vmo_name, Ino());
+    zx_status_t status = source->Init(GetMapIndex(), inode_.block_count, vmo_name.c_str());
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("Failed to initialize page source; error: %d\n", status);
+        return status;
+    }
+
+    zx::vmo vmo;
+    status = blobfs_->Pager()->CreateVmo(std::move(source), num_blocks * kBlobfsBlockSize, &vmo);
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("Failed to create paged vmo; error: %d\n", status);
+        return status;
+    }
+    FormatVmoName(kBlobVmoNamePrefix, &vmo_name, Ino());
+    vmo.set_property(ZX_PROP_NAME, vmo_name.c_str(), vmo_name.length());
+    paged_vmo_ = std::move(vmo);
+
+    blobfs_->Metrics().UpdateMerkleDiskRead(merkle_blocks * kBlobfsBlockSize, ticker.End());
+    return ZX_OK;
+}
+
+zx_status_t Blob::ReadVmos() {
+    TRACE_DURATION("blobfs", "Blobfs::ReadVmos");
 
     if (mapping_.vmo()) {
         return ZX_OK;
@@ -121,6 +445,10 @@ zx_status_t Blob::InitVmos() {
         if ((status = InitCompressed(CompressionAlgorithm::ZSTD)) != ZX_OK) {
             return status;
         }
+    } else if ((inode_.header.flags & kBlobFlagChunkCompressed) != 0) {
+        if ((status = InitCompressed(CompressionAlgorithm::CHUNKED)) != ZX_OK) {
+            return status;
+        }
     } else {
         if ((status = InitUncompressed()) != ZX_OK) {
             return status;
@@ -213,6 +541,9 @@ zx_status_t Blob::InitCompressed(CompressionAlgorithm algorithm) {
     case CompressionAlgorithm::ZSTD:
         status = ZSTDDecompress(GetData(), &target_size, compressed_buffer, &compressed_size);
         break;
+    case CompressionAlgorithm::CHUNKED:
+        status = ChunkedDecompress(GetData(), &target_size, compressed_buffer, &compressed_size);
+        break;
     default:
         FS_TRACE_ERROR("Unsupported decompression algorithm");
         return ZX_ERR_NOT_SUPPORTED;
@@ -349,7 +680,7 @@ zx_status_t Blob::SpaceAllocate(uint64_t size_data) {
     fbl::StringBuffer<ZX_MAX_NAME_LEN> vmo_name;
     if (inode_.blob_size >= kCompressionMinBytesSaved) {
         write_info->compressor =
-            BlobCompressor::Create(CompressionAlgorithm::ZSTD, inode_.blob_size);
+            BlobCompressor::Create(CompressionAlgorithm::CHUNKED, inode_.blob_size);
         if (!write_info->compressor) {
             FS_TRACE_ERROR("blobfs: Failed to initialize compressor: %d\n", status);
             return status;
@@ -452,7 +783,8 @@ zx_status_t Blob::WriteMetadata() {
         ZX_ASSERT(populator.Walk(on_node, on_extent) == ZX_OK);
 
         // Ensure all non-allocation flags are propagated to the inode.
-        const uint16_t non_allocation_flags = kBlobFlagZSTDCompressed | kBlobFlagLZ4Compressed;
+        const uint16_t non_allocation_flags =
+            kBlobFlagZSTDCompressed | kBlobFlagLZ4Compressed | kBlobFlagChunkCompressed;
         mapped_inode->header.flags |= (inode_.header.flags & non_allocation_flags);
     } else {
         // Special case: Empty node.
@@ -551,7 +883,7 @@ zx_status_t Blob::WriteInternal(const void* data, size_t len, size_t* actual) {
             fs::Ticker ticker(blobfs_->Metrics().Collecting());
 
             if ((status = MerkleTree::Create(blob_data, inode_.blob_size, merkle_data, merkle_size,
-                                             &digest)) != ZX_OK) {
+                                             &digest, blobfs_->MerklePool())) != ZX_OK) {
                 return status;
             } else if (digest != GetKey()) {
                 // Downloaded blob did not match provided digest.
@@ -599,7 +931,7 @@ zx_status_t Blob::WriteInternal(const void* data, size_t len, size_t* actual) {
             ZX_DEBUG_ASSERT(inode_.block_count > blocks);
 
             inode_.block_count = blocks;
-            inode_.header.flags |= kBlobFlagZSTDCompressed;
+            inode_.header.flags |= kBlobFlagChunkCompressed;
         } else {
             uint64_t blocks64 =
                 fbl::round_up(inode_.blob_size, kBlobfsBlockSize) / kBlobfsBlockSize;
@@ -681,8 +1013,8 @@ zx_status_t Blob::CloneVmo(zx_rights_t rights, zx_handle_t* out_vmo, size_t* out
     // was requested.
     const size_t merkle_bytes = MerkleTreeBlocks(inode_) * kBlobfsBlockSize;
     zx::vmo clone;
-    if ((status = mapping_.vmo().create_child(ZX_VMO_CHILD_COPY_ON_WRITE, merkle_bytes,
-                                              inode_.blob_size, &clone)) != ZX_OK) {
+    if ((status = Vmo().create_child(ZX_VMO_CHILD_COPY_ON_WRITE, merkle_bytes, inode_.blob_size,
+                                     &clone)) != ZX_OK) {
         return status;
     }
 
@@ -698,7 +1030,7 @@ zx_status_t Blob::CloneVmo(zx_rights_t rights, zx_handle_t* out_vmo, size_t* out
     *out_size = inode_.blob_size;
 
     if (clone_watcher_.object() == ZX_HANDLE_INVALID) {
-        clone_watcher_.set_object(mapping_.vmo().get());
+        clone_watcher_.set_object(Vmo().get());
         clone_watcher_.set_trigger(ZX_VMO_ZERO_CHILDREN);
 
         // Keep a reference to "this" alive, preventing the blob
@@ -717,6 +1049,7 @@ void Blob::HandleNoClones(async_dispatcher_t* dispatcher, async::WaitBase* wait,
                           const zx_packet_signal_t* signal) {
     ZX_DEBUG_ASSERT(status == ZX_OK);
     ZX_DEBUG_ASSERT((signal->observed & ZX_VMO_ZERO_CHILDREN) != 0);
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     ZX_DEBUG_ASSERT(clone_watcher_.object() != ZX_HANDLE_INVALID);
     clone_watcher_.set_object(ZX_HANDLE_INVALID);
     clone_ref_ = nullptr;
@@ -725,22 +1058,26 @@ void Blob::HandleNoClones(async_dispatcher_t* dispatcher, async::WaitBase* wait,
 zx_status_t Blob::ReadInternal(void* data, size_t len, size_t off, size_t* actual) {
     TRACE_DURATION("blobfs", "Blobfs::ReadInternal", "len", len, "off", off);
 
-    if (GetState() != kBlobStateReadable) {
-        return ZX_ERR_BAD_STATE;
-    }
+    {
+        fbl::AutoLock lock(blobfs_->VnodeLock());
+        if (GetState() != kBlobStateReadable) {
+            return ZX_ERR_BAD_STATE;
+        }
 
-    if (inode_.blob_size == 0) {
-        *actual = 0;
-        return ZX_OK;
-    }
+        if (inode_.blob_size == 0) {
+            *actual = 0;
+            return ZX_OK;
+        }
 
-    zx_status_t status = InitVmos();
-    if (status != ZX_OK) {
-        return status;
+        zx_status_t status = InitVmos();
+        if (status != ZX_OK) {
+            return status;
+        }
     }
 
-    Digest d(GetKey());
-
+    // A readable blob is immutable, and its VMO is kept until the last
+    // reference to it is released, so the copy (and any page faults it
+    // takes) can run alongside other operations.
     if (off >= inode_.blob_size) {
         *actual = 0;
         return ZX_OK;
@@ -750,7 +1087,7 @@ zx_status_t Blob::ReadInternal(void* data, size_t len, size_t off, size_t* actua
     }
 
     const size_t merkle_bytes = MerkleTreeBlocks(inode_) * kBlobfsBlockSize;
-    status = mapping_.vmo().read(data, merkle_bytes + off, len);
+    zx_status_t status = Vmo().read(data, merkle_bytes + off, len);
     if (status == ZX_OK) {
         *actual = len;
     }
@@ -771,8 +1108,8 @@ zx_status_t Blob::VerifyBlob(Blobfs* bs, uint32_t node_index) {
     vn->PopulateInode(node_index);
 
     // If we are unable to read in the blob from disk, this should also be a VerifyBlob error.
-    // Since InitVmos calls Verify as its final step, we can just return its result here.
-    return vn->InitVmos();
+    // Since ReadVmos calls Verify as its final step, we can just return its result here.
+    return vn->ReadVmos();
 }
 
 BlobCache& Blob::Cache() {
@@ -796,6 +1133,10 @@ void Blob::ActivateLowMemory() {
         blobfs_->DetachVmo(vmoid_);
     }
     mapping_.Reset();
+    if (paged_vmo_) {
+        blobfs_->Pager()->DetachVmo(paged_vmo_);
+        paged_vmo_.reset();
+    }
 }
 
 Blob::~Blob() {
@@ -807,6 +1148,7 @@ zx_status_t Blob::ValidateFlags(uint32_t flags) {
         return ZX_ERR_NOT_DIR;
     }
 
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     if (flags & ZX_FS_RIGHT_WRITABLE) {
         if (GetState() != kBlobStateEmpty) {
             return ZX_ERR_ACCESS_DENIED;
@@ -817,6 +1159,7 @@ zx_status_t Blob::ValidateFlags(uint32_t flags) {
 
 zx_status_t Blob::GetNodeInfo(uint32_t flags, fuchsia_io_NodeInfo* info) {
     info->tag = fuchsia_io_NodeInfoTag_file;
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     return GetReadableEvent(&info->file.event);
 }
 
@@ -830,11 +1173,13 @@ zx_status_t Blob::Read(void* data, size_t len, size_t off, size_t* out_actual) {
 zx_status_t Blob::Write(const void* data, size_t len, size_t offset, size_t* out_actual) {
     TRACE_DURATION("blobfs", "Blob::Write", "len", len, "off", offset);
     auto event = blobfs_->Metrics().NewLatencyEvent(fs_metrics::Event::kWrite);
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     return WriteInternal(data, len, out_actual);
 }
 
 zx_status_t Blob::Append(const void* data, size_t len, size_t* out_end, size_t* out_actual) {
     auto event = blobfs_->Metrics().NewLatencyEvent(fs_metrics::Event::kAppend);
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     zx_status_t status = WriteInternal(data, len, out_actual);
     if (GetState() == kBlobStateDataWrite) {
         ZX_DEBUG_ASSERT(write_info_ != nullptr);
@@ -847,6 +1192,7 @@ zx_status_t Blob::Append(const void* data, size_t len, size_t* out_end, size_t*
 
 zx_status_t Blob::Getattr(vnattr_t* a) {
     auto event = blobfs_->Metrics().NewLatencyEvent(fs_metrics::Event::kGetAttr);
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     memset(a, 0, sizeof(vnattr_t));
     a->mode = V_TYPE_FILE | V_IRUSR;
     a->inode = Ino();
@@ -862,6 +1208,7 @@ zx_status_t Blob::Getattr(vnattr_t* a) {
 zx_status_t Blob::Truncate(size_t len) {
     TRACE_DURATION("blobfs", "Blob::Truncate", "len", len);
     auto event = blobfs_->Metrics().NewLatencyEvent(fs_metrics::Event::kTruncate);
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     return SpaceAllocate(len);
 }
 
@@ -873,6 +1220,7 @@ zx_status_t Blob::QueryFilesystem(fuchsia_io_FilesystemInfo* info) {
     static_assert(fbl::constexpr_strlen(kFsName) + 1 < fuchsia_io_MAX_FS_NAME_BUFFER,
                   "Blobfs name too long");
 
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     memset(info, 0, sizeof(*info));
     info->block_size = kBlobfsBlockSize;
     info->max_filename_size = Digest::kLength * 2;
@@ -907,11 +1255,13 @@ zx_status_t Blob::GetVmo(int flags, zx_handle_t* out_vmo, size_t* out_size) {
     // the immutability of blobfs blobs.
     rights |= (flags & fuchsia_io_VMO_FLAG_READ) ? ZX_RIGHT_READ : 0;
     rights |= (flags & fuchsia_io_VMO_FLAG_EXEC) ? ZX_RIGHT_EXECUTE : 0;
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     return CloneVmo(rights, out_vmo, out_size);
 }
 
 void Blob::Sync(SyncCallback closure) {
     auto event = blobfs_->Metrics().NewLatencyEvent(fs_metrics::Event::kSync);
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     if (atomic_load(&syncing_)) {
         blobfs_->Sync([this, evt = std::move(event), cb = std::move(closure)](zx_status_t status) {
             if (status != ZX_OK) {
@@ -947,12 +1297,16 @@ fbl::RefPtr<Blob> Blob::CloneWatcherTeardown() {
 }
 
 zx_status_t Blob::Open(uint32_t flags, fbl::RefPtr<Vnode>* out_redirect) {
+    // Unlike the other operations, this doesn't take the vnode lock: it is
+    // either called by the Vfs, which serializes it with Close, or by
+    // Directory::Create, which already holds the vnode lock.
     fd_count_++;
     return ZX_OK;
 }
 
 zx_status_t Blob::Close() {
     auto event = blobfs_->Metrics().NewLatencyEvent(fs_metrics::Event::kClose);
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     ZX_DEBUG_ASSERT_MSG(fd_count_ > 0, "Closing blob with no fds open");
     fd_count_--;
     // Attempt purge in case blob was unlinked prior to close
@@ -973,6 +1327,17 @@ zx_status_t Blob::Purge() {
     if (GetState() == kBlobStateReadable) {
         // A readable blob should only be purged if it has been unlinked.
         ZX_ASSERT(DeletionQueued());
+
+        // Clients may still be using the blob, but its blocks are about to be
+        // released; fault in everything they may still access.
+        if (paged_vmo_ && clone_watcher_.object() != ZX_HANDLE_INVALID) {
+            const uint64_t merkle_bytes = MerkleTreeBlocks(inode_) * kBlobfsBlockSize;
+            zx_status_t status = paged_vmo_.op_range(ZX_VMO_OP_COMMIT, merkle_bytes,
+                                                     inode_.blob_size, nullptr, 0);
+            if (status != ZX_OK) {
+                FS_TRACE_ERROR("blobfs: Failed to page in purged blob: %d\n", status);
+            }
+        }
         fbl::unique_ptr<WritebackWork> wb;
         zx_status_t status = blobfs_->CreateWork(&wb, this);
         if (status != ZX_OK) {
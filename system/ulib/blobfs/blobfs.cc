@@ -18,6 +18,7 @@
 #include <digest/digest.h>
 #include <digest/merkle-tree.h>
 #include <fbl/auto_call.h>
+#include <fbl/auto_lock.h>
 #include <fbl/ref_ptr.h>
 #include <fs/block-txn.h>
 #include <fs/ticker.h>
@@ -176,8 +177,9 @@ void Blobfs::Shutdown(fs::Vfs::ShutdownCallback cb) {
     // 1) Shutdown all external connections to blobfs.
     ManagedVfs::Shutdown([this, cb = std::move(cb)](zx_status_t status) mutable {
         // 2a) Shutdown all internal connections to blobfs.
-        Cache().ForAllOpenNodes([](fbl::RefPtr<CacheNode> cache_node) {
+        Cache().ForAllOpenNodes([this](fbl::RefPtr<CacheNode> cache_node) {
             auto vnode = fbl::RefPtr<Blob>::Downcast(std::move(cache_node));
+            fbl::AutoLock lock(&vnode_lock_);
             vnode->CloneWatcherTeardown();
         });
 
@@ -193,8 +195,9 @@ void Blobfs::Shutdown(fs::Vfs::ShutdownCallback cb) {
                     // after completing, scope it here to be extra cautious.
                 }
 
-                metrics_.Dump();
                 flush_loop_.Shutdown();
+                metrics_.UpdateDentryCache(GetDentryCacheStats());
+                metrics_.Dump();
 
                 auto on_unmount = std::move(on_unmount_);
 
@@ -465,15 +468,22 @@ Blobfs::Blobfs(std::unique_ptr<BlockDevice> device, const Superblock* info)
 }
 
 Blobfs::~Blobfs() {
+    // The cache holds the root directory, which refers back to this object.
+    ClearDentryCache();
+
     // The journal must be destroyed before the writeback buffer, since it may still need
     // to enqueue more transactions for writeback.
     journal_.reset();
     writeback_.reset();
 
     Cache().Reset();
+
+    // Blobs detach their paged VMOs when released, so the pager must outlive the cache.
+    pager_.reset();
 }
 
 void Blobfs::ScheduleMetricFlush() {
+    metrics_.UpdateDentryCache(GetDentryCacheStats());
     metrics_.mutable_collector()->Flush();
     async::PostDelayedTask(
         flush_loop_.dispatcher(), [this]() { ScheduleMetricFlush(); }, kCobaltFlushTimer);
@@ -521,7 +531,18 @@ zx_status_t Blobfs::Create(std::unique_ptr<BlockDevice> device, MountOptions* op
     auto fs = std::unique_ptr<Blobfs>(new Blobfs(std::move(device), superblock));
     fs->block_info_ = std::move(block_info);
     fs->SetReadonly(options->writability != blobfs::Writability::Writable);
+    // Blobs are created and purged by blobfs itself, so only the names which
+    // don't exist are cached; this also keeps the cache from pinning blobs.
+    fs::DentryCacheOptions dentry_options;
+    dentry_options.positive_entries = false;
+    fs->EnableDentryCache(dentry_options);
     fs->Cache().SetCachePolicy(options->cache_policy);
+    if (options->pager) {
+        if ((status = UserPager::Create(&fs->pager_)) != ZX_OK) {
+            FS_TRACE_ERROR("blobfs: Failed to create pager: %d\n", status);
+            return status;
+        }
+    }
     if (options->metrics) {
         fs->Metrics().Collect();
         // TODO(gevalentino): Once we have async llcpp bindings, instead pass a dispatcher for
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <blobfs/compression/blob-compressor.h>
+#include <blobfs/compression/chunked.h>
 #include <blobfs/compression/lz4.h>
 #include <blobfs/compression/zstd.h>
 #include <fbl/algorithm.h>
@@ -49,6 +50,22 @@ std::optional<BlobCompressor> BlobCompressor::Create(CompressionAlgorithm algori
         auto result = BlobCompressor(std::move(compressor), std::move(compressed_blob));
         return std::make_optional(std::move(result));
     }
+    case CompressionAlgorithm::CHUNKED: {
+        fzl::OwnedVmoMapper compressed_blob;
+        size_t max = ChunkedCompressor::BufferMax(blob_size);
+        zx_status_t status = compressed_blob.CreateAndMap(max, "chunked-blob");
+        if (status != ZX_OK) {
+            return std::nullopt;
+        }
+        fbl::unique_ptr<ChunkedCompressor> compressor;
+        status = ChunkedCompressor::Create(blob_size, compressed_blob.start(),
+                                           compressed_blob.size(), &compressor);
+        if (status != ZX_OK) {
+            return std::nullopt;
+        }
+        auto result = BlobCompressor(std::move(compressor), std::move(compressed_blob));
+        return std::make_optional(std::move(result));
+    }
     default:
         return std::nullopt;
     }
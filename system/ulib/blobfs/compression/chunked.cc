@@ -0,0 +1,267 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <blobfs/compression/chunked.h>
+#include <blobfs/compression/compressor.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fs/trace.h>
+#include <zircon/types.h>
+#include <zstd/zstd.h>
+
+#include <limits>
+#include <utility>
+
+namespace blobfs {
+namespace {
+
+constexpr int kCompressionLevel = 3;
+
+uint32_t ChunkCount(size_t data_size, uint32_t chunk_size) {
+    return static_cast<uint32_t>(fbl::round_up(data_size, chunk_size) / chunk_size);
+}
+
+} // namespace
+
+ChunkedCompressor::ChunkedCompressor(ZSTD_CCtx* ctx, size_t input_size, uint32_t chunk_count,
+                                     void* compression_buffer, size_t compression_buffer_length)
+    : ctx_(ctx), input_size_(input_size), chunk_count_(chunk_count),
+      buf_(static_cast<uint8_t*>(compression_buffer)), buf_max_(compression_buffer_length),
+      buf_used_(ChunkedTableSize(chunk_count)) {}
+
+ChunkedCompressor::~ChunkedCompressor() {
+    ZSTD_freeCCtx(ctx_);
+}
+
+size_t ChunkedCompressor::BufferMax(size_t input_length) {
+    const uint32_t chunk_count = ChunkCount(input_length, kChunkedChunkSize);
+    size_t max = ChunkedTableSize(chunk_count);
+    if (chunk_count > 0) {
+        // Every chunk but the last is full-sized.
+        max += (chunk_count - 1) * ZSTD_compressBound(kChunkedChunkSize);
+        max += ZSTD_compressBound(input_length - (chunk_count - 1) * size_t{kChunkedChunkSize});
+    }
+    return max;
+}
+
+zx_status_t ChunkedCompressor::Create(size_t input_size, void* compression_buffer,
+                                      size_t compression_buffer_length,
+                                      fbl::unique_ptr<ChunkedCompressor>* out) {
+    if (BufferMax(input_size) > compression_buffer_length) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    if (fbl::round_up(input_size, kChunkedChunkSize) / kChunkedChunkSize >
+        std::numeric_limits<uint32_t>::max() - 1) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    ZSTD_CCtx* ctx = ZSTD_createCCtx();
+    if (ctx == nullptr) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    const uint32_t chunk_count = ChunkCount(input_size, kChunkedChunkSize);
+    auto compressor = fbl::unique_ptr<ChunkedCompressor>(new ChunkedCompressor(
+        ctx, input_size, chunk_count, compression_buffer, compression_buffer_length));
+
+    fbl::AllocChecker ac;
+    compressor->pending_.reset(new (&ac) uint8_t[kChunkedChunkSize]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    ChunkedHeader header;
+    header.magic = kChunkedMagic;
+    header.chunk_size = kChunkedChunkSize;
+    header.chunk_count = chunk_count;
+    memcpy(compressor->buf_, &header, sizeof(header));
+    compressor->FrameOffsets()[0] = compressor->buf_used_;
+
+    *out = std::move(compressor);
+    return ZX_OK;
+}
+
+uint64_t* ChunkedCompressor::FrameOffsets() const {
+    return reinterpret_cast<uint64_t*>(buf_ + sizeof(ChunkedHeader));
+}
+
+zx_status_t ChunkedCompressor::CompressChunk(const void* data, size_t length) {
+    if (chunks_written_ == chunk_count_) {
+        FS_TRACE_ERROR("[blobfs][chunked] More input than expected\n");
+        return ZX_ERR_INVALID_ARGS;
+    }
+    size_t r = ZSTD_compressCCtx(ctx_, buf_ + buf_used_, buf_max_ - buf_used_, data, length,
+                                 kCompressionLevel);
+    if (ZSTD_isError(r)) {
+        FS_TRACE_ERROR("[blobfs][chunked] Failed to compress: %s\n", ZSTD_getErrorName(r));
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    buf_used_ += r;
+    FrameOffsets()[++chunks_written_] = buf_used_;
+    return ZX_OK;
+}
+
+zx_status_t ChunkedCompressor::Update(const void* input_data, size_t input_length) {
+    auto input = static_cast<const uint8_t*>(input_data);
+    while (input_length > 0) {
+        // Whole chunks are compressed straight from the input.
+        if (pending_length_ == 0 && input_length >= kChunkedChunkSize) {
+            zx_status_t status = CompressChunk(input, kChunkedChunkSize);
+            if (status != ZX_OK) {
+                return status;
+            }
+            input += kChunkedChunkSize;
+            input_length -= kChunkedChunkSize;
+            continue;
+        }
+
+        const size_t length = fbl::min(input_length, kChunkedChunkSize - pending_length_);
+        memcpy(pending_.get() + pending_length_, input, length);
+        pending_length_ += length;
+        input += length;
+        input_length -= length;
+        if (pending_length_ == kChunkedChunkSize) {
+            zx_status_t status = CompressChunk(pending_.get(), pending_length_);
+            if (status != ZX_OK) {
+                return status;
+            }
+            pending_length_ = 0;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t ChunkedCompressor::End() {
+    if (pending_length_ > 0) {
+        zx_status_t status = CompressChunk(pending_.get(), pending_length_);
+        if (status != ZX_OK) {
+            return status;
+        }
+        pending_length_ = 0;
+    }
+    if (chunks_written_ != chunk_count_) {
+        FS_TRACE_ERROR("[blobfs][chunked] Expected %zu bytes of input\n", input_size_);
+        return ZX_ERR_BAD_STATE;
+    }
+    return ZX_OK;
+}
+
+size_t ChunkedCompressor::Size() const {
+    return buf_used_;
+}
+
+zx_status_t ChunkTable::TableSize(const void* data, size_t length, uint64_t data_size,
+                                  size_t* out_table_size) {
+    ChunkedHeader header;
+    if (length < sizeof(header)) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != kChunkedMagic) {
+        FS_TRACE_ERROR("[blobfs][chunked] Bad magic\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    if (header.chunk_size == 0 || header.chunk_count == std::numeric_limits<uint32_t>::max() ||
+        header.chunk_count != ChunkCount(data_size, header.chunk_size)) {
+        FS_TRACE_ERROR("[blobfs][chunked] Bad chunk count %u of size %u for %lu bytes\n",
+                       header.chunk_count, header.chunk_size, data_size);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    *out_table_size = ChunkedTableSize(header.chunk_count);
+    return ZX_OK;
+}
+
+zx_status_t ChunkTable::Create(const void* data, size_t length, size_t compressed_size,
+                               uint64_t data_size, ChunkTable* out) {
+    size_t table_size;
+    zx_status_t status = TableSize(data, length, data_size, &table_size);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (length < table_size || compressed_size < table_size) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
+    ChunkedHeader header;
+    memcpy(&header, data, sizeof(header));
+    fbl::AllocChecker ac;
+    fbl::Array<uint64_t> frame_offsets(new (&ac) uint64_t[header.chunk_count + 1],
+                                       header.chunk_count + 1);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    memcpy(frame_offsets.get(), static_cast<const uint8_t*>(data) + sizeof(header),
+           frame_offsets.size() * sizeof(uint64_t));
+
+    // Frames must follow the table, in order, within the compressed data.
+    if (frame_offsets[0] != table_size) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    for (uint32_t i = 0; i < header.chunk_count; i++) {
+        if (frame_offsets[i + 1] <= frame_offsets[i]) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+    if (frame_offsets[header.chunk_count] > compressed_size) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    out->data_size_ = data_size;
+    out->chunk_size_ = header.chunk_size;
+    out->chunk_count_ = header.chunk_count;
+    out->frame_offsets_ = std::move(frame_offsets);
+    return ZX_OK;
+}
+
+size_t ChunkTable::ChunkLength(uint32_t index) const {
+    const uint64_t start = uint64_t{index} * chunk_size_;
+    return fbl::min(data_size_ - start, uint64_t{chunk_size_});
+}
+
+zx_status_t ChunkedDecompressChunk(const ChunkTable& table, uint32_t index, const void* frame,
+                                   void* target_buf) {
+    const size_t target_size = table.ChunkLength(index);
+    size_t r = ZSTD_decompress(target_buf, target_size, frame,
+                               table.FrameEnd(index) - table.FrameStart(index));
+    if (ZSTD_isError(r)) {
+        FS_TRACE_ERROR("[blobfs][chunked] Failed to decompress chunk %u: %s\n", index,
+                       ZSTD_getErrorName(r));
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    if (r != target_size) {
+        FS_TRACE_ERROR("[blobfs][chunked] Chunk %u decompressed to %zu bytes, expected %zu\n",
+                       index, r, target_size);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return ZX_OK;
+}
+
+zx_status_t ChunkedDecompress(void* target_buf, size_t* target_size, const void* src_buf,
+                              size_t* src_size) {
+    TRACE_DURATION("blobfs", "ChunkedDecompress", "target_size", *target_size,
+                   "src_size", *src_size);
+    ChunkTable table;
+    zx_status_t status = ChunkTable::Create(src_buf, *src_size, *src_size, *target_size, &table);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    auto src = static_cast<const uint8_t*>(src_buf);
+    auto target = static_cast<uint8_t*>(target_buf);
+    for (uint32_t i = 0; i < table.chunk_count(); i++) {
+        status = ChunkedDecompressChunk(table, i, src + table.FrameStart(i),
+                                        target + uint64_t{i} * table.chunk_size());
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    *src_size = table.chunk_count() > 0 ? table.FrameEnd(table.chunk_count() - 1)
+                                        : ChunkedTableSize(0);
+    return ZX_OK;
+}
+
+} // namespace blobfs
@@ -8,6 +8,7 @@
 #include <blobfs/blobfs.h>
 #include <blobfs/metrics.h>
 #include <digest/digest.h>
+#include <fbl/auto_lock.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/string_piece.h>
 #include <fs/metrics/events.h>
@@ -45,6 +46,7 @@ zx_status_t Directory::ValidateFlags(uint32_t flags) {
 
 zx_status_t Directory::Readdir(fs::vdircookie_t* cookie, void* dirents, size_t len,
                                size_t* out_actual) {
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     return blobfs_->Readdir(cookie, dirents, len, out_actual);
 }
 
@@ -75,6 +77,7 @@ zx_status_t Directory::Lookup(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name
     if ((status = digest.Parse(name.data(), name.length())) != ZX_OK) {
         return status;
     }
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     fbl::RefPtr<CacheNode> cache_node;
     if ((status = Cache().Lookup(digest, &cache_node)) != ZX_OK) {
         return status;
@@ -109,6 +112,7 @@ zx_status_t Directory::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name
         return status;
     }
 
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     fbl::RefPtr<Blob> vn = fbl::AdoptRef(new Blob(blobfs_, std::move(digest)));
     if ((status = Cache().Add(vn)) != ZX_OK) {
         return status;
@@ -126,6 +130,7 @@ zx_status_t Directory::QueryFilesystem(fuchsia_io_FilesystemInfo* info) {
     static_assert(fbl::constexpr_strlen(kFsName) + 1 < fuchsia_io_MAX_FS_NAME_BUFFER,
                   "Blobfs name too long");
 
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     memset(info, 0, sizeof(*info));
     info->block_size = kBlobfsBlockSize;
     info->max_filename_size = Digest::kLength * 2;
@@ -154,6 +159,7 @@ zx_status_t Directory::Unlink(fbl::StringPiece name, bool must_be_dir) {
     if ((status = digest.Parse(name.data(), name.length())) != ZX_OK) {
         return status;
     }
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     fbl::RefPtr<CacheNode> cache_node;
     if ((status = Cache().Lookup(digest, &cache_node)) != ZX_OK) {
         return status;
@@ -164,6 +170,7 @@ zx_status_t Directory::Unlink(fbl::StringPiece name, bool must_be_dir) {
 }
 
 void Directory::Sync(SyncCallback closure) {
+    fbl::AutoLock lock(blobfs_->VnodeLock());
     blobfs_->Sync([this, cb = std::move(closure)](zx_status_t status) {
         if (status != ZX_OK) {
             cb(status);
@@ -217,7 +224,11 @@ zx_status_t Directory::Serve(fs::Vfs* vfs, zx::channel channel, uint32_t flags)
 zx_status_t Directory::GetAllocatedRegions(fidl_txn_t* txn) const {
     zx::vmo vmo;
     zx_status_t status = ZX_OK;
-    fbl::Vector<BlockRegion> buffer = blobfs_->GetAllocatedRegions();
+    fbl::Vector<BlockRegion> buffer;
+    {
+        fbl::AutoLock lock(blobfs_->VnodeLock());
+        buffer = blobfs_->GetAllocatedRegions();
+    }
     uint64_t allocations = buffer.size();
     if (allocations != 0) {
         status = zx::vmo::create(sizeof(BlockRegion) * allocations, 0, &vmo);
@@ -25,6 +25,7 @@
 #include <lib/async/cpp/wait.h>
 #include <lib/fzl/owned-vmo-mapper.h>
 #include <lib/zx/event.h>
+#include <lib/zx/vmo.h>
 
 #include <blobfs/allocator.h>
 #include <blobfs/blob-cache.h>
@@ -221,14 +222,20 @@ private:
     // Requires: kBlobStateReadable
     zx_status_t ReadInternal(void* data, size_t len, size_t off, size_t* actual);
 
-    // Reads both VMOs into memory, if we haven't already.
+    // Prepares the blob's contents to be read, if we haven't already.
     //
-    // TODO(ZX-1481): When we have can register the Blob Store as a pager
-    // service, and it can properly handle pages faults on a vnode's contents,
-    // then we can avoid reading the entire blob up-front. Until then, read
-    // the contents of a VMO into memory when it is opened.
+    // When blobfs is serving blobs through a pager, uncompressed blobs are
+    // backed by a pager-owned VMO which is populated and verified as it is
+    // accessed. Otherwise, the blob is read in its entirety by |ReadVmos()|.
     zx_status_t InitVmos();
 
+    // Reads both VMOs into memory and verifies the blob, if we haven't already.
+    zx_status_t ReadVmos();
+
+    // Creates a pager-owned VMO for the blob, reading only its Merkle tree.
+    // Data is read and verified one Merkle tree node at a time, as it is faulted in.
+    zx_status_t InitPagedVmo();
+
     // Initializes a compressed blob by reading it from disk and decompressing it.
     // Does not verify the blob.
     zx_status_t InitCompressed(CompressionAlgorithm algorithm);
@@ -249,6 +256,12 @@ private:
     void* GetData() const;
     void* GetMerkle() const;
 
+    // Returns the VMO holding the blob, laid out as in |mapping_|.
+    // Requires: InitVmos() has succeeded.
+    const zx::vmo& Vmo() const {
+        return paged_vmo_ ? paged_vmo_ : mapping_.vmo();
+    }
+
     Blobfs* const blobfs_;
     BlobFlags flags_ = {};
     std::atomic_bool syncing_;
@@ -259,6 +272,11 @@ private:
     fzl::OwnedVmoMapper mapping_;
     vmoid_t vmoid_ = {};
 
+    // For blobs served by the pager, the VMO holding the blob, in place of
+    // |mapping_|. Only the data following the Merkle tree blocks is ever
+    // populated.
+    zx::vmo paged_vmo_;
+
     // Watches any clones of "vmo_" provided to clients.
     // Observes the ZX_VMO_ZERO_CHILDREN signal.
     async::WaitMethod<Blob, &Blob::HandleNoClones> clone_watcher_;
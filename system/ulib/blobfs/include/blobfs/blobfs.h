@@ -20,8 +20,10 @@
 #include <block-client/cpp/block-device.h>
 #include <block-client/cpp/client.h>
 #include <digest/digest.h>
+#include <digest/thread-pool.h>
 #include <fbl/algorithm.h>
 #include <fbl/macros.h>
+#include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_fd.h>
@@ -57,6 +59,7 @@
 #include <blobfs/journal.h>
 #include <blobfs/metrics.h>
 #include <blobfs/node-reserver.h>
+#include <blobfs/user-pager.h>
 #include <blobfs/writeback.h>
 
 namespace blobfs {
@@ -74,12 +77,24 @@ enum class Writability {
     Writable,
 };
 
+// The most threads which may service the connections to blobfs. Each thread
+// which touches the block device takes one of the MAX_TXN_GROUP_COUNT
+// transaction groups, and the writeback, journal and pager threads hold three.
+constexpr uint32_t kMaxDispatchThreads = 4;
+
 // Toggles that may be set on blobfs during initialization.
 struct MountOptions {
     Writability writability = Writability::Writable;
     bool metrics = false;
     bool journal = false;
+    // Serve uncompressed blobs on demand through a pager, rather than reading them
+    // entirely when first opened.
+    bool pager = false;
     CachePolicy cache_policy = CachePolicy::EvictImmediately;
+    // Number of threads of the dispatcher passed to |Mount|, at most
+    // |kMaxDispatchThreads|. Operations on blobs are serialized, but reads
+    // of blobs which are already open may proceed in parallel.
+    uint32_t dispatch_threads = 1;
 };
 
 class Blobfs : public fs::ManagedVfs, public fbl::RefCounted<Blobfs>, public TransactionManager {
@@ -186,10 +201,22 @@ public:
 
     BlobCache& Cache() { return blob_cache_; }
 
+    // Serializes the operations on the blobs and the root directory, which
+    // share the allocator, the node map and the writeback state, when
+    // connections are dispatched on several threads. Only copies out of the
+    // VMO of a readable blob are made without it.
+    fbl::Mutex* VnodeLock() { return &vnode_lock_; }
+
     zx_status_t Readdir(fs::vdircookie_t* cookie, void* dirents, size_t len, size_t* out_actual);
 
     BlockDevice* Device() const { return block_device_.get(); }
 
+    // Returns the pager serving blob contents, or nullptr if blobs are read eagerly.
+    UserPager* Pager() const { return pager_.get(); }
+
+    // Returns the threads used to create and verify the Merkle trees of large blobs.
+    digest::ThreadPool* MerklePool() { return &merkle_pool_; }
+
     // Returns an unique identifier for this instance.
     uint64_t GetFsId() const { return fs_id_; }
 
@@ -264,8 +291,11 @@ private:
     Superblock info_;
 
     BlobCache blob_cache_;
+    fbl::Mutex vnode_lock_;
 
     std::unique_ptr<BlockDevice> block_device_;
+    std::unique_ptr<UserPager> pager_;
+    digest::ThreadPool merkle_pool_;
     fuchsia_hardware_block_BlockInfo block_info_ = {};
     std::atomic<groupid_t> next_group_ = {};
 
@@ -0,0 +1,133 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <blobfs/compression/compressor.h>
+#include <fbl/array.h>
+#include <fbl/unique_ptr.h>
+#include <zircon/types.h>
+#include <zstd/zstd.h>
+
+namespace blobfs {
+
+// The chunked format splits data into fixed-size chunks, each of which is
+// compressed as an independent ZSTD frame. A table at the start of the
+// compressed data locates every frame, so any range of the data can be
+// decompressed without decompressing the frames before it.
+//
+// On-disk layout:
+//   ChunkedHeader
+//   uint64_t frame_offsets[chunk_count + 1]
+//   Frames, in chunk order.
+//
+// Frame offsets are relative to the start of the header. The final offset is
+// the end of the last frame, and therefore the size of the compressed data.
+
+constexpr uint64_t kChunkedMagic = 0x6b6e75686364627aULL;
+
+// The number of uncompressed bytes in every chunk but the last, as written by
+// ChunkedCompressor.
+constexpr uint32_t kChunkedChunkSize = 1 << 16;
+
+struct ChunkedHeader {
+    uint64_t magic;
+    uint32_t chunk_size;
+    uint32_t chunk_count;
+};
+
+static_assert(sizeof(ChunkedHeader) == 16, "Chunked header size changed");
+
+// Returns the size of the header and frame table describing |chunk_count| chunks.
+constexpr size_t ChunkedTableSize(uint32_t chunk_count) {
+    return sizeof(ChunkedHeader) + (chunk_count + 1) * sizeof(uint64_t);
+}
+
+class ChunkedCompressor : public Compressor {
+public:
+    // Returns the maximum possible size a buffer would need to be
+    // in order to compress data of size |input_length|.
+    static size_t BufferMax(size_t input_length);
+
+    // Unlike the streaming compressors, exactly |input_size| bytes must be
+    // provided before |End()|, since the size of the frame table depends on it.
+    static zx_status_t Create(size_t input_size, void* compression_buffer,
+                              size_t compression_buffer_length,
+                              fbl::unique_ptr<ChunkedCompressor>* out);
+    ~ChunkedCompressor();
+
+    ////////////////////////////////////////
+    // Compressor interface
+    size_t Size() const final;
+    zx_status_t Update(const void* input_data, size_t input_length) final;
+    zx_status_t End() final;
+
+private:
+    ChunkedCompressor(ZSTD_CCtx* ctx, size_t input_size, uint32_t chunk_count,
+                      void* compression_buffer, size_t compression_buffer_length);
+
+    // Compresses |length| bytes at |data| as the next frame.
+    zx_status_t CompressChunk(const void* data, size_t length);
+
+    uint64_t* FrameOffsets() const;
+
+    ZSTD_CCtx* ctx_ = nullptr;
+    const size_t input_size_;
+    const uint32_t chunk_count_;
+    uint32_t chunks_written_ = 0;
+
+    uint8_t* buf_ = nullptr;
+    size_t buf_max_ = 0;
+    size_t buf_used_ = 0;
+
+    // Input which has not yet filled a whole chunk.
+    fbl::unique_ptr<uint8_t[]> pending_;
+    size_t pending_length_ = 0;
+};
+
+// A validated copy of the frame table of chunk-compressed data.
+class ChunkTable {
+public:
+    // Validates the header at the start of |data|, which must be at least
+    // |sizeof(ChunkedHeader)| bytes, against the uncompressed |data_size|.
+    // On success, returns the number of bytes which must be passed to |Create|.
+    static zx_status_t TableSize(const void* data, size_t length, uint64_t data_size,
+                                 size_t* out_table_size);
+
+    // Parses the header and frame table at the start of |data|, holding
+    // |length| bytes, which describe compressed data of no more than
+    // |compressed_size| bytes decompressing to |data_size| bytes.
+    static zx_status_t Create(const void* data, size_t length, size_t compressed_size,
+                              uint64_t data_size, ChunkTable* out);
+
+    uint32_t chunk_size() const { return chunk_size_; }
+    uint32_t chunk_count() const { return chunk_count_; }
+
+    // Returns the uncompressed size of chunk |index|.
+    size_t ChunkLength(uint32_t index) const;
+
+    // Returns the range of the compressed data holding the frame of chunk |index|.
+    uint64_t FrameStart(uint32_t index) const { return frame_offsets_[index]; }
+    uint64_t FrameEnd(uint32_t index) const { return frame_offsets_[index + 1]; }
+
+private:
+    uint64_t data_size_ = 0;
+    uint32_t chunk_size_ = 0;
+    uint32_t chunk_count_ = 0;
+    fbl::Array<uint64_t> frame_offsets_;
+};
+
+// Decompresses the frame of chunk |index| at |frame| into |target_buf|, which
+// must hold |table.ChunkLength(index)| bytes.
+zx_status_t ChunkedDecompressChunk(const ChunkTable& table, uint32_t index, const void* frame,
+                                   void* target_buf);
+
+// Decompress the source buffer into the target buffer. |*target_size| must be
+// the exact uncompressed size of the data.
+zx_status_t ChunkedDecompress(void* target_buf, size_t* target_size, const void* src_buf,
+                              size_t* src_size);
+
+} // namespace blobfs
@@ -28,7 +28,7 @@
 namespace blobfs {
 constexpr uint64_t kBlobfsMagic0  = (0xac2153479e694d21ULL);
 constexpr uint64_t kBlobfsMagic1  = (0x985000d4d4d3d314ULL);
-constexpr uint32_t kBlobfsVersion = 0x00000007;
+constexpr uint32_t kBlobfsVersion = 0x00000008;
 
 constexpr uint32_t kBlobFlagClean        = 1;
 constexpr uint32_t kBlobFlagDirty        = 2;
@@ -281,6 +281,11 @@ constexpr uint16_t kBlobFlagExtentContainer = 1 << 2;
 // Identifies that the on-disk storage of the blob is ZSTD compressed.
 constexpr uint16_t kBlobFlagZSTDCompressed = 1 << 3;
 
+// Identifies that the on-disk storage of the blob is ZSTD compressed in
+// independently decompressible chunks, as described in
+// <blobfs/compression/chunked.h>.
+constexpr uint16_t kBlobFlagChunkCompressed = 1 << 4;
+
 // The number of extents within a normal inode.
 constexpr uint32_t kInlineMaxExtents = 1;
 // The number of extents within an extent container node.
@@ -17,6 +17,7 @@
 #include <bitmap/raw-bitmap.h>
 #include <bitmap/storage.h>
 #include <digest/digest.h>
+#include <digest/thread-pool.h>
 #include <fbl/algorithm.h>
 #include <fbl/macros.h>
 #include <fbl/ref_counted.h>
@@ -264,8 +265,10 @@ zx_status_t blobfs_create(fbl::unique_ptr<Blobfs>* out, fbl::unique_fd blockfd);
 
 // Pre-process a blob by creating a merkle tree and digest from the supplied file.
 // Also return the length of the file. If |compress| is true and we decide to compress the file,
-// the compressed length and data are returned.
-zx_status_t blobfs_preprocess(int data_fd, bool compress, MerkleInfo* out_info);
+// the compressed length and data are returned.  If |merkle_pool| is not null, the merkle tree is
+// created on its threads.
+zx_status_t blobfs_preprocess(int data_fd, bool compress, MerkleInfo* out_info,
+                              digest::ThreadPool* merkle_pool = nullptr);
 
 // blobfs_add_blob may be called by multiple threads to gain concurrent
 // merkle tree generation. No other methods are thread safe.
@@ -11,6 +11,7 @@
 #endif
 
 #include <cobalt-client/cpp/collector.h>
+#include <fs/dentry-cache.h>
 #include <fs/metrics/cobalt-metrics.h>
 #include <fs/metrics/composite-latency-event.h>
 #include <fs/metrics/events.h>
@@ -20,6 +21,8 @@
 #include <lib/inspect-vmo/types.h>
 #include <lib/zx/time.h>
 
+#include <atomic>
+
 namespace blobfs {
 
 // Alias for the LatencyEvent used in blobfs.
@@ -69,6 +72,17 @@ public:
     // since mounting.
     void UpdateMerkleVerify(uint64_t size_data, uint64_t size_merkle, const fs::Duration& duration);
 
+    // Updates aggregate information about pages of blobs read and verified
+    // on demand since mounting.
+    //
+    // Unlike the other updates, this is invoked from the pager thread.
+    void UpdatePageIn(uint64_t size, const fs::Duration& read_duration,
+                      const fs::Duration& verify_duration);
+
+    // Updates the path lookup cache counters to |stats|, the running totals
+    // of the Vfs.
+    void UpdateDentryCache(const fs::DentryCacheStats& stats);
+
     // Returns a new Latency event for the given event. This requires the event to be backed up by
     // an histogram in both cobalt metrics and Inspect.
     LatencyEvent NewLatencyEvent(fs_metrics::Event event) {
@@ -122,6 +136,19 @@ private:
     uint64_t blobs_verified_total_size_merkle_ = 0;
     zx::ticks total_verification_time_ticks_ = {};
 
+    // PAGING STATS
+
+    // Updated concurrently with all other stats, by the pager thread.
+    std::atomic<uint64_t> page_ins_ = 0;
+    std::atomic<uint64_t> bytes_paged_in_ = 0;
+    std::atomic<zx_ticks_t> total_page_in_read_time_ticks_ = 0;
+    std::atomic<zx_ticks_t> total_page_in_verify_time_ticks_ = 0;
+
+    // PATH LOOKUP STATS
+
+    // The totals last reported to cobalt.
+    fs::DentryCacheStats dentry_cache_stats_;
+
     // FVM STATS
     // TODO(smklein)
 
@@ -0,0 +1,98 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#ifndef __Fuchsia__
+#error Fuchsia-only Header
+#endif
+
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_counted.h>
+#include <fbl/ref_ptr.h>
+#include <fs/locking.h>
+#include <lib/zx/pager.h>
+#include <lib/zx/port.h>
+#include <lib/zx/vmo.h>
+#include <zircon/types.h>
+
+#include <memory>
+#include <thread>
+
+namespace blobfs {
+
+class UserPager;
+
+// The backing store of a single pager-owned VMO.
+//
+// Page sources are only invoked from the pager thread, so requests for a single
+// VMO are never serviced concurrently.
+class PageSource : public fbl::RefCounted<PageSource>,
+                   public fbl::DoublyLinkedListable<fbl::RefPtr<PageSource>> {
+public:
+    virtual ~PageSource() = default;
+
+    // Supplies at least the range [offset, offset + length) of |vmo|, which has been
+    // faulted on by some client, by invoking |UserPager::SupplyPages|.
+    //
+    // Returning an error causes |vmo| to be detached from the pager, failing the
+    // outstanding and all future accesses to unsupplied pages.
+    virtual zx_status_t PopulateRange(UserPager* pager, const zx::vmo& vmo, uint64_t offset,
+                                      uint64_t length) = 0;
+
+private:
+    friend class UserPager;
+
+    // A handle to the VMO this source backs, used to supply pages and detach.
+    zx::vmo vmo_;
+};
+
+// Owns a kernel pager object, and a thread which services page requests for
+// all VMOs created through it.
+//
+// This class is thread-safe.
+class UserPager {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(UserPager);
+
+    static zx_status_t Create(std::unique_ptr<UserPager>* out);
+
+    // Stops the pager thread, and detaches all VMOs which are still attached.
+    ~UserPager();
+
+    // Creates a VMO of |size| bytes, the contents of which are populated
+    // on-demand by |source|.
+    //
+    // The pager keeps a reference to |source| until the VMO is detached. The
+    // VMO must be explicitly detached with |DetachVmo| before it is released.
+    zx_status_t CreateVmo(fbl::RefPtr<PageSource> source, uint64_t size, zx::vmo* out);
+
+    // Detaches a VMO created by |CreateVmo|. Accesses to pages which were never
+    // supplied fail after this point.
+    zx_status_t DetachVmo(const zx::vmo& vmo);
+
+    // Moves the pages in [aux_offset, aux_offset + length) of |aux_vmo| into
+    // [offset, offset + length) of the pager-owned |vmo|.
+    zx_status_t SupplyPages(const zx::vmo& vmo, uint64_t offset, uint64_t length,
+                            const zx::vmo& aux_vmo, uint64_t aux_offset);
+
+private:
+    UserPager() = default;
+
+    // Services page requests until the terminate packet is received.
+    void Run();
+
+    zx::pager pager_;
+    zx::port port_;
+    std::thread thrd_;
+
+    // Sources of all VMOs which have not yet been reported complete by the kernel.
+    // Each source's address is the key of its VMO's page requests.
+    fbl::Mutex lock_;
+    fbl::DoublyLinkedList<fbl::RefPtr<PageSource>> sources_ FS_TA_GUARDED(lock_);
+};
+
+} // namespace blobfs
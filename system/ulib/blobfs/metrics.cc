@@ -52,6 +52,17 @@ void BlobfsMetrics::Dump() const {
     FS_TRACE_INFO("  Spent %zu ms reading %zu MB from disk, %zu ms verifying\n",
                   TicksToMs(total_read_from_disk_time_ticks_), bytes_read_from_disk_ / mb,
                   TicksToMs(total_verification_time_ticks_));
+    FS_TRACE_INFO("Paging Info:\n");
+    FS_TRACE_INFO("  Paged in %zu MB in %zu requests\n", bytes_paged_in_.load() / mb,
+                  page_ins_.load());
+    FS_TRACE_INFO("  Spent %zu ms reading from disk, %zu ms verifying\n",
+                  TicksToMs(zx::ticks(total_page_in_read_time_ticks_.load())),
+                  TicksToMs(zx::ticks(total_page_in_verify_time_ticks_.load())));
+    const fs::DentryCacheStats& dentries = dentry_cache_stats_;
+    const uint64_t dentry_lookups = dentries.hits + dentries.negative_hits + dentries.misses;
+    FS_TRACE_INFO("Path Lookup Info:\n");
+    FS_TRACE_INFO("  Served %zu of %zu lookups from the cache (%zu not found)\n",
+                  dentries.hits + dentries.negative_hits, dentry_lookups, dentries.negative_hits);
 }
 
 void BlobfsMetrics::UpdateAllocation(uint64_t size_data, const fs::Duration& duration) {
@@ -115,4 +126,25 @@ void BlobfsMetrics::UpdateMerkleVerify(uint64_t size_data, uint64_t size_merkle,
     }
 }
 
+void BlobfsMetrics::UpdateDentryCache(const fs::DentryCacheStats& stats) {
+    if (Collecting()) {
+        fs_metrics::DentryCacheMetrics* counters = cobalt_metrics_.mutable_dentry_cache_metrics();
+        counters->hits.Increment(stats.hits - dentry_cache_stats_.hits);
+        counters->negative_hits.Increment(stats.negative_hits - dentry_cache_stats_.negative_hits);
+        counters->misses.Increment(stats.misses - dentry_cache_stats_.misses);
+        dentry_cache_stats_ = stats;
+    }
+}
+
+void BlobfsMetrics::UpdatePageIn(uint64_t size, const fs::Duration& read_duration,
+                                 const fs::Duration& verify_duration) {
+    if (Collecting()) {
+        page_ins_.fetch_add(1, std::memory_order_relaxed);
+        bytes_paged_in_.fetch_add(size, std::memory_order_relaxed);
+        total_page_in_read_time_ticks_.fetch_add(read_duration.get(), std::memory_order_relaxed);
+        total_page_in_verify_time_ticks_.fetch_add(verify_duration.get(),
+                                                   std::memory_order_relaxed);
+    }
+}
+
 } // namespace blobfs
@@ -33,6 +33,9 @@ zx_status_t Mount(async_dispatcher_t* dispatcher, std::unique_ptr<BlockDevice> d
 
     fs->SetDispatcher(dispatcher);
     fs->SetUnmountCallback(std::move(on_unmount));
+    if (options->dispatch_threads > 1) {
+        fs->EnableConcurrentDispatch();
+    }
 
     fbl::RefPtr<Directory> vn;
     if ((status = fs->OpenRootNode(&vn)) != ZX_OK) {
@@ -8,6 +8,7 @@
 #include <memory>
 
 #include <blobfs/compression/blob-compressor.h>
+#include <blobfs/compression/chunked.h>
 #include <blobfs/compression/compressor.h>
 #include <blobfs/compression/lz4.h>
 #include <blobfs/compression/zstd.h>
@@ -77,6 +78,9 @@ void DecompressionHelper(CompressionAlgorithm algorithm,
     case CompressionAlgorithm::ZSTD:
         ASSERT_EQ(ZX_OK, ZSTDDecompress(output.get(), &target_size, compressed, &src_size));
         break;
+    case CompressionAlgorithm::CHUNKED:
+        ASSERT_EQ(ZX_OK, ChunkedDecompress(output.get(), &target_size, compressed, &src_size));
+        break;
     default:
         ASSERT_TRUE(false, "Bad algorithm");
     }
@@ -170,6 +174,72 @@ TEST(CompressorTests, CompressDecompressZSTDCompressible4) {
     RunCompressDecompressTest(CompressionAlgorithm::ZSTD, DataType::Random, 1 << 15, 1 << 10);
 }
 
+TEST(CompressorTests, CompressDecompressChunkedRandom1) {
+    RunCompressDecompressTest(CompressionAlgorithm::CHUNKED, DataType::Random, 1 << 0, 1 << 0);
+}
+
+TEST(CompressorTests, CompressDecompressChunkedRandom2) {
+    RunCompressDecompressTest(CompressionAlgorithm::CHUNKED, DataType::Random, 1 << 15, 1 << 10);
+}
+
+TEST(CompressorTests, CompressDecompressChunkedRandom3) {
+    RunCompressDecompressTest(CompressionAlgorithm::CHUNKED, DataType::Random, (1 << 18) + 7,
+                              1 << 10);
+}
+
+TEST(CompressorTests, CompressDecompressChunkedRandom4) {
+    RunCompressDecompressTest(CompressionAlgorithm::CHUNKED, DataType::Random, (1 << 18) + 7,
+                              1 << 17);
+}
+
+TEST(CompressorTests, CompressDecompressChunkedCompressible1) {
+    RunCompressDecompressTest(CompressionAlgorithm::CHUNKED, DataType::Compressible, 1 << 15,
+                              1 << 10);
+}
+
+TEST(CompressorTests, CompressDecompressChunkedCompressible2) {
+    RunCompressDecompressTest(CompressionAlgorithm::CHUNKED, DataType::Compressible,
+                              (1 << 18) + 7, 1 << 17);
+}
+
+TEST(CompressorTests, ChunkedRejectsExtraInput) {
+    const size_t input_size = 1024;
+    auto compressor = BlobCompressor::Create(CompressionAlgorithm::CHUNKED, input_size);
+    ASSERT_TRUE(compressor);
+
+    std::unique_ptr<char[]> input(new char[input_size + 1]);
+    memset(input.get(), 'a', input_size + 1);
+    EXPECT_NE(ZX_OK, compressor->Update(input.get(), input_size + 1));
+}
+
+TEST(CompressorTests, ChunkedDecompressSingleChunks) {
+    const size_t size = 3 * kChunkedChunkSize + 100;
+    std::unique_ptr<char[]> input(GenerateInput(DataType::Compressible, 0, size));
+    std::optional<BlobCompressor> compressor;
+    ASSERT_NO_FAILURES(CompressionHelper(CompressionAlgorithm::CHUNKED, input.get(), size,
+                                         size, &compressor));
+
+    ChunkTable table;
+    ASSERT_EQ(ZX_OK, ChunkTable::Create(compressor->Data(), compressor->Size(),
+                                        compressor->Size(), size, &table));
+    ASSERT_EQ(4u, table.chunk_count());
+    EXPECT_EQ(100u, table.ChunkLength(3));
+
+    // Each chunk decompresses on its own, in any order.
+    const auto compressed = static_cast<const uint8_t*>(compressor->Data());
+    std::unique_ptr<char[]> output(new char[kChunkedChunkSize]);
+    for (uint32_t i : {2u, 0u, 3u, 1u}) {
+        ASSERT_EQ(ZX_OK, ChunkedDecompressChunk(table, i, compressed + table.FrameStart(i),
+                                                output.get()));
+        EXPECT_EQ(0, memcmp(input.get() + i * kChunkedChunkSize, output.get(),
+                            table.ChunkLength(i)));
+    }
+
+    // A table describing a different amount of data is rejected.
+    EXPECT_NE(ZX_OK, ChunkTable::Create(compressor->Data(), compressor->Size(),
+                                        compressor->Size(), size + kChunkedChunkSize, &table));
+}
+
 void RunUpdateNoDataTest(CompressionAlgorithm algorithm) {
     const size_t input_size = 1024;
     auto compressor = BlobCompressor::Create(algorithm, input_size);
@@ -197,6 +267,10 @@ TEST(CompressorTests, UpdateNoDataZSTD) {
     RunUpdateNoDataTest(CompressionAlgorithm::ZSTD);
 }
 
+TEST(CompressorTests, UpdateNoDataChunked) {
+    RunUpdateNoDataTest(CompressionAlgorithm::CHUNKED);
+}
+
 // TODO(smklein): Add a test of:
 // - Compress
 // - Round up compressed size to block
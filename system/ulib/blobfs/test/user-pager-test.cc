@@ -0,0 +1,136 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <blobfs/user-pager.h>
+
+#include <fbl/ref_ptr.h>
+#include <lib/sync/completion.h>
+#include <lib/zx/vmo.h>
+#include <zircon/assert.h>
+
+#include <atomic>
+#include <memory>
+
+#include <zxtest/zxtest.h>
+
+namespace blobfs {
+namespace {
+
+constexpr uint64_t kVmoSize = 16 * ZX_PAGE_SIZE;
+
+uint8_t PatternAt(uint64_t offset) {
+    return static_cast<uint8_t>(offset + offset / ZX_PAGE_SIZE);
+}
+
+// Supplies exactly the requested range with a known pattern.
+class PatternSource : public PageSource {
+public:
+    explicit PatternSource(sync_completion_t* released = nullptr) : released_(released) {}
+
+    ~PatternSource() {
+        if (released_ != nullptr) {
+            sync_completion_signal(released_);
+        }
+    }
+
+    zx_status_t PopulateRange(UserPager* pager, const zx::vmo& vmo, uint64_t offset,
+                              uint64_t length) final {
+        requests_++;
+        if (fail_) {
+            return ZX_ERR_IO;
+        }
+        zx::vmo aux;
+        zx_status_t status = zx::vmo::create(length, 0, &aux);
+        if (status != ZX_OK) {
+            return status;
+        }
+        std::unique_ptr<uint8_t[]> buffer(new uint8_t[length]);
+        for (uint64_t i = 0; i < length; i++) {
+            buffer[i] = PatternAt(offset + i);
+        }
+        if ((status = aux.write(buffer.get(), 0, length)) != ZX_OK) {
+            return status;
+        }
+        return pager->SupplyPages(vmo, offset, length, aux, 0);
+    }
+
+    uint32_t requests() const { return requests_.load(); }
+    void set_fail(bool fail) { fail_ = fail; }
+
+private:
+    sync_completion_t* released_;
+    std::atomic<uint32_t> requests_ = 0;
+    std::atomic<bool> fail_ = false;
+};
+
+TEST(UserPagerTest, Creation) {
+    std::unique_ptr<UserPager> pager;
+    ASSERT_OK(UserPager::Create(&pager));
+}
+
+TEST(UserPagerTest, ReadSuppliesOnlyFaultedPages) {
+    std::unique_ptr<UserPager> pager;
+    ASSERT_OK(UserPager::Create(&pager));
+    auto source = fbl::MakeRefCounted<PatternSource>();
+    zx::vmo vmo;
+    ASSERT_OK(pager->CreateVmo(fbl::WrapRefPtr<PageSource>(source.get()), kVmoSize, &vmo));
+
+    uint8_t page[ZX_PAGE_SIZE];
+    const uint64_t offset = 3 * ZX_PAGE_SIZE;
+    ASSERT_OK(vmo.read(page, offset, sizeof(page)));
+    for (uint64_t i = 0; i < sizeof(page); i++) {
+        ASSERT_EQ(PatternAt(offset + i), page[i]);
+    }
+    EXPECT_EQ(1u, source->requests());
+
+    // Supplied pages are not requested again.
+    ASSERT_OK(vmo.read(page, offset, sizeof(page)));
+    EXPECT_EQ(1u, source->requests());
+
+    ASSERT_OK(pager->DetachVmo(vmo));
+}
+
+TEST(UserPagerTest, FailedPopulateFailsAccess) {
+    std::unique_ptr<UserPager> pager;
+    ASSERT_OK(UserPager::Create(&pager));
+    auto source = fbl::MakeRefCounted<PatternSource>();
+    source->set_fail(true);
+    zx::vmo vmo;
+    ASSERT_OK(pager->CreateVmo(fbl::WrapRefPtr<PageSource>(source.get()), kVmoSize, &vmo));
+
+    uint8_t page[ZX_PAGE_SIZE];
+    EXPECT_NOT_OK(vmo.read(page, 0, sizeof(page)));
+}
+
+TEST(UserPagerTest, DetachReleasesSource) {
+    std::unique_ptr<UserPager> pager;
+    ASSERT_OK(UserPager::Create(&pager));
+    sync_completion_t released;
+    zx::vmo vmo;
+    ASSERT_OK(pager->CreateVmo(fbl::MakeRefCounted<PatternSource>(&released), kVmoSize, &vmo));
+
+    ASSERT_OK(pager->DetachVmo(vmo));
+    ASSERT_OK(sync_completion_wait(&released, ZX_TIME_INFINITE));
+
+    uint8_t page[ZX_PAGE_SIZE];
+    EXPECT_NOT_OK(vmo.read(page, 0, sizeof(page)));
+}
+
+TEST(UserPagerTest, DestructorReleasesAttachedSources) {
+    sync_completion_t released;
+    zx::vmo vmo;
+    {
+        std::unique_ptr<UserPager> pager;
+        ASSERT_OK(UserPager::Create(&pager));
+        ASSERT_OK(pager->CreateVmo(fbl::MakeRefCounted<PatternSource>(&released), kVmoSize,
+                                   &vmo));
+    }
+    EXPECT_TRUE(sync_completion_signaled(&released));
+
+    uint8_t page[ZX_PAGE_SIZE];
+    EXPECT_NOT_OK(vmo.read(page, 0, sizeof(page)));
+}
+
+} // namespace
+} // namespace blobfs
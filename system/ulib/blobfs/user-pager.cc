@@ -0,0 +1,136 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <blobfs/user-pager.h>
+
+#include <fbl/auto_lock.h>
+#include <fs/trace.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls/port.h>
+
+#include <utility>
+
+namespace blobfs {
+
+zx_status_t UserPager::Create(std::unique_ptr<UserPager>* out) {
+    std::unique_ptr<UserPager> pager(new UserPager());
+    zx_status_t status = zx::pager::create(0, &pager->pager_);
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("blobfs: Cannot create pager: %d\n", status);
+        return status;
+    }
+    if ((status = zx::port::create(0, &pager->port_)) != ZX_OK) {
+        FS_TRACE_ERROR("blobfs: Cannot create pager port: %d\n", status);
+        return status;
+    }
+    pager->thrd_ = std::thread([p = pager.get()] { p->Run(); });
+    *out = std::move(pager);
+    return ZX_OK;
+}
+
+UserPager::~UserPager() {
+    if (thrd_.joinable()) {
+        zx_port_packet_t packet = {};
+        packet.type = ZX_PKT_TYPE_USER;
+        ZX_ASSERT(port_.queue(&packet) == ZX_OK);
+        thrd_.join();
+    }
+
+    // Any VMOs which are still attached are detached, so that accesses to them
+    // fail rather than wait on a thread which no longer exists.
+    fbl::DoublyLinkedList<fbl::RefPtr<PageSource>> sources;
+    {
+        fbl::AutoLock lock(&lock_);
+        sources = std::move(sources_);
+    }
+    while (!sources.is_empty()) {
+        fbl::RefPtr<PageSource> source = sources.pop_front();
+        pager_.detach_vmo(source->vmo_);
+    }
+}
+
+zx_status_t UserPager::CreateVmo(fbl::RefPtr<PageSource> source, uint64_t size, zx::vmo* out) {
+    PageSource* key = source.get();
+    {
+        // The source must be tracked before the VMO exists, since the kernel may
+        // report the VMO complete as soon as it is detached.
+        fbl::AutoLock lock(&lock_);
+        sources_.push_back(std::move(source));
+    }
+
+    zx::vmo vmo;
+    zx_status_t status = pager_.create_vmo(0, port_, reinterpret_cast<uintptr_t>(key), size,
+                                           &vmo);
+    if (status != ZX_OK) {
+        fbl::RefPtr<PageSource> released;
+        {
+            fbl::AutoLock lock(&lock_);
+            released = sources_.erase(*key);
+        }
+        return status;
+    }
+    if ((status = vmo.duplicate(ZX_RIGHT_SAME_RIGHTS, &key->vmo_)) != ZX_OK) {
+        // The source is released once the kernel reports the detached VMO complete.
+        pager_.detach_vmo(vmo);
+        return status;
+    }
+
+    *out = std::move(vmo);
+    return ZX_OK;
+}
+
+zx_status_t UserPager::DetachVmo(const zx::vmo& vmo) {
+    return pager_.detach_vmo(vmo);
+}
+
+zx_status_t UserPager::SupplyPages(const zx::vmo& vmo, uint64_t offset, uint64_t length,
+                                   const zx::vmo& aux_vmo, uint64_t aux_offset) {
+    return pager_.supply_pages(vmo, offset, length, aux_vmo, aux_offset);
+}
+
+void UserPager::Run() {
+    for (;;) {
+        zx_port_packet_t packet;
+        zx_status_t status = port_.wait(zx::time::infinite(), &packet);
+        if (status != ZX_OK) {
+            FS_TRACE_ERROR("blobfs: Pager port wait failed: %d\n", status);
+            return;
+        }
+        if (packet.type == ZX_PKT_TYPE_USER) {
+            return;
+        }
+        if (packet.type != ZX_PKT_TYPE_PAGE_REQUEST) {
+            continue;
+        }
+
+        // The source remains in |sources_| until its VMO's completion is handled
+        // below, on this thread.
+        auto source = reinterpret_cast<PageSource*>(packet.key);
+        switch (packet.page_request.command) {
+        case ZX_PAGER_VMO_READ:
+            status = source->PopulateRange(this, source->vmo_, packet.page_request.offset,
+                                           packet.page_request.length);
+            if (status != ZX_OK) {
+                FS_TRACE_ERROR("blobfs: Failed to populate [%lu, %lu): %d\n",
+                               packet.page_request.offset,
+                               packet.page_request.offset + packet.page_request.length, status);
+                pager_.detach_vmo(source->vmo_);
+            }
+            break;
+        case ZX_PAGER_VMO_COMPLETE: {
+            fbl::RefPtr<PageSource> released;
+            {
+                fbl::AutoLock lock(&lock_);
+                released = sources_.erase(*source);
+            }
+            break;
+        }
+        default:
+            FS_TRACE_ERROR("blobfs: Unknown page request: %u\n", packet.page_request.command);
+            break;
+        }
+    }
+}
+
+} // namespace blobfs
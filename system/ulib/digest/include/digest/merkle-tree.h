@@ -20,6 +20,8 @@
 
 namespace digest {
 
+class ThreadPool;
+
 // digest::MerkleTree represents a hash tree that can be used to independently
 // verify subsets of a set data associated with a trusted digest.
 //
@@ -40,6 +42,10 @@ namespace digest {
 // If |s| is NO_ERROR, the |data| between |offset| and |offset + length| is the
 // same as when "Create" was called. If it is ERR_IO_DATA_INTEGRITY, either the
 // data, tree, or root digest have been altered.
+//
+// Both methods have variants taking a digest::ThreadPool, which hash the nodes
+// of each level of the tree in parallel.  These produce the same results and
+// are much faster for large data.
 class MerkleTree final {
 public:
     // This sets the size that the tree uses to chunk up the data and digests.
@@ -58,6 +64,11 @@ public:
     static zx_status_t Create(const void* data, size_t data_len, void* tree,
                               size_t tree_len, Digest* digest);
 
+    // Same as above, but hashes the nodes of each level on the threads of
+    // |pool|, if not null.
+    static zx_status_t Create(const void* data, size_t data_len, void* tree,
+                              size_t tree_len, Digest* digest, ThreadPool* pool);
+
     // Checks the integrity of a the region of data given by the offset and
     // length.  It checks integrity using the given Merkle tree and trusted root
     // digest. |tree_len| must be at least as much as returned by
@@ -67,6 +78,13 @@ public:
                               const void* tree, size_t tree_len, size_t offset,
                               size_t length, const Digest& digest);
 
+    // Same as above, but checks the nodes of each level on the threads of
+    // |pool|, if not null.
+    static zx_status_t Verify(const void* data, size_t data_len,
+                              const void* tree, size_t tree_len, size_t offset,
+                              size_t length, const Digest& digest,
+                              ThreadPool* pool);
+
     // The stateful instance methods below are only needed when creating a
     // Merkle tree using the Init/Update/Final methods.
     MerkleTree();
@@ -102,10 +120,12 @@ private:
     // offset and length.  It checks integrity using next level up of the given
     // Merkle tree. |tree_len| must be at least as much as returned by
     // |GetTreeLength(data_len)|.  |offset| and |length| must describe a range
-    // wholly within |data_len|.
+    // wholly within |data_len|.  Nodes are checked on the threads of |pool|,
+    // if not null.
     static zx_status_t VerifyLevel(const void* data, size_t data_len,
                                    const void* tree, size_t offset,
-                                   size_t length, uint64_t level);
+                                   size_t length, uint64_t level,
+                                   ThreadPool* pool);
 
     // See CreateFinal.  This implements that method, with an extra parameter to
     // allow levels other than the bottommost to be padded.
@@ -0,0 +1,77 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fbl/macros.h>
+
+namespace digest {
+
+// digest::ThreadPool runs batches of independent tasks on a set of worker
+// threads.  It is used to hash the nodes of a Merkle tree in parallel, e.g.:
+//      digest::ThreadPool pool;
+//      digest::MerkleTree::Create(data, data_len, tree, tree_len, &digest, &pool);
+//
+// A pool may be shared by any number of threads, each running its own batch.
+class ThreadPool final {
+public:
+    // Creates a pool with one worker thread fewer than there are CPUs, since
+    // the thread running a batch also runs its tasks.
+    ThreadPool();
+
+    // Creates a pool with |num_threads| worker threads.  With no worker
+    // threads, batches run entirely on the calling thread.
+    explicit ThreadPool(size_t num_threads);
+
+    // Stops and joins the worker threads.  No batches may be running.
+    ~ThreadPool();
+
+    size_t num_threads() const { return threads_.size(); }
+
+    // Calls |task(i)| for each |i| in [0, |count|), on the worker threads and
+    // the calling thread, in no particular order.  Returns once every call has
+    // returned.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ThreadPool);
+
+    struct Batch {
+        size_t count;
+        const std::function<void(size_t)>* task;
+        // The next task to start.
+        size_t next;
+        // The number of tasks that have returned.
+        size_t finished;
+    };
+
+    void WorkerThread();
+
+    // Starts the next task of |batch| and waits for it to return.  Must be
+    // called with |lock_| held, and with tasks left to start.  Removes |batch|
+    // from |batches_| when starting its last task.
+    void RunNextTask(Batch* batch, std::unique_lock<std::mutex>* lock);
+
+    std::vector<std::thread> threads_;
+
+    std::mutex lock_;
+    // Signaled when a batch is added or the pool is shutting down.
+    std::condition_variable work_available_;
+    // Signaled when the last task of a batch returns.
+    std::condition_variable batch_finished_;
+    // Batches with tasks that have not started yet.
+    std::deque<Batch*> batches_;
+    bool shutdown_ = false;
+};
+
+} // namespace digest
@@ -7,13 +7,18 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <atomic>
+
 #include <digest/digest.h>
+#include <digest/thread-pool.h>
 #include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/unique_ptr.h>
 #include <zircon/assert.h>
 #include <zircon/errors.h>
 
+#include "sha256-multi.h"
+
 namespace digest {
 
 // Size of a node in bytes.  Defined in tree.h.
@@ -75,6 +80,19 @@ void DigestFinal(Digest* digest, size_t offset) {
     digest->Final();
 }
 
+// Hashes the node at |offset| in a level of the tree holding |data_len| bytes
+// of |data| at the given |level|.
+zx_status_t HashNode(Digest* digest, const uint8_t* data, size_t data_len, size_t offset,
+                     uint64_t level) {
+    zx_status_t rc;
+    if ((rc = DigestInit(digest, offset | level, data_len - offset)) != ZX_OK) {
+        return rc;
+    }
+    size_t chunk = DigestUpdate(digest, data + offset, offset, data_len - offset);
+    DigestFinal(digest, offset + chunk);
+    return ZX_OK;
+}
+
 ////////
 // Helper functions for working between levels of the tree.
 
@@ -94,6 +112,117 @@ size_t NextAligned(size_t length) {
     return fbl::round_up(NextLength(length), MerkleTree::kNodeSize);
 }
 
+////////
+// Helper functions for hashing the nodes of a level, several at a time and in
+// parallel.
+
+// The number of nodes hashed by each task given to a thread pool.  Tasks need
+// to be large enough that the cost of handing them out is negligible.
+const size_t kNodesPerTask = 16;
+
+// The length of the locality and length hashed ahead of a node's data.
+const size_t kNodePrefixLength = sizeof(uint64_t) + sizeof(uint32_t);
+
+// Hashes |count| full nodes of a level starting at the node-aligned |offset|
+// in a single call to |Sha256Multi|, and writes their digests one after the
+// other to |out|.
+void HashFullNodes(const uint8_t* data, size_t offset, size_t count, uint64_t level,
+                   uint8_t* out) {
+    ZX_DEBUG_ASSERT(count <= internal::kSha256MaxMessages);
+    uint8_t prefixes[internal::kSha256MaxMessages][kNodePrefixLength];
+    const uint8_t* prefix_ptrs[internal::kSha256MaxMessages];
+    const uint8_t* nodes[internal::kSha256MaxMessages];
+    uint32_t len32 = static_cast<uint32_t>(MerkleTree::kNodeSize);
+    for (size_t i = 0; i < count; ++i, offset += MerkleTree::kNodeSize) {
+        uint64_t locality = offset | level;
+        memcpy(prefixes[i], &locality, sizeof(locality));
+        memcpy(prefixes[i] + sizeof(locality), &len32, sizeof(len32));
+        prefix_ptrs[i] = prefixes[i];
+        nodes[i] = data + offset;
+    }
+    internal::Sha256Multi(prefix_ptrs, kNodePrefixLength, nodes, MerkleTree::kNodeSize, count,
+                          out);
+}
+
+// Hashes up to |kSha256MaxMessages| nodes of a level from the node-aligned
+// |offset| up to |finish|, and writes their digests one after the other to
+// |out|.  Full nodes are hashed together; a partial node is only ever the last
+// one in the level and is hashed on its own.  Sets |out_count| to the number
+// of nodes hashed.
+zx_status_t HashNodeBatch(const uint8_t* data, size_t data_len, size_t offset, size_t finish,
+                          uint64_t level, uint8_t* out, size_t* out_count) {
+    size_t count = fbl::min((finish - offset) / MerkleTree::kNodeSize,
+                            internal::kSha256MaxMessages);
+    if (count != 0) {
+        HashFullNodes(data, offset, count, level, out);
+        *out_count = count;
+        return ZX_OK;
+    }
+    zx_status_t rc;
+    Digest digest;
+    if ((rc = HashNode(&digest, data, data_len, offset, level)) != ZX_OK) {
+        return rc;
+    }
+    *out_count = 1;
+    return digest.CopyTo(out, Digest::kLength);
+}
+
+// Hashes the nodes of a level from the node-aligned |offset| up to |finish|,
+// and writes their digests to |digests| in the next level up.
+zx_status_t HashNodes(const uint8_t* data, size_t data_len, uint8_t* digests, size_t offset,
+                      size_t finish, uint64_t level) {
+    zx_status_t rc;
+    size_t count;
+    for (; offset < finish; offset += count * MerkleTree::kNodeSize) {
+        if ((rc = HashNodeBatch(data, data_len, offset, finish, level,
+                                digests + (offset / kDigestsPerNode), &count)) != ZX_OK) {
+            return rc;
+        }
+    }
+    return ZX_OK;
+}
+
+// Checks the nodes of a level from the node-aligned |offset| up to |finish|
+// against their |digests| in the next level up.
+zx_status_t VerifyNodes(const uint8_t* data, size_t data_len, const uint8_t* digests,
+                        size_t offset, size_t finish, uint64_t level) {
+    zx_status_t rc;
+    uint8_t actual[internal::kSha256MaxMessages * Digest::kLength];
+    size_t count;
+    for (; offset < finish; offset += count * MerkleTree::kNodeSize) {
+        if ((rc = HashNodeBatch(data, data_len, offset, finish, level, actual, &count)) != ZX_OK) {
+            return rc;
+        }
+        if (memcmp(actual, digests + (offset / kDigestsPerNode), count * Digest::kLength) != 0) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+    return ZX_OK;
+}
+
+// Splits the node-aligned range from |offset| up to |finish| into tasks of
+// |kNodesPerTask| nodes, and calls |func(task_offset, task_finish)| for each
+// on the threads of |pool|.  Calls |func| once for the whole range if |pool| is
+// null.  Returns the first error reported by any task.
+template <typename Func>
+zx_status_t ForEachTask(ThreadPool* pool, size_t offset, size_t finish, Func func) {
+    const size_t task_len = kNodesPerTask * MerkleTree::kNodeSize;
+    if (!pool || finish - offset <= task_len) {
+        return func(offset, finish);
+    }
+    std::atomic<zx_status_t> result(ZX_OK);
+    size_t num_tasks = fbl::round_up(finish - offset, task_len) / task_len;
+    pool->ParallelFor(num_tasks, [&](size_t i) {
+        size_t task_offset = offset + (i * task_len);
+        zx_status_t rc = func(task_offset, fbl::min(task_offset + task_len, finish));
+        zx_status_t expected = ZX_OK;
+        if (rc != ZX_OK) {
+            result.compare_exchange_strong(expected, rc);
+        }
+    });
+    return result.load();
+}
+
 } // namespace
 
 ////////
@@ -106,14 +235,51 @@ size_t MerkleTree::GetTreeLength(size_t data_len) {
 
 zx_status_t MerkleTree::Create(const void* data, size_t data_len, void* tree, size_t tree_len,
                                Digest* digest) {
-    zx_status_t rc;
-    MerkleTree mt;
-    if ((rc = mt.CreateInit(data_len, tree_len)) != ZX_OK ||
-        (rc = mt.CreateUpdate(data, data_len, tree)) != ZX_OK ||
-        (rc = mt.CreateFinal(tree, digest)) != ZX_OK) {
-        return rc;
+    return Create(data, data_len, tree, tree_len, digest, nullptr);
+}
+
+zx_status_t MerkleTree::Create(const void* data, size_t data_len, void* tree, size_t tree_len,
+                               Digest* digest, ThreadPool* pool) {
+    // A single node has no tree to build.
+    if (data_len <= kNodeSize) {
+        zx_status_t rc;
+        MerkleTree mt;
+        if ((rc = mt.CreateInit(data_len, tree_len)) != ZX_OK ||
+            (rc = mt.CreateUpdate(data, data_len, tree)) != ZX_OK ||
+            (rc = mt.CreateFinal(tree, digest)) != ZX_OK) {
+            return rc;
+        }
+        return ZX_OK;
     }
-    return ZX_OK;
+    if (tree_len < GetTreeLength(data_len)) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    if (!data || !tree || !digest) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    uint8_t* out = static_cast<uint8_t*>(tree);
+    uint64_t level = 0;
+    // Unlike |CreateUpdate|, hash a whole level before ascending the tree, so
+    // that the nodes in the level can be hashed several at a time and, given a
+    // |pool|, in parallel.
+    while (data_len > kNodeSize) {
+        zx_status_t rc;
+        size_t next_len = NextLength(data_len);
+        size_t next_aligned = NextAligned(data_len);
+        memset(out + next_len, 0, next_aligned - next_len);
+        rc = ForEachTask(pool, 0, data_len, [=](size_t offset, size_t finish) {
+            return HashNodes(in, data_len, out, offset, finish, level);
+        });
+        if (rc != ZX_OK) {
+            return rc;
+        }
+        in = out;
+        data_len = next_aligned;
+        out += next_aligned;
+        ++level;
+    }
+    return HashNode(digest, in, data_len, 0, level);
 }
 
 MerkleTree::MerkleTree() : initialized_(false), next_(nullptr), level_(0), offset_(0), length_(0) {}
@@ -246,12 +412,18 @@ zx_status_t MerkleTree::CreateFinalInternal(const void* data, void* tree, Digest
 
 zx_status_t MerkleTree::Verify(const void* data, size_t data_len, const void* tree, size_t tree_len,
                                size_t offset, size_t length, const Digest& root) {
+    return Verify(data, data_len, tree, tree_len, offset, length, root, nullptr);
+}
+
+zx_status_t MerkleTree::Verify(const void* data, size_t data_len, const void* tree, size_t tree_len,
+                               size_t offset, size_t length, const Digest& root,
+                               ThreadPool* pool) {
     uint64_t level = 0;
     size_t root_len = data_len;
     while (data_len > kNodeSize) {
         zx_status_t rc;
         // Verify the data in this level.
-        if ((rc = VerifyLevel(data, data_len, tree, offset, length, level)) != ZX_OK) {
+        if ((rc = VerifyLevel(data, data_len, tree, offset, length, level, pool)) != ZX_OK) {
             return rc;
         }
         // Ascend to the next level up.
@@ -289,8 +461,8 @@ zx_status_t MerkleTree::VerifyRoot(const void* data, size_t root_len, uint64_t l
 }
 
 zx_status_t MerkleTree::VerifyLevel(const void* data, size_t data_len, const void* tree,
-                                    size_t offset, size_t length, uint64_t level) {
-    zx_status_t rc;
+                                    size_t offset, size_t length, uint64_t level,
+                                    ThreadPool* pool) {
     ZX_DEBUG_ASSERT(offset + length >= offset);
     // Must have more than one node of data and digests to check against.
     if (!data || data_len <= kNodeSize || !tree) {
@@ -302,28 +474,14 @@ zx_status_t MerkleTree::VerifyLevel(const void* data, size_t data_len, const voi
     }
     // Align parameters to node boundaries, but don't exceed data_len
     offset -= offset % kNodeSize;
-    size_t finish = fbl::round_up(offset + length, kNodeSize);
-    length = fbl::min(finish, data_len) - offset;
-    const uint8_t* in = static_cast<const uint8_t*>(data) + offset;
+    size_t finish = fbl::min(fbl::round_up(offset + length, kNodeSize), data_len);
+    const uint8_t* in = static_cast<const uint8_t*>(data);
     // The digests are in the next level up.
-    Digest actual;
-    const uint8_t* expected = static_cast<const uint8_t*>(tree) + (offset / kDigestsPerNode);
+    const uint8_t* digests = static_cast<const uint8_t*>(tree);
     // Check the data of this level against the digests.
-    while (length > 0) {
-        if ((rc = DigestInit(&actual, offset | level, data_len - offset)) != ZX_OK) {
-            return rc;
-        }
-        size_t chunk = DigestUpdate(&actual, in, offset, length);
-        in += chunk;
-        offset += chunk;
-        length -= chunk;
-        DigestFinal(&actual, offset);
-        if (actual != expected) {
-            return ZX_ERR_IO_DATA_INTEGRITY;
-        }
-        expected += Digest::kLength;
-    }
-    return ZX_OK;
+    return ForEachTask(pool, offset, finish, [=](size_t task_offset, size_t task_finish) {
+        return VerifyNodes(in, data_len, digests, task_offset, task_finish, level);
+    });
 }
 
 } // namespace digest
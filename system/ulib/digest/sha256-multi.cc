@@ -0,0 +1,298 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sha256-multi.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <utility>
+
+#include <fbl/algorithm.h>
+#include <zircon/assert.h>
+
+// See note in //zircon/third_party/ulib/uboringssl/rules.mk
+#define BORINGSSL_NO_CXX
+#include <openssl/sha.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__Fuchsia__)
+#include <zircon/features.h>
+#include <zircon/syscalls.h>
+
+// Defined in sha256-multi-arm64.S.  Runs |num_blocks| blocks from each of |in0|
+// and |in1| through the SHA-256 compression function, updating |state0| and
+// |state1| respectively.
+extern "C" void digest_sha256_blocks_x2_armv8(uint32_t* state0, uint32_t* state1,
+                                              const uint8_t* in0, const uint8_t* in1,
+                                              size_t num_blocks);
+#endif
+
+namespace digest {
+namespace internal {
+namespace {
+
+const uint32_t kInitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+// Runs |num_blocks| consecutive blocks, starting at |blocks[i]|, through the
+// SHA-256 compression function to update |states[i]|, for each |i| less than
+// |count|.
+using BlocksFunc = void (*)(uint32_t (*states)[8], const uint8_t* const* blocks, size_t count,
+                            size_t num_blocks);
+
+// Hashes the messages one after the other using BoringSSL, which picks the best
+// single-message implementation for the CPU.
+void BlocksGeneric(uint32_t (*states)[8], const uint8_t* const* blocks, size_t count,
+                   size_t num_blocks) {
+    for (size_t i = 0; i < count; ++i) {
+        SHA256_TransformBlocks(states[i], blocks[i], num_blocks);
+    }
+}
+
+#if defined(__x86_64__)
+
+alignas(16) const uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+// Does rounds |4 * Q| through |4 * Q + 3| for each of |N| messages, whose
+// states are in |abef| and |cdgh|, and whose message schedules are in |msgs|.
+// The SHA-NI round instructions keep the state as the word pairs ABEF and
+// CDGH, rather than in the order A through H.
+template <size_t N, size_t Q>
+__attribute__((target("sha,sse4.1"), always_inline)) inline void RoundsShaNi(
+    __m128i* abef, __m128i* cdgh, __m128i (*msgs)[4], const uint8_t* const* in) {
+    const __m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(&kRoundConstants[Q * 4]));
+    for (size_t l = 0; l < N; ++l) {
+        __m128i msg;
+        if constexpr (Q < 4) {
+            const __m128i byte_swap =
+                _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+            msg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[l] + Q * 16));
+            msg = _mm_shuffle_epi8(msg, byte_swap);
+        } else {
+            msg = _mm_sha256msg1_epu32(msgs[l][Q % 4], msgs[l][(Q + 1) % 4]);
+            msg = _mm_add_epi32(msg, _mm_alignr_epi8(msgs[l][(Q + 3) % 4], msgs[l][(Q + 2) % 4], 4));
+            msg = _mm_sha256msg2_epu32(msg, msgs[l][(Q + 3) % 4]);
+        }
+        msgs[l][Q % 4] = msg;
+        const __m128i wk = _mm_add_epi32(msg, k);
+        cdgh[l] = _mm_sha256rnds2_epu32(cdgh[l], abef[l], wk);
+        abef[l] = _mm_sha256rnds2_epu32(abef[l], cdgh[l], _mm_shuffle_epi32(wk, 0x0e));
+    }
+}
+
+template <size_t N, size_t... Q>
+__attribute__((target("sha,sse4.1"), always_inline)) inline void BlockShaNi(
+    __m128i* abef, __m128i* cdgh, const uint8_t* const* in, std::index_sequence<Q...>) {
+    __m128i msgs[N][4];
+    (RoundsShaNi<N, Q>(abef, cdgh, msgs, in), ...);
+}
+
+// Hashes |N| messages in lockstep using the SHA extensions.
+template <size_t N>
+__attribute__((target("sha,sse4.1"))) void BlocksShaNi(uint32_t (*states)[8],
+                                                       const uint8_t* const* blocks,
+                                                       size_t num_blocks) {
+    __m128i abef[N];
+    __m128i cdgh[N];
+    const uint8_t* in[N];
+    for (size_t l = 0; l < N; ++l) {
+        __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&states[l][0]));
+        __m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&states[l][4]));
+        __m128i cdab = _mm_shuffle_epi32(dcba, 0xb1);
+        __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+        abef[l] = _mm_alignr_epi8(cdab, efgh, 8);
+        cdgh[l] = _mm_blend_epi16(efgh, cdab, 0xf0);
+        in[l] = blocks[l];
+    }
+
+    for (size_t b = 0; b < num_blocks; ++b) {
+        __m128i abef_saved[N];
+        __m128i cdgh_saved[N];
+        for (size_t l = 0; l < N; ++l) {
+            abef_saved[l] = abef[l];
+            cdgh_saved[l] = cdgh[l];
+        }
+        BlockShaNi<N>(abef, cdgh, in, std::make_index_sequence<16>());
+        for (size_t l = 0; l < N; ++l) {
+            abef[l] = _mm_add_epi32(abef[l], abef_saved[l]);
+            cdgh[l] = _mm_add_epi32(cdgh[l], cdgh_saved[l]);
+            in[l] += SHA256_CBLOCK;
+        }
+    }
+
+    for (size_t l = 0; l < N; ++l) {
+        __m128i feba = _mm_shuffle_epi32(abef[l], 0x1b);
+        __m128i dchg = _mm_shuffle_epi32(cdgh[l], 0xb1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&states[l][0]),
+                         _mm_blend_epi16(feba, dchg, 0xf0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&states[l][4]),
+                         _mm_alignr_epi8(dchg, feba, 8));
+    }
+}
+
+// Two messages are enough to keep the SHA-NI units busy on current CPUs, and
+// more would not fit in the vector registers.
+void BlocksShaNiPairs(uint32_t (*states)[8], const uint8_t* const* blocks, size_t count,
+                      size_t num_blocks) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        BlocksShaNi<2>(states + i, blocks + i, num_blocks);
+    }
+    if (i < count) {
+        BlocksShaNi<1>(states + i, blocks + i, num_blocks);
+    }
+}
+
+BlocksFunc SelectBlocksFunc() {
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, nullptr) < 7) {
+        return BlocksGeneric;
+    }
+    __cpuid(1, eax, ebx, ecx, edx);
+    if ((ecx & bit_SSE4_1) == 0) {
+        return BlocksGeneric;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & bit_SHA) != 0 ? BlocksShaNiPairs : BlocksGeneric;
+}
+
+#elif defined(__aarch64__) && defined(__Fuchsia__)
+
+void BlocksArmv8Pairs(uint32_t (*states)[8], const uint8_t* const* blocks, size_t count,
+                      size_t num_blocks) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        digest_sha256_blocks_x2_armv8(states[i], states[i + 1], blocks[i], blocks[i + 1],
+                                      num_blocks);
+    }
+    if (i < count) {
+        // An odd message out takes as long on its own as in a pair.
+        uint32_t unused[8];
+        memcpy(unused, states[i], sizeof(unused));
+        digest_sha256_blocks_x2_armv8(states[i], unused, blocks[i], blocks[i], num_blocks);
+    }
+}
+
+BlocksFunc SelectBlocksFunc() {
+    uint32_t features;
+    if (zx_system_get_features(ZX_FEATURE_KIND_CPU, &features) != ZX_OK ||
+        (features & ZX_ARM64_FEATURE_ISA_SHA2) == 0) {
+        return BlocksGeneric;
+    }
+    return BlocksArmv8Pairs;
+}
+
+#else
+
+BlocksFunc SelectBlocksFunc() {
+    return BlocksGeneric;
+}
+
+#endif
+
+// Selected on first use.  Racing threads select the same function.
+std::atomic<BlocksFunc> gBlocksFunc(nullptr);
+
+BlocksFunc GetBlocksFunc() {
+    BlocksFunc func = gBlocksFunc.load(std::memory_order_relaxed);
+    if (!func) {
+        func = SelectBlocksFunc();
+        gBlocksFunc.store(func, std::memory_order_relaxed);
+    }
+    return func;
+}
+
+// Copies the bytes at [start, start + SHA256_CBLOCK) of the padded message made
+// of |prefix| and |data| to |block|.  The padding is a single 0x80 byte, zeros,
+// and the message length in bits in the last eight bytes of the |last| block.
+void FillBlock(uint8_t* block, size_t start, const uint8_t* prefix, size_t prefix_len,
+               const uint8_t* data, size_t data_len, bool last) {
+    const size_t msg_len = prefix_len + data_len;
+    const size_t end = start + SHA256_CBLOCK;
+    memset(block, 0, SHA256_CBLOCK);
+    if (start < prefix_len) {
+        memcpy(block, prefix + start, fbl::min(prefix_len, end) - start);
+    }
+    size_t data_start = fbl::max(start, prefix_len);
+    size_t data_end = fbl::min(end, msg_len);
+    if (data_start < data_end) {
+        memcpy(block + (data_start - start), data + (data_start - prefix_len),
+               data_end - data_start);
+    }
+    if (start <= msg_len && msg_len < end) {
+        block[msg_len - start] = 0x80;
+    }
+    if (last) {
+        uint64_t bits = msg_len * 8;
+        for (size_t i = 1; i <= sizeof(bits); ++i) {
+            block[SHA256_CBLOCK - i] = static_cast<uint8_t>(bits);
+            bits >>= 8;
+        }
+    }
+}
+
+} // namespace
+
+void Sha256Multi(const uint8_t* const* prefixes, size_t prefix_len, const uint8_t* const* data,
+                 size_t data_len, size_t count, uint8_t* out) {
+    ZX_DEBUG_ASSERT(count <= kSha256MaxMessages);
+    const BlocksFunc blocks_func = GetBlocksFunc();
+    uint32_t states[kSha256MaxMessages][8];
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(states[i], kInitialState, sizeof(kInitialState));
+    }
+
+    // Room for at least the 0x80 byte and the 64-bit length after the message.
+    const size_t msg_len = prefix_len + data_len;
+    const size_t num_blocks = (msg_len + 1 + sizeof(uint64_t) + SHA256_CBLOCK - 1) / SHA256_CBLOCK;
+    const uint8_t* blocks[kSha256MaxMessages];
+    uint8_t scratch[kSha256MaxMessages][SHA256_CBLOCK];
+    for (size_t block = 0; block < num_blocks;) {
+        const size_t start = block * SHA256_CBLOCK;
+        // Blocks lying wholly within the data are hashed in place.
+        if (start >= prefix_len && start + SHA256_CBLOCK <= msg_len) {
+            size_t run = (msg_len - start) / SHA256_CBLOCK;
+            for (size_t i = 0; i < count; ++i) {
+                blocks[i] = data[i] + (start - prefix_len);
+            }
+            blocks_func(states, blocks, count, run);
+            block += run;
+            continue;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            FillBlock(scratch[i], start, prefixes[i], prefix_len, data[i], data_len,
+                      block == num_blocks - 1);
+            blocks[i] = scratch[i];
+        }
+        blocks_func(states, blocks, count, 1);
+        ++block;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < 8; ++j) {
+            uint32_t word = states[i][j];
+            uint8_t* p = out + (i * SHA256_DIGEST_LENGTH) + (j * sizeof(word));
+            p[0] = static_cast<uint8_t>(word >> 24);
+            p[1] = static_cast<uint8_t>(word >> 16);
+            p[2] = static_cast<uint8_t>(word >> 8);
+            p[3] = static_cast<uint8_t>(word);
+        }
+    }
+}
+
+} // namespace internal
+} // namespace digest
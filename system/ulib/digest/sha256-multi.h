@@ -0,0 +1,28 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace digest {
+namespace internal {
+
+// The maximum number of messages hashed by a single call to Sha256Multi.
+constexpr size_t kSha256MaxMessages = 8;
+
+// Computes the SHA-256 digests of |count| messages of the same length, where
+// message |i| is the |prefix_len| bytes at |prefixes[i]| followed by the
+// |data_len| bytes at |data[i]|.  Writes the digests one after the other to
+// |out|, which must have room for |count| digests.  |count| must be at most
+// |kSha256MaxMessages|.
+//
+// On CPUs with SHA-256 instructions, the messages are hashed in lockstep so
+// that the latency of each instruction is hidden by work on the others.
+void Sha256Multi(const uint8_t* const* prefixes, size_t prefix_len, const uint8_t* const* data,
+                 size_t data_len, size_t count, uint8_t* out);
+
+} // namespace internal
+} // namespace digest
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 
 #include <digest/digest.h>
+#include <digest/thread-pool.h>
 #include <zircon/assert.h>
 #include <zircon/status.h>
 #include <unittest/unittest.h>
@@ -626,6 +627,85 @@ bool VerifyBadLeaves(void) {
     END_TEST;
 }
 
+// Used by CreateParallelAll below.  The expected tree is built incrementally,
+// which hashes one node at a time, rather than a level at a time like
+// |MerkleTree::Create|.
+bool CreateParallel(size_t data_len, const char* digest, digest::ThreadPool* pool) {
+    zx_status_t rc;
+    size_t tree_len = MerkleTree::GetTreeLength(data_len);
+    uint8_t tree[sizeof(gTree)];
+    Digest expected;
+    MerkleTree mt;
+    ASSERT_OK(mt.CreateInit(data_len, tree_len));
+    ASSERT_OK(mt.CreateUpdate(gData, data_len, tree));
+    ASSERT_OK(mt.CreateFinal(tree, &expected));
+    Digest actual;
+    memset(gTree, 0xff, sizeof(gTree));
+    ASSERT_OK(MerkleTree::Create(gData, data_len, gTree, tree_len, &actual, pool));
+    ASSERT_TRUE(actual == expected, "Incorrect root digest");
+    ASSERT_BYTES_EQ(tree, gTree, tree_len, "Incorrect tree");
+    ASSERT_OK(expected.Parse(digest, strlen(digest)));
+    ASSERT_TRUE(actual == expected, "Incorrect root digest");
+    return true;
+}
+
+bool CreateParallelAll(void) {
+    BEGIN_TEST;
+    digest::ThreadPool pool(4);
+    for (size_t i = 0; i < kNumCases; ++i) {
+        if (!CreateParallel(kCases[i].data_len, kCases[i].digest, &pool)) {
+            unittest_printf_critical(
+                "CreateParallelAll failed with data length of %zu\n",
+                kCases[i].data_len);
+        }
+    }
+    END_TEST;
+}
+
+bool CreateParallelWithoutThreads(void) {
+    BEGIN_TEST_WITH_RC;
+    digest::ThreadPool pool(0);
+    size_t tree_len = MerkleTree::GetTreeLength(kUnalignedLarge);
+    Digest expected, actual;
+    ASSERT_OK(MerkleTree::Create(gData, kUnalignedLarge, gTree, tree_len, &expected));
+    ASSERT_OK(MerkleTree::Create(gData, kUnalignedLarge, gTree, tree_len, &actual, &pool));
+    ASSERT_TRUE(actual == expected, "Incorrect root digest");
+    END_TEST;
+}
+
+bool CreateParallelBadArgs(void) {
+    BEGIN_TEST_WITH_RC;
+    digest::ThreadPool pool(4);
+    Digest digest;
+    ASSERT_ERR(ZX_ERR_INVALID_ARGS,
+               MerkleTree::Create(nullptr, kLarge, gTree, sizeof(gTree), &digest, &pool));
+    ASSERT_ERR(ZX_ERR_INVALID_ARGS,
+               MerkleTree::Create(gData, kLarge, nullptr, sizeof(gTree), &digest, &pool));
+    ASSERT_ERR(ZX_ERR_BUFFER_TOO_SMALL,
+               MerkleTree::Create(gData, kLarge, gTree, kNodeSize, &digest, &pool));
+    END_TEST;
+}
+
+bool VerifyParallel(void) {
+    BEGIN_TEST_WITH_RC;
+    digest::ThreadPool pool(4);
+    size_t tree_len = MerkleTree::GetTreeLength(kUnalignedLarge);
+    Digest digest;
+    ASSERT_OK(MerkleTree::Create(gData, kUnalignedLarge, gTree, tree_len, &digest));
+    ASSERT_OK(MerkleTree::Verify(gData, kUnalignedLarge, gTree, tree_len, 0,
+                                 kUnalignedLarge, digest, &pool));
+    // Damage the last node, which is hashed by the last task.
+    size_t last = kUnalignedLarge - 1;
+    gData[last] ^= 1;
+    ASSERT_ERR(ZX_ERR_IO_DATA_INTEGRITY,
+               MerkleTree::Verify(gData, kUnalignedLarge, gTree, tree_len, 0,
+                                  kUnalignedLarge, digest, &pool));
+    ASSERT_OK(MerkleTree::Verify(gData, kUnalignedLarge, gTree, tree_len, 0,
+                                 last - (last % kNodeSize), digest, &pool));
+    gData[last] ^= 1;
+    END_TEST;
+}
+
 bool CreateAndVerifyHugePRNGData(void) {
     BEGIN_TEST_WITH_RC;
     Digest digest;
@@ -739,5 +819,9 @@ RUN_TEST(VerifyGoodPartOfBadTree)
 RUN_TEST(VerifyBadTree)
 RUN_TEST(VerifyGoodPartOfBadLeaves)
 RUN_TEST(VerifyBadLeaves)
+RUN_TEST(CreateParallelAll)
+RUN_TEST(CreateParallelWithoutThreads)
+RUN_TEST(CreateParallelBadArgs)
+RUN_TEST(VerifyParallel)
 RUN_TEST(CreateAndVerifyHugePRNGData)
 END_TEST_CASE(MerkleTreeTests)
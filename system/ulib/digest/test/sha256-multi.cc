@@ -0,0 +1,140 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sha256-multi.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <unittest/unittest.h>
+
+// See note in //zircon/third_party/ulib/uboringssl/rules.mk
+#define BORINGSSL_NO_CXX
+#include <openssl/sha.h>
+
+// These unit tests check digest::internal::Sha256Multi, whichever
+// implementation is selected for the CPU, against BoringSSL's SHA-256.
+
+namespace {
+
+using digest::internal::kSha256MaxMessages;
+using digest::internal::Sha256Multi;
+
+// Lengths around the block size and the 55 bytes which are the most that fit
+// in a block along with the padding.
+const size_t kPrefixLengths[] = {0, 1, 12, 55, 56, 63, 64, 65, 100};
+const size_t kDataLengths[] = {0, 1, 51, 52, 55, 56, 63, 64, 65, 119, 120, 127, 128, 1000, 8192};
+
+const size_t kMaxPrefixLength = 100;
+const size_t kMaxDataLength = 8192;
+
+uint8_t gPrefixes[kSha256MaxMessages][kMaxPrefixLength];
+uint8_t gData[kSha256MaxMessages][kMaxDataLength];
+
+// Fills the messages with bytes which differ between messages.
+void FillMessages() {
+    uint32_t x = 1;
+    for (size_t i = 0; i < kSha256MaxMessages; ++i) {
+        for (size_t j = 0; j < kMaxPrefixLength; ++j) {
+            x = x * 1103515245 + 12345;
+            gPrefixes[i][j] = static_cast<uint8_t>(x >> 16);
+        }
+        for (size_t j = 0; j < kMaxDataLength; ++j) {
+            x = x * 1103515245 + 12345;
+            gData[i][j] = static_cast<uint8_t>(x >> 16);
+        }
+    }
+}
+
+// Checks the digests of |count| messages made of the first |prefix_len| bytes
+// of |gPrefixes[i]| and the |data_len| bytes of |gData[i]| starting at
+// |data_offset|, which need not be aligned.
+bool CheckMessages(size_t prefix_len, size_t data_len, size_t data_offset, size_t count) {
+    BEGIN_HELPER;
+    const uint8_t* prefixes[kSha256MaxMessages];
+    const uint8_t* data[kSha256MaxMessages];
+    for (size_t i = 0; i < count; ++i) {
+        prefixes[i] = gPrefixes[i];
+        data[i] = gData[i] + data_offset;
+    }
+    uint8_t actual[kSha256MaxMessages * SHA256_DIGEST_LENGTH];
+    Sha256Multi(prefixes, prefix_len, data, data_len, count, actual);
+
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t expected[SHA256_DIGEST_LENGTH];
+        SHA256_CTX ctx;
+        SHA256_Init(&ctx);
+        SHA256_Update(&ctx, prefixes[i], prefix_len);
+        SHA256_Update(&ctx, data[i], data_len);
+        SHA256_Final(expected, &ctx);
+        if (memcmp(expected, actual + i * SHA256_DIGEST_LENGTH, SHA256_DIGEST_LENGTH) != 0) {
+            unittest_printf_critical(
+                "Sha256Multi mismatch: prefix %zu, data %zu at %zu, message %zu of %zu\n",
+                prefix_len, data_len, data_offset, i, count);
+        }
+        ASSERT_BYTES_EQ(expected, actual + i * SHA256_DIGEST_LENGTH, SHA256_DIGEST_LENGTH,
+                        "Incorrect digest");
+    }
+    END_HELPER;
+}
+
+////////////////
+// Test cases
+
+bool Sha256MultiEmpty(void) {
+    BEGIN_TEST;
+    FillMessages();
+    // echo -n | sha256sum
+    const uint8_t kZeroDigest[SHA256_DIGEST_LENGTH] = {
+        0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+        0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55,
+    };
+    const uint8_t* prefixes[kSha256MaxMessages];
+    const uint8_t* data[kSha256MaxMessages];
+    for (size_t i = 0; i < kSha256MaxMessages; ++i) {
+        prefixes[i] = gPrefixes[i];
+        data[i] = gData[i];
+    }
+    uint8_t actual[kSha256MaxMessages * SHA256_DIGEST_LENGTH];
+    Sha256Multi(prefixes, 0, data, 0, kSha256MaxMessages, actual);
+    for (size_t i = 0; i < kSha256MaxMessages; ++i) {
+        ASSERT_BYTES_EQ(kZeroDigest, actual + i * SHA256_DIGEST_LENGTH, SHA256_DIGEST_LENGTH,
+                        "Incorrect digest");
+    }
+    END_TEST;
+}
+
+bool Sha256MultiAllLengths(void) {
+    BEGIN_TEST;
+    FillMessages();
+    for (size_t prefix_len : kPrefixLengths) {
+        for (size_t data_len : kDataLengths) {
+            for (size_t count = 1; count <= kSha256MaxMessages; ++count) {
+                ASSERT_TRUE(CheckMessages(prefix_len, data_len, 0, count));
+            }
+        }
+    }
+    END_TEST;
+}
+
+bool Sha256MultiUnalignedData(void) {
+    BEGIN_TEST;
+    FillMessages();
+    // Whole blocks of data are hashed in place, so must not need alignment.
+    for (size_t data_offset = 1; data_offset < 8; ++data_offset) {
+        for (size_t count = 1; count <= kSha256MaxMessages; ++count) {
+            ASSERT_TRUE(CheckMessages(12, 1000, data_offset, count));
+            ASSERT_TRUE(CheckMessages(64, 1000, data_offset, count));
+        }
+    }
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(Sha256MultiTests)
+RUN_TEST(Sha256MultiEmpty)
+RUN_TEST(Sha256MultiAllLengths)
+RUN_TEST(Sha256MultiUnalignedData)
+END_TEST_CASE(Sha256MultiTests)
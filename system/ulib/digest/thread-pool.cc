@@ -0,0 +1,74 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <digest/thread-pool.h>
+
+#include <algorithm>
+
+namespace digest {
+
+ThreadPool::ThreadPool() : ThreadPool(std::max(std::thread::hardware_concurrency(), 1u) - 1) {}
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    threads_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads_.emplace_back([this] { WorkerThread(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        shutdown_ = true;
+    }
+    work_available_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+    Batch batch = {count, &task, 0, 0};
+    std::unique_lock<std::mutex> lock(lock_);
+    if (count > 1 && !threads_.empty()) {
+        batches_.push_back(&batch);
+        work_available_.notify_all();
+    }
+    while (batch.next < batch.count) {
+        RunNextTask(&batch, &lock);
+    }
+    batch_finished_.wait(lock, [&batch] { return batch.finished == batch.count; });
+}
+
+void ThreadPool::WorkerThread() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+        work_available_.wait(lock, [this] { return shutdown_ || !batches_.empty(); });
+        if (batches_.empty()) {
+            return;
+        }
+        RunNextTask(batches_.front(), &lock);
+    }
+}
+
+void ThreadPool::RunNextTask(Batch* batch, std::unique_lock<std::mutex>* lock) {
+    size_t index = batch->next++;
+    if (batch->next == batch->count) {
+        auto it = std::find(batches_.begin(), batches_.end(), batch);
+        if (it != batches_.end()) {
+            batches_.erase(it);
+        }
+    }
+    lock->unlock();
+    (*batch->task)(index);
+    lock->lock();
+    if (++batch->finished == batch->count) {
+        batch_finished_.notify_all();
+    }
+}
+
+} // namespace digest
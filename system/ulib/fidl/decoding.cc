@@ -5,6 +5,7 @@
 #include <lib/fidl/coding.h>
 #include <lib/fidl/envelope_frames.h>
 #include <lib/fidl/internal.h>
+#include <lib/fidl/specialized_coders.h>
 #include <lib/fidl/visitor.h>
 #include <lib/fidl/walker.h>
 #include <stdalign.h>
@@ -226,6 +227,38 @@ class FidlDecoder final
   fidl::EnvelopeFrames envelope_frames_;
 };
 
+// Checks the outcome of decoding, and closes all handles if it failed.
+template <typename Decoder>
+zx_status_t FinishDecode(const Decoder& decoder, const zx_handle_t* handles, uint32_t num_handles,
+                         const char** out_error_msg) {
+  auto drop_all_handles = [&]() {
+#ifdef __Fuchsia__
+    // Return value intentionally ignored. This is best-effort cleanup.
+    (void)zx_handle_close_many(handles, num_handles);
+#endif
+  };
+  auto set_error = [&out_error_msg](const char* msg) {
+    if (out_error_msg)
+      *out_error_msg = msg;
+  };
+
+  if (decoder.status() != ZX_OK) {
+    drop_all_handles();
+    return decoder.status();
+  }
+  if (!decoder.DidConsumeAllBytes()) {
+    set_error("message did not decode all provided bytes");
+    drop_all_handles();
+    return ZX_ERR_INVALID_ARGS;
+  }
+  if (!decoder.DidConsumeAllHandles()) {
+    set_error("message did not decode all provided handles");
+    drop_all_handles();
+    return ZX_ERR_INVALID_ARGS;
+  }
+  return ZX_OK;
+}
+
 }  // namespace
 
 zx_status_t fidl_decode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
@@ -264,22 +297,19 @@ zx_status_t fidl_decode(const fidl_type_t* type, void* bytes, uint32_t num_bytes
     return status;
   }
 
+  if (auto specialized = fidl::SpecializedCodersFor(type)) {
+    // Specialized types have no envelopes, so there are never unknown handles to close.
+    fidl::internal::SpecializedDecoder decoder(bytes, num_bytes, handles, num_handles,
+                                               next_out_of_line, out_error_msg);
+    specialized->decode(&decoder);
+    return FinishDecode(decoder, handles, num_handles, out_error_msg);
+  }
+
   FidlDecoder decoder(bytes, num_bytes, handles, num_handles, next_out_of_line, out_error_msg);
   fidl::Walk(decoder, type, StartingPoint{reinterpret_cast<uint8_t*>(bytes)});
 
-  if (decoder.status() != ZX_OK) {
-    drop_all_handles();
-    return decoder.status();
-  }
-  if (!decoder.DidConsumeAllBytes()) {
-    set_error("message did not decode all provided bytes");
-    drop_all_handles();
-    return ZX_ERR_INVALID_ARGS;
-  }
-  if (!decoder.DidConsumeAllHandles()) {
-    set_error("message did not decode all provided handles");
-    drop_all_handles();
-    return ZX_ERR_INVALID_ARGS;
+  if ((status = FinishDecode(decoder, handles, num_handles, out_error_msg)) != ZX_OK) {
+    return status;
   }
 
 #ifdef __Fuchsia__
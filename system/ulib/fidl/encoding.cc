@@ -5,6 +5,7 @@
 #include <lib/fidl/coding.h>
 #include <lib/fidl/envelope_frames.h>
 #include <lib/fidl/internal.h>
+#include <lib/fidl/specialized_coders.h>
 #include <lib/fidl/visitor.h>
 #include <lib/fidl/walker.h>
 #include <stdalign.h>
@@ -203,33 +204,13 @@ class FidlEncoder final
   fidl::EnvelopeFrames envelope_frames_;
 };
 
-}  // namespace
-
-zx_status_t fidl_encode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
-                        zx_handle_t* handles, uint32_t max_handles, uint32_t* out_actual_handles,
-                        const char** out_error_msg) {
+template <typename Encoder>
+zx_status_t FinishEncode(const Encoder& encoder, zx_handle_t* handles, uint32_t max_handles,
+                         uint32_t* out_actual_handles, const char** out_error_msg) {
   auto set_error = [&out_error_msg](const char* msg) {
     if (out_error_msg)
       *out_error_msg = msg;
   };
-  if (bytes == nullptr) {
-    set_error("Cannot encode null bytes");
-    return ZX_ERR_INVALID_ARGS;
-  }
-  if (!fidl::IsAligned(reinterpret_cast<uint8_t*>(bytes))) {
-    set_error("Bytes must be aligned to FIDL_ALIGNMENT");
-    return ZX_ERR_INVALID_ARGS;
-  }
-
-  uint32_t next_out_of_line;
-  zx_status_t status;
-  if ((status = fidl::StartingOutOfLineOffset(type, num_bytes, &next_out_of_line, out_error_msg)) !=
-      ZX_OK) {
-    return status;
-  }
-
-  FidlEncoder encoder(bytes, num_bytes, handles, max_handles, next_out_of_line, out_error_msg);
-  fidl::Walk(encoder, type, StartingPoint{reinterpret_cast<uint8_t*>(bytes)});
 
   auto drop_all_handles = [&]() {
     if (out_actual_handles) {
@@ -268,6 +249,43 @@ zx_status_t fidl_encode(const fidl_type_t* type, void* bytes, uint32_t num_bytes
   return encoder.status();
 }
 
+}  // namespace
+
+zx_status_t fidl_encode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
+                        zx_handle_t* handles, uint32_t max_handles, uint32_t* out_actual_handles,
+                        const char** out_error_msg) {
+  auto set_error = [&out_error_msg](const char* msg) {
+    if (out_error_msg)
+      *out_error_msg = msg;
+  };
+  if (bytes == nullptr) {
+    set_error("Cannot encode null bytes");
+    return ZX_ERR_INVALID_ARGS;
+  }
+  if (!fidl::IsAligned(reinterpret_cast<uint8_t*>(bytes))) {
+    set_error("Bytes must be aligned to FIDL_ALIGNMENT");
+    return ZX_ERR_INVALID_ARGS;
+  }
+
+  uint32_t next_out_of_line;
+  zx_status_t status;
+  if ((status = fidl::StartingOutOfLineOffset(type, num_bytes, &next_out_of_line, out_error_msg)) !=
+      ZX_OK) {
+    return status;
+  }
+
+  if (auto specialized = fidl::SpecializedCodersFor(type)) {
+    fidl::internal::SpecializedEncoder encoder(bytes, num_bytes, handles, max_handles,
+                                               next_out_of_line, out_error_msg);
+    specialized->encode(&encoder);
+    return FinishEncode(encoder, handles, max_handles, out_actual_handles, out_error_msg);
+  }
+
+  FidlEncoder encoder(bytes, num_bytes, handles, max_handles, next_out_of_line, out_error_msg);
+  fidl::Walk(encoder, type, StartingPoint{reinterpret_cast<uint8_t*>(bytes)});
+  return FinishEncode(encoder, handles, max_handles, out_actual_handles, out_error_msg);
+}
+
 zx_status_t fidl_encode_msg(const fidl_type_t* type, fidl_msg_t* msg, uint32_t* out_actual_handles,
                             const char** out_error_msg) {
   return fidl_encode(type, msg->bytes, msg->num_bytes, msg->handles, msg->num_handles,
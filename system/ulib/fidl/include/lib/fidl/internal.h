@@ -146,17 +146,29 @@ struct FidlCodedBits {
       : underlying_type(underlying_type), mask(mask) {}
 };
 
+// Defined in <lib/fidl/specialized_coders.h>.
+struct FidlSpecializedCoders;
+
 // Though the |size| is implied by the fields, computing that information is not the purview of this
 // library. It's easier for the compiler to stash it.
+// |specialized_coders| is nullptr unless fidlc generated code to code this struct without walking
+// |fields|. It is only used when this is the type passed to fidl_encode() and friends; nested
+// structs are always walked.
 struct FidlCodedStruct {
   const FidlStructField* const fields;
   const uint32_t field_count;
   const uint32_t size;
   const char* name;  // may be nullptr if omitted at compile time
+  const FidlSpecializedCoders* const specialized_coders;
 
   constexpr FidlCodedStruct(const FidlStructField* fields, uint32_t field_count, uint32_t size,
-                            const char* name)
-      : fields(fields), field_count(field_count), size(size), name(name) {}
+                            const char* name,
+                            const FidlSpecializedCoders* specialized_coders = nullptr)
+      : fields(fields),
+        field_count(field_count),
+        size(size),
+        name(name),
+        specialized_coders(specialized_coders) {}
 };
 
 struct FidlCodedStructPointer {
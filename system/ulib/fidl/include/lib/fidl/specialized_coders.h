@@ -0,0 +1,256 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_SPECIALIZED_CODERS_H_
+#define LIB_FIDL_SPECIALIZED_CODERS_H_
+
+#include <lib/fidl/coding.h>
+#include <lib/fidl/internal.h>
+#include <string.h>
+#include <zircon/compiler.h>
+
+#include <cstdint>
+
+#ifdef __Fuchsia__
+#include <zircon/syscalls.h>
+#endif
+
+// Specialized coders encode, decode, and validate one particular struct without interpreting its
+// coding table. fidlc emits them (with --specialized-coders) for message and struct types whose
+// wire format has no out-of-line objects, as a sequence of calls to the primitive operations
+// below with constant offsets, which the compiler inlines into straight-line code.
+//
+// Each operation has exactly the effect the corresponding fidl::Walker step would have with the
+// visitor in encoding.cc, decoding.cc, or validating.cc, so that a specialized coder produces
+// the same output, and reports the same first error, as walking the coding table. Types with
+// pointers, strings, vectors, tables, unions, or xunions always use the coding table.
+
+namespace fidl {
+namespace internal {
+
+template <typename Byte, bool ContinueAfterConstraintViolation>
+class SpecializedCoderBase {
+ public:
+  SpecializedCoderBase(Byte* bytes, uint32_t num_bytes, uint32_t next_out_of_line,
+                       const char** out_error_msg)
+      : bytes_(bytes),
+        num_bytes_(num_bytes),
+        next_out_of_line_(next_out_of_line),
+        out_error_msg_(out_error_msg) {}
+
+  template <typename T>
+  void Enum(uint32_t offset, const fidl_type_t* enum_type) {
+    if (Stopped())
+      return;
+    uint64_t value = static_cast<uint64_t>(*reinterpret_cast<const T*>(&bytes_[offset]));
+    if (!enum_type->coded_enum.validate(value)) {
+      SetError("not a valid enum member");
+    }
+  }
+
+  template <typename T>
+  void Bits(uint32_t offset, uint64_t mask) {
+    if (Stopped())
+      return;
+    uint64_t value = *reinterpret_cast<const T*>(&bytes_[offset]);
+    if (value & ~mask) {
+      SetError("not a valid bits member");
+    }
+  }
+
+  zx_status_t status() const { return status_; }
+
+  uint32_t handle_idx() const { return handle_idx_; }
+
+  // Specialized coders never claim out-of-line storage.
+  bool DidConsumeAllBytes() const { return next_out_of_line_ == num_bytes_; }
+
+ protected:
+  bool Stopped() const { return !ContinueAfterConstraintViolation && status_ != ZX_OK; }
+
+  void SetError(const char* error) {
+    if (status_ == ZX_OK) {
+      status_ = ZX_ERR_INVALID_ARGS;
+      if (out_error_msg_ != nullptr) {
+        *out_error_msg_ = error;
+      }
+    }
+  }
+
+  void ValidatePadding(uint32_t offset, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+      if (bytes_[offset + i] != 0) {
+        SetError("non-zero padding bytes detected");
+        return;
+      }
+    }
+  }
+
+  Byte* const bytes_;
+  const uint32_t num_bytes_;
+  const uint32_t next_out_of_line_;
+  const char** const out_error_msg_;
+
+  zx_status_t status_ = ZX_OK;
+  uint32_t handle_idx_ = 0;
+};
+
+class SpecializedEncoder final : public SpecializedCoderBase<uint8_t, true> {
+ public:
+  SpecializedEncoder(void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles,
+                     uint32_t next_out_of_line, const char** out_error_msg)
+      : SpecializedCoderBase(static_cast<uint8_t*>(bytes), num_bytes, next_out_of_line,
+                             out_error_msg),
+        handles_(handles),
+        max_handles_(max_handles) {}
+
+  void Padding(uint32_t offset, uint32_t length) { memset(&bytes_[offset], 0, length); }
+
+  void Handle(uint32_t offset, FidlNullability nullable) {
+    auto handle = reinterpret_cast<zx_handle_t*>(&bytes_[offset]);
+    if (*handle == ZX_HANDLE_INVALID) {
+      if (!nullable) {
+        SetError("message is missing a non-nullable handle");
+      }
+      return;
+    }
+    if (handle_idx_ == max_handles_) {
+      SetError("message tried to encode too many handles");
+      ThrowAwayHandle(handle);
+      return;
+    }
+    if (handles_ == nullptr) {
+      SetError("did not provide place to store handles");
+      ThrowAwayHandle(handle);
+      return;
+    }
+    handles_[handle_idx_] = *handle;
+    *handle = FIDL_HANDLE_PRESENT;
+    handle_idx_++;
+  }
+
+ private:
+  static void ThrowAwayHandle(zx_handle_t* handle) {
+#ifdef __Fuchsia__
+    zx_handle_close(*handle);
+#endif
+    *handle = ZX_HANDLE_INVALID;
+  }
+
+  zx_handle_t* const handles_;
+  const uint32_t max_handles_;
+};
+
+class SpecializedDecoder final : public SpecializedCoderBase<uint8_t, false> {
+ public:
+  SpecializedDecoder(void* bytes, uint32_t num_bytes, const zx_handle_t* handles,
+                     uint32_t num_handles, uint32_t next_out_of_line, const char** out_error_msg)
+      : SpecializedCoderBase(static_cast<uint8_t*>(bytes), num_bytes, next_out_of_line,
+                             out_error_msg),
+        handles_(handles),
+        num_handles_(num_handles) {}
+
+  void Padding(uint32_t offset, uint32_t length) {
+    if (Stopped())
+      return;
+    ValidatePadding(offset, length);
+  }
+
+  void Handle(uint32_t offset, FidlNullability nullable) {
+    if (Stopped())
+      return;
+    auto handle = reinterpret_cast<zx_handle_t*>(&bytes_[offset]);
+    if (*handle == ZX_HANDLE_INVALID) {
+      if (!nullable) {
+        SetError("message is missing a non-nullable handle");
+      }
+      return;
+    }
+    if (*handle != FIDL_HANDLE_PRESENT) {
+      SetError("message tried to decode a garbage handle");
+      return;
+    }
+    if (handle_idx_ == num_handles_) {
+      SetError("message decoded too many handles");
+      return;
+    }
+    if (handles_ == nullptr) {
+      SetError("decoder noticed a handle is present but the handle table is empty");
+      *handle = ZX_HANDLE_INVALID;
+      return;
+    }
+    if (handles_[handle_idx_] == ZX_HANDLE_INVALID) {
+      SetError("invalid handle detected in handle table");
+      return;
+    }
+    *handle = handles_[handle_idx_];
+    handle_idx_++;
+  }
+
+  bool DidConsumeAllHandles() const { return handle_idx_ == num_handles_; }
+
+ private:
+  const zx_handle_t* const handles_;
+  const uint32_t num_handles_;
+};
+
+class SpecializedValidator final : public SpecializedCoderBase<const uint8_t, true> {
+ public:
+  SpecializedValidator(const void* bytes, uint32_t num_bytes, uint32_t num_handles,
+                       uint32_t next_out_of_line, const char** out_error_msg)
+      : SpecializedCoderBase(static_cast<const uint8_t*>(bytes), num_bytes, next_out_of_line,
+                             out_error_msg),
+        num_handles_(num_handles) {}
+
+  void Padding(uint32_t offset, uint32_t length) { ValidatePadding(offset, length); }
+
+  void Handle(uint32_t offset, FidlNullability nullable) {
+    auto handle = reinterpret_cast<const zx_handle_t*>(&bytes_[offset]);
+    if (*handle == ZX_HANDLE_INVALID) {
+      if (!nullable) {
+        SetError("message is missing a non-nullable handle");
+      }
+      return;
+    }
+    if (*handle != FIDL_HANDLE_PRESENT) {
+      SetError("message contains a garbage handle");
+      return;
+    }
+    if (handle_idx_ == num_handles_) {
+      SetError("message has too many handles");
+      return;
+    }
+    handle_idx_++;
+  }
+
+  bool DidConsumeAllHandles() const { return handle_idx_ == num_handles_; }
+
+ private:
+  const uint32_t num_handles_;
+};
+
+}  // namespace internal
+
+struct FidlSpecializedCoders {
+  void (*const encode)(internal::SpecializedEncoder* encoder);
+  void (*const decode)(internal::SpecializedDecoder* decoder);
+  void (*const validate)(internal::SpecializedValidator* validator);
+
+  constexpr FidlSpecializedCoders(void (*encode)(internal::SpecializedEncoder*),
+                                  void (*decode)(internal::SpecializedDecoder*),
+                                  void (*validate)(internal::SpecializedValidator*))
+      : encode(encode), decode(decode), validate(validate) {}
+};
+
+// Returns the specialized coders for |type|, or nullptr if it must be coded by walking its
+// coding table.
+inline const FidlSpecializedCoders* SpecializedCodersFor(const fidl_type_t* type) {
+  if (type == nullptr || type->type_tag != kFidlTypeStruct)
+    return nullptr;
+  return type->coded_struct.specialized_coders;
+}
+
+}  // namespace fidl
+
+#endif  // LIB_FIDL_SPECIALIZED_CODERS_H_
@@ -5,6 +5,7 @@
 #include <lib/fidl/coding.h>
 #include <lib/fidl/envelope_frames.h>
 #include <lib/fidl/internal.h>
+#include <lib/fidl/specialized_coders.h>
 #include <lib/fidl/visitor.h>
 #include <lib/fidl/walker.h>
 #include <stdalign.h>
@@ -194,6 +195,27 @@ class FidlValidator final
   fidl::EnvelopeFrames envelope_frames_;
 };
 
+template <typename Validator>
+zx_status_t FinishValidate(const Validator& validator, const char** out_error_msg) {
+  auto set_error = [&out_error_msg](const char* msg) {
+    if (out_error_msg)
+      *out_error_msg = msg;
+  };
+
+  if (validator.status() == ZX_OK) {
+    if (!validator.DidConsumeAllBytes()) {
+      set_error("message did not consume all provided bytes");
+      return ZX_ERR_INVALID_ARGS;
+    }
+    if (!validator.DidConsumeAllHandles()) {
+      set_error("message did not reference all provided handles");
+      return ZX_ERR_INVALID_ARGS;
+    }
+  }
+
+  return validator.status();
+}
+
 }  // namespace
 
 zx_status_t fidl_validate(const fidl_type_t* type, const void* bytes, uint32_t num_bytes,
@@ -214,21 +236,16 @@ zx_status_t fidl_validate(const fidl_type_t* type, const void* bytes, uint32_t n
     return status;
   }
 
-  FidlValidator validator(bytes, num_bytes, num_handles, next_out_of_line, out_error_msg);
-  fidl::Walk(validator, type, StartingPoint{reinterpret_cast<const uint8_t*>(bytes)});
-
-  if (validator.status() == ZX_OK) {
-    if (!validator.DidConsumeAllBytes()) {
-      set_error("message did not consume all provided bytes");
-      return ZX_ERR_INVALID_ARGS;
-    }
-    if (!validator.DidConsumeAllHandles()) {
-      set_error("message did not reference all provided handles");
-      return ZX_ERR_INVALID_ARGS;
-    }
+  if (auto specialized = fidl::SpecializedCodersFor(type)) {
+    fidl::internal::SpecializedValidator validator(bytes, num_bytes, num_handles,
+                                                   next_out_of_line, out_error_msg);
+    specialized->validate(&validator);
+    return FinishValidate(validator, out_error_msg);
   }
 
-  return validator.status();
+  FidlValidator validator(bytes, num_bytes, num_handles, next_out_of_line, out_error_msg);
+  fidl::Walk(validator, type, StartingPoint{reinterpret_cast<const uint8_t*>(bytes)});
+  return FinishValidate(validator, out_error_msg);
 }
 
 zx_status_t fidl_validate_msg(const fidl_type_t* type, const fidl_msg_t* msg,
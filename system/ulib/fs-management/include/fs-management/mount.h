@@ -86,6 +86,11 @@ typedef struct mount_options {
     bool create_mountpoint;
     // Enable journaling on the file system (if supported).
     bool enable_journal;
+    // Serve file contents on demand through a pager (if supported).
+    bool enable_pager;
+    // Number of threads servicing requests to the filesystem (if supported),
+    // or zero for the filesystem's default.
+    uint32_t dispatch_threads;
 } mount_options_t;
 
 extern const mount_options_t default_mount_options;
@@ -208,6 +208,15 @@ zx_status_t Mounter::MountNativeFs(const char* binary, zx::channel device,
     if (options.enable_journal) {
         argv.push_back("--journal");
     }
+    if (options.enable_pager) {
+        argv.push_back("--pager");
+    }
+    char threads[11];
+    if (options.dispatch_threads > 1) {
+        snprintf(threads, sizeof(threads), "%u", options.dispatch_threads);
+        argv.push_back("--threads");
+        argv.push_back(threads);
+    }
     argv.push_back("mount");
     argv.push_back(nullptr);
     return LaunchAndMount(cb, options, argv.get(), static_cast<int>(argv.size() - 1));
@@ -250,6 +259,8 @@ const mount_options_t default_mount_options = {
     .wait_until_ready = true,
     .create_mountpoint = false,
     .enable_journal = false,
+    .enable_pager = false,
+    .dispatch_threads = 0,
 };
 
 const mkfs_options_t default_mkfs_options = {
@@ -11,6 +11,8 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
 #include <fbl/string_buffer.h>
 #include <fs/handler.h>
 #include <fs/trace.h>
@@ -43,6 +45,31 @@ namespace fs {
 
 namespace {
 
+// Holds the dispatch lock of a vnode, if the Vfs has one, for the lifetime
+// of the object.
+class DispatchGuard {
+public:
+    DispatchGuard(Vfs* vfs, fbl::RefPtr<Vnode> vnode) __TA_NO_THREAD_SAFETY_ANALYSIS
+        : lock_(vfs->DispatchLock(vnode.get())) {
+        if (lock_ != nullptr) {
+            vnode_ = std::move(vnode);
+            lock_->Acquire();
+        }
+    }
+    ~DispatchGuard() __TA_NO_THREAD_SAFETY_ANALYSIS {
+        if (lock_ != nullptr) {
+            lock_->Release();
+        }
+    }
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(DispatchGuard);
+
+    fbl::Mutex* const lock_;
+    // Keeps the lock alive, since the message may destroy the connection.
+    fbl::RefPtr<Vnode> vnode_;
+};
+
 // Returns true if the rights flags in |flags_a| does not exceed those in |flags_b|.
 bool StricterOrSameRights(uint32_t flags_a, uint32_t flags_b) {
     uint32_t rights_a = flags_a & ZX_FS_RIGHTS;
@@ -428,10 +455,15 @@ void Connection::HandleSignals(async_dispatcher_t* dispatcher, async::WaitBase*
             // opened while filesystems are torn down.
             status = ZX_ERR_PEER_CLOSED;
         } else if (signal->observed & ZX_CHANNEL_READABLE) {
-            // Handle the message.
-            status = ReadMessage(channel_.get(), [this](fidl_msg_t* msg, FidlConnection* txn) {
-                return HandleMessage(msg, txn->Txn());
-            });
+            // Handle the message. The wait is only rearmed once the dispatch
+            // lock has been dropped.
+            {
+                DispatchGuard guard(vfs_, vnode_);
+                status = ReadMessage(channel_.get(), [this](fidl_msg_t* msg,
+                                                            FidlConnection* txn) {
+                    return HandleMessage(msg, txn->Txn());
+                });
+            }
             switch (status) {
             case ERR_DISPATCHER_ASYNC:
                 return;
@@ -448,8 +480,12 @@ void Connection::HandleSignals(async_dispatcher_t* dispatcher, async::WaitBase*
         }
     }
 
-    bool call_close = (status != ERR_DISPATCHER_DONE);
-    Terminate(call_close);
+    if (status != ERR_DISPATCHER_DONE) {
+        // Closing the vnode is dispatched like any other message.
+        DispatchGuard guard(vfs_, vnode_);
+        CallClose();
+    }
+    Terminate(/* call_close= */ false);
 }
 
 void Connection::Terminate(bool call_close) {
@@ -510,7 +546,7 @@ zx_status_t Connection::NodeClone(uint32_t flags, zx_handle_t object) {
     fbl::RefPtr<Vnode> vn(vnode_);
     zx_status_t status = ZX_OK;
     if (!IsVnodeRefOnly(clone_flags)) {
-        status = OpenVnode(clone_flags, &vn);
+        status = vfs_->CloneVnode(clone_flags, &vn);
     }
     if (describe) {
         OnOpenMsg response;
@@ -535,7 +571,7 @@ zx_status_t Connection::NodeClose(fidl_txn_t* txn) {
     if (IsVnodeRefOnly(flags_)) {
         status = ZX_OK;
     } else {
-        status = vnode_->Close();
+        status = vfs_->CloseVnode(vnode_.get());
     }
     fuchsia_io_NodeClose_reply(txn, status);
 
@@ -0,0 +1,109 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fs/dentry-cache.h>
+
+#include <fbl/alloc_checker.h>
+#include <fs/vnode.h>
+
+#include <utility>
+
+namespace fs {
+
+DentryCache::Entry::Entry(fbl::RefPtr<Vnode> dir, fbl::StringPiece name,
+                          fbl::RefPtr<Vnode> vnode)
+    : dir_(std::move(dir)), name_(name), vnode_(std::move(vnode)) {}
+
+DentryCache::Entry::~Entry() = default;
+
+DentryCache::DentryCache(const DentryCacheOptions& options) : options_(options) {}
+
+DentryCache::~DentryCache() {
+    Clear();
+}
+
+bool DentryCache::Lookup(Vnode* dir, fbl::StringPiece name, zx_status_t* out_status,
+                         fbl::RefPtr<Vnode>* out) {
+    auto it = entries_.find({dir, name});
+    if (it == entries_.end()) {
+        stats_.misses++;
+        return false;
+    }
+
+    Entry* entry = &*it;
+    lru_.erase(*entry);
+    lru_.push_front(entry);
+    if (entry->vnode() == nullptr) {
+        stats_.negative_hits++;
+        *out_status = ZX_ERR_NOT_FOUND;
+    } else {
+        stats_.hits++;
+        *out_status = ZX_OK;
+        *out = entry->vnode();
+    }
+    return true;
+}
+
+void DentryCache::Insert(fbl::RefPtr<Vnode> dir, fbl::StringPiece name, zx_status_t status,
+                         fbl::RefPtr<Vnode> vn) {
+    if (status == ZX_OK) {
+        if (!options_.positive_entries) {
+            Invalidate(dir.get(), name);
+            return;
+        }
+    } else if (status == ZX_ERR_NOT_FOUND) {
+        vn = nullptr;
+    } else {
+        return;
+    }
+    if (options_.capacity == 0) {
+        return;
+    }
+
+    fbl::unique_ptr<Entry> stale;
+    auto it = entries_.find({dir.get(), name});
+    if (it != entries_.end()) {
+        stale = Remove(&*it);
+    } else if (entries_.size() >= options_.capacity) {
+        stale = Remove(&lru_.back());
+        stats_.evictions++;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Entry> entry(new (&ac) Entry(std::move(dir), name, std::move(vn)));
+    if (!ac.check()) {
+        return;
+    }
+    lru_.push_front(entry.get());
+    entries_.insert(std::move(entry));
+}
+
+fbl::RefPtr<Vnode> DentryCache::Invalidate(Vnode* dir, fbl::StringPiece name) {
+    auto it = entries_.find({dir, name});
+    if (it == entries_.end()) {
+        return nullptr;
+    }
+    return Remove(&*it)->vnode();
+}
+
+void DentryCache::InvalidateDirectory(Vnode* dir) {
+    auto it = entries_.lower_bound({dir, fbl::StringPiece()});
+    while (it.IsValid() && it->key().dir == dir) {
+        Entry* entry = &*it;
+        ++it;
+        Remove(entry);
+    }
+}
+
+void DentryCache::Clear() {
+    lru_.clear();
+    entries_.clear();
+}
+
+fbl::unique_ptr<DentryCache::Entry> DentryCache::Remove(Entry* entry) {
+    lru_.erase(*entry);
+    return entries_.erase(*entry);
+}
+
+} // namespace fs
@@ -0,0 +1,157 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/macros.h>
+#include <fbl/ref_ptr.h>
+#include <fbl/string.h>
+#include <fbl/string_piece.h>
+#include <fbl/unique_ptr.h>
+#include <zircon/types.h>
+
+namespace fs {
+
+class Vnode;
+
+struct DentryCacheOptions {
+    // Maximum number of names remembered.
+    size_t capacity = 1024;
+
+    // Whether successful lookups are remembered, holding a reference to the
+    // vnode they found. If false, only lookups which failed with
+    // ZX_ERR_NOT_FOUND are.
+    bool positive_entries = true;
+};
+
+// Counts of the lookups seen by a DentryCache.
+struct DentryCacheStats {
+    // Lookups answered with a cached vnode.
+    uint64_t hits = 0;
+    // Lookups answered with a cached ZX_ERR_NOT_FOUND.
+    uint64_t negative_hits = 0;
+    // Lookups which had to be forwarded to the filesystem.
+    uint64_t misses = 0;
+    // Entries dropped to make room for newer ones.
+    uint64_t evictions = 0;
+};
+
+// A bounded cache of the results of Vnode::Lookup, keyed by directory and
+// name, which remembers names which don't exist as well as those which do.
+//
+// Each entry holds a reference to its directory, so that a directory which is
+// destroyed and reallocated can't match stale entries, and positive entries
+// hold a reference to the vnode they found. The least recently used entries
+// are evicted when the cache is full.
+//
+// The cache only knows what it is told: its owner must invalidate the names
+// which are created, removed or shadowed by a mount.
+//
+// This class is thread-compatible.
+class DentryCache {
+public:
+    explicit DentryCache(const DentryCacheOptions& options);
+    ~DentryCache();
+
+    // Returns true if the result of looking up |name| in |dir| is cached, in
+    // which case it is returned in |*out_status| and |*out|.
+    bool Lookup(Vnode* dir, fbl::StringPiece name, zx_status_t* out_status,
+                fbl::RefPtr<Vnode>* out);
+
+    // Remembers that looking up |name| in |dir| returned |status| and |vn|.
+    // Results other than ZX_OK and ZX_ERR_NOT_FOUND are ignored, and ZX_OK
+    // only invalidates the name if positive entries aren't kept.
+    void Insert(fbl::RefPtr<Vnode> dir, fbl::StringPiece name, zx_status_t status,
+                fbl::RefPtr<Vnode> vn);
+
+    // Forgets the result of looking up |name| in |dir|, returning the vnode
+    // it found, if any.
+    fbl::RefPtr<Vnode> Invalidate(Vnode* dir, fbl::StringPiece name);
+
+    // Forgets the results of every lookup in |dir|.
+    void InvalidateDirectory(Vnode* dir);
+
+    // Forgets everything.
+    void Clear();
+
+    const DentryCacheStats& stats() const { return stats_; }
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(DentryCache);
+
+    struct Key {
+        const Vnode* dir;
+        fbl::StringPiece name;
+    };
+
+    struct TreeTraits;
+    struct LruTraits;
+    class Entry {
+    public:
+        Entry(fbl::RefPtr<Vnode> dir, fbl::StringPiece name, fbl::RefPtr<Vnode> vnode);
+        ~Entry();
+
+        Key key() const { return {dir_.get(), name_}; }
+        const fbl::RefPtr<Vnode>& vnode() const { return vnode_; }
+
+    private:
+        fbl::RefPtr<Vnode> dir_;
+        fbl::String name_;
+        // Null for a name which doesn't exist.
+        fbl::RefPtr<Vnode> vnode_;
+
+        // Node states.
+        friend TreeTraits;
+        friend LruTraits;
+        fbl::WAVLTreeNodeState<fbl::unique_ptr<Entry>> tree_state_;
+        fbl::DoublyLinkedListNodeState<Entry*> lru_state_;
+    };
+
+    struct KeyTraits {
+        static Key GetKey(const Entry& entry) { return entry.key(); }
+        static bool LessThan(const Key& key1, const Key& key2) {
+            if (key1.dir != key2.dir) {
+                return key1.dir < key2.dir;
+            }
+            return key1.name < key2.name;
+        }
+        static bool EqualTo(const Key& key1, const Key& key2) {
+            return key1.dir == key2.dir && key1.name == key2.name;
+        }
+    };
+
+    struct TreeTraits {
+        using PtrTraits = fbl::internal::ContainerPtrTraits<fbl::unique_ptr<Entry>>;
+        static fbl::WAVLTreeNodeState<fbl::unique_ptr<Entry>>& node_state(Entry& entry) {
+            return entry.tree_state_;
+        }
+    };
+
+    struct LruTraits {
+        static fbl::DoublyLinkedListNodeState<Entry*>& node_state(Entry& entry) {
+            return entry.lru_state_;
+        }
+    };
+
+    using EntryMap = fbl::WAVLTree<Key, fbl::unique_ptr<Entry>, KeyTraits, TreeTraits>;
+    using LruList = fbl::DoublyLinkedList<Entry*, LruTraits>;
+
+    // Removes |entry| from the cache, returning it so that the caller
+    // controls when the vnodes it holds are released.
+    fbl::unique_ptr<Entry> Remove(Entry* entry);
+
+    const DentryCacheOptions options_;
+    DentryCacheStats stats_;
+
+    EntryMap entries_;
+    // Most recently used first.
+    LruList lru_;
+};
+
+} // namespace fs
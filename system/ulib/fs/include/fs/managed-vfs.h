@@ -11,19 +11,24 @@
 #include <lib/async/cpp/task.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/function.h>
+#include <fbl/mutex.h>
 #include <fbl/unique_ptr.h>
 #include <fs/connection.h>
+#include <fs/locking.h>
 #include <fs/vfs.h>
 
+#include <atomic>
+
 namespace fs {
 
 // A specialization of |Vfs| which provides a mechanism to tear down
 // all active connections before it is destroyed.
 //
-// This class is NOT thread-safe and it must be used with a
-// single-threaded asynchronous dispatcher. However, after an operation
-// has been dispatched to a connection, it is safe to defer completion
-// of that operation, returning "ERR_DISPATCHER_ASYNC".
+// This class is thread-safe: its connections may be serviced by a
+// multi-threaded asynchronous dispatcher if |EnableConcurrentDispatch|
+// has been called. After an operation has been dispatched to a
+// connection, it is safe to defer completion of that operation,
+// returning "ERR_DISPATCHER_ASYNC".
 //
 // It is unsafe to shutdown the dispatch loop before shutting down the
 // ManagedVfs object.
@@ -49,11 +54,11 @@ public:
 
 private:
     // Posts the task for OnShutdownComplete if it is safe to do so.
-    void CheckForShutdownComplete();
+    void CheckForShutdownCompleteLocked() FS_TA_REQUIRES(lock_);
 
     // Identifies if the filesystem has fully terminated, and is
     // ready for "OnShutdownComplete" to execute.
-    bool IsTerminated() const;
+    bool IsTerminatedLocked() const FS_TA_REQUIRES(lock_);
 
     // Invokes the handler from |Shutdown| once all connections have been
     // released. Additionally, unmounts all sub-mounted filesystems, if any
@@ -64,11 +69,18 @@ private:
     void UnregisterConnection(Connection* connection) final;
     bool IsTerminating() const final;
 
-    fbl::DoublyLinkedList<fbl::unique_ptr<Connection>> connections_;
+    // Guards the connections and the shutdown state. Connections are
+    // destroyed outside of it, since doing so releases their vnodes.
+    mutable fbl::Mutex lock_;
+
+    fbl::DoublyLinkedList<fbl::unique_ptr<Connection>> connections_ FS_TA_GUARDED(lock_);
+    // Connections which have been unregistered but not yet destroyed.
+    size_t closing_connections_ FS_TA_GUARDED(lock_) = 0;
 
-    bool is_shutting_down_;
+    // Only modified with |lock_| held, but checked by every message.
+    std::atomic<bool> is_shutting_down_;
     async::TaskMethod<ManagedVfs, &ManagedVfs::OnShutdownComplete> shutdown_task_{this};
-    ShutdownCallback shutdown_handler_;
+    ShutdownCallback shutdown_handler_ FS_TA_GUARDED(lock_);
 };
 
 } // namespace fs
@@ -10,6 +10,7 @@
 #include <sys/types.h>
 
 #include <lib/fdio/vfs.h>
+#include <fs/dentry-cache.h>
 #include <fs/locking.h>
 #include <zircon/assert.h>
 #include <zircon/compiler.h>
@@ -37,6 +38,7 @@
 #include <fbl/string_piece.h>
 #include <fbl/unique_ptr.h>
 
+#include <memory>
 #include <utility>
 
 namespace fs {
@@ -98,10 +100,26 @@ public:
                      fbl::StringPiece path, fbl::StringPiece* pathout,
                      uint32_t flags, uint32_t mode) FS_TA_EXCLUDES(vfs_lock_);
     zx_status_t Unlink(fbl::RefPtr<Vnode> vn, fbl::StringPiece path) FS_TA_EXCLUDES(vfs_lock_);
+    zx_status_t Rename(fbl::RefPtr<Vnode> oldparent, fbl::RefPtr<Vnode> newparent,
+                       fbl::StringPiece oldStr, fbl::StringPiece newStr) FS_TA_EXCLUDES(vfs_lock_);
 
     // Sets whether this file system is read-only.
     void SetReadonly(bool value) FS_TA_EXCLUDES(vfs_lock_);
 
+    // Caches the results of looking up path components, including the names
+    // which don't exist. The filesystem must not add or remove names behind
+    // the back of the Vfs, other than through |InvalidateDentryLocked|.
+    void EnableDentryCache(const DentryCacheOptions& options) FS_TA_EXCLUDES(vfs_lock_);
+
+    // Drops every cached lookup, releasing the vnodes held by the cache. A
+    // filesystem which enabled the cache must call this before tearing down
+    // the state its vnodes depend on.
+    void ClearDentryCache() FS_TA_EXCLUDES(vfs_lock_);
+
+    // Returns the statistics of the cache, which are all zero if it is not
+    // enabled.
+    DentryCacheStats GetDentryCacheStats() FS_TA_EXCLUDES(vfs_lock_);
+
 #ifdef __Fuchsia__
     // Unmounts the underlying filesystem.
     //
@@ -134,6 +152,26 @@ public:
     // Begins serving VFS messages over the specified connection.
     zx_status_t ServeConnection(fbl::unique_ptr<Connection> connection) FS_TA_EXCLUDES(vfs_lock_);
 
+    // Allows the connections of this filesystem to be serviced by several
+    // threads of its dispatcher. Messages for connections to the same vnode,
+    // including the close of a connection, are still handled one at a time
+    // under the vnode's own dispatch lock, and |Vnode::Open| and |Vnode::Close|
+    // are serialized with path operations by the vfs lock, but any other
+    // operations may run concurrently: the filesystem must protect the state
+    // its vnodes share.
+    //
+    // Must be called before any connection is served.
+    void EnableConcurrentDispatch();
+
+    // Returns the lock held by a connection to |vn| while it handles a
+    // message, or nullptr if concurrent dispatch is not enabled.
+    fbl::Mutex* DispatchLock(Vnode* vn);
+
+    // Opens |vn| for a cloned connection, or closes it for a connection which
+    // is going away, holding the vfs lock if concurrent dispatch is enabled.
+    zx_status_t CloneVnode(uint32_t flags, fbl::RefPtr<Vnode>* vn) FS_TA_EXCLUDES(vfs_lock_);
+    zx_status_t CloseVnode(Vnode* vn) FS_TA_EXCLUDES(vfs_lock_);
+
     // Called by a VFS connection when it is closed remotely.
     // The VFS is now responsible for destroying the connection.
     void OnConnectionClosedRemotely(Connection* connection) FS_TA_EXCLUDES(vfs_lock_);
@@ -172,6 +210,10 @@ protected:
     // Whether this file system is read-only.
     bool ReadonlyLocked() const FS_TA_REQUIRES(vfs_lock_) { return readonly_; }
 
+    // Forgets the cached lookup of |name| in |dir|, for filesystems which add
+    // names without going through the Vfs.
+    void InvalidateDentryLocked(Vnode* dir, fbl::StringPiece name) FS_TA_REQUIRES(vfs_lock_);
+
 private:
     // Starting at vnode |vn|, walk the tree described by the path string,
     // until either there is only one path segment remaining in the string
@@ -187,8 +229,20 @@ private:
                            fbl::StringPiece path, fbl::StringPiece* pathout,
                            uint32_t flags, uint32_t mode) FS_TA_REQUIRES(vfs_lock_);
 
+    // Looks up the single path component |name| in |vn|, through the cache if
+    // it is enabled.
+    zx_status_t LookupLocked(fbl::RefPtr<Vnode> vn, fbl::StringPiece name,
+                             fbl::RefPtr<Vnode>* out) FS_TA_REQUIRES(vfs_lock_);
+
+    // Forgets the cached lookup of |name| in |dir|, and those within the node
+    // it names, before the name is removed or replaced.
+    void InvalidateNameLocked(fbl::RefPtr<Vnode> dir,
+                              fbl::StringPiece name) FS_TA_REQUIRES(vfs_lock_);
+
     bool readonly_{};
 
+    fbl::unique_ptr<DentryCache> dentry_cache_ FS_TA_GUARDED(vfs_lock_);
+
 #ifdef __Fuchsia__
     zx_status_t TokenToVnode(zx::event token, fbl::RefPtr<Vnode>* out) FS_TA_REQUIRES(vfs_lock_);
     zx_status_t InstallRemoteLocked(fbl::RefPtr<Vnode> vn, MountChannel h) FS_TA_REQUIRES(vfs_lock_);
@@ -197,6 +251,9 @@ private:
 
     fbl::HashTable<zx_koid_t, std::unique_ptr<VnodeToken>> vnode_tokens_;
 
+    // Set by |EnableConcurrentDispatch|.
+    bool concurrent_dispatch_ = false;
+
     // Non-intrusive node in linked list of vnodes acting as mount points
     class MountNode final : public fbl::DoublyLinkedListable<fbl::unique_ptr<MountNode>> {
     public:
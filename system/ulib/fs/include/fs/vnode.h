@@ -28,6 +28,7 @@
 #include <utility>
 
 #ifdef __Fuchsia__
+#include <fbl/mutex.h>
 #include <fuchsia/io/c/fidl.h>
 #include <lib/zx/channel.h>
 #include <zircon/device/vfs.h>
@@ -100,6 +101,10 @@ public:
     virtual zx_status_t GetNodeInfo(uint32_t flags, fuchsia_io_NodeInfo* info) = 0;
 
     virtual zx_status_t WatchDir(Vfs* vfs, uint32_t mask, uint32_t options, zx::channel watcher);
+
+    // Held by the connections to the vnode while they handle a message, if
+    // their Vfs dispatches concurrently.
+    fbl::Mutex* dispatch_lock() { return &dispatch_lock_; }
 #endif
 
     // Closes vn. Will be called once for each successful Open().
@@ -217,6 +222,11 @@ public:
 protected:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Vnode);
     Vnode();
+
+#ifdef __Fuchsia__
+private:
+    fbl::Mutex dispatch_lock_;
+#endif
 };
 
 // Opens a vnode by reference.
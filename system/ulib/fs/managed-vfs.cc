@@ -4,6 +4,7 @@
 
 #include <fs/managed-vfs.h>
 
+#include <fbl/auto_lock.h>
 #include <fbl/unique_ptr.h>
 #include <lib/async/cpp/task.h>
 #include <lib/sync/completion.h>
@@ -20,58 +21,87 @@ ManagedVfs::~ManagedVfs() {
     ZX_DEBUG_ASSERT(connections_.is_empty());
 }
 
-bool ManagedVfs::IsTerminated() const {
-    return is_shutting_down_ && connections_.is_empty();
+bool ManagedVfs::IsTerminatedLocked() const {
+    return is_shutting_down_ && connections_.is_empty() && closing_connections_ == 0;
 }
 
 // Asynchronously drop all connections.
 void ManagedVfs::Shutdown(ShutdownCallback handler) {
     ZX_DEBUG_ASSERT(handler);
     zx_status_t status = async::PostTask(dispatcher(), [this, closure = std::move(handler)]() mutable {
-        ZX_DEBUG_ASSERT(!shutdown_handler_);
-        shutdown_handler_ = std::move(closure);
-        is_shutting_down_ = true;
+        {
+            fbl::AutoLock lock(&lock_);
+            ZX_DEBUG_ASSERT(!shutdown_handler_);
+            shutdown_handler_ = std::move(closure);
+            is_shutting_down_ = true;
+        }
 
         UninstallAll(ZX_TIME_INFINITE);
 
+        fbl::AutoLock lock(&lock_);
         // Signal the teardown on channels in a way that doesn't potentially
         // pull them out from underneath async callbacks.
         for (auto& c : connections_) {
             c.AsyncTeardown();
         }
 
-        CheckForShutdownComplete();
+        CheckForShutdownCompleteLocked();
     });
     ZX_DEBUG_ASSERT(status == ZX_OK);
 }
 
 // Trigger "OnShutdownComplete" if all preconditions have been met.
-void ManagedVfs::CheckForShutdownComplete() {
-    if (IsTerminated()) {
+void ManagedVfs::CheckForShutdownCompleteLocked() {
+    if (IsTerminatedLocked()) {
         shutdown_task_.Post(dispatcher());
     }
 }
 
 void ManagedVfs::OnShutdownComplete(async_dispatcher_t*, async::TaskBase*, zx_status_t status) {
-    ZX_ASSERT_MSG(IsTerminated(),
-                  "Failed to complete VFS shutdown: dispatcher status = %d\n", status);
-    ZX_DEBUG_ASSERT(shutdown_handler_);
+    ShutdownCallback handler;
+    {
+        fbl::AutoLock lock(&lock_);
+        if (status == ZX_OK && !IsTerminatedLocked()) {
+            // A connection was registered by another thread after the task
+            // was posted. The task is posted again once it is destroyed.
+            return;
+        }
+        ZX_ASSERT_MSG(IsTerminatedLocked(),
+                      "Failed to complete VFS shutdown: dispatcher status = %d\n", status);
+        ZX_DEBUG_ASSERT(shutdown_handler_);
+        handler = std::move(shutdown_handler_);
+    }
 
-    auto handler = std::move(shutdown_handler_);
+    // The handler may destroy this object.
     handler(status);
 }
 
 void ManagedVfs::RegisterConnection(fbl::unique_ptr<Connection> connection) {
-    ZX_DEBUG_ASSERT(!is_shutting_down_);
+    fbl::AutoLock lock(&lock_);
+    if (is_shutting_down_) {
+        // Another dispatcher thread began the shutdown while this connection
+        // was being opened; it is torn down like the others.
+        connection->AsyncTeardown();
+    }
     connections_.push_back(std::move(connection));
 }
 
 void ManagedVfs::UnregisterConnection(Connection* connection) {
-    // We drop the result of |erase| on the floor, effectively destroying the
-    // connection when all other references (like async callbacks) have
-    // completed.
-    connections_.erase(*connection);
-    CheckForShutdownComplete();
+    fbl::unique_ptr<Connection> closing;
+    {
+        fbl::AutoLock lock(&lock_);
+        closing = connections_.erase(*connection);
+        closing_connections_++;
+    }
+
+    // Destroy the connection, now that all other references (like async
+    // callbacks) have completed, without holding the lock: this may release
+    // the last reference to its vnode.
+    closing.reset();
+
+    fbl::AutoLock lock(&lock_);
+    closing_connections_--;
+    CheckForShutdownCompleteLocked();
 }
 
 bool ManagedVfs::IsTerminating() const {
@@ -47,6 +47,12 @@ const char* GetMetricName(uint32_t metric_id) {
         return "Vnode.Unlink";
     case Event::kLink:
         return "Vnode.Link";
+    case Event::kDentryCacheHit:
+        return "DentryCache.Hit";
+    case Event::kDentryCacheNegativeHit:
+        return "DentryCache.NegativeHit";
+    case Event::kDentryCacheMiss:
+        return "DentryCache.Miss";
     default:
         return "kUnknown";
     };
@@ -72,6 +78,19 @@ cobalt_client::HistogramOptions MakeHistogramOptions(const cobalt_client::Histog
     return options;
 }
 
+cobalt_client::MetricOptions MakeCounterOptions(const fbl::String& fs_name, bool local_metrics,
+                                                Event metric_id) {
+    cobalt_client::MetricOptions options;
+    options.component = fs_name;
+    options.SetMode(local_metrics ? cobalt_client::MetricOptions::Mode::kRemoteAndLocal
+                                  : cobalt_client::MetricOptions::Mode::kRemote);
+    options.metric_id = static_cast<uint32_t>(metric_id);
+    options.event_code = static_cast<uint32_t>(VnodeCobalt::EventCode::kUnknown);
+    options.get_metric_name = GetMetricName;
+    options.get_event_name = nullptr;
+    return options;
+}
+
 } // namespace
 
 VnodeMetrics::VnodeMetrics(cobalt_client::Collector* collector, const fbl::String& fs_name,
@@ -130,10 +149,20 @@ VnodeMetrics::VnodeMetrics(cobalt_client::Collector* collector, const fbl::Strin
         collector);
 }
 
+DentryCacheMetrics::DentryCacheMetrics(cobalt_client::Collector* collector,
+                                       const fbl::String& fs_name, bool local_metrics) {
+    hits.Initialize(MakeCounterOptions(fs_name, local_metrics, Event::kDentryCacheHit),
+                    collector);
+    negative_hits.Initialize(
+        MakeCounterOptions(fs_name, local_metrics, Event::kDentryCacheNegativeHit), collector);
+    misses.Initialize(MakeCounterOptions(fs_name, local_metrics, Event::kDentryCacheMiss),
+                      collector);
+}
+
 Metrics::Metrics(cobalt_client::CollectorOptions options, bool local_metrics,
                  const fbl::String& fs_name)
     : collector_(std::move(options)), vnode_metrics_(&collector_, fs_name, local_metrics),
-      is_enabled_(false) {}
+      dentry_cache_metrics_(&collector_, fs_name, local_metrics), is_enabled_(false) {}
 
 const VnodeMetrics& Metrics::vnode_metrics() const {
     return vnode_metrics_;
@@ -143,6 +172,14 @@ VnodeMetrics* Metrics::mutable_vnode_metrics() {
     return &vnode_metrics_;
 }
 
+const DentryCacheMetrics& Metrics::dentry_cache_metrics() const {
+    return dentry_cache_metrics_;
+}
+
+DentryCacheMetrics* Metrics::mutable_dentry_cache_metrics() {
+    return &dentry_cache_metrics_;
+}
+
 void Metrics::EnableMetrics(bool should_enable) {
     is_enabled_ = should_enable;
     vnode_metrics_.metrics_enabled = should_enable;
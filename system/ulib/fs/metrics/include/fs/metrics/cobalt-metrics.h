@@ -7,6 +7,7 @@
 #include <cstdint>
 
 #include <cobalt-client/cpp/collector.h>
+#include <cobalt-client/cpp/counter.h>
 #include <cobalt-client/cpp/histogram.h>
 #include <fbl/string.h>
 
@@ -38,6 +39,19 @@ struct VnodeMetrics {
     bool metrics_enabled = false;
 };
 
+// Path lookup cache counters, as reported by fs::Vfs::GetDentryCacheStats.
+struct DentryCacheMetrics {
+    DentryCacheMetrics(cobalt_client::Collector* collector, const fbl::String& fs_name,
+                       bool local_metrics);
+
+    // Lookups answered with a cached vnode.
+    cobalt_client::Counter hits;
+    // Lookups answered with a cached ZX_ERR_NOT_FOUND.
+    cobalt_client::Counter negative_hits;
+    // Lookups forwarded to the filesystem.
+    cobalt_client::Counter misses;
+};
+
 // Provides a base class for collecting metrics in FS implementations. This is optional, but
 // provides a source of truth of how data is collected for filesystems. Specific filesystem
 // implementations with custom APIs can extend and collect more data, but for basic operations, this
@@ -70,10 +84,14 @@ public:
     const VnodeMetrics& vnode_metrics() const;
     VnodeMetrics* mutable_vnode_metrics();
 
+    const DentryCacheMetrics& dentry_cache_metrics() const;
+    DentryCacheMetrics* mutable_dentry_cache_metrics();
+
 protected:
     cobalt_client::Collector collector_;
 
     VnodeMetrics vnode_metrics_;
+    DentryCacheMetrics dentry_cache_metrics_;
 
     bool is_enabled_ = false;
 };
@@ -29,6 +29,11 @@ enum class Event : uint32_t {
 
     // Fs Manager Level operation.
     kDataCorruption = 14,
+
+    // Vfs Level path lookup cache.
+    kDentryCacheHit = 15,
+    kDentryCacheNegativeHit = 16,
+    kDentryCacheMiss = 17,
 };
 
 // Collection of Vnode Events.
@@ -47,6 +52,17 @@ constexpr Event kFsManagerEvents[] = {Event::kDataCorruption};
 // Number of different metric types recorded at Fs Manager level.
 constexpr uint64_t kFsManagerEventCount = fbl::count_of(kFsManagerEvents);
 
+// Collection of path lookup cache events, which are counted rather than
+// timed.
+constexpr Event kDentryCacheEvents[] = {
+    Event::kDentryCacheHit,
+    Event::kDentryCacheNegativeHit,
+    Event::kDentryCacheMiss,
+};
+
+// Number of different counters recorded for the path lookup cache.
+constexpr uint64_t kDentryCacheEventCount = fbl::count_of(kDentryCacheEvents);
+
 // Total number of events in the registry.
 constexpr uint64_t kEventCount = kVnodeEventCount + kFsManagerEventCount;
 
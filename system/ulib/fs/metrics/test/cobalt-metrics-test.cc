@@ -114,5 +114,20 @@ TEST(CobaltMetrics, AddCustomMetric) {
     // Sanity check.
     metrics.mutable_collector()->Flush();
 }
+
+TEST(CobaltMetricsTest, DentryCacheCounters) {
+    fs_metrics::Metrics metrics(MakeOptions(), /*local_metrics*/ false, "TestFs");
+    metrics.EnableMetrics(/*should_collect*/ true);
+
+    fs_metrics::DentryCacheMetrics* dentry_cache = metrics.mutable_dentry_cache_metrics();
+    ASSERT_NOT_NULL(dentry_cache);
+    dentry_cache->hits.Increment(3);
+    dentry_cache->negative_hits.Increment(2);
+    dentry_cache->misses.Increment();
+
+    EXPECT_EQ(metrics.dentry_cache_metrics().hits.GetRemoteCount(), 3);
+    EXPECT_EQ(metrics.dentry_cache_metrics().negative_hits.GetRemoteCount(), 2);
+    EXPECT_EQ(metrics.dentry_cache_metrics().misses.GetRemoteCount(), 1);
+}
 } // namespace
 } // namespace fs_metrics
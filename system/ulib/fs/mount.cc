@@ -61,9 +61,13 @@ zx_status_t Vfs::InstallRemote(fbl::RefPtr<Vnode> vn, MountChannel h) {
     if (status != ZX_OK) {
         return status;
     }
+    fbl::AutoLock lock(&vfs_lock_);
+    if (dentry_cache_ != nullptr) {
+        // The contents of the node are now shadowed by the remote.
+        dentry_cache_->InvalidateDirectory(vn.get());
+    }
     // Save this node in the list of mounted vnodes
     mount_point->SetNode(std::move(vn));
-    fbl::AutoLock lock(&vfs_lock_);
     remote_list_.push_front(std::move(mount_point));
     return ZX_OK;
 }
@@ -84,6 +88,9 @@ zx_status_t Vfs::InstallRemoteLocked(fbl::RefPtr<Vnode> vn, MountChannel h) {
     if (status != ZX_OK) {
         return status;
     }
+    if (dentry_cache_ != nullptr) {
+        dentry_cache_->InvalidateDirectory(vn.get());
+    }
     // Save this node in the list of mounted vnodes
     mount_point->SetNode(std::move(vn));
     remote_list_.push_front(std::move(mount_point));
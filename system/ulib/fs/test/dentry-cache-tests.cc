@@ -0,0 +1,232 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sys/stat.h>
+
+#include <fbl/string.h>
+#include <fbl/vector.h>
+#include <fs/dentry-cache.h>
+#include <fs/synchronous-vfs.h>
+#include <fs/vfs.h>
+#include <fs/vnode.h>
+#include <fuchsia/io/c/fidl.h>
+#include <unittest/unittest.h>
+
+#include <utility>
+
+namespace {
+
+// A directory which counts the lookups it serves.
+class TestDir : public fs::Vnode {
+public:
+    explicit TestDir(bool* destroyed = nullptr) : destroyed_(destroyed) {}
+    ~TestDir() {
+        if (destroyed_ != nullptr) {
+            *destroyed_ = true;
+        }
+    }
+
+    int lookups() const { return lookups_; }
+
+    void AddChild(fbl::StringPiece name, fbl::RefPtr<TestDir> node) {
+        children_.push_back({fbl::String(name), std::move(node)});
+    }
+
+    zx_status_t Lookup(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name) final {
+        lookups_++;
+        for (const Child& child : children_) {
+            if (child.name.ToStringPiece() == name) {
+                *out = child.node;
+                return ZX_OK;
+            }
+        }
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    zx_status_t Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name,
+                       uint32_t mode) final {
+        for (const Child& child : children_) {
+            if (child.name.ToStringPiece() == name) {
+                return ZX_ERR_ALREADY_EXISTS;
+            }
+        }
+        fbl::RefPtr<TestDir> node = fbl::AdoptRef(new TestDir());
+        AddChild(name, node);
+        *out = std::move(node);
+        return ZX_OK;
+    }
+
+    zx_status_t Unlink(fbl::StringPiece name, bool must_be_dir) final {
+        for (size_t i = 0; i < children_.size(); i++) {
+            if (children_[i].name.ToStringPiece() == name) {
+                children_.erase(i);
+                return ZX_OK;
+            }
+        }
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    bool IsDirectory() const final { return true; }
+
+    zx_status_t GetNodeInfo(uint32_t flags, fuchsia_io_NodeInfo* info) final {
+        info->tag = fuchsia_io_NodeInfoTag_directory;
+        return ZX_OK;
+    }
+
+private:
+    struct Child {
+        fbl::String name;
+        fbl::RefPtr<TestDir> node;
+    };
+
+    bool* destroyed_;
+    int lookups_ = 0;
+    fbl::Vector<Child> children_;
+};
+
+zx_status_t Open(fs::Vfs* vfs, fbl::RefPtr<TestDir> root, const char* path,
+                 fbl::RefPtr<fs::Vnode>* out) {
+    fbl::StringPiece path_out;
+    return vfs->Open(std::move(root), out, path, &path_out, ZX_FS_RIGHT_READABLE, 0);
+}
+
+zx_status_t Mkdir(fs::Vfs* vfs, fbl::RefPtr<TestDir> root, const char* path) {
+    fbl::RefPtr<fs::Vnode> out;
+    fbl::StringPiece path_out;
+    return vfs->Open(std::move(root), &out, path, &path_out,
+                     ZX_FS_FLAG_CREATE | ZX_FS_FLAG_EXCLUSIVE | ZX_FS_RIGHT_READABLE, S_IFDIR);
+}
+
+bool TestDentryCacheEntries() {
+    BEGIN_TEST;
+
+    fs::DentryCacheOptions options;
+    options.capacity = 2;
+    fs::DentryCache cache(options);
+    fbl::RefPtr<TestDir> dir = fbl::AdoptRef(new TestDir());
+    fbl::RefPtr<TestDir> child = fbl::AdoptRef(new TestDir());
+
+    zx_status_t status;
+    fbl::RefPtr<fs::Vnode> out;
+    EXPECT_FALSE(cache.Lookup(dir.get(), "child", &status, &out));
+    cache.Insert(dir, "child", ZX_OK, child);
+    cache.Insert(dir, "missing", ZX_ERR_NOT_FOUND, nullptr);
+    // Other failures aren't remembered.
+    cache.Insert(dir, "bad", ZX_ERR_IO, nullptr);
+    EXPECT_FALSE(cache.Lookup(dir.get(), "bad", &status, &out));
+
+    EXPECT_TRUE(cache.Lookup(dir.get(), "child", &status, &out));
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(out.get(), child.get());
+    EXPECT_TRUE(cache.Lookup(dir.get(), "missing", &status, &out));
+    EXPECT_EQ(status, ZX_ERR_NOT_FOUND);
+
+    // "child" is the least recently used entry, so it makes room for "other".
+    cache.Insert(dir, "other", ZX_ERR_NOT_FOUND, nullptr);
+    EXPECT_FALSE(cache.Lookup(dir.get(), "child", &status, &out));
+    EXPECT_TRUE(cache.Lookup(dir.get(), "missing", &status, &out));
+
+    EXPECT_EQ(cache.stats().hits, 1);
+    EXPECT_EQ(cache.stats().negative_hits, 2);
+    EXPECT_EQ(cache.stats().misses, 3);
+    EXPECT_EQ(cache.stats().evictions, 1);
+
+    // Entries are keyed by directory.
+    cache.Insert(child, "missing", ZX_ERR_NOT_FOUND, nullptr);
+    cache.InvalidateDirectory(dir.get());
+    EXPECT_FALSE(cache.Lookup(dir.get(), "missing", &status, &out));
+    EXPECT_TRUE(cache.Lookup(child.get(), "missing", &status, &out));
+    EXPECT_NULL(cache.Invalidate(child.get(), "missing"));
+    EXPECT_FALSE(cache.Lookup(child.get(), "missing", &status, &out));
+
+    END_TEST;
+}
+
+bool TestDentryCacheNegativeOnly() {
+    BEGIN_TEST;
+
+    fs::DentryCacheOptions options;
+    options.positive_entries = false;
+    fs::DentryCache cache(options);
+    fbl::RefPtr<TestDir> dir = fbl::AdoptRef(new TestDir());
+    fbl::RefPtr<TestDir> child = fbl::AdoptRef(new TestDir());
+
+    zx_status_t status;
+    fbl::RefPtr<fs::Vnode> out;
+    cache.Insert(dir, "child", ZX_ERR_NOT_FOUND, nullptr);
+    EXPECT_TRUE(cache.Lookup(dir.get(), "child", &status, &out));
+
+    // Finding the name forgets that it was missing.
+    cache.Insert(dir, "child", ZX_OK, child);
+    EXPECT_FALSE(cache.Lookup(dir.get(), "child", &status, &out));
+
+    END_TEST;
+}
+
+bool TestVfsDentryCache() {
+    BEGIN_TEST;
+
+    fs::SynchronousVfs vfs;
+    fs::DentryCacheOptions options;
+    vfs.EnableDentryCache(options);
+    fbl::RefPtr<TestDir> root = fbl::AdoptRef(new TestDir());
+    fbl::RefPtr<TestDir> dir = fbl::AdoptRef(new TestDir());
+    root->AddChild("dir", dir);
+
+    // Repeated lookups, successful or not, only reach the filesystem once.
+    fbl::RefPtr<fs::Vnode> out;
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(Open(&vfs, root, "dir/missing", &out), ZX_ERR_NOT_FOUND);
+    }
+    EXPECT_EQ(root->lookups(), 1);
+    EXPECT_EQ(dir->lookups(), 1);
+    fs::DentryCacheStats stats = vfs.GetDentryCacheStats();
+    EXPECT_EQ(stats.hits, 2);
+    EXPECT_EQ(stats.negative_hits, 2);
+    EXPECT_EQ(stats.misses, 2);
+
+    // Creating the name replaces the negative entry.
+    EXPECT_EQ(Mkdir(&vfs, root, "dir/missing"), ZX_OK);
+    EXPECT_EQ(Open(&vfs, root, "dir/missing", &out), ZX_OK);
+    EXPECT_EQ(dir->lookups(), 1);
+
+    // Unlinking it forgets it.
+    EXPECT_EQ(vfs.Unlink(dir, "missing"), ZX_OK);
+    EXPECT_EQ(Open(&vfs, root, "dir/missing", &out), ZX_ERR_NOT_FOUND);
+
+    vfs.ClearDentryCache();
+    EXPECT_EQ(Open(&vfs, root, "dir", &out), ZX_OK);
+    EXPECT_EQ(root->lookups(), 2);
+
+    END_TEST;
+}
+
+bool TestVfsDentryCacheReleasesUnlinked() {
+    BEGIN_TEST;
+
+    fs::SynchronousVfs vfs;
+    fs::DentryCacheOptions options;
+    vfs.EnableDentryCache(options);
+    fbl::RefPtr<TestDir> root = fbl::AdoptRef(new TestDir());
+    bool destroyed = false;
+    root->AddChild("dir", fbl::AdoptRef(new TestDir(&destroyed)));
+
+    // The negative entry within the directory holds a reference to it, which
+    // is dropped when the directory is unlinked.
+    fbl::RefPtr<fs::Vnode> out;
+    EXPECT_EQ(Open(&vfs, root, "dir/missing", &out), ZX_ERR_NOT_FOUND);
+    EXPECT_EQ(vfs.Unlink(root, "dir"), ZX_OK);
+    EXPECT_TRUE(destroyed);
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(dentry_cache_tests)
+RUN_TEST(TestDentryCacheEntries)
+RUN_TEST(TestDentryCacheNegativeOnly)
+RUN_TEST(TestVfsDentryCache)
+RUN_TEST(TestVfsDentryCacheReleasesUnlinked)
+END_TEST_CASE(dentry_cache_tests)
@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string.h>
+
 #include <fs/managed-vfs.h>
 #include <fs/synchronous-vfs.h>
 #include <fs/vfs.h>
@@ -15,6 +17,7 @@
 
 #include <unittest/unittest.h>
 
+#include <atomic>
 #include <utility>
 
 namespace {
@@ -93,6 +96,49 @@ private:
     sync_completion_t* completions_;
 };
 
+// A vnode whose Getattr blocks until it is released.
+class SlowGetattrVnode : public FdCountVnode {
+public:
+    SlowGetattrVnode(sync_completion_t* started, sync_completion_t* release)
+        : started_(started), release_(release) {}
+
+    int getattrs() const {
+        return getattrs_.load();
+    }
+
+    zx_status_t Getattr(vnattr_t* attr) final {
+        getattrs_++;
+        sync_completion_signal(started_);
+        sync_completion_wait(release_, ZX_TIME_INFINITE);
+        memset(attr, 0, sizeof(*attr));
+        return ZX_OK;
+    }
+
+private:
+    std::atomic<int> getattrs_ = 0;
+    sync_completion_t* started_;
+    sync_completion_t* release_;
+};
+
+bool serve_vnode(fs::Vfs* vfs, fbl::RefPtr<FdCountVnode> vn, zx::channel* client) {
+    BEGIN_HELPER;
+    zx::channel server;
+    ASSERT_EQ(zx::channel::create(0, client, &server), ZX_OK);
+    ASSERT_EQ(vn->Open(0, nullptr), ZX_OK);
+    ASSERT_EQ(vn->Serve(vfs, std::move(server), 0), ZX_OK);
+    END_HELPER;
+}
+
+bool send_getattr(const zx::channel& client) {
+    BEGIN_HELPER;
+    fuchsia_io_NodeGetAttrRequest request;
+    memset(&request, 0, sizeof(request));
+    request.hdr.txid = 5;
+    request.hdr.ordinal = fuchsia_io_NodeGetAttrOrdinal;
+    ASSERT_EQ(client.write(0, &request, sizeof(request), nullptr, 0), ZX_OK);
+    END_HELPER;
+}
+
 bool send_sync(const zx::channel& client) {
     BEGIN_HELPER;
     fuchsia_io_NodeSyncRequest request;
@@ -346,6 +392,62 @@ bool TestSynchronousTeardown() {
     END_TEST;
 }
 
+// Test a case where the connections of the VFS are serviced by several
+// threads, and one of them is blocked inside a vnode.
+bool TestConcurrentDispatchTeardown() {
+    BEGIN_TEST;
+
+    async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+    auto vfs = std::make_unique<fs::ManagedVfs>(loop.dispatcher());
+    vfs->EnableConcurrentDispatch();
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(loop.StartThread(), ZX_OK);
+    }
+
+    sync_completion_t started;
+    sync_completion_t release;
+    auto slow = fbl::AdoptRef(new SlowGetattrVnode(&started, &release));
+    auto fast = fbl::AdoptRef(new FdCountVnode());
+    ASSERT_NE(vfs->DispatchLock(slow.get()), vfs->DispatchLock(fast.get()));
+
+    zx::channel slow_client1, slow_client2, fast_client;
+    ASSERT_TRUE(serve_vnode(vfs.get(), slow, &slow_client1));
+    ASSERT_TRUE(serve_vnode(vfs.get(), slow, &slow_client2));
+    ASSERT_TRUE(serve_vnode(vfs.get(), fast, &fast_client));
+
+    // Block a thread inside the slow vnode.
+    ASSERT_TRUE(send_getattr(slow_client1));
+    ASSERT_EQ(sync_completion_wait(&started, ZX_SEC(3)), ZX_OK);
+
+    // Another vnode is still served...
+    int32_t getattr_status;
+    fuchsia_io_NodeAttributes attributes;
+    ASSERT_EQ(fuchsia_io_NodeGetAttr(fast_client.get(), &getattr_status, &attributes), ZX_OK);
+
+    // ... but other connections to the slow one wait for it.
+    sync_completion_reset(&started);
+    ASSERT_TRUE(send_getattr(slow_client2));
+    ASSERT_EQ(sync_completion_wait(&started, ZX_MSEC(10)), ZX_ERR_TIMED_OUT);
+    EXPECT_EQ(slow->getattrs(), 1);
+
+    sync_completion_signal(&release);
+    ASSERT_EQ(slow_client1.wait_one(ZX_CHANNEL_READABLE, zx::time::infinite(), nullptr), ZX_OK);
+    ASSERT_EQ(slow_client2.wait_one(ZX_CHANNEL_READABLE, zx::time::infinite(), nullptr), ZX_OK);
+    EXPECT_EQ(slow->getattrs(), 2);
+
+    sync_completion_t shutdown_done;
+    vfs->Shutdown([&shutdown_done](zx_status_t status) {
+        ZX_ASSERT(status == ZX_OK);
+        sync_completion_signal(&shutdown_done);
+    });
+    ASSERT_EQ(sync_completion_wait(&shutdown_done, ZX_SEC(3)), ZX_OK);
+    EXPECT_EQ(slow->fds(), 0);
+    EXPECT_EQ(fast->fds(), 0);
+    vfs = nullptr;
+
+    END_TEST;
+}
+
 } // namespace
 
 BEGIN_TEST_CASE(teardown_tests)
@@ -355,4 +457,5 @@ RUN_TEST(TestTeardownDeleteThis)
 RUN_TEST(TestTeardownSlowAsyncCallback)
 RUN_TEST(TestTeardownSlowClone)
 RUN_TEST(TestSynchronousTeardown)
+RUN_TEST(TestConcurrentDispatchTeardown)
 END_TEST_CASE(teardown_tests)
@@ -7,6 +7,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <fs/trace.h>
 #include <fs/vfs.h>
@@ -58,16 +59,6 @@ zx_status_t TrimName(fbl::StringPiece name, fbl::StringPiece* name_out, bool* di
     return ZX_OK;
 }
 
-zx_status_t LookupNode(fbl::RefPtr<Vnode> vn, fbl::StringPiece name, fbl::RefPtr<Vnode>* out) {
-    if (name == "..") {
-        return ZX_ERR_INVALID_ARGS;
-    } else if (name == ".") {
-        *out = std::move(vn);
-        return ZX_OK;
-    }
-    return vn->Lookup(out, name);
-}
-
 // Validate open flags as much as they can be validated
 // independently of the target node.
 zx_status_t PrevalidateFlags(uint32_t flags) {
@@ -172,12 +163,15 @@ zx_status_t Vfs::OpenLocked(fbl::RefPtr<Vnode> vndir, fbl::RefPtr<Vnode>* out,
             }
             return r;
         }
+        if (dentry_cache_ != nullptr) {
+            dentry_cache_->Insert(vndir, path, ZX_OK, vn);
+        }
 #ifdef __Fuchsia__
         vndir->Notify(path, fuchsia_io_WATCH_EVENT_ADDED);
 #endif
     } else {
     try_open:
-        r = LookupNode(std::move(vndir), path, &vn);
+        r = LookupLocked(std::move(vndir), path, &vn);
         if (r < 0) {
             return r;
         }
@@ -235,6 +229,7 @@ zx_status_t Vfs::Unlink(fbl::RefPtr<Vnode> vndir, fbl::StringPiece path) {
         if (ReadonlyLocked()) {
             r = ZX_ERR_ACCESS_DENIED;
         } else {
+            InvalidateNameLocked(vndir, path);
             r = vndir->Unlink(path, must_be_dir);
         }
     }
@@ -247,6 +242,48 @@ zx_status_t Vfs::Unlink(fbl::RefPtr<Vnode> vndir, fbl::StringPiece path) {
     return ZX_OK;
 }
 
+zx_status_t Vfs::Rename(fbl::RefPtr<Vnode> oldparent, fbl::RefPtr<Vnode> newparent,
+                        fbl::StringPiece oldStr, fbl::StringPiece newStr) {
+    // Local filesystem
+    bool old_must_be_dir;
+    bool new_must_be_dir;
+    zx_status_t r;
+    if ((r = TrimName(oldStr, &oldStr, &old_must_be_dir)) != ZX_OK) {
+        return r;
+    } else if (oldStr == ".") {
+        return ZX_ERR_UNAVAILABLE;
+    } else if (oldStr == "..") {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    if ((r = TrimName(newStr, &newStr, &new_must_be_dir)) != ZX_OK) {
+        return r;
+    } else if (newStr == "." || newStr == "..") {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    {
+#ifdef __Fuchsia__
+        fbl::AutoLock lock(&vfs_lock_);
+#endif
+        if (ReadonlyLocked()) {
+            return ZX_ERR_ACCESS_DENIED;
+        }
+        InvalidateDentryLocked(oldparent.get(), oldStr);
+        InvalidateNameLocked(newparent, newStr);
+        r = oldparent->Rename(newparent, oldStr, newStr, old_must_be_dir,
+                              new_must_be_dir);
+    }
+    if (r != ZX_OK) {
+        return r;
+    }
+#ifdef __Fuchsia__
+    oldparent->Notify(oldStr, fuchsia_io_WATCH_EVENT_REMOVED);
+    newparent->Notify(newStr, fuchsia_io_WATCH_EVENT_ADDED);
+#endif
+    return ZX_OK;
+}
+
 #ifdef __Fuchsia__
 
 #define TOKEN_RIGHTS (ZX_RIGHTS_BASIC)
@@ -315,43 +352,15 @@ zx_status_t Vfs::TokenToVnode(zx::event token, fbl::RefPtr<Vnode>* out) {
 
 zx_status_t Vfs::Rename(zx::event token, fbl::RefPtr<Vnode> oldparent,
                         fbl::StringPiece oldStr, fbl::StringPiece newStr) {
-    // Local filesystem
-    bool old_must_be_dir;
-    bool new_must_be_dir;
-    zx_status_t r;
-    if ((r = TrimName(oldStr, &oldStr, &old_must_be_dir)) != ZX_OK) {
-        return r;
-    } else if (oldStr == ".") {
-        return ZX_ERR_UNAVAILABLE;
-    } else if (oldStr == "..") {
-        return ZX_ERR_INVALID_ARGS;
-    }
-
-    if ((r = TrimName(newStr, &newStr, &new_must_be_dir)) != ZX_OK) {
-        return r;
-    } else if (newStr == "." || newStr == "..") {
-        return ZX_ERR_INVALID_ARGS;
-    }
-
     fbl::RefPtr<fs::Vnode> newparent;
     {
         fbl::AutoLock lock(&vfs_lock_);
-        if (ReadonlyLocked()) {
-            return ZX_ERR_ACCESS_DENIED;
-        }
+        zx_status_t r;
         if ((r = TokenToVnode(std::move(token), &newparent)) != ZX_OK) {
             return r;
         }
-
-        r = oldparent->Rename(newparent, oldStr, newStr, old_must_be_dir,
-                              new_must_be_dir);
-    }
-    if (r != ZX_OK) {
-        return r;
     }
-    oldparent->Notify(oldStr, fuchsia_io_WATCH_EVENT_REMOVED);
-    newparent->Notify(newStr, fuchsia_io_WATCH_EVENT_ADDED);
-    return ZX_OK;
+    return Rename(std::move(oldparent), std::move(newparent), oldStr, newStr);
 }
 
 zx_status_t Vfs::Readdir(Vnode* vn, vdircookie_t* cookie,
@@ -393,23 +402,55 @@ zx_status_t Vfs::Link(zx::event token, fbl::RefPtr<Vnode> oldparent,
 
     // Look up the target vnode
     fbl::RefPtr<Vnode> target;
-    if ((r = oldparent->Lookup(&target, oldStr)) < 0) {
+    if ((r = LookupLocked(oldparent, oldStr, &target)) < 0) {
         return r;
     }
     r = newparent->Link(newStr, target);
     if (r != ZX_OK) {
         return r;
     }
+    InvalidateDentryLocked(newparent.get(), newStr);
     newparent->Notify(newStr, fuchsia_io_WATCH_EVENT_ADDED);
     return ZX_OK;
 }
 
+void Vfs::EnableConcurrentDispatch() {
+    concurrent_dispatch_ = true;
+}
+
+fbl::Mutex* Vfs::DispatchLock(Vnode* vn) {
+    // Each vnode has a lock of its own, so that a connection blocked in one
+    // vnode, such as on a page fault of a cold file, never holds up another.
+    return concurrent_dispatch_ ? vn->dispatch_lock() : nullptr;
+}
+
+zx_status_t Vfs::CloneVnode(uint32_t flags, fbl::RefPtr<Vnode>* vn) {
+    if (!concurrent_dispatch_) {
+        return OpenVnode(flags, vn);
+    }
+    fbl::AutoLock lock(&vfs_lock_);
+    return OpenVnode(flags, vn);
+}
+
+zx_status_t Vfs::CloseVnode(Vnode* vn) {
+    if (!concurrent_dispatch_) {
+        return vn->Close();
+    }
+    fbl::AutoLock lock(&vfs_lock_);
+    return vn->Close();
+}
+
 zx_status_t Vfs::ServeConnection(fbl::unique_ptr<Connection> connection) {
     ZX_DEBUG_ASSERT(connection);
 
-    zx_status_t status = connection->Serve();
-    if (status == ZX_OK) {
-        RegisterConnection(std::move(connection));
+    // The connection is registered before it is served, since another
+    // dispatcher thread may handle its first message, and unregister it,
+    // as soon as it is waiting on its channel.
+    Connection* raw = connection.get();
+    RegisterConnection(std::move(connection));
+    zx_status_t status = raw->Serve();
+    if (status != ZX_OK) {
+        UnregisterConnection(raw);
     }
     return status;
 }
@@ -448,6 +489,82 @@ void Vfs::SetReadonly(bool value) {
     readonly_ = value;
 }
 
+void Vfs::EnableDentryCache(const DentryCacheOptions& options) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DentryCache> cache(new (&ac) DentryCache(options));
+    if (!ac.check()) {
+        // The cache is only an optimization.
+        return;
+    }
+#ifdef __Fuchsia__
+    fbl::AutoLock lock(&vfs_lock_);
+#endif
+    dentry_cache_ = std::move(cache);
+}
+
+void Vfs::ClearDentryCache() {
+#ifdef __Fuchsia__
+    fbl::AutoLock lock(&vfs_lock_);
+#endif
+    if (dentry_cache_ != nullptr) {
+        dentry_cache_->Clear();
+    }
+}
+
+DentryCacheStats Vfs::GetDentryCacheStats() {
+#ifdef __Fuchsia__
+    fbl::AutoLock lock(&vfs_lock_);
+#endif
+    if (dentry_cache_ == nullptr) {
+        return DentryCacheStats();
+    }
+    return dentry_cache_->stats();
+}
+
+void Vfs::InvalidateDentryLocked(Vnode* dir, fbl::StringPiece name) {
+    if (dentry_cache_ != nullptr) {
+        dentry_cache_->Invalidate(dir, name);
+    }
+}
+
+void Vfs::InvalidateNameLocked(fbl::RefPtr<Vnode> dir, fbl::StringPiece name) {
+    if (dentry_cache_ == nullptr) {
+        return;
+    }
+    // The entries within the node go too, since they hold a reference to it;
+    // look it up if its own entry isn't cached.
+    fbl::RefPtr<Vnode> vn = dentry_cache_->Invalidate(dir.get(), name);
+    if (vn == nullptr && dir->Lookup(&vn, name) != ZX_OK) {
+        return;
+    }
+    dentry_cache_->InvalidateDirectory(vn.get());
+}
+
+zx_status_t Vfs::LookupLocked(fbl::RefPtr<Vnode> vn, fbl::StringPiece name,
+                              fbl::RefPtr<Vnode>* out) {
+    if (name == "..") {
+        return ZX_ERR_INVALID_ARGS;
+    } else if (name == ".") {
+        *out = std::move(vn);
+        return ZX_OK;
+    }
+    if (dentry_cache_ == nullptr) {
+        return vn->Lookup(out, name);
+    }
+
+    zx_status_t r;
+    if (dentry_cache_->Lookup(vn.get(), name, &r, out)) {
+        return r;
+    }
+    fbl::RefPtr<Vnode> found;
+    r = vn->Lookup(&found, name);
+    dentry_cache_->Insert(vn, name, r, found);
+    if (r == ZX_OK) {
+        *out = std::move(found);
+    }
+    return r;
+}
+
 zx_status_t Vfs::Walk(fbl::RefPtr<Vnode> vn, fbl::RefPtr<Vnode>* out_vn,
                       fbl::StringPiece path, fbl::StringPiece* out_path) {
     zx_status_t r;
@@ -489,7 +606,7 @@ zx_status_t Vfs::Walk(fbl::RefPtr<Vnode> vn, fbl::RefPtr<Vnode>* out_vn,
         if (component.length() > NAME_MAX) {
             return ZX_ERR_BAD_PATH;
         }
-        if ((r = LookupNode(std::move(vn), component, &vn)) != ZX_OK) {
+        if ((r = LookupLocked(std::move(vn), component, &vn)) != ZX_OK) {
             return r;
         }
         // Traverse to the next segment.
@@ -97,8 +97,9 @@ public:
 
     // Asynchronous completion. When an issued operation has completed
     // asynchronously, this function should be called. The status of the operation
-    // should be set in |sop|’s result field. This function is non-blocking and
-    // safe to call from an interrupt handler context.
+    // should be set in |sop|’s result field. The op is released to the client
+    // from this context, and Wake() may be invoked if the completion allows
+    // ops held back by a barrier to be issued.
     void AsyncComplete(StreamOp* sop) __TA_EXCLUDES(stream_lock_);
 
     // API invoked by worker threads.
@@ -118,23 +119,33 @@ public:
                         UniqueOp* out_list, size_t* out_actual,
                         size_t* out_num_ready = nullptr) __TA_EXCLUDES(stream_lock_);
 
-    // Remove an op from the scheduler queue.
+    // Remove the next op to be issued from the scheduler queue. Ops are taken
+    // from the highest priority stream which has an op ready to be issued, and
+    // round-robin between streams of equal priority.
     //
     // Ownership:
-    //    If successful, ownership of the op is transferred to the caller.
+    //    If successful, ownership of the op is transferred to the caller, which
+    // must issue it and then either pass it to Release() or, if it is being
+    // completed asynchronously, to AsyncComplete().
     //
     // If no ops are available:
-    //      returns ZX_ERR_CANCELED if shutdown has started.
+    //      returns ZX_ERR_CANCELED if shutdown has started and all ops have completed.
     //      returns ZX_ERR_SHOULD_WAIT if |wait| is false.
-    //      otherwise returns ZX_ERR_SHOULD_WAIT.
+    //      otherwise blocks until an op is ready to be issued.
     zx_status_t Dequeue(UniqueOp* op_out, bool wait) __TA_EXCLUDES(stream_lock_);
 
+    // Report that an op returned by Dequeue() has completed, and release it to the client.
+    void Release(UniqueOp op) __TA_EXCLUDES(stream_lock_);
+
 private:
     using StreamIdMap = Stream::WAVLTreeSortById;
     using StreamList = Stream::ListUnsorted;
 
     zx_status_t FindStreamLocked(uint32_t id, StreamRef* out) __TA_REQUIRES(stream_lock_);
 
+    // Pop the next op to be issued from the active streams, if any is ready.
+    zx_status_t PopLocked(UniqueOp* op_out) __TA_REQUIRES(stream_lock_);
+
     SchedulerClient* client_ = nullptr; // Client-supplied callback interface.
     uint32_t options_ = 0;              // Ordering options.
 
@@ -147,11 +158,14 @@ private:
     uint32_t active_streams_ __TA_GUARDED(stream_lock_) = 0;
     // Total number of acquired ops in all streams.
     uint32_t acquired_ops_ __TA_GUARDED(stream_lock_) = 0;
+    // Total number of issued ops in all streams which have not yet been released.
+    uint32_t issued_ops_ __TA_GUARDED(stream_lock_) = 0;
     // Map of id to stream. Contains all streams.
     StreamIdMap stream_map_ __TA_GUARDED(stream_lock_);
     // List of streams that have ops ready to be scheduled.
     StreamList active_list_ __TA_GUARDED(stream_lock_);
-    // Event notifying worker threads that active streams are available.
+    // Event notifying worker threads that ops may be ready to issue, or that
+    // all ops have completed.
     fbl::ConditionVariable active_available_ __TA_GUARDED(stream_lock_);
 
     fbl::Vector<fbl::unique_ptr<Worker>> workers_;
@@ -11,17 +11,20 @@
 namespace ioscheduler {
 
 // Callback interface from Scheduler to client. Callbacks are made from within
-// the Scheduler library to the client implementation. All callbacks are made
-// with no locks held and are allowed to block. Any callbacks may be invoked
-// simultanously, and one may be called multiple times concurrently, but never
-// with the same data. Notably, Acquire(), Issue(), and Release() may be called
-// multiple times after CancelAcquire() has been called.
+// the Scheduler library to the client implementation. All callbacks except
+// CanReorder() are made with no locks held and are allowed to block. Any
+// callbacks may be invoked simultanously, and one may be called multiple times
+// concurrently, but never with the same data. Notably, Acquire(), Issue(), and
+// Release() may be called multiple times after CancelAcquire() has been called.
 class SchedulerClient {
 public:
     // CanReorder
     //   Compare if ops can be reordered with respect to each other. This
     // function is called for every pair of ops whose position in
-    // the stream is being considered for reorder relative to each other.
+    // the stream is being considered for reorder relative to each other,
+    // after the scheduler's own ordering options and barriers have permitted
+    // it. It is called with the scheduler's lock held, so it must not block
+    // or call into the scheduler.
     // Returns:
     //   true if it is safe to reorder |second| ahead of |first|.
     //   false otherwise.
@@ -37,7 +40,8 @@ public:
     //   actual_count - the number of entries filled in sop_list.
     //   wait - block until data is available if true.
     // Returns:
-    //   ZX_OK if one or more ops have been added to the list.
+    //   ZX_OK if one or more ops have been added to the list, or if a blocking
+    //     call has been interrupted by Wake().
     //   ZX_ERR_CANCELED if op source has been closed.
     //   ZX_ERR_SHOULD_WAIT if ops are currently unavailable and |wait| is
     //     false.
@@ -71,6 +75,12 @@ public:
     //   sop - op to be released.
     virtual void Release(StreamOp* sop) = 0;
 
+    // Wake
+    //   Ops which were held back by a barrier may now be issued. Causes a
+    // pending or the next blocking call to Acquire to return, with zero ops if
+    // none are available, so that the worker can issue them.
+    virtual void Wake() = 0;
+
     // CancelAcquire
     //   Cancels any pending blocking calls to Acquire. No further reading of
     // ops should be done. Blocked Acquire callers and any subsequent Acquire
@@ -132,7 +132,7 @@ public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(StreamOp);
 
     OpType type() { return type_; }
-    void set_ype(OpType type) { type_ = type; }
+    void set_type(OpType type) { type_ = type; }
 
     uint32_t stream() { return stream_id_; }
     void set_stream(uint32_t stream_id) { stream_id_ = stream_id; }
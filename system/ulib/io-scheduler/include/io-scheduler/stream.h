@@ -11,6 +11,7 @@
 #include <fbl/ref_ptr.h>
 #include <zircon/types.h>
 
+#include <io-scheduler/scheduler-client.h>
 #include <io-scheduler/stream-op.h>
 
 namespace ioscheduler {
@@ -32,6 +33,7 @@ public:
     uint32_t Priority() { return priority_; }
 
     void Close();
+    bool IsOpen() { return open_; }
 
     // Functions requiring the Scheduler stream lock be held.
     // ---------------------------------------------------------
@@ -40,12 +42,22 @@ public:
     // On error op's error status is set and it is moved to |*op_err|.
     zx_status_t Push(UniqueOp op, UniqueOp* op_err);
 
-    // Fetch an op from the head of the stream.
-    UniqueOp Pop();
+    // Fetch the earliest op which may be issued, and account for it as issued.
+    // Ops are reordered ahead of earlier ones only as permitted by |options|,
+    // the barriers in the stream and |client|.
+    // Returns ZX_ERR_SHOULD_WAIT if every op is held back until an issued op completes.
+    zx_status_t Pop(SchedulerClient* client, uint32_t options, UniqueOp* op_out);
+
+    // Account for the completion of an op issued from this stream.
+    // Returns true if this allows a barrier which was holding back the stream to be issued.
+    bool Complete(StreamOp* op);
 
     // Does the stream contain any ops that are not yet issued?
     bool IsEmpty() { return (num_acquired_ == 0); }
 
+    // Does the stream contain any ops that are not yet issued or completed?
+    bool IsIdle() { return (num_acquired_ == 0) && (num_issued_ == 0); }
+
     // ---------------------------------------------------------
     // End functions requiring stream lock.
 
@@ -76,6 +88,9 @@ private:
     friend struct WAVLTreeNodeTraitsSortById;
     friend struct KeyTraitsSortById;
 
+    // Have all issued ops which |barrier| waits for completed?
+    bool BarrierReady(StreamOp* barrier);
+
     WAVLTreeNodeState map_node_;
     ListNodeState list_node_;
     uint32_t id_;
@@ -84,6 +99,11 @@ private:
 
     uint32_t num_acquired_ = 0; // Number of ops acquired and waiting for issue.
     fbl::DoublyLinkedList<StreamOp*> acquired_list_;
+
+    uint32_t num_issued_ = 0;   // Number of ops issued and waiting for completion.
+    uint32_t issued_reads_ = 0; // Number of issued ops with read ordering.
+    uint32_t issued_writes_ = 0; // Number of issued ops with write ordering.
+    bool blocked_ = false;      // The earliest op is a barrier waiting for completions.
 };
 
 
@@ -83,10 +83,11 @@ zx_status_t Scheduler::StreamClose(uint32_t id) {
     StreamRef stream = iter.CopyPointer();
     stream->Close();
     // Once closed, the stream cannot transition from idle to active.
-    if (stream->IsEmpty()) {
+    if (stream->IsIdle()) {
         // Stream is inactive, delete here.
-        // Otherwise, it will be deleted by the worker that drains it.
+        // Otherwise, it will be deleted when its last op is released.
         stream_map_.erase(*stream);
+        num_streams_--;
     }
     return ZX_OK;
 }
@@ -111,7 +112,7 @@ zx_status_t Scheduler::Serve() {
 }
 
 void Scheduler::AsyncComplete(StreamOp* sop) {
-    ZX_DEBUG_ASSERT(false); // Not yet implemented.
+    Release(UniqueOp(sop));
 }
 
 Scheduler::~Scheduler() {
@@ -167,9 +168,12 @@ zx_status_t Scheduler::Enqueue(UniqueOp* in_list, size_t in_count,
 
 zx_status_t Scheduler::Dequeue(UniqueOp* op_out, bool wait) {
     fbl::AutoLock lock(&stream_lock_);
-    while (acquired_ops_ == 0) {
-        ZX_DEBUG_ASSERT(active_list_.is_empty());
-        if (shutdown_initiated_) {
+    for ( ; ; ) {
+        if (PopLocked(op_out) == ZX_OK) {
+            return ZX_OK;
+        }
+        if (shutdown_initiated_ && (acquired_ops_ == 0) && (issued_ops_ == 0)) {
+            ZX_DEBUG_ASSERT(active_list_.is_empty());
             return ZX_ERR_CANCELED;
         }
         if (!wait) {
@@ -177,20 +181,79 @@ zx_status_t Scheduler::Dequeue(UniqueOp* op_out, bool wait) {
         }
         active_available_.Wait(&stream_lock_);
     }
-    ZX_DEBUG_ASSERT(!active_list_.is_empty());
-    StreamRef stream = active_list_.pop_front();
-    ZX_DEBUG_ASSERT(stream != nullptr);
+}
 
-    *op_out = stream->Pop();
-    acquired_ops_--;
-    if (stream->IsEmpty()) {
-        // Stream has been removed from active list.
-        active_streams_--;
-    } else {
-        // Return stream to tail of active list.
-        active_list_.push_back(std::move(stream));
+zx_status_t Scheduler::PopLocked(UniqueOp* op_out) {
+    // Try streams in decreasing order of priority, since a higher priority
+    // stream may have all of its ops held back by barriers.
+    uint32_t ceiling = kMaxPriority + 1;
+    for ( ; ; ) {
+        bool found = false;
+        uint32_t priority = 0;
+        for (auto& stream : active_list_) {
+            if ((stream.Priority() < ceiling) && (!found || (stream.Priority() > priority))) {
+                priority = stream.Priority();
+                found = true;
+            }
+        }
+        if (!found) {
+            return ZX_ERR_SHOULD_WAIT;
+        }
+
+        for (auto iter = active_list_.begin(); iter != active_list_.end(); ++iter) {
+            if ((iter->Priority() != priority) ||
+                (iter->Pop(client_, options_, op_out) != ZX_OK)) {
+                continue;
+            }
+            acquired_ops_--;
+            issued_ops_++;
+            StreamRef stream = active_list_.erase(iter);
+            if (stream->IsEmpty()) {
+                // Stream has been removed from active list.
+                active_streams_--;
+            } else {
+                // Return stream to tail of active list.
+                active_list_.push_back(std::move(stream));
+            }
+            return ZX_OK;
+        }
+        ceiling = priority;
+    }
+}
+
+void Scheduler::Release(UniqueOp op) {
+    SchedulerClient* client;
+    StreamRef stream;
+    bool wake;
+    {
+        fbl::AutoLock lock(&stream_lock_);
+        client = client_;
+        zx_status_t status = FindStreamLocked(op->stream(), &stream);
+        ZX_DEBUG_ASSERT(status == ZX_OK);
+        wake = stream->Complete(op.get());
+    }
+
+    client->Release(op.release());
+    if (wake) {
+        client->Wake();
+    }
+
+    // The op is only accounted as released once the client has seen it, so that
+    // shutdown waits for it.
+    fbl::AutoLock lock(&stream_lock_);
+    issued_ops_--;
+    if (!stream->IsOpen() && stream->IsIdle()) {
+        // Last op of a closed stream. Concurrent releases may both observe this,
+        // so only remove the stream if it is still in the map.
+        StreamRef mapped;
+        if ((FindStreamLocked(stream->Id(), &mapped) == ZX_OK) && (mapped == stream)) {
+            stream_map_.erase(*stream);
+            num_streams_--;
+        }
+    }
+    if ((acquired_ops_ > 0) || (shutdown_initiated_ && (issued_ops_ == 0))) {
+        active_available_.Broadcast();
     }
-    return ZX_OK;
 }
 
 zx_status_t Scheduler::FindStreamLocked(uint32_t id, StreamRef* out) {
@@ -7,11 +7,79 @@
 
 namespace ioscheduler {
 
+namespace {
+
+// Ordering classes of an op.
+constexpr uint32_t kClassRead  = (1u << 0);
+constexpr uint32_t kClassWrite = (1u << 1);
+
+// Maximum number of ops examined for issue when the head of a stream is held back.
+constexpr uint32_t kMaxReorderDepth = 16;
+
+uint32_t OrderClasses(OpType type) {
+    switch (type) {
+    case OpType::kOpTypeUnknown:
+        return 0;
+    case OpType::kOpTypeRead:
+    case OpType::kOpTypeReadBarrier:
+        return kClassRead;
+    case OpType::kOpTypeWrite:
+    case OpType::kOpTypeDiscard:
+    case OpType::kOpTypeSync:
+    case OpType::kOpTypeWriteBarrier:
+    case OpType::kOpTypeWriteCompleteBarrier:
+        return kClassWrite;
+    default:
+        // Renames, commands, ordered ops and full barriers.
+        return kClassRead | kClassWrite;
+    }
+}
+
+bool IsBarrier(OpType type) {
+    return type >= OpType::kOpTypeReadBarrier;
+}
+
+// Can |later| be issued ahead of the unissued |earlier| op?
+bool CanReorder(SchedulerClient* client, uint32_t options, StreamOp* earlier, StreamOp* later) {
+    // Ordered ops, including barriers, are never issued ahead of earlier ops, and
+    // nothing is issued ahead of an ordered op which is not a barrier.
+    if ((later->type() >= OpType::kOpTypeOrderedUnknown) ||
+        (earlier->type() == OpType::kOpTypeOrderedUnknown)) {
+        return false;
+    }
+    const uint32_t earlier_classes = OrderClasses(earlier->type());
+    const uint32_t later_classes = OrderClasses(later->type());
+    // Barriers hold back the classes of ops they order.
+    if (IsBarrier(earlier->type()) && (earlier_classes & later_classes)) {
+        return false;
+    }
+    if ((later_classes & kClassRead) && (earlier_classes & kClassRead) &&
+        !(options & kOptionReorderReads)) {
+        return false;
+    }
+    if ((later_classes & kClassWrite) && (earlier_classes & kClassWrite) &&
+        !(options & kOptionReorderWrites)) {
+        return false;
+    }
+    if ((later_classes & kClassRead) && (earlier_classes & kClassWrite) &&
+        !(options & kOptionReorderReadsAheadOfWrites)) {
+        return false;
+    }
+    if ((later_classes & kClassWrite) && (earlier_classes & kClassRead) &&
+        !(options & kOptionReorderWritesAheadOfReads)) {
+        return false;
+    }
+    return client->CanReorder(earlier, later);
+}
+
+} // namespace
+
 Stream::Stream(uint32_t id, uint32_t pri) : id_(id), priority_(pri) {}
 
 Stream::~Stream() {
     ZX_DEBUG_ASSERT(open_ == false);
     ZX_DEBUG_ASSERT(acquired_list_.is_empty());
+    ZX_DEBUG_ASSERT(num_issued_ == 0);
 }
 
 void Stream::Close() {
@@ -30,11 +98,70 @@ zx_status_t Stream::Push(UniqueOp op, UniqueOp* op_err) {
     return ZX_OK;
 }
 
-UniqueOp Stream::Pop() {
-    UniqueOp op(acquired_list_.pop_front());
-    ZX_DEBUG_ASSERT(op != nullptr);
+bool Stream::BarrierReady(StreamOp* barrier) {
+    switch (barrier->type()) {
+    case OpType::kOpTypeWriteCompleteBarrier:
+        return (issued_writes_ == 0);
+    case OpType::kOpTypeFullCompleteBarrier:
+        return (num_issued_ == 0);
+    default:
+        // Issue barriers only wait for earlier ops to be issued, which they
+        // have been once the barrier is at the head of the stream.
+        return true;
+    }
+}
+
+zx_status_t Stream::Pop(SchedulerClient* client, uint32_t options, UniqueOp* op_out) {
+    blocked_ = false;
+    StreamOp* op = nullptr;
+    uint32_t depth = 0;
+    for (auto candidate = acquired_list_.begin();
+         candidate.IsValid() && (depth < kMaxReorderDepth); ++candidate, ++depth) {
+        if (depth == 0) {
+            if (IsBarrier(candidate->type()) && !BarrierReady(&*candidate)) {
+                blocked_ = true;
+                continue;
+            }
+        } else {
+            // The head is held back. Look for a later op which may pass every op ahead of it.
+            bool can_issue = true;
+            for (auto earlier = acquired_list_.begin(); earlier != candidate; ++earlier) {
+                if (!CanReorder(client, options, &*earlier, &*candidate)) {
+                    can_issue = false;
+                    break;
+                }
+            }
+            if (!can_issue) {
+                continue;
+            }
+        }
+        op = acquired_list_.erase(candidate);
+        break;
+    }
+    if (op == nullptr) {
+        return ZX_ERR_SHOULD_WAIT;
+    }
+
     num_acquired_--;
-    return op;
+    const uint32_t classes = OrderClasses(op->type());
+    num_issued_++;
+    issued_reads_ += (classes & kClassRead) ? 1 : 0;
+    issued_writes_ += (classes & kClassWrite) ? 1 : 0;
+    op_out->set(op);
+    return ZX_OK;
+}
+
+bool Stream::Complete(StreamOp* op) {
+    const uint32_t classes = OrderClasses(op->type());
+    ZX_DEBUG_ASSERT(num_issued_ > 0);
+    num_issued_--;
+    issued_reads_ -= (classes & kClassRead) ? 1 : 0;
+    issued_writes_ -= (classes & kClassWrite) ? 1 : 0;
+    if (blocked_ && !acquired_list_.is_empty() && BarrierReady(&acquired_list_.front())) {
+        blocked_ = false;
+        return true;
+    }
+    return false;
 }
 
 } // namespace ioscheduler
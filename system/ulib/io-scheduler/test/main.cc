@@ -10,6 +10,7 @@
 #include <fbl/intrusive_double_list.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
+#include <fbl/vector.h>
 #include <zxtest/zxtest.h>
 
 #include <io-scheduler/io-scheduler.h>
@@ -18,6 +19,7 @@ namespace {
 
 using IoScheduler = ioscheduler::Scheduler;
 using SchedOp = ioscheduler::StreamOp;
+using OpType = ioscheduler::OpType;
 
 enum {
     kStageInput = 0,
@@ -31,8 +33,9 @@ enum {
 class TestOp : public fbl::DoublyLinkedListable<fbl::RefPtr<TestOp>>,
                public fbl::RefCounted<TestOp> {
 public:
-    TestOp(uint32_t id, uint32_t stream_id, uint32_t group = ioscheduler::kOpGroupNone) : id_(id),
-        sop_(ioscheduler::OpType::kOpTypeUnknown, stream_id, group, 0, this) {}
+    TestOp(uint32_t id, uint32_t stream_id, uint32_t group = ioscheduler::kOpGroupNone,
+           OpType type = OpType::kOpTypeUnknown) : id_(id),
+        sop_(type, stream_id, group, 0, this) {}
 
     void set_id(uint32_t id) { id_ = id; }
     uint32_t id() { return id_; }
@@ -45,6 +48,7 @@ public:
     zx_status_t result() { return sop_.result(); }
     SchedOp* sop() { return &sop_; }
     bool async() { return async_; }
+    void set_async(bool async) { async_ = async; }
 
     uint32_t stage() { return stage_; }
     void set_stage(uint32_t stage) { stage_ = stage; }
@@ -75,6 +79,8 @@ protected:
         issued_total_ = 0;
         completed_total_ = 0;
         released_total_ = 0;
+        woken_ = false;
+        issue_order_.reset();
         sched_.reset(new IoScheduler());
     }
 
@@ -97,15 +103,28 @@ protected:
     void WaitAcquire();
     void CheckExpectedResult();
 
+    // Wait until |count| ops have been issued.
+    void WaitIssued(uint32_t count);
+
+    // Complete the asynchronous op |id|, which must have been issued.
+    void CompleteAsync(uint32_t id);
+
+    // Complete asynchronous ops as they are issued until |count| ops have completed.
+    void CompleteAllAsync(uint32_t count);
+
+    // Ids of ops in the order they were issued.
+    void GetIssueOrder(fbl::Vector<uint32_t>* out);
+
     // Callback methods.
     bool CanReorder(SchedOp* first, SchedOp* second) override {
-        return false;
+        return true;
     }
 
     zx_status_t Acquire(SchedOp** sop_list, size_t list_count,
                            size_t* actual_count, bool wait) override;
     zx_status_t Issue(SchedOp* sop) override;
     void Release(SchedOp* sop) override;
+    void Wake() override;
     void CancelAcquire() override;
     void Fatal() override;
 
@@ -117,6 +136,7 @@ private:
     fbl::Mutex lock_;
     bool end_requested_ __TA_GUARDED(lock_) = false;    // Request closing the stream.
     bool end_of_stream_ __TA_GUARDED(lock_) = false;    // Stream has been closed.
+    bool woken_ __TA_GUARDED(lock_) = false;            // Wake() called since last Acquire.
 
     // Fields to track the ops passing through the stages of the pipeline.
 
@@ -140,6 +160,9 @@ private:
     // Used by the acquire callback to block on input.
     fbl::ConditionVariable in_avail_ __TA_GUARDED(lock_);
 
+    // Event signalling an op has been issued.
+    fbl::ConditionVariable issued_ __TA_GUARDED(lock_);
+
     // Event signalling all pending ops have been acquired.  Used by test shutdown threads to drain
     // the input pipeline.
     fbl::ConditionVariable acquired_all_ __TA_GUARDED(lock_);
@@ -158,6 +181,9 @@ private:
 
     // List of ops released by the scheduler.
     fbl::DoublyLinkedList<TopRef> released_list_ __TA_GUARDED(lock_);
+
+    // Ids of issued ops, in issue order.
+    fbl::Vector<uint32_t> issue_order_ __TA_GUARDED(lock_);
 };
 
 void IOSchedTestFixture::InsertOp(TopRef top) {
@@ -207,10 +233,76 @@ void IOSchedTestFixture::CheckExpectedResult() {
     }
 }
 
+void IOSchedTestFixture::WaitIssued(uint32_t count) {
+    fbl::AutoLock lock(&lock_);
+    while (issued_total_ < count) {
+        issued_.Wait(&lock_);
+    }
+}
+
+void IOSchedTestFixture::CompleteAsync(uint32_t id) {
+    SchedOp* sop = nullptr;
+    {
+        fbl::AutoLock lock(&lock_);
+        for (auto& top : issued_list_) {
+            if (top.id() == id) {
+                top.set_result(top.should_fail() ? ZX_ERR_BAD_PATH : ZX_OK);
+                top.set_stage(kStageCompleted);
+                completed_total_++;
+                sop = top.sop();
+                break;
+            }
+        }
+    }
+    ZX_ASSERT(sop != nullptr);
+    // The op stays on the issued list until released.
+    sched_->AsyncComplete(sop);
+}
+
+void IOSchedTestFixture::CompleteAllAsync(uint32_t count) {
+    for ( ; ; ) {
+        uint32_t id;
+        {
+            fbl::AutoLock lock(&lock_);
+            if (completed_total_ == count) {
+                return;
+            }
+            TestOp* next = nullptr;
+            while (next == nullptr) {
+                for (auto& top : issued_list_) {
+                    if (top.stage() == kStageIssued) {
+                        next = &top;
+                        break;
+                    }
+                }
+                if (next == nullptr) {
+                    issued_.Wait(&lock_);
+                }
+            }
+            id = next->id();
+        }
+        CompleteAsync(id);
+    }
+}
+
+void IOSchedTestFixture::GetIssueOrder(fbl::Vector<uint32_t>* out) {
+    fbl::AutoLock lock(&lock_);
+    out->reset();
+    for (uint32_t id : issue_order_) {
+        out->push_back(id);
+    }
+}
+
 zx_status_t IOSchedTestFixture::Acquire(SchedOp** sop_list, size_t list_count,
                                         size_t* actual_count, bool wait) {
     fbl::AutoLock lock(&lock_);
     while (in_list_.is_empty()) {
+        if (woken_) {
+            // Interrupted so that held back ops can be issued.
+            woken_ = false;
+            *actual_count = 0;
+            return ZX_OK;
+        }
         if (end_requested_) {
             end_of_stream_ = true;
             acquired_all_.Broadcast();
@@ -240,7 +332,9 @@ zx_status_t IOSchedTestFixture::Acquire(SchedOp** sop_list, size_t list_count,
 zx_status_t IOSchedTestFixture::Issue(SchedOp* sop) {
     fbl::AutoLock lock(&lock_);
     issued_total_++;
+    issued_.Broadcast();
     TopRef top = acquired_list_.erase(*static_cast<TestOp*>(sop->cookie()));
+    issue_order_.push_back(top->id());
     if (top->async()) {
         // Will be completed asynchronously.
         top->set_stage(kStageIssued);
@@ -274,7 +368,11 @@ void IOSchedTestFixture::Release(SchedOp* sop) {
         ref = issued_list_.erase(*top);
         break;
     case kStageCompleted:
-        ref = completed_list_.erase(*top);
+        if (top->async()) {
+            ref = issued_list_.erase(*top);
+        } else {
+            ref = completed_list_.erase(*top);
+        }
         break;
     default:
         fprintf(stderr, "Invalid op stage %u\n", stage);
@@ -286,6 +384,12 @@ void IOSchedTestFixture::Release(SchedOp* sop) {
     released_total_++;
 }
 
+void IOSchedTestFixture::Wake() {
+    fbl::AutoLock lock(&lock_);
+    woken_ = true;
+    in_avail_.Signal();
+}
+
 void IOSchedTestFixture::CancelAcquire() {
     fbl::AutoLock lock(&lock_);
     if (!end_of_stream_) {
@@ -344,6 +448,7 @@ void IOSchedTestFixture::DoServeTest(uint32_t num_ops, bool async, uint32_t fail
 
     for (uint32_t i = 0; i < num_ops; i++) {
         TopRef top = fbl::AdoptRef(new TestOp(i, 0));
+        top->set_async(async);
         if (fail_pct) {
             if((static_cast<uint32_t>(rand()) % 100u) < fail_pct) {
                 top->set_should_fail(true);
@@ -353,6 +458,10 @@ void IOSchedTestFixture::DoServeTest(uint32_t num_ops, bool async, uint32_t fail
     }
     ASSERT_OK(sched_->Serve(), "Failed to begin service");
 
+    if (async) {
+        CompleteAllAsync(num_ops);
+    }
+
     // Wait until all ops have been acquired.
     WaitAcquire();
 
@@ -375,6 +484,14 @@ TEST_F(IOSchedTestFixture, ServeTestMultiFailures) {
     DoServeTest(200, false, 10);
 }
 
+TEST_F(IOSchedTestFixture, ServeTestAsync) {
+    DoServeTest(200, true, 0);
+}
+
+TEST_F(IOSchedTestFixture, ServeTestAsyncFailures) {
+    DoServeTest(200, true, 10);
+}
+
 TEST_F(IOSchedTestFixture, ServeTestMultistream) {
     zx_status_t status = sched_->Init(this, ioscheduler::kOptionStrictlyOrdered);
     ASSERT_OK(status, "Failed to init scheduler");
@@ -413,5 +530,103 @@ TEST_F(IOSchedTestFixture, ServeTestMultistream) {
     CheckExpectedResult();
 }
 
-} // namespace
+// Ops from higher priority streams are issued first.
+TEST_F(IOSchedTestFixture, PriorityTest) {
+    ASSERT_OK(sched_->Init(this, ioscheduler::kOptionStrictlyOrdered));
+    ASSERT_OK(sched_->StreamOpen(0, 1));
+    ASSERT_OK(sched_->StreamOpen(1, ioscheduler::kMaxPriority));
 
+    // Few enough ops to be acquired together.
+    const uint32_t num_ops = 8;
+    for (uint32_t i = 0; i < num_ops; i++) {
+        InsertOp(fbl::AdoptRef(new TestOp(i, i % 2)));
+    }
+    ASSERT_OK(sched_->Serve());
+    WaitAcquire();
+    ASSERT_OK(sched_->StreamClose(0));
+    ASSERT_OK(sched_->StreamClose(1));
+    sched_->Shutdown();
+
+    fbl::Vector<uint32_t> order;
+    GetIssueOrder(&order);
+    ASSERT_EQ(num_ops, order.size());
+    for (uint32_t i = 0; i < num_ops; i++) {
+        // Odd ops, from stream 1, are issued first.
+        EXPECT_EQ((i < num_ops / 2) ? 1u : 0u, order[i] % 2);
+    }
+    CheckExpectedResult();
+}
+
+// A write complete barrier holds back later writes until earlier writes complete,
+// but reads may be issued ahead of it.
+TEST_F(IOSchedTestFixture, WriteCompleteBarrierTest) {
+    ASSERT_OK(sched_->Init(this, ioscheduler::kOptionFullyOutOfOrder));
+    ASSERT_OK(sched_->StreamOpen(0, ioscheduler::kDefaultPriority));
+
+    TopRef write = fbl::AdoptRef(new TestOp(0, 0, ioscheduler::kOpGroupNone,
+                                            OpType::kOpTypeWrite));
+    write->set_async(true);
+    InsertOp(std::move(write));
+    InsertOp(fbl::AdoptRef(new TestOp(1, 0, ioscheduler::kOpGroupNone,
+                                      OpType::kOpTypeWriteCompleteBarrier)));
+    InsertOp(fbl::AdoptRef(new TestOp(2, 0, ioscheduler::kOpGroupNone, OpType::kOpTypeRead)));
+    InsertOp(fbl::AdoptRef(new TestOp(3, 0, ioscheduler::kOpGroupNone, OpType::kOpTypeWrite)));
+    ASSERT_OK(sched_->Serve());
+
+    // The read passes the barrier while the write is outstanding.
+    WaitIssued(2);
+    fbl::Vector<uint32_t> order;
+    GetIssueOrder(&order);
+    ASSERT_EQ(2u, order.size());
+    EXPECT_EQ(0u, order[0]);
+    EXPECT_EQ(2u, order[1]);
+
+    // Completing the write releases the barrier and the write behind it.
+    CompleteAsync(0);
+    WaitIssued(4);
+    GetIssueOrder(&order);
+    ASSERT_EQ(4u, order.size());
+    EXPECT_EQ(1u, order[2]);
+    EXPECT_EQ(3u, order[3]);
+
+    WaitAcquire();
+    ASSERT_OK(sched_->StreamClose(0));
+    sched_->Shutdown();
+    CheckExpectedResult();
+}
+
+// Without reordering options, nothing is issued ahead of a barrier.
+TEST_F(IOSchedTestFixture, StrictlyOrderedBarrierTest) {
+    ASSERT_OK(sched_->Init(this, ioscheduler::kOptionStrictlyOrdered));
+    ASSERT_OK(sched_->StreamOpen(0, ioscheduler::kDefaultPriority));
+
+    TopRef write = fbl::AdoptRef(new TestOp(0, 0, ioscheduler::kOpGroupNone,
+                                            OpType::kOpTypeWrite));
+    write->set_async(true);
+    InsertOp(std::move(write));
+    InsertOp(fbl::AdoptRef(new TestOp(1, 0, ioscheduler::kOpGroupNone,
+                                      OpType::kOpTypeFullCompleteBarrier)));
+    InsertOp(fbl::AdoptRef(new TestOp(2, 0, ioscheduler::kOpGroupNone, OpType::kOpTypeRead)));
+    ASSERT_OK(sched_->Serve());
+
+    WaitIssued(1);
+    // Give the worker a chance to misbehave.
+    usleep(10000);
+    fbl::Vector<uint32_t> order;
+    GetIssueOrder(&order);
+    ASSERT_EQ(1u, order.size());
+
+    CompleteAsync(0);
+    WaitIssued(3);
+    GetIssueOrder(&order);
+    ASSERT_EQ(3u, order.size());
+    EXPECT_EQ(1u, order[1]);
+    EXPECT_EQ(2u, order[2]);
+
+    WaitAcquire();
+    ASSERT_OK(sched_->StreamClose(0));
+    sched_->Shutdown();
+    CheckExpectedResult();
+}
+
+} // namespace
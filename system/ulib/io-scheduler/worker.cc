@@ -48,21 +48,23 @@ void Worker::WorkerLoop() {
     const size_t max_ops = 10;
     SchedulerClient* client = sched_->client();
     zx_status_t status;
+    bool acquire_done = false;
     while (!cancelled_) {
 
         // Fetch ops from the client.
 
         size_t acquire_count = 0;
         StreamOp* op_list[max_ops];
-        status = client->Acquire(op_list, max_ops, &acquire_count, true);
-        if (status == ZX_ERR_CANCELED) {
-            // Cancel received, no more ops to read. Drain the streams and exit.
-            break;
-        }
-        if (status != ZX_OK) {
-            fprintf(stderr, "Unexpected return status from Acquire() %d\n", status);
-            client->Fatal();
-            break;
+        if (!acquire_done) {
+            status = client->Acquire(op_list, max_ops, &acquire_count, true);
+            if (status == ZX_ERR_CANCELED) {
+                // Cancel received, no more ops to read. Drain the streams and exit.
+                acquire_done = true;
+            } else if (status != ZX_OK) {
+                fprintf(stderr, "Unexpected return status from Acquire() %d\n", status);
+                client->Fatal();
+                break;
+            }
         }
 
         // Containerize all ops for safety.
@@ -73,24 +75,28 @@ void Worker::WorkerLoop() {
 
         // Enqueue ops in the scheduler's priority queue.
 
-        size_t num_ready = 0;
-        size_t num_error = 0;
-        sched_->Enqueue(uop_list, acquire_count, uop_list, &num_error, &num_ready);
-        // Any ops remaining in the list have encountered an error and should be released.
-        for (size_t i = 0; i < num_error; i++) {
-            client->Release(uop_list[i].release());
+        if (acquire_count > 0) {
+            size_t num_ready = 0;
+            size_t num_error = 0;
+            sched_->Enqueue(uop_list, acquire_count, uop_list, &num_error, &num_ready);
+            // Any ops remaining in the list have encountered an error and should be released.
+            for (size_t i = 0; i < num_error; i++) {
+                client->Release(uop_list[i].release());
+            }
         }
 
-        // Drain the priority queue.
+        // Drain the priority queue. Once acquisition is done, wait here for
+        // held back and outstanding asynchronous ops until the scheduler shuts down.
 
         for ( ; ; ) {
 
             // Fetch an op.
 
             UniqueOp op;
-            status = sched_->Dequeue(&op, false);
+            status = sched_->Dequeue(&op, acquire_done);
             if (status == ZX_ERR_SHOULD_WAIT) {
-                // No more ops.
+                // No more ops ready. Ops held back by barriers will be signalled
+                // through Wake() when they become ready.
                 break;
             } else if (status == ZX_ERR_CANCELED) {
                 // Shutdown initiated.
@@ -106,18 +112,16 @@ void Worker::WorkerLoop() {
             status = client->Issue(op.get());
             if (status == ZX_OK) {
                 // Op completed successfully or encountered a synchronous error.
-                client->Release(op.release());
+                sched_->Release(std::move(op));
             } else if (status == ZX_ERR_ASYNC) {
-                // Op queued for async completion. Released when completed.
-
-                // Todo: transfer op to pending list to await async completion.
-                // sched_->AddAsync(std::move(op));
-                ZX_DEBUG_ASSERT(false);
+                // Op queued for async completion. The client returns it through
+                // AsyncComplete() when completed.
+                op.release();
             } else {
                 fprintf(stderr, "Unexpected return status from Issue() %d\n", status);
                 // Mark op as failed.
                 op->set_result(ZX_ERR_IO);
-                client->Release(op.release());
+                sched_->Release(std::move(op));
             }
         }
     }
@@ -58,6 +58,8 @@ zx_status_t memfs_create_filesystem_with_page_limit(async_dispatcher_t* dispatch
     if ((status = memfs::Vfs::Create("<tmp>", max_num_pages, &vfs, &root)) != ZX_OK) {
         return status;
     }
+    // Only the connections served below add and remove names.
+    vfs->EnableDentryCache(fs::DentryCacheOptions());
     vfs->SetDispatcher(dispatcher);
     fbl::unique_ptr<memfs_filesystem_t> fs = std::make_unique<memfs_filesystem_t>(std::move(vfs));
     if ((status = fs->vfs->ServeDirectory(std::move(root), std::move(server))) != ZX_OK) {
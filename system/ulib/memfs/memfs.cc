@@ -108,13 +108,20 @@ zx_status_t Vfs::Create(const char* name, size_t pages_limit,
 Vfs::Vfs(uint64_t id, size_t pages_limit, const char* name)
     : fs::ManagedVfs(), fs_id_(id), pages_limit_(pages_limit) {}
 
-Vfs::~Vfs() = default;
+Vfs::~Vfs() {
+    // Cached vnodes refer back to this Vfs.
+    ClearDentryCache();
+}
 
 zx_status_t Vfs::CreateFromVmo(VnodeDir* parent, fbl::StringPiece name,
                                zx_handle_t vmo, zx_off_t off,
                                zx_off_t len) {
     fbl::AutoLock lock(&vfs_lock_);
-    return parent->CreateFromVmo(name, vmo, off, len);
+    zx_status_t status = parent->CreateFromVmo(name, vmo, off, len);
+    if (status == ZX_OK) {
+        InvalidateDentryLocked(parent, name);
+    }
+    return status;
 }
 
 std::atomic<uint64_t> VnodeMemfs::ino_ctr_ = 0;
@@ -0,0 +1,383 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/array.h>
+#include <fbl/ref_ptr.h>
+#include <fs/trace.h>
+#include <lib/zircon-internal/fnv1hash.h>
+#include <minfs/transaction-limits.h>
+
+#include "directory-index.h"
+#include "minfs-private.h"
+#include "vnode.h"
+
+namespace minfs {
+namespace {
+
+// Buckets are only filled to this many entries when the index is built, to
+// leave room for later insertions before they need to be split.
+constexpr uint32_t kBuildBucketEntries = kMinfsDirIndexBucketEntries * 3 / 4;
+
+size_t BucketOffset(uint32_t bucket) {
+    return kMinfsDirIndexStart + (static_cast<size_t>(bucket) + 1) * kMinfsBlockSize;
+}
+
+bool EntryLess(const DirIndexEntry& a, const DirIndexEntry& b) {
+    return a.hash < b.hash || (a.hash == b.hash && a.off < b.off);
+}
+
+bool HashLess(const DirIndexEntry& entry, uint32_t hash) {
+    return entry.hash < hash;
+}
+
+bool LessHash(uint32_t hash, const DirIndexEntry& entry) {
+    return hash < entry.hash;
+}
+
+} // namespace
+
+DirectoryIndex::DirectoryIndex(VnodeMinfs* vnode) : vnode_(vnode) {}
+
+DirectoryIndex::~DirectoryIndex() = default;
+
+uint32_t DirectoryIndex::Hash(fbl::StringPiece name) {
+    return fnv1a32(name.data(), name.length());
+}
+
+bool DirectoryIndex::IsValid() {
+    if (state_ == State::kUnknown) {
+        state_ = State::kInvalid;
+        if (vnode_->GetSize() < kMinfsDirIndexStart + kMinfsBlockSize) {
+            return false;
+        }
+        fbl::AllocChecker ac;
+        root_.reset(new (&ac) DirIndexRoot);
+        if (!ac.check()) {
+            return false;
+        }
+        if (vnode_->ReadExactInternal(nullptr, root_.get(), kMinfsBlockSize,
+                                      kMinfsDirIndexStart) != ZX_OK ||
+            root_->magic != kMinfsDirIndexMagic || root_->bucket_count == 0 ||
+            root_->bucket_count > kMinfsDirIndexMaxBuckets || root_->ranges[0].hash != 0 ||
+            root_->last_off >= kMinfsMaxDirectorySize) {
+            root_.reset();
+            return false;
+        }
+        state_ = State::kValid;
+    }
+    // A driver unaware of the index may have modified the directory since.
+    return state_ == State::kValid && root_->seq_num == vnode_->GetInode()->seq_num;
+}
+
+zx_status_t DirectoryIndex::Build(DirIndexEntry* entries, size_t count, uint32_t last_off) {
+    Invalidate();
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexRoot> root(new (&ac) DirIndexRoot);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    memset(root.get(), 0, sizeof(DirIndexRoot));
+    root->magic = kMinfsDirIndexMagic;
+    root->last_off = last_off;
+
+    std::sort(entries, entries + count, EntryLess);
+
+    Minfs* fs = vnode_->Vfs();
+    fbl::unique_ptr<Transaction> transaction;
+    zx_status_t status;
+
+    // Drop any stale index first, so that its blocks are reused.
+    if (vnode_->GetSize() > kMinfsDirIndexStart) {
+        if ((status = fs->BeginTransaction(0, 0, &transaction)) != ZX_OK) {
+            return status;
+        }
+        if ((status = vnode_->TruncateInternal(transaction.get(), kMinfsDirIndexStart)) != ZX_OK) {
+            return status;
+        }
+        vnode_->InodeSync(transaction->GetWork(), kMxFsSyncDefault);
+        transaction->GetWork()->PinVnode(fbl::WrapRefPtr(vnode_));
+        if ((status = fs->CommitTransaction(std::move(transaction))) != ZX_OK) {
+            return status;
+        }
+    }
+
+    // Divide the entries between buckets, never separating the entries of a
+    // hash.
+    fbl::Array<size_t> starts(new (&ac) size_t[kMinfsDirIndexMaxBuckets + 1],
+                              kMinfsDirIndexMaxBuckets + 1);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    uint32_t bucket_count = 0;
+    size_t start = 0;
+    do {
+        if (bucket_count == kMinfsDirIndexMaxBuckets) {
+            return ZX_ERR_NO_SPACE;
+        }
+        size_t end = std::min<size_t>(start + kBuildBucketEntries, count);
+        while (end < count && entries[end].hash == entries[end - 1].hash) {
+            end++;
+        }
+        if (end - start > kMinfsDirIndexBucketEntries) {
+            return ZX_ERR_NO_SPACE;
+        }
+        starts[bucket_count] = start;
+        root->ranges[bucket_count].hash = (bucket_count == 0) ? 0 : entries[start].hash;
+        root->ranges[bucket_count].bucket = bucket_count;
+        bucket_count++;
+        start = end;
+    } while (start < count);
+    starts[bucket_count] = count;
+
+    // Write the buckets a few at a time, keeping each transaction within the
+    // limits of the journal.
+    const uint32_t max_buckets =
+        std::max<uint32_t>(fs->Limits().GetMaximumMetaDataBlocks() - 1, 1);
+    fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (uint32_t first = 0; first < bucket_count; first += max_buckets) {
+        uint32_t last = std::min(first + max_buckets, bucket_count);
+        uint32_t reserve_blocks;
+        if ((status = GetRequiredBlockCount(BucketOffset(first),
+                                            (last - first) * kMinfsBlockSize,
+                                            &reserve_blocks)) != ZX_OK) {
+            return status;
+        }
+        if ((status = fs->BeginTransaction(0, reserve_blocks, &transaction)) != ZX_OK) {
+            return status;
+        }
+        for (uint32_t n = first; n < last; n++) {
+            memset(bucket.get(), 0, sizeof(DirIndexBucket));
+            bucket->count = static_cast<uint32_t>(starts[n + 1] - starts[n]);
+            memcpy(bucket->entries, &entries[starts[n]], bucket->count * sizeof(DirIndexEntry));
+            if ((status = WriteBucket(transaction.get(), n, *bucket)) != ZX_OK) {
+                return status;
+            }
+        }
+        vnode_->InodeSync(transaction->GetWork(), kMxFsSyncDefault);
+        transaction->GetWork()->PinVnode(fbl::WrapRefPtr(vnode_));
+        if ((status = fs->CommitTransaction(std::move(transaction))) != ZX_OK) {
+            return status;
+        }
+    }
+    root->bucket_count = bucket_count;
+
+    // Writing the root last makes the index valid only once it is complete.
+    uint32_t reserve_blocks;
+    if ((status = GetRequiredBlockCount(kMinfsDirIndexStart, kMinfsBlockSize,
+                                        &reserve_blocks)) != ZX_OK) {
+        return status;
+    }
+    if ((status = fs->BeginTransaction(0, reserve_blocks, &transaction)) != ZX_OK) {
+        return status;
+    }
+    root->seq_num = vnode_->GetInode()->seq_num;
+    root_ = std::move(root);
+    state_ = State::kValid;
+    if ((status = WriteRoot(transaction.get())) != ZX_OK) {
+        Invalidate();
+        return status;
+    }
+    vnode_->InodeSync(transaction->GetWork(), kMxFsSyncDefault);
+    transaction->GetWork()->PinVnode(fbl::WrapRefPtr(vnode_));
+    return fs->CommitTransaction(std::move(transaction));
+}
+
+zx_status_t DirectoryIndex::Find(uint32_t hash, DirIndexBucket* bucket, uint32_t* start,
+                                 uint32_t* end) {
+    ZX_DEBUG_ASSERT(state_ == State::kValid);
+    zx_status_t status = ReadBucket(root_->ranges[FindRange(hash)].bucket, bucket);
+    if (status != ZX_OK) {
+        return status;
+    }
+    DirIndexEntry* entries_end = bucket->entries + bucket->count;
+    *start = static_cast<uint32_t>(
+        std::lower_bound(bucket->entries, entries_end, hash, HashLess) - bucket->entries);
+    *end = static_cast<uint32_t>(
+        std::upper_bound(bucket->entries, entries_end, hash, LessHash) - bucket->entries);
+    return ZX_OK;
+}
+
+uint32_t DirectoryIndex::LastOffset() const {
+    ZX_DEBUG_ASSERT(state_ == State::kValid);
+    return root_->last_off;
+}
+
+zx_status_t DirectoryIndex::Insert(Transaction* transaction, uint32_t hash, uint32_t off) {
+    if (!IsValid()) {
+        return ZX_OK;
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+    if (!ac.check()) {
+        Invalidate();
+        return ZX_OK;
+    }
+    uint32_t range = FindRange(hash);
+    zx_status_t status = ReadBucket(root_->ranges[range].bucket, bucket.get());
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (bucket->count == kMinfsDirIndexBucketEntries) {
+        if ((status = Split(transaction, range, bucket.get())) != ZX_OK) {
+            if (status == ZX_ERR_NO_SPACE) {
+                // The names don't fit the index; carry on without it.
+                Invalidate();
+                return ZX_OK;
+            }
+            return status;
+        }
+        range = FindRange(hash);
+        if ((status = ReadBucket(root_->ranges[range].bucket, bucket.get())) != ZX_OK) {
+            return status;
+        }
+    }
+
+    DirIndexEntry entry = {hash, off};
+    DirIndexEntry* pos = std::upper_bound(bucket->entries, bucket->entries + bucket->count,
+                                          entry, EntryLess);
+    memmove(pos + 1, pos, (bucket->entries + bucket->count - pos) * sizeof(DirIndexEntry));
+    *pos = entry;
+    bucket->count++;
+    return WriteBucket(transaction, root_->ranges[range].bucket, *bucket);
+}
+
+zx_status_t DirectoryIndex::Remove(Transaction* transaction, uint32_t hash, uint32_t off) {
+    if (!IsValid()) {
+        return ZX_OK;
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+    if (!ac.check()) {
+        Invalidate();
+        return ZX_OK;
+    }
+    uint32_t start, end;
+    zx_status_t status = Find(hash, bucket.get(), &start, &end);
+    if (status != ZX_OK) {
+        return status;
+    }
+    for (uint32_t i = start; i < end; i++) {
+        if (bucket->entries[i].off == off) {
+            memmove(&bucket->entries[i], &bucket->entries[i + 1],
+                    (bucket->count - i - 1) * sizeof(DirIndexEntry));
+            bucket->count--;
+            return WriteBucket(transaction, root_->ranges[FindRange(hash)].bucket, *bucket);
+        }
+    }
+    FS_TRACE_WARN("minfs: Dirent at offset %u of directory #%u is missing from its index\n",
+                  off, vnode_->GetIno());
+    Invalidate();
+    return ZX_OK;
+}
+
+void DirectoryIndex::SetLastOffset(uint32_t off) {
+    if (state_ == State::kValid) {
+        root_->last_off = off;
+    }
+}
+
+zx_status_t DirectoryIndex::Sync(Transaction* transaction) {
+    if (state_ != State::kValid) {
+        return ZX_OK;
+    }
+    root_->seq_num = vnode_->GetInode()->seq_num;
+    return WriteRoot(transaction);
+}
+
+uint32_t DirectoryIndex::FindRange(uint32_t hash) const {
+    const DirIndexRange* begin = root_->ranges;
+    const DirIndexRange* end = root_->ranges + root_->bucket_count;
+    const DirIndexRange* pos = std::upper_bound(
+        begin, end, hash, [](uint32_t hash, const DirIndexRange& r) { return hash < r.hash; });
+    // The first range starts at zero, so every hash falls in some range.
+    return static_cast<uint32_t>(pos - begin) - 1;
+}
+
+zx_status_t DirectoryIndex::ReadBucket(uint32_t bucket, DirIndexBucket* out) {
+    zx_status_t status = vnode_->ReadExactInternal(nullptr, out, kMinfsBlockSize,
+                                                   BucketOffset(bucket));
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (out->count > kMinfsDirIndexBucketEntries) {
+        FS_TRACE_ERROR("minfs: Bucket %u of the index of directory #%u is corrupt\n", bucket,
+                       vnode_->GetIno());
+        Invalidate();
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return ZX_OK;
+}
+
+zx_status_t DirectoryIndex::WriteBucket(Transaction* transaction, uint32_t bucket,
+                                        const DirIndexBucket& data) {
+    return vnode_->WriteExactInternal(transaction, &data, kMinfsBlockSize, BucketOffset(bucket));
+}
+
+zx_status_t DirectoryIndex::WriteRoot(Transaction* transaction) {
+    return vnode_->WriteExactInternal(transaction, root_.get(), kMinfsBlockSize,
+                                      kMinfsDirIndexStart);
+}
+
+zx_status_t DirectoryIndex::Split(Transaction* transaction, uint32_t range,
+                                  DirIndexBucket* bucket) {
+    if (root_->bucket_count == kMinfsDirIndexMaxBuckets) {
+        return ZX_ERR_NO_SPACE;
+    }
+    // Split as close to the middle as possible without separating the entries
+    // of a hash.
+    const DirIndexEntry* entries = bucket->entries;
+    uint32_t split = bucket->count / 2;
+    while (split < bucket->count && entries[split].hash == entries[split - 1].hash) {
+        split++;
+    }
+    if (split == bucket->count) {
+        split = bucket->count / 2;
+        while (split > 0 && entries[split].hash == entries[split - 1].hash) {
+            split--;
+        }
+        if (split == 0) {
+            return ZX_ERR_NO_SPACE;
+        }
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexBucket> upper(new (&ac) DirIndexBucket);
+    if (!ac.check()) {
+        return ZX_ERR_NO_SPACE;
+    }
+    memset(upper.get(), 0, sizeof(DirIndexBucket));
+    upper->count = bucket->count - split;
+    memcpy(upper->entries, &entries[split], upper->count * sizeof(DirIndexEntry));
+    bucket->count = split;
+    memset(&bucket->entries[split], 0, upper->count * sizeof(DirIndexEntry));
+
+    uint32_t new_bucket = root_->bucket_count;
+    zx_status_t status;
+    if ((status = WriteBucket(transaction, root_->ranges[range].bucket, *bucket)) != ZX_OK ||
+        (status = WriteBucket(transaction, new_bucket, *upper)) != ZX_OK) {
+        Invalidate();
+        return status;
+    }
+    memmove(&root_->ranges[range + 2], &root_->ranges[range + 1],
+            (root_->bucket_count - range - 1) * sizeof(DirIndexRange));
+    root_->ranges[range + 1].hash = upper->entries[0].hash;
+    root_->ranges[range + 1].bucket = new_bucket;
+    root_->bucket_count++;
+    return ZX_OK;
+}
+
+void DirectoryIndex::Invalidate() {
+    state_ = State::kInvalid;
+    root_.reset();
+}
+
+} // namespace minfs
@@ -0,0 +1,98 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file describes the hashed index of a MinFS directory.
+
+#pragma once
+
+#include <fbl/macros.h>
+#include <fbl/string_piece.h>
+#include <fbl/unique_ptr.h>
+#include <minfs/format.h>
+#include <minfs/writeback.h>
+
+namespace minfs {
+
+class VnodeMinfs;
+
+// The hashed index of a directory, mapping the hash of each name to the offset
+// of its dirent.  See format.h for the on-disk layout.
+//
+// The index doesn't know about dirents: the directory reports every dirent it
+// adds or removes, and records the new |seq_num| of its inode with |Sync|
+// afterwards.  If the index can't follow a change, it is left stale, and the
+// directory falls back to walking its dirents until the index is rebuilt.
+class DirectoryIndex {
+public:
+    // The maximum number of blocks allocated by |Insert|.
+    static constexpr blk_t kMaxInsertBlocks = 1;
+
+    explicit DirectoryIndex(VnodeMinfs* vnode);
+    ~DirectoryIndex();
+
+    // Returns the hash of |name| in the index.
+    static uint32_t Hash(fbl::StringPiece name);
+
+    // Returns true if the directory has an index which is up to date with its
+    // dirents, loading the root of the index on first use.
+    bool IsValid();
+
+    // Replaces any index of the directory with one holding |entries|, which
+    // lists every dirent in the directory and is sorted in place.  |last_off|
+    // is the offset of the dirent flagged with kMinfsReclenLast.
+    //
+    // Writes the index in its own transactions, a few blocks at a time.
+    zx_status_t Build(DirIndexEntry* entries, size_t count, uint32_t last_off);
+
+    // Reads into |bucket| the bucket which holds |hash|, and sets |*start| and
+    // |*end| to the range of its entries for |hash|.  The index must be valid.
+    zx_status_t Find(uint32_t hash, DirIndexBucket* bucket, uint32_t* start, uint32_t* end);
+
+    // Returns the offset of the dirent flagged with kMinfsReclenLast.  The
+    // index must be valid.
+    uint32_t LastOffset() const;
+
+    // The following methods update the index for a modification of the
+    // dirents, and are no-ops if the index isn't valid.
+    //
+    // Adds the dirent for a name with |hash| at |off|.
+    zx_status_t Insert(Transaction* transaction, uint32_t hash, uint32_t off);
+    // Removes the dirent for a name with |hash| at |off|.
+    zx_status_t Remove(Transaction* transaction, uint32_t hash, uint32_t off);
+    // Records that the dirent flagged with kMinfsReclenLast is now at |off|.
+    void SetLastOffset(uint32_t off);
+    // Records the current |seq_num| of the directory inode, completing an
+    // update of the index.
+    zx_status_t Sync(Transaction* transaction);
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(DirectoryIndex);
+
+    enum class State {
+        kUnknown,
+        kValid,
+        kInvalid,
+    };
+
+    // Returns the position of the range holding |hash| in the root.
+    uint32_t FindRange(uint32_t hash) const;
+
+    zx_status_t ReadBucket(uint32_t bucket, DirIndexBucket* out);
+    zx_status_t WriteBucket(Transaction* transaction, uint32_t bucket,
+                            const DirIndexBucket& data);
+    zx_status_t WriteRoot(Transaction* transaction);
+
+    // Splits the full bucket of the range at |range| in two, moving the upper
+    // half of its hashes to a new bucket.
+    zx_status_t Split(Transaction* transaction, uint32_t range, DirIndexBucket* bucket);
+
+    // Stops using the index, leaving it stale on disk.
+    void Invalidate();
+
+    VnodeMinfs* const vnode_;
+    State state_ = State::kUnknown;
+    fbl::unique_ptr<DirIndexRoot> root_;
+};
+
+} // namespace minfs
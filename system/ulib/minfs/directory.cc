@@ -11,6 +11,8 @@
 #include <sys/stat.h>
 
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/array.h>
 #include <fbl/auto_call.h>
 #include <fbl/string_piece.h>
 #include <fs/block-txn.h>
@@ -67,7 +69,7 @@ zx_status_t NextDirent(Dirent* de, DirectoryOffset* offs) {
 
 } // namespace anonymous
 
-Directory::Directory(Minfs* fs) : VnodeMinfs(fs) {}
+Directory::Directory(Minfs* fs) : VnodeMinfs(fs), index_(this) {}
 
 Directory::~Directory() = default;
 
@@ -150,6 +152,17 @@ zx_status_t Directory::UnlinkChild(Transaction* transaction,
     Dirent de_prev, de_next;
     zx_status_t status;
 
+    const uint32_t hash = DirectoryIndex::Hash(fbl::StringPiece(de->name, de->namelen));
+    if (off_prev == off && off != 0) {
+        // Found through the index.
+        if ((status = FindPreviousDirent(transaction, hash, off, &off_prev)) != ZX_OK) {
+            return status;
+        }
+    }
+    if ((status = index_.Remove(transaction, hash, static_cast<uint32_t>(off))) != ZX_OK) {
+        return status;
+    }
+
     // Read the direntries we're considering merging with.
     // Verify they are free and small enough to merge.
     size_t coalesced_size = MinfsReclen(de, off);
@@ -199,9 +212,14 @@ zx_status_t Directory::UnlinkChild(Transaction* transaction,
     }
 
     if (de->reclen & kMinfsReclenLast) {
-        // Truncating the directory merely removed unused space; if it fails,
-        // the directory contents are still valid.
-        TruncateInternal(transaction, off + MINFS_DIRENT_SIZE);
+        if (index_.IsValid()) {
+            // Truncating the directory would drop its index.
+            index_.SetLastOffset(static_cast<uint32_t>(off));
+        } else {
+            // Truncating the directory merely removed unused space; if it fails,
+            // the directory contents are still valid.
+            TruncateInternal(transaction, off + MINFS_DIRENT_SIZE);
+        }
     }
 
     inode_.dirent_count--;
@@ -359,6 +377,7 @@ zx_status_t Directory::AppendDirent(DirArgs* args) {
     }
 
     uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, args->offs.off));
+    uint32_t size = 0;
     if (de->ino == 0) {
         // empty entry, do we fit?
         if (args->reclen > reclen) {
@@ -366,7 +385,7 @@ zx_status_t Directory::AppendDirent(DirArgs* args) {
         }
     } else {
         // filled entry, can we sub-divide?
-        uint32_t size = static_cast<uint32_t>(DirentSize(de->namelen));
+        size = static_cast<uint32_t>(DirentSize(de->namelen));
         if (size > reclen) {
             FS_TRACE_ERROR("bad reclen (smaller than dirent) %u < %u\n", reclen, size);
             return ZX_ERR_IO;
@@ -375,6 +394,14 @@ zx_status_t Directory::AppendDirent(DirArgs* args) {
         if (extra < args->reclen) {
             return ZX_ERR_NO_SPACE;
         }
+    }
+
+    if ((status = index_.Insert(args->transaction, DirectoryIndex::Hash(args->name),
+                                static_cast<uint32_t>(args->offs.off + size))) != ZX_OK) {
+        return status;
+    }
+
+    if (de->ino != 0) {
         // shrink existing entry
         bool was_last_record = de->reclen & kMinfsReclenLast;
         de->reclen = size;
@@ -386,7 +413,10 @@ zx_status_t Directory::AppendDirent(DirArgs* args) {
 
         args->offs.off += size;
         // Overwrite dirent data to reflect the new dirent.
-        de->reclen = extra | (was_last_record ? kMinfsReclenLast : 0);
+        de->reclen = (reclen - size) | (was_last_record ? kMinfsReclenLast : 0);
+        if (was_last_record) {
+            index_.SetLastOffset(static_cast<uint32_t>(args->offs.off));
+        }
     }
 
     de->ino = args->ino;
@@ -404,10 +434,7 @@ zx_status_t Directory::AppendDirent(DirArgs* args) {
     }
 
     inode_.dirent_count++;
-    inode_.seq_num++;
-    InodeSync(args->transaction->GetWork(), kMxFsSyncMtime);
-    args->transaction->GetWork()->PinVnode(fbl::WrapRefPtr(this));
-    return ZX_OK;
+    return SyncDirents(args->transaction);
 }
 
 // Calls a callback 'func' on all direntries in a directory 'vn' with the
@@ -442,10 +469,7 @@ zx_status_t Directory::ForEachDirent(DirArgs* args, const DirentCallback func) {
         case kDirIteratorNext:
             break;
         case kDirIteratorSaveSync:
-            inode_.seq_num++;
-            InodeSync(args->transaction->GetWork(), kMxFsSyncMtime);
-            args->transaction->GetWork()->PinVnode(fbl::WrapRefPtr(this));
-            return ZX_OK;
+            return SyncDirents(args->transaction);
         case kDirIteratorDone:
         default:
             return status;
@@ -455,6 +479,180 @@ zx_status_t Directory::ForEachDirent(DirArgs* args, const DirentCallback func) {
     return ZX_ERR_NOT_FOUND;
 }
 
+zx_status_t Directory::FindDirent(DirArgs* args, const DirentCallback func) {
+    if (!index_.IsValid()) {
+        return ForEachDirent(args, func);
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    uint32_t start, end;
+    if (index_.Find(DirectoryIndex::Hash(args->name), bucket.get(), &start, &end) != ZX_OK) {
+        return ForEachDirent(args, func);
+    }
+
+    char data[kMinfsMaxDirentSize];
+    Dirent* de = (Dirent*) data;
+    for (uint32_t i = start; i < end; i++) {
+        args->offs.off = bucket->entries[i].off;
+        args->offs.off_prev = args->offs.off;
+        size_t r;
+        zx_status_t status = ReadInternal(args->transaction, data, kMinfsMaxDirentSize,
+                                          args->offs.off, &r);
+        if (status != ZX_OK) {
+            return status;
+        } else if ((status = ValidateDirent(de, r, args->offs.off)) != ZX_OK) {
+            return status;
+        }
+
+        switch ((status = func(fbl::RefPtr<Directory>(this), de, args))) {
+        case kDirIteratorNext:
+            break;
+        case kDirIteratorSaveSync:
+            return SyncDirents(args->transaction);
+        case kDirIteratorDone:
+        default:
+            return status;
+        }
+    }
+
+    return ZX_ERR_NOT_FOUND;
+}
+
+zx_status_t Directory::FindPreviousDirent(Transaction* transaction, uint32_t hash, size_t off,
+                                          size_t* off_prev) {
+    // The other dirents in the bucket of |hash| are spread over the directory, so one of
+    // them is usually close by.
+    size_t cur = 0;
+    if (index_.IsValid()) {
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        uint32_t start, end;
+        if (index_.Find(hash, bucket.get(), &start, &end) == ZX_OK) {
+            for (uint32_t i = 0; i < bucket->count; i++) {
+                if (bucket->entries[i].off < off && bucket->entries[i].off > cur) {
+                    cur = bucket->entries[i].off;
+                }
+            }
+        }
+    }
+
+    Dirent de;
+    while (true) {
+        size_t len = MINFS_DIRENT_SIZE;
+        zx_status_t status;
+        if ((status = ReadExactInternal(transaction, &de, len, cur)) != ZX_OK) {
+            return status;
+        } else if ((status = ValidateDirent(&de, len, cur)) != ZX_OK) {
+            return status;
+        }
+        size_t next = cur + MinfsReclen(&de, cur);
+        if (next == off) {
+            *off_prev = cur;
+            return ZX_OK;
+        } else if (next > off || (de.reclen & kMinfsReclenLast)) {
+            FS_TRACE_ERROR("minfs: No dirent of directory #%u precedes offset %zu\n",
+                           GetIno(), off);
+            return ZX_ERR_IO;
+        }
+        cur = next;
+    }
+}
+
+zx_status_t Directory::FindSpace(DirArgs* args) {
+    if (index_.IsValid()) {
+        // New dirents fit at the end of the directory until it nears its maximum size.
+        char data[kMinfsMaxDirentSize];
+        Dirent* de = (Dirent*) data;
+        args->offs.off = index_.LastOffset();
+        args->offs.off_prev = args->offs.off;
+        size_t r;
+        zx_status_t status = ReadInternal(args->transaction, data, kMinfsMaxDirentSize,
+                                          args->offs.off, &r);
+        if (status != ZX_OK) {
+            return status;
+        } else if ((status = ValidateDirent(de, r, args->offs.off)) != ZX_OK) {
+            return status;
+        } else if (!(de->reclen & kMinfsReclenLast)) {
+            FS_TRACE_ERROR("minfs: Index of directory #%u has a bad last dirent\n", GetIno());
+            return ZX_ERR_IO;
+        }
+        if ((status = DirentCallbackFindSpace(fbl::RefPtr<Directory>(this), de, args)) !=
+            kDirIteratorNext) {
+            return status;
+        }
+    }
+    return ForEachDirent(args, DirentCallbackFindSpace);
+}
+
+zx_status_t Directory::SyncDirents(Transaction* transaction) {
+    inode_.seq_num++;
+    zx_status_t status = index_.Sync(transaction);
+    InodeSync(transaction->GetWork(), kMxFsSyncMtime);
+    transaction->GetWork()->PinVnode(fbl::WrapRefPtr(this));
+    return status;
+}
+
+void Directory::EnsureIndex() {
+    if (GetSize() <= kMinfsBlockSize || index_.IsValid()) {
+        return;
+    }
+    if (index_build_failed_ && index_build_failed_seq_num_ == inode_.seq_num) {
+        return;
+    }
+    zx_status_t status = BuildIndex();
+    index_build_failed_ = (status != ZX_OK);
+    if (status != ZX_OK) {
+        FS_TRACE_WARN("minfs: Failed to index directory #%u: %d\n", GetIno(), status);
+        index_build_failed_seq_num_ = inode_.seq_num;
+    }
+}
+
+zx_status_t Directory::BuildIndex() {
+    fbl::AllocChecker ac;
+    fbl::Array<DirIndexEntry> entries(new (&ac) DirIndexEntry[inode_.dirent_count],
+                                      inode_.dirent_count);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    size_t count = 0;
+    char data[kMinfsMaxDirentSize];
+    Dirent* de = (Dirent*) data;
+    size_t off = 0;
+    while (true) {
+        if (off + MINFS_DIRENT_SIZE >= kMinfsMaxDirectorySize) {
+            return ZX_ERR_IO;
+        }
+        size_t r;
+        zx_status_t status = ReadInternal(nullptr, data, kMinfsMaxDirentSize, off, &r);
+        if (status != ZX_OK) {
+            return status;
+        } else if ((status = ValidateDirent(de, r, off)) != ZX_OK) {
+            return status;
+        }
+        if (de->ino != 0) {
+            if (count == entries.size()) {
+                FS_TRACE_ERROR("minfs: Directory #%u has more dirents than expected\n",
+                               GetIno());
+                return ZX_ERR_IO;
+            }
+            entries[count].hash = DirectoryIndex::Hash(fbl::StringPiece(de->name, de->namelen));
+            entries[count].off = static_cast<uint32_t>(off);
+            count++;
+        }
+        if (de->reclen & kMinfsReclenLast) {
+            break;
+        }
+        off += MinfsReclen(de, off);
+    }
+    return index_.Build(entries.get(), count, static_cast<uint32_t>(off));
+}
+
 zx_status_t Directory::ValidateFlags(uint32_t flags) {
     FS_TRACE_DEBUG("Directory::ValidateFlags(0x%x) vn=%p(#%u)\n", flags, this, GetIno());
     if (flags & ZX_FS_FLAG_NOT_DIRECTORY) {
@@ -493,7 +691,7 @@ zx_status_t Directory::LookupInternal(fbl::RefPtr<fs::Vnode>* out, fbl::StringPi
     auto get_metrics = fbl::MakeAutoCall([&ticker, &success, this]() {
         fs_->UpdateLookupMetrics(success, ticker.End());
     });
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) < 0) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) < 0) {
         return status;
     }
     fbl::RefPtr<VnodeMinfs> vn;
@@ -597,11 +795,13 @@ zx_status_t Directory::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name
         return ZX_ERR_BAD_STATE;
     }
 
+    EnsureIndex();
+
     DirArgs args = DirArgs();
     args.name = name;
     // ensure file does not exist
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
         return ZX_ERR_ALREADY_EXISTS;
     }
 
@@ -612,7 +812,7 @@ zx_status_t Directory::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name
     // before updating any other metadata.
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
-    status = ForEachDirent(&args, DirentCallbackFindSpace);
+    status = FindSpace(&args);
     if (status == ZX_ERR_NOT_FOUND) {
         return ZX_ERR_NO_SPACE;
     } else if (status != ZX_OK) {
@@ -628,6 +828,7 @@ zx_status_t Directory::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name
 
     // Reserve 1 additional block for the new directory's initial . and .. entries.
     reserve_blocks += 1;
+    reserve_blocks += DirectoryIndex::kMaxInsertBlocks;
     ZX_DEBUG_ASSERT(reserve_blocks <= fs_->Limits().GetMaximumMetaDataBlocks());
 
     // In addition to reserve_blocks, reserve 1 inode for the vnode to be created.
@@ -691,7 +892,7 @@ zx_status_t Directory::Unlink(fbl::StringPiece name, bool must_be_dir) {
     args.name = name;
     args.type = must_be_dir ? kMinfsTypeDir : 0;
     args.transaction = transaction.get();
-    status = ForEachDirent(&args, DirentCallbackUnlink);
+    status = FindDirent(&args, DirentCallbackUnlink);
     if (status != ZX_OK) {
         return status;
     }
@@ -748,7 +949,7 @@ zx_status_t Directory::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece o
     // acquire the 'oldname' node (it must exist)
     DirArgs args = DirArgs();
     args.name = oldname;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) < 0) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) < 0) {
         return status;
     }
     if ((status = fs_->VnodeGet(&oldvn, args.ino)) < 0) {
@@ -777,7 +978,8 @@ zx_status_t Directory::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece o
     args.type = oldvn->IsDirectory() ? kMinfsTypeDir : kMinfsTypeFile;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(newname.length())));
 
-    status = newdir->ForEachDirent(&args, DirentCallbackFindSpace);
+    newdir->EnsureIndex();
+    status = newdir->FindSpace(&args);
     if (status == ZX_ERR_NOT_FOUND) {
         return ZX_ERR_NO_SPACE;
     }
@@ -793,6 +995,7 @@ zx_status_t Directory::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece o
         != ZX_OK) {
         return status;
     }
+    reserved_blocks += DirectoryIndex::kMaxInsertBlocks;
 
     fbl::unique_ptr<Transaction> transaction;
     if ((status = fs_->BeginTransaction(0, reserved_blocks, &transaction)) != ZX_OK) {
@@ -804,7 +1007,7 @@ zx_status_t Directory::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece o
     args.transaction = transaction.get();
     args.name = newname;
     args.ino = oldvn->GetIno();
-    status = newdir->ForEachDirent(&args, DirentCallbackAttemptRename);
+    status = newdir->FindDirent(&args, DirentCallbackAttemptRename);
     if (status == ZX_ERR_NOT_FOUND) {
         // if 'newname' does not exist, create it
         args.offs = append_offs;
@@ -825,7 +1028,7 @@ zx_status_t Directory::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece o
         auto vn = fbl::RefPtr<Directory>::Downcast(vn_fs);
         args.name = "..";
         args.ino = newdir->GetIno();
-        if ((status = vn->ForEachDirent(&args, DirentCallbackUpdateInode)) < 0) {
+        if ((status = vn->FindDirent(&args, DirentCallbackUpdateInode)) < 0) {
             return status;
         }
     }
@@ -836,7 +1039,7 @@ zx_status_t Directory::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece o
 
     // finally, remove oldname from its original position
     args.name = oldname;
-    if ((status = ForEachDirent(&args, DirentCallbackForceUnlink)) != ZX_OK) {
+    if ((status = FindDirent(&args, DirentCallbackForceUnlink)) != ZX_OK) {
         return status;
     }
     transaction->GetWork()->PinVnode(oldvn);
@@ -862,11 +1065,13 @@ zx_status_t Directory::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targe
         return ZX_ERR_NOT_FILE;
     }
 
+    EnsureIndex();
+
     // The destination should not exist
     DirArgs args = DirArgs();
     args.name = name;
     zx_status_t status;
-    if ((status = ForEachDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
+    if ((status = FindDirent(&args, DirentCallbackFind)) != ZX_ERR_NOT_FOUND) {
         return (status == ZX_OK) ? ZX_ERR_ALREADY_EXISTS : status;
     }
 
@@ -874,7 +1079,7 @@ zx_status_t Directory::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targe
     // before updating any other metadata.
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
-    status = ForEachDirent(&args, DirentCallbackFindSpace);
+    status = FindSpace(&args);
     if (status == ZX_ERR_NOT_FOUND) {
         return ZX_ERR_NO_SPACE;
     } else if (status != ZX_OK) {
@@ -887,6 +1092,7 @@ zx_status_t Directory::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targe
         != ZX_OK) {
         return status;
     }
+    reserved_blocks += DirectoryIndex::kMaxInsertBlocks;
 
     fbl::unique_ptr<Transaction> transaction;
     if ((status = fs_->BeginTransaction(0, reserved_blocks, &transaction)) != ZX_OK) {
@@ -14,6 +14,7 @@
 #include <minfs/transaction-limits.h>
 #include <minfs/writeback.h>
 
+#include "directory-index.h"
 #include "vnode.h"
 
 namespace minfs {
@@ -95,6 +96,32 @@ private:
     // Enumerates directories.
     zx_status_t ForEachDirent(DirArgs* args, const DirentCallback func);
 
+    // Calls |func| on the dirents which may be named |args->name|, using the index of the
+    // directory when it has one. Otherwise the same as |ForEachDirent|.
+    //
+    // The index doesn't tell where the previous dirent is, so dirents found through it are
+    // passed with |args->offs.off_prev| equal to |args->offs.off|; see |FindPreviousDirent|.
+    zx_status_t FindDirent(DirArgs* args, const DirentCallback func);
+
+    // Sets |*off_prev| to the offset of the dirent preceding the one at |off|, which holds a
+    // name with |hash|. Walks the dirents from the closest preceding one listed with it in the
+    // index, or from the start of the directory.
+    zx_status_t FindPreviousDirent(Transaction* transaction, uint32_t hash, size_t off,
+                                   size_t* off_prev);
+
+    // Finds space for a dirent of |args->reclen| bytes, as |ForEachDirent| with
+    // |DirentCallbackFindSpace| does, but tries the end of the directory first.
+    zx_status_t FindSpace(DirArgs* args);
+
+    // Records a modification of the dirents within |transaction|.
+    zx_status_t SyncDirents(Transaction* transaction);
+
+    // Builds the index of a directory larger than a block, if it doesn't have an up to date one.
+    // The directory remains usable without an index, so failures are only logged, and the
+    // build isn't tried again until the directory changes.
+    void EnsureIndex();
+    zx_status_t BuildIndex();
+
     // Directory callback functions.
     //
     // The following functions are passable to |ForEachDirent|, which reads the parent directory,
@@ -117,6 +144,11 @@ private:
 
     zx_status_t UnlinkChild(Transaction* transaction, fbl::RefPtr<VnodeMinfs> child,
                             Dirent* de, DirectoryOffset* offs);
+
+    DirectoryIndex index_;
+    // Whether building the index failed, and the |seq_num| of the directory when it did.
+    bool index_build_failed_ = false;
+    uint32_t index_build_failed_seq_num_ = 0;
 };
 
 } // namespace minfs
@@ -0,0 +1,406 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <minfs/transaction-limits.h>
+
+#include "extent-tree.h"
+#include "minfs-private.h"
+
+namespace minfs {
+namespace {
+
+static_assert(ExtentTree::kMaxWriteBlocks <= TransactionLimits::kMaxExtentTreeBlocks,
+              "Extent tree updates don't fit in a transaction");
+
+bool Contiguous(const Extent& a, const Extent& b) {
+    return a.start + a.length == b.start && a.bno + a.length == b.bno;
+}
+
+// Appends |extent| to |out|, merging it with the last extent if they are contiguous.
+zx_status_t AppendExtent(const Extent& extent, fbl::Vector<Extent>* out) {
+    if (!out->is_empty() && Contiguous((*out)[out->size() - 1], extent)) {
+        (*out)[out->size() - 1].length += extent.length;
+        return ZX_OK;
+    }
+    fbl::AllocChecker ac;
+    out->push_back(extent, &ac);
+    return ac.check() ? ZX_OK : ZX_ERR_NO_MEMORY;
+}
+
+// Replaces the items [first, last) of |v| with the |count| items at |items|.
+template <typename T>
+zx_status_t Splice(fbl::Vector<T>* v, size_t first, size_t last, const T* items, size_t count) {
+    fbl::Vector<T> result;
+    fbl::AllocChecker ac;
+    result.reserve(v->size() - (last - first) + count, &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < first; i++) {
+        result.push_back((*v)[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        result.push_back(items[i]);
+    }
+    for (size_t i = last; i < v->size(); i++) {
+        result.push_back((*v)[i]);
+    }
+    *v = std::move(result);
+    return ZX_OK;
+}
+
+} // namespace
+
+ExtentTree::ExtentTree(Minfs* fs, Inode* inode) : fs_(fs), inode_(inode) {}
+
+ExtentTree::~ExtentTree() = default;
+
+zx_status_t ExtentTree::Load() {
+    const ExtentRoot* root = GetExtentRoot(inode_);
+    if (root->depth > kMinfsExtentMaxDepth || root->count > kMinfsInlineExtents) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    depth_ = root->depth;
+    if (depth_ > 0 && root->count == 0) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return LoadEntries(depth_, root->entries, root->count);
+}
+
+zx_status_t ExtentTree::LoadEntries(uint32_t depth, const Extent* entries, uint32_t count) {
+    const blk_t block_count = fs_->Info().block_count;
+    for (uint32_t i = 0; i < count; i++) {
+        const Extent& entry = entries[i];
+        if (depth == 0) {
+            if (entry.length == 0 || entry.bno == 0 || entry.bno >= block_count ||
+                entry.length > block_count - entry.bno || entry.start >= kMinfsMaxFileBlock ||
+                entry.length > kMinfsMaxFileBlock - entry.start) {
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+            if (!extents_.is_empty()) {
+                const Extent& prev = extents_[extents_.size() - 1];
+                if (prev.start + prev.length > entry.start) {
+                    return ZX_ERR_IO_DATA_INTEGRITY;
+                }
+            }
+            fbl::AllocChecker ac;
+            extents_.push_back(entry, &ac);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
+            continue;
+        }
+
+        if (entry.length != 0 || entry.bno == 0 || entry.bno >= block_count) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<ExtentNode> node(new (&ac) ExtentNode);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        zx_status_t status;
+        if ((status = fs_->ReadDat(entry.bno, node.get())) != ZX_OK) {
+            return status;
+        }
+        if (node->magic != kMinfsExtentMagic || node->depth != depth - 1 || node->count == 0 ||
+            node->count > kMinfsExtentsPerNode) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        const size_t first = extents_.size();
+        if ((status = LoadEntries(depth - 1, node->entries, node->count)) != ZX_OK) {
+            return status;
+        }
+        if (extents_[first].start != entry.start) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        nodes_[depth - 1].push_back({entry.bno, node->count, false}, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t ExtentTree::GetNodes(fbl::Vector<blk_t>* out) const {
+    for (uint32_t d = 0; d < depth_; d++) {
+        for (const Node& node : nodes_[d]) {
+            fbl::AllocChecker ac;
+            out->push_back(node.bno, &ac);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
+        }
+    }
+    return ZX_OK;
+}
+
+size_t ExtentTree::Find(blk_t block) const {
+    auto ends_after = [](blk_t block, const Extent& extent) {
+        return block < extent.start + extent.length;
+    };
+    return std::upper_bound(extents_.begin(), extents_.end(), block, ends_after) -
+           extents_.begin();
+}
+
+zx_status_t ExtentTree::Replace(Transaction* transaction, blk_t start, blk_t end,
+                                const Extent* extents, size_t count) {
+    ZX_DEBUG_ASSERT(start < end);
+    size_t first = Find(start);
+    size_t last = first;
+    while (last < extents_.size() && extents_[last].start < end) {
+        last++;
+    }
+
+    // Keep whatever the replaced extents map outside of [start, end), and
+    // merge the new extents with their neighbors where possible.
+    if (first > 0 && count > 0 && Contiguous(extents_[first - 1], extents[0])) {
+        first--;
+    }
+    if (last < extents_.size() && count > 0 && Contiguous(extents[count - 1], extents_[last])) {
+        last++;
+    }
+    fbl::Vector<Extent> replacement;
+    zx_status_t status;
+    for (size_t i = first; i < last && extents_[i].start < start; i++) {
+        Extent head = extents_[i];
+        head.length = fbl::min(head.length, start - head.start);
+        if ((status = AppendExtent(head, &replacement)) != ZX_OK) {
+            return status;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        ZX_DEBUG_ASSERT(extents[i].start >= start && extents[i].start + extents[i].length <= end);
+        if ((status = AppendExtent(extents[i], &replacement)) != ZX_OK) {
+            return status;
+        }
+    }
+    for (size_t i = first; i < last; i++) {
+        const Extent& extent = extents_[i];
+        if (extent.start + extent.length > end) {
+            const blk_t skip = extent.start < end ? end - extent.start : 0;
+            Extent tail = {extent.start + skip, extent.bno + skip, extent.length - skip};
+            if ((status = AppendExtent(tail, &replacement)) != ZX_OK) {
+                return status;
+            }
+        }
+    }
+
+    if (first == last && replacement.is_empty()) {
+        return ZX_OK;
+    }
+    if ((status = Splice(&extents_, first, last, replacement.get(), replacement.size())) !=
+        ZX_OK) {
+        return status;
+    }
+    if ((status = Rebalance(transaction, 1, first, last, replacement.size())) != ZX_OK) {
+        return status;
+    }
+    if ((status = ResizeRoot(transaction)) != ZX_OK) {
+        return status;
+    }
+    return Flush(transaction);
+}
+
+zx_status_t ExtentTree::Rebalance(Transaction* transaction, uint32_t level, size_t first,
+                                  size_t last, size_t count) {
+    for (; level <= depth_; level++) {
+        fbl::Vector<Node>& nodes = nodes_[level - 1];
+        ZX_DEBUG_ASSERT(!nodes.is_empty());
+
+        // Find the nodes [a, b] which held the replaced entries, or the one
+        // receiving the new entries if none were replaced.
+        size_t a = 0;
+        size_t pos = 0;
+        while (a + 1 < nodes.size() && pos + nodes[a].count <= first) {
+            pos += nodes[a++].count;
+        }
+        size_t b = a;
+        size_t end = pos + nodes[a].count;
+        while (b + 1 < nodes.size() && end < last) {
+            end += nodes[++b].count;
+        }
+        size_t total = end - pos + count - (last - first);
+
+        // Nodes are kept at least half full, unless they are the only one of
+        // their level.
+        if (total < kMinfsExtentsPerNode / 2 && b - a + 1 < nodes.size()) {
+            if (b + 1 < nodes.size()) {
+                total += nodes[++b].count;
+            } else {
+                total += nodes[--a].count;
+            }
+        }
+
+        // Spread the entries evenly over as few nodes as possible, reusing
+        // the blocks of the old ones.
+        const size_t old_count = b - a + 1;
+        const size_t new_count = (total + kMinfsExtentsPerNode - 1) / kMinfsExtentsPerNode;
+        fbl::Vector<Node> replacement;
+        fbl::AllocChecker ac;
+        replacement.reserve(new_count, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        zx_status_t status;
+        for (size_t i = 0; i < new_count; i++) {
+            uint32_t entries = static_cast<uint32_t>(total / new_count + (i < total % new_count));
+            Node node;
+            if (i < old_count) {
+                node = {nodes[a + i].bno, entries, true};
+            } else {
+                NewNode(transaction, entries, &node);
+            }
+            replacement.push_back(node);
+        }
+        for (size_t i = new_count; i < old_count; i++) {
+            FreeNode(transaction, nodes[a + i]);
+        }
+        if ((status = Splice(&nodes, a, b + 1, replacement.get(), replacement.size())) !=
+            ZX_OK) {
+            return status;
+        }
+
+        first = a;
+        last = b + 1;
+        count = new_count;
+    }
+    return ZX_OK;
+}
+
+zx_status_t ExtentTree::ResizeRoot(Transaction* transaction) {
+    while (LevelSize(depth_) > kMinfsInlineExtents) {
+        if (depth_ == kMinfsExtentMaxDepth) {
+            return ZX_ERR_OUT_OF_RANGE;
+        }
+        const size_t total = LevelSize(depth_);
+        const size_t new_count = (total + kMinfsExtentsPerNode - 1) / kMinfsExtentsPerNode;
+        fbl::AllocChecker ac;
+        nodes_[depth_].reserve(new_count, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        for (size_t i = 0; i < new_count; i++) {
+            uint32_t entries = static_cast<uint32_t>(total / new_count + (i < total % new_count));
+            Node node;
+            NewNode(transaction, entries, &node);
+            nodes_[depth_].push_back(node);
+        }
+        depth_++;
+    }
+    while (depth_ > 0 && LevelSize(depth_ - 1) <= kMinfsInlineExtents) {
+        depth_--;
+        for (const Node& node : nodes_[depth_]) {
+            FreeNode(transaction, node);
+        }
+        nodes_[depth_].reset();
+    }
+    return ZX_OK;
+}
+
+void ExtentTree::NewNode(Transaction* transaction, uint32_t count, Node* out) {
+    blk_t bno;
+    fs_->BlockNew(transaction, &bno);
+    inode_->block_count++;
+    *out = {bno, count, true};
+}
+
+void ExtentTree::FreeNode(Transaction* transaction, const Node& node) {
+    fs_->BlockFree(transaction, node.bno);
+    inode_->block_count--;
+}
+
+void ExtentTree::FillEntries(uint32_t level, size_t first, size_t count,
+                             const fbl::Vector<blk_t>& starts, Extent* out) const {
+    for (size_t i = 0; i < count; i++) {
+        if (level == 0) {
+            out[i] = extents_[first + i];
+        } else {
+            out[i] = {starts[first + i], nodes_[level - 1][first + i].bno, 0};
+        }
+    }
+}
+
+zx_status_t ExtentTree::Flush(Transaction* transaction) {
+    // Find the first block mapped under each node, level by level.
+    fbl::Vector<blk_t> starts[kMinfsExtentMaxDepth + 1];
+    for (uint32_t level = 1; level <= depth_; level++) {
+        fbl::AllocChecker ac;
+        starts[level].reserve(LevelSize(level), &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        size_t pos = 0;
+        for (const Node& node : nodes_[level - 1]) {
+            starts[level].push_back(level == 1 ? extents_[pos].start : starts[level - 1][pos]);
+            pos += node.count;
+        }
+    }
+
+    ExtentRoot* root = GetExtentRoot(inode_);
+    memset(root, 0, sizeof(*root));
+    root->depth = static_cast<uint16_t>(depth_);
+    root->count = static_cast<uint16_t>(LevelSize(depth_));
+    FillEntries(depth_, 0, root->count, starts[depth_], root->entries);
+
+#ifdef __Fuchsia__
+    if (!staging_.vmo().is_valid()) {
+        zx_status_t status;
+        if ((status = staging_.CreateAndMap(kMaxWriteBlocks * kMinfsBlockSize,
+                                            "minfs-extents")) != ZX_OK) {
+            return status;
+        }
+    }
+    blk_t staged = 0;
+#else
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<ExtentNode> buffer(new (&ac) ExtentNode);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+#endif
+    for (uint32_t d = 0; d < depth_; d++) {
+        size_t pos = 0;
+        for (Node& node : nodes_[d]) {
+            if (node.dirty) {
+#ifdef __Fuchsia__
+                ZX_ASSERT(staged < kMaxWriteBlocks);
+                ExtentNode* data = reinterpret_cast<ExtentNode*>(
+                    static_cast<uint8_t*>(staging_.start()) + staged * kMinfsBlockSize);
+#else
+                ExtentNode* data = buffer.get();
+#endif
+                memset(data, 0, sizeof(*data));
+                data->magic = kMinfsExtentMagic;
+                data->depth = static_cast<uint16_t>(d);
+                data->count = static_cast<uint16_t>(node.count);
+                FillEntries(d, pos, node.count, starts[d], data->entries);
+#ifdef __Fuchsia__
+                transaction->GetWork()->Enqueue(staging_.vmo().get(), staged,
+                                                node.bno + fs_->Info().dat_block, 1);
+                staged++;
+#else
+                zx_status_t status;
+                if ((status = fs_->bc_->Writeblk(node.bno + fs_->Info().dat_block, data)) !=
+                    ZX_OK) {
+                    return status;
+                }
+#endif
+                node.dirty = false;
+            }
+            pos += node.count;
+        }
+    }
+    return ZX_OK;
+}
+
+} // namespace minfs
@@ -0,0 +1,126 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file describes the extent tree of a MinFS file.
+
+#pragma once
+
+#include <fbl/macros.h>
+#include <fbl/vector.h>
+#include <minfs/format.h>
+#include <minfs/writeback.h>
+
+#ifdef __Fuchsia__
+#include <lib/fzl/owned-vmo-mapper.h>
+#endif
+
+namespace minfs {
+
+class Minfs;
+
+// The extents of a file flagged with kMinfsInodeFlagExtents, and the tree of
+// nodes holding them.  See format.h for the on-disk layout.
+//
+// The whole tree is loaded on first use: lookups search the sorted extents in
+// memory, and updates rewrite the few nodes covering the modified blocks.
+//
+// On Fuchsia, the nodes written by an update are staged in a VMO until the
+// transaction is committed, so a transaction may only hold one update.
+class ExtentTree {
+public:
+    // The maximum number of blocks of the file which one update may remap
+    // while the bounds below hold: the extents they replace and their
+    // neighbors then span at most two nodes of each depth.
+    static constexpr blk_t kMaxUpdateBlocks = kMinfsExtentsPerNode / 4;
+
+    // The maximum number of nodes allocated by an update of at most
+    // |kMaxUpdateBlocks| blocks: one per depth, and one to grow the tree.
+    static constexpr blk_t kMaxAllocBlocks = kMinfsExtentMaxDepth + 1;
+
+    // The maximum number of nodes written by any update: up to three for
+    // each depth, and one to grow the tree.
+    static constexpr blk_t kMaxWriteBlocks = 3 * kMinfsExtentMaxDepth + 1;
+
+    // Creates the tree of |inode|, which must outlive it.
+    ExtentTree(Minfs* fs, Inode* inode);
+    ~ExtentTree();
+
+    // Reads the nodes of the tree.  Fails with ZX_ERR_IO_DATA_INTEGRITY if
+    // they aren't consistent with each other.
+    zx_status_t Load();
+
+    // Returns the extents of the file, sorted by |start|.
+    const fbl::Vector<Extent>& Extents() const { return extents_; }
+
+    // Returns the blocks of the nodes of the tree.
+    zx_status_t GetNodes(fbl::Vector<blk_t>* out) const;
+
+    // Returns the position in |Extents()| of the first extent which ends after
+    // |block|.
+    size_t Find(blk_t block) const;
+
+    // Maps the blocks [start, end) of the file to the |count| extents at
+    // |extents| instead, which must be sorted and within that range.  Nodes
+    // are allocated and freed in |transaction| as needed, and the updated ones
+    // are written to it.  Updates the root and |block_count| of the inode, but
+    // doesn't write it.
+    zx_status_t Replace(Transaction* transaction, blk_t start, blk_t end, const Extent* extents,
+                        size_t count);
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ExtentTree);
+
+    // A node of the tree, which holds |count| consecutive entries of the
+    // level below it.
+    struct Node {
+        blk_t bno;
+        uint32_t count;
+        bool dirty;
+    };
+
+    // Level zero holds the extents, and level d + 1 the nodes of depth d.
+    // The root holds all of level |depth_|.
+    size_t LevelSize(uint32_t level) const {
+        return level == 0 ? extents_.size() : nodes_[level - 1].size();
+    }
+
+    // Appends the |count| entries at |entries|, taken from the root or from a
+    // node of depth |depth| - 1, to the levels of the tree.
+    zx_status_t LoadEntries(uint32_t depth, const Extent* entries, uint32_t count);
+
+    // Rebalances the nodes of |level| and above after the entries [first, last)
+    // of the level below were replaced with |count| entries.
+    zx_status_t Rebalance(Transaction* transaction, uint32_t level, size_t first, size_t last,
+                          size_t count);
+
+    // Adds levels to the tree while the root can't hold the top one, and
+    // removes those whose entries would all fit in the root.
+    zx_status_t ResizeRoot(Transaction* transaction);
+
+    // Sets |*out| to a new node holding |count| entries.
+    void NewNode(Transaction* transaction, uint32_t count, Node* out);
+    void FreeNode(Transaction* transaction, const Node& node);
+
+    // Writes the root to the inode, and the dirty nodes to |transaction|.
+    zx_status_t Flush(Transaction* transaction);
+
+    // Fills |*out| with the entries of level |level| at [first, first + count),
+    // where |starts| holds the first block mapped under each node of that level.
+    void FillEntries(uint32_t level, size_t first, size_t count,
+                     const fbl::Vector<blk_t>& starts, Extent* out) const;
+
+    Minfs* const fs_;
+    Inode* const inode_;
+
+    uint32_t depth_ = 0;
+    fbl::Vector<Extent> extents_;
+    fbl::Vector<Node> nodes_[kMinfsExtentMaxDepth];
+
+#ifdef __Fuchsia__
+    // Staging area for the nodes written by an update.
+    fzl::OwnedVmoMapper staging_;
+#endif
+};
+
+} // namespace minfs
@@ -32,6 +32,14 @@
 #include "vnode.h"
 
 namespace minfs {
+namespace {
+
+// Blocks reserved by each write to a file mapped by extents, for the nodes its extent tree may
+// need. Pending blocks are remapped at most ExtentTree::kMaxUpdateBlocks at a time, which takes
+// fewer than two updates of the tree per write.
+constexpr blk_t kExtentTreeReserveBlocks = 2 * ExtentTree::kMaxAllocBlocks;
+
+} // namespace
 
 File::File(Minfs* fs) : VnodeMinfs(fs) {}
 
@@ -91,7 +99,10 @@ void File::AllocateData() {
         // ensure that all user data goes out to disk before associated metadata.
         transaction->InitDataWork();
 
-        if (bno_start + bno_count >= kMinfsDirect) {
+        if (HasExtents()) {
+            // Bound the number of extent tree nodes updated within the transaction.
+            bno_count = fbl::min(bno_count, ExtentTree::kMaxUpdateBlocks);
+        } else if (bno_start + bno_count >= kMinfsDirect) {
             // Calculate the number of pre-indirect blocks. These will not factor into the number
             // of indirect blocks being touched, and can be added back at the end.
             blk_t pre_indirect = bno_start < kMinfsDirect ? kMinfsDirect - bno_start : 0;
@@ -156,8 +167,10 @@ void File::AllocateData() {
         transaction->GetWork()->PinVnode(fbl::WrapRefPtr(this));
         transaction->Resolve();
 
-        // Return remaining reserved blocks back to the allocation state.
-        blk_t bno_remaining = expected_blocks - bno_count;
+        // Return remaining reserved blocks back to the allocation state. For files mapped by
+        // extents, this includes the blocks reserved for the nodes of the tree.
+        blk_t bno_remaining = HasExtents() ? static_cast<blk_t>(transaction->GetReservedBlocks())
+                                           : expected_blocks - bno_count;
         transaction->GiveBlocksToPromise(bno_remaining, allocation_state_.GetPromise());
 
         // Commit may fail if we are in a readonly state, but we should continue resolving all
@@ -299,6 +312,9 @@ zx_status_t File::Write(const void* data, size_t len, size_t offset,
     if (status != ZX_OK) {
         return status;
     }
+    if (HasExtents()) {
+        reserve_blocks += kExtentTreeReserveBlocks;
+    }
     fbl::unique_ptr<Transaction> transaction;
     if ((status = fs_->BeginTransaction(0, reserve_blocks, &transaction)) != ZX_OK) {
         return status;
@@ -309,6 +325,13 @@ zx_status_t File::Write(const void* data, size_t len, size_t offset,
         return status;
     }
     if (*out_actual != 0) {
+#ifdef __Fuchsia__
+        if (HasExtents()) {
+            // The extents are updated once the data blocks are allocated.
+            transaction->GiveBlocksToPromise(kExtentTreeReserveBlocks,
+                                             allocation_state_.GetPromise());
+        }
+#endif
         // Enqueue metadata allocated via write.
         InodeSync(transaction->GetWork(), kMxFsSyncMtime);  // Successful writes updates mtime
         transaction->GetWork()->PinVnode(fbl::WrapRefPtr(this));
@@ -343,6 +366,9 @@ zx_status_t File::Truncate(size_t len) {
     fbl::unique_ptr<Transaction> transaction;
     // Due to file copy-on-write, up to 1 new (data) block may be required.
     size_t reserve_blocks = 1;
+    if (HasExtents()) {
+        reserve_blocks += kExtentTreeReserveBlocks;
+    }
     zx_status_t status;
 
     if ((status = fs_->BeginTransaction(0, reserve_blocks, &transaction)) != ZX_OK) {
@@ -354,6 +380,11 @@ zx_status_t File::Truncate(size_t len) {
     }
 
 #ifdef __Fuchsia__
+    if (HasExtents() && allocation_state_.GetTotalPending() != 0) {
+        transaction->GiveBlocksToPromise(kExtentTreeReserveBlocks,
+                                         allocation_state_.GetPromise());
+    }
+
     // Shortcut case: If we don't have any data blocks to update, we may as well just update
     // the inode by itself.
     //
@@ -7,9 +7,15 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
+
+#include <fbl/vector.h>
 #include <minfs/format.h>
 #include <minfs/fsck.h>
+#include <minfs/journal.h>
 
+#include "directory-index.h"
+#include "extent-tree.h"
 #include "minfs-private.h"
 #include <utility>
 
@@ -46,8 +52,15 @@ private:
                                blk_t* bno_out);
     zx_status_t CheckDirectory(Inode* inode, ino_t ino,
                                ino_t parent, uint32_t flags);
+    // Verifies that an up to date index of a directory lists exactly the
+    // dirents in |entries|, with the kMinfsReclenLast dirent at |last_off|.
+    zx_status_t CheckDirectoryIndex(Inode* inode, ino_t ino, VnodeMinfs* vn,
+                                    fbl::Vector<DirIndexEntry>* entries, size_t last_off);
     const char* CheckDataBlock(blk_t bno);
     zx_status_t CheckFile(Inode* inode, ino_t ino);
+    zx_status_t CheckExtents(Inode* inode, ino_t ino);
+    // Verifies that the file ends after block |next_blk| - 1 and holds |block_count| blocks.
+    void CheckFileBlocks(Inode* inode, ino_t ino, blk_t next_blk, uint32_t block_count);
 
     fbl::unique_ptr<Minfs> fs_;
     RawBitmap checked_inodes_;
@@ -177,6 +190,7 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
         return status;
     }
 
+    fbl::Vector<DirIndexEntry> entries;
     size_t off = 0;
     while (true) {
         uint32_t data[MINFS_DIRENT_SIZE];
@@ -254,6 +268,16 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
                     return status;
                 }
             }
+            if (flags & CD_DUMP) {
+                fbl::AllocChecker ac;
+                DirIndexEntry entry = {
+                    DirectoryIndex::Hash(fbl::StringPiece(de->name, de->namelen)),
+                    static_cast<uint32_t>(off)};
+                entries.push_back(entry, &ac);
+                if (!ac.check()) {
+                    return ZX_ERR_NO_MEMORY;
+                }
+            }
             dirent_count++;
         }
         if (is_last) {
@@ -273,6 +297,110 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
     if (dotdot == false) {
         FS_TRACE_ERROR("check: ino#%u: directory missing '..'\n", ino);
     }
+    if (flags & CD_DUMP) {
+        return CheckDirectoryIndex(inode, ino, vn.get(), &entries, off);
+    }
+    return ZX_OK;
+}
+
+zx_status_t MinfsChecker::CheckDirectoryIndex(Inode* inode, ino_t ino, VnodeMinfs* vn,
+                                              fbl::Vector<DirIndexEntry>* entries,
+                                              size_t last_off) {
+    if (inode->size < kMinfsDirIndexStart + kMinfsBlockSize) {
+        return ZX_OK;
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<DirIndexRoot> root(new (&ac) DirIndexRoot);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::unique_ptr<DirIndexBucket> bucket(new (&ac) DirIndexBucket);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_status_t status;
+    if ((status = vn->ReadExactInternal(nullptr, root.get(), kMinfsBlockSize,
+                                        kMinfsDirIndexStart)) != ZX_OK) {
+        FS_TRACE_ERROR("check: ino#%u: Could not read index root\n", ino);
+        return status;
+    }
+    if (root->magic != kMinfsDirIndexMagic) {
+        return ZX_OK;
+    }
+    if (root->seq_num != inode->seq_num) {
+        // The index is stale, and will be rebuilt before it is used.
+        FS_TRACE_DEBUG("ino#%u: stale index\n", ino);
+        return ZX_OK;
+    }
+    if (root->bucket_count == 0 || root->bucket_count > kMinfsDirIndexMaxBuckets ||
+        root->ranges[0].hash != 0) {
+        FS_TRACE_ERROR("check: ino#%u: index has bad root\n", ino);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    if (root->last_off != last_off) {
+        FS_TRACE_ERROR("check: ino#%u: index last dirent at %u != %zu (actual)\n", ino,
+                       root->last_off, last_off);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    fbl::Array<bool> seen(new (&ac) bool[root->bucket_count](), root->bucket_count);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::Vector<DirIndexEntry> indexed;
+    for (uint32_t n = 0; n < root->bucket_count; n++) {
+        const DirIndexRange& range = root->ranges[n];
+        if ((n > 0 && range.hash <= root->ranges[n - 1].hash) ||
+            range.bucket >= root->bucket_count || seen[range.bucket]) {
+            FS_TRACE_ERROR("check: ino#%u: index range %u is invalid\n", ino, n);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        seen[range.bucket] = true;
+        size_t bucket_off = kMinfsDirIndexStart + (range.bucket + 1) * kMinfsBlockSize;
+        if ((status = vn->ReadExactInternal(nullptr, bucket.get(), kMinfsBlockSize,
+                                            bucket_off)) != ZX_OK) {
+            FS_TRACE_ERROR("check: ino#%u: Could not read index bucket %u\n", ino,
+                           range.bucket);
+            return status;
+        }
+        if (bucket->count > kMinfsDirIndexBucketEntries) {
+            FS_TRACE_ERROR("check: ino#%u: index bucket %u is too large\n", ino, range.bucket);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        for (uint32_t i = 0; i < bucket->count; i++) {
+            const DirIndexEntry& entry = bucket->entries[i];
+            if (entry.hash < range.hash ||
+                (n + 1 < root->bucket_count && entry.hash >= root->ranges[n + 1].hash) ||
+                (i > 0 && entry.hash < bucket->entries[i - 1].hash)) {
+                FS_TRACE_ERROR("check: ino#%u: index bucket %u is out of order\n", ino,
+                               range.bucket);
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+            indexed.push_back(entry, &ac);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
+        }
+    }
+
+    // Every dirent must be listed exactly once, under the hash of its name.
+    auto less = [](const DirIndexEntry& a, const DirIndexEntry& b) {
+        return a.hash < b.hash || (a.hash == b.hash && a.off < b.off);
+    };
+    std::sort(entries->begin(), entries->end(), less);
+    std::sort(indexed.begin(), indexed.end(), less);
+    if (indexed.size() != entries->size()) {
+        FS_TRACE_ERROR("check: ino#%u: index holds %zu dirents != %zu (actual)\n", ino,
+                       indexed.size(), entries->size());
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    for (size_t i = 0; i < indexed.size(); i++) {
+        if (indexed[i].hash != (*entries)[i].hash || indexed[i].off != (*entries)[i].off) {
+            FS_TRACE_ERROR("check: ino#%u: index entry for offset %u is invalid\n", ino,
+                           indexed[i].off);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
     return ZX_OK;
 }
 
@@ -294,7 +422,71 @@ const char* MinfsChecker::CheckDataBlock(blk_t bno) {
     return nullptr;
 }
 
+zx_status_t MinfsChecker::CheckExtents(Inode* inode, ino_t ino) {
+    if (!(fs_->Info().flags & kMinfsFlagExtents)) {
+        FS_TRACE_WARN("check: ino#%u: mapped by extents, which the filesystem doesn't use\n",
+                      ino);
+        conforming_ = false;
+    }
+
+    ExtentTree tree(fs_.get(), inode);
+    zx_status_t status;
+    if ((status = tree.Load()) != ZX_OK) {
+        FS_TRACE_ERROR("check: ino#%u: Could not load extents: %d\n", ino, status);
+        return status;
+    }
+    fbl::Vector<blk_t> nodes;
+    if ((status = tree.GetNodes(&nodes)) != ZX_OK) {
+        return status;
+    }
+
+    uint32_t block_count = 0;
+    const char* msg;
+    for (blk_t bno : nodes) {
+        if ((msg = CheckDataBlock(bno)) != nullptr) {
+            FS_TRACE_WARN("check: ino#%u: extent node (@%u): %s\n", ino, bno, msg);
+            conforming_ = false;
+        }
+        block_count++;
+    }
+
+    blk_t next_blk = 0;
+    for (const Extent& extent : tree.Extents()) {
+        for (blk_t n = 0; n < extent.length; n++) {
+            if ((msg = CheckDataBlock(extent.bno + n)) != nullptr) {
+                FS_TRACE_WARN("check: ino#%u: block %u(@%u): %s\n", ino, extent.start + n,
+                              extent.bno + n, msg);
+                conforming_ = false;
+            }
+        }
+        block_count += extent.length;
+        next_blk = extent.start + extent.length;
+    }
+    CheckFileBlocks(inode, ino, next_blk, block_count);
+    return ZX_OK;
+}
+
+void MinfsChecker::CheckFileBlocks(Inode* inode, ino_t ino, blk_t next_blk,
+                                   uint32_t block_count) {
+    if (next_blk) {
+        unsigned max_blocks = fbl::round_up(inode->size, kMinfsBlockSize) / kMinfsBlockSize;
+        if (next_blk > max_blocks) {
+            FS_TRACE_WARN("check: ino#%u: filesize too small\n", ino);
+            conforming_ = false;
+        }
+    }
+    if (block_count != inode->block_count) {
+        FS_TRACE_WARN("check: ino#%u: block count %u, actual blocks %u\n",
+             ino, inode->block_count, block_count);
+        conforming_ = false;
+    }
+}
+
 zx_status_t MinfsChecker::CheckFile(Inode* inode, ino_t ino) {
+    if (inode->flags & kMinfsInodeFlagExtents) {
+        return CheckExtents(inode, ino);
+    }
+
     FS_TRACE_DEBUG("Direct blocks: \n");
     for (unsigned n = 0; n < kMinfsDirect; n++) {
         FS_TRACE_DEBUG(" %d,", inode->dnum[n]);
@@ -379,18 +571,7 @@ zx_status_t MinfsChecker::CheckFile(Inode* inode, ino_t ino) {
         }
         n = next_n;
     }
-    if (next_blk) {
-        unsigned max_blocks = fbl::round_up(inode->size, kMinfsBlockSize) / kMinfsBlockSize;
-        if (next_blk > max_blocks) {
-            FS_TRACE_WARN("check: ino#%u: filesize too small\n", ino);
-            conforming_ = false;
-        }
-    }
-    if (block_count != inode->block_count) {
-        FS_TRACE_WARN("check: ino#%u: block count %u, actual blocks %u\n",
-             ino, inode->block_count, block_count);
-        conforming_ = false;
-    }
+    CheckFileBlocks(inode, ino, next_blk, block_count);
     return ZX_OK;
 }
 
@@ -448,6 +629,10 @@ zx_status_t MinfsChecker::CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot
 
     if (inode.magic == kMinfsMagicDir) {
         FS_TRACE_DEBUG("ino#%u: DIR blks=%u links=%u\n", ino, inode.block_count, inode.link_count);
+        if (inode.flags & kMinfsInodeFlagExtents) {
+            FS_TRACE_ERROR("check: ino#%u: directory mapped by extents\n", ino);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
         if ((status = CheckFile(&inode, ino)) < 0) {
             return status;
         }
@@ -603,6 +788,11 @@ zx_status_t MinfsChecker::CheckJournal() const {
         FS_TRACE_ERROR("minfs: invalid journal magic\n");
         return ZX_ERR_BAD_STATE;
     }
+    if (journal_info->checksum != 0 &&
+        journal_info->checksum != JournalInfoChecksum(*journal_info)) {
+        FS_TRACE_ERROR("minfs: invalid journal checksum\n");
+        return ZX_ERR_BAD_STATE;
+    }
 
     return ZX_OK;
 }
@@ -695,6 +885,15 @@ zx_status_t Fsck(fbl::unique_ptr<Bcache> bc) {
         return status;
     }
 
+    // Check the filesystem as it will be mounted.
+    if ((status = ReplayJournal(bc.get(), info)) != ZX_OK) {
+        FS_TRACE_ERROR("Fsck: failed to replay journal: %d\n", status);
+        return status;
+    }
+    if ((status = LoadSuperblock(bc, &info)) != ZX_OK) {
+        return status;
+    }
+
     MinfsChecker chk;
     if ((status = chk.Init(std::move(bc), &info)) != ZX_OK) {
         FS_TRACE_ERROR("Fsck: Init failure: %d\n", status);
@@ -464,6 +464,48 @@ int emu_mkdir(const char* path, mode_t mode) {
     }
 }
 
+// Opens the directory holding the last component of the target |path|, which is
+// returned in |name|.
+static zx_status_t emu_open_parent(const char* path, fbl::RefPtr<fs::Vnode>* out,
+                                   fbl::StringPiece* name) {
+    path += PREFIX_SIZE;
+    const char* last = strrchr(path, '/');
+    if (last == nullptr) {
+        *out = fakeFs.fake_root;
+        *name = fbl::StringPiece(path);
+        return ZX_OK;
+    }
+    *name = fbl::StringPiece(last + 1);
+    fbl::StringPiece dir(path, last - path);
+    return fakeFs.fake_vfs->Open(fakeFs.fake_root, out, dir, &dir, O_RDONLY, 0);
+}
+
+int emu_unlink(const char* path) {
+    ZX_DEBUG_ASSERT_MSG(!host_path(path), "'emu_' functions can only operate on target paths");
+    fbl::RefPtr<fs::Vnode> dir;
+    fbl::StringPiece name;
+    zx_status_t status = emu_open_parent(path, &dir, &name);
+    if (status == ZX_OK) {
+        status = fakeFs.fake_vfs->Unlink(std::move(dir), name);
+    }
+    STATUS(status);
+}
+
+int emu_rename(const char* oldpath, const char* newpath) {
+    ZX_DEBUG_ASSERT_MSG(!host_path(oldpath) && !host_path(newpath),
+                        "'emu_' functions can only operate on target paths");
+    fbl::RefPtr<fs::Vnode> olddir, newdir;
+    fbl::StringPiece oldname, newname;
+    zx_status_t status = emu_open_parent(oldpath, &olddir, &oldname);
+    if (status == ZX_OK) {
+        status = emu_open_parent(newpath, &newdir, &newname);
+    }
+    if (status == ZX_OK) {
+        status = fakeFs.fake_vfs->Rename(std::move(olddir), std::move(newdir), oldname, newname);
+    }
+    STATUS(status);
+}
+
 DIR* emu_opendir(const char* name) {
     ZX_DEBUG_ASSERT_MSG(!host_path(name), "'emu_' functions can only operate on target paths");
     fbl::RefPtr<fs::Vnode> vn;
@@ -33,10 +33,15 @@ typedef uint32_t ino_t;
 constexpr uint64_t kMinfsMagic0         = (0x002153466e694d21ULL);
 constexpr uint64_t kMinfsMagic1         = (0x385000d3d3d3d304ULL);
 constexpr uint32_t kMinfsVersion        = 0x00000007;
+// Version of filesystems formatted with kMinfsFlagExtents, whose extent inodes
+// older drivers would misread as block pointers.
+constexpr uint32_t kMinfsExtentsVersion = 0x00000008;
 
 constexpr ino_t    kMinfsRootIno        = 1;
 constexpr uint32_t kMinfsFlagClean      = 0x00000001; // Currently unused
 constexpr uint32_t kMinfsFlagFVM        = 0x00000002; // Mounted on FVM
+constexpr uint32_t kMinfsFlagExtents    = 0x00000004; // New files are mapped by extents
+constexpr uint32_t kMinfsFlagsKnown     = kMinfsFlagClean | kMinfsFlagFVM | kMinfsFlagExtents;
 constexpr uint32_t kMinfsBlockSize      = 8192;
 constexpr uint32_t kMinfsBlockBits      = (kMinfsBlockSize * 8);
 constexpr uint32_t kMinfsInodeSize      = 256;
@@ -129,16 +134,46 @@ constexpr size_t kMinfsMinimumSlices = 7;
 
 constexpr uint64_t kMinfsDefaultInodeCount = 32768;
 
+// The journal starts with a JournalInfo block, followed by the entries.  Each
+// entry is a JournalEntryHeader block, the blocks it updates, and a
+// JournalEntryCommit block, laid out contiguously.  Entries are written one
+// after the other from the start of the journal, and the journal is retired
+// (emptied) before an entry would run past its end.
+//
+// On mount, the entries from |start_block| are replayed in order, as long as
+// their headers and commits are intact and their timestamps follow each other
+// from |timestamp|.
 struct JournalInfo {
     uint64_t magic;
-    uint64_t reserved0;
-    uint64_t reserved1;
-    uint64_t reserved2;
-    uint64_t reserved3;
+    uint64_t start_block; // Entry block at which the first live entry starts.
+    uint64_t timestamp;   // Timestamp expected from the entry at |start_block|.
+    uint64_t checksum;    // crc32 of this structure, computed with |checksum| set to zero.
+    uint64_t reserved;
 };
 
 static_assert(sizeof(JournalInfo) <= kMinfsBlockSize, "Journal info size is too large");
 
+constexpr uint64_t kJournalEntryHeaderMagic = (0x6d696e6a68656164ULL);
+constexpr uint64_t kJournalEntryCommitMagic = (0x6d696e6a636d6974ULL);
+
+struct JournalEntryHeader {
+    uint64_t magic;
+    uint64_t timestamp;
+    uint64_t reserved;
+    uint64_t num_blocks; // Number of blocks updated by the entry.
+    blk_t target_blocks[kJournalEntryHeaderMaxBlocks];
+};
+
+static_assert(sizeof(JournalEntryHeader) == kMinfsBlockSize, "Journal header size is wrong");
+
+struct JournalEntryCommit {
+    uint64_t magic;
+    uint64_t timestamp;
+    uint64_t checksum; // crc32 of the header and updated blocks of the entry.
+};
+
+static_assert(sizeof(JournalEntryCommit) <= kMinfsBlockSize, "Journal commit size is too large");
+
 struct Inode {
     uint32_t magic;
     uint32_t size;
@@ -151,7 +186,8 @@ struct Inode {
     uint32_t dirent_count;          // for directories
     ino_t last_inode;               // index to the previous unlinked inode
     ino_t next_inode;               // index to the next unlinked inode
-    uint32_t rsvd[3];
+    uint32_t flags;                 // kMinfsInodeFlag*
+    uint32_t rsvd[2];
     blk_t dnum[kMinfsDirect];    // direct blocks
     blk_t inum[kMinfsIndirect];  // indirect blocks
     blk_t dinum[kMinfsDoublyIndirect]; // doubly indirect blocks
@@ -160,6 +196,65 @@ struct Inode {
 static_assert(sizeof(Inode) == kMinfsInodeSize,
               "minfs inode size is wrong");
 
+constexpr uint32_t kMinfsInodeFlagExtents = 0x00000001; // Data is mapped by an ExtentRoot
+
+// Files created on a filesystem with kMinfsFlagExtents carry
+// kMinfsInodeFlagExtents, and map their data with extents rather than block
+// pointers: the space of dnum, inum and dinum holds an ExtentRoot instead.
+// Directories always use block pointers. Drivers which don't know about
+// extents would misread these files, so the format is only used when requested
+// by mkfs.
+//
+// A file with up to kMinfsInlineExtents extents lists them in the root, which
+// then has a depth of zero. Larger files have a tree of ExtentNodes: the root
+// and the nodes of depth d > 0 list the nodes of depth d - 1 below them, and
+// the nodes of depth zero list the extents of the file. Entries are sorted by
+// |start| and don't overlap. Entries pointing at a node have the first block
+// of the file mapped under that node as |start|, the node as |bno|, and a
+// |length| of zero.
+//
+// Every node but the only one of its depth is kept at least half full.
+constexpr uint64_t kMinfsExtentMagic    = (0x746e657478652121ULL);
+constexpr uint32_t kMinfsInlineExtents  = 15;
+constexpr uint32_t kMinfsExtentMaxDepth = 2;
+
+struct Extent {
+    blk_t start;      // First block of the file mapped by the extent
+    blk_t bno;        // First data block of the extent, or the node below
+    uint32_t length;  // Number of blocks, or zero when pointing at a node
+};
+
+struct ExtentRoot {
+    uint16_t depth;     // Zero if |entries| are extents, else one more than their nodes
+    uint16_t count;     // Number of entries
+    uint32_t reserved[2];
+    Extent entries[kMinfsInlineExtents];
+};
+
+static_assert(sizeof(ExtentRoot) ==
+              sizeof(blk_t) * (kMinfsDirect + kMinfsIndirect + kMinfsDoublyIndirect),
+              "minfs extent root size is wrong");
+
+constexpr uint32_t kMinfsExtentsPerNode = (kMinfsBlockSize - 16) / sizeof(Extent);
+
+struct ExtentNode {
+    uint64_t magic;
+    uint16_t depth;
+    uint16_t count;
+    uint32_t reserved;
+    Extent entries[kMinfsExtentsPerNode];
+};
+
+static_assert(sizeof(ExtentNode) == kMinfsBlockSize, "minfs extent node size is wrong");
+
+inline ExtentRoot* GetExtentRoot(Inode* inode) {
+    return reinterpret_cast<ExtentRoot*>(inode->dnum);
+}
+
+inline const ExtentRoot* GetExtentRoot(const Inode* inode) {
+    return reinterpret_cast<const ExtentRoot*>(inode->dnum);
+}
+
 struct Dirent {
     ino_t ino;                      // inode number
     uint32_t reclen;                // Low 28 bits: Length of record
@@ -205,6 +300,59 @@ static_assert(kMinfsMaxDirectorySize <= kMinfsReclenMask,
 //   record starts. If the MAX_DIR_SIZE is increased, this 'last' record will
 //   also increase in size.
 
+// Directories larger than a single block carry a hashed index from names to
+// the offsets of their dirents, so that lookups don't need to walk the whole
+// directory. The index lives in the blocks starting at kMinfsDirIndexStart,
+// past the last possible dirent, where linear walks of the directory never
+// look.
+//
+// The first block of the index holds a DirIndexRoot, which splits the space of
+// name hashes into ranges, each covered by one bucket. Bucket n is the block
+// at kMinfsDirIndexStart + (n + 1) * kMinfsBlockSize, and holds a
+// DirIndexBucket listing the dirents of the names in its range.
+//
+// The index is only used while |DirIndexRoot::seq_num| matches the |seq_num|
+// of the directory inode, which changes with every modification of the
+// dirents. Drivers which don't know about the index leave it stale, and it is
+// then rebuilt from the dirents.
+constexpr uint64_t kMinfsDirIndexMagic = (0x78646e6972696421ULL);
+constexpr uint32_t kMinfsDirIndexStart = ((kMinfsMaxDirectorySize + kMinfsBlockSize - 1) /
+                                          kMinfsBlockSize) * kMinfsBlockSize;
+
+struct DirIndexRange {
+    uint32_t hash;    // Smallest name hash in the range
+    uint32_t bucket;  // Bucket holding the names in the range
+};
+
+constexpr uint32_t kMinfsDirIndexMaxBuckets = (kMinfsBlockSize - 24) / sizeof(DirIndexRange);
+
+struct DirIndexRoot {
+    uint64_t magic;
+    uint32_t seq_num;       // Inode seq_num as of the last update of the index
+    uint32_t last_off;      // Offset of the dirent flagged with kMinfsReclenLast
+    uint32_t bucket_count;  // Number of ranges and buckets
+    uint32_t reserved;
+    DirIndexRange ranges[kMinfsDirIndexMaxBuckets];  // Sorted by hash, the first one is zero
+};
+
+static_assert(sizeof(DirIndexRoot) == kMinfsBlockSize, "minfs directory index root size is wrong");
+
+struct DirIndexEntry {
+    uint32_t hash;  // FNV-1a hash of the name
+    uint32_t off;   // Offset of the dirent
+};
+
+constexpr uint32_t kMinfsDirIndexBucketEntries = (kMinfsBlockSize - 8) / sizeof(DirIndexEntry);
+
+struct DirIndexBucket {
+    uint32_t count;
+    uint32_t reserved;
+    DirIndexEntry entries[kMinfsDirIndexBucketEntries];  // Sorted by hash
+};
+
+static_assert(sizeof(DirIndexBucket) == kMinfsBlockSize,
+              "minfs directory index bucket size is wrong");
+
 // blocksize   8K    16K    32K
 // 16 dir =  128K   256K   512K
 // 32 ind =  512M  1024M  2048M
@@ -53,6 +53,8 @@ int emu_fstat(int fd, struct stat* s);
 int emu_stat(const char* fn, struct stat* s);
 
 int emu_mkdir(const char* path, mode_t mode);
+int emu_unlink(const char* path);
+int emu_rename(const char* oldpath, const char* newpath);
 DIR* emu_opendir(const char* name);
 struct dirent* emu_readdir(DIR* dirp);
 void emu_rewinddir(DIR* dirp);
@@ -0,0 +1,123 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file describes the metadata journal of MinFS.  See format.h for the
+// on-disk layout.
+
+#pragma once
+
+#include <fbl/macros.h>
+#include <minfs/bcache.h>
+#include <minfs/format.h>
+
+#ifdef __Fuchsia__
+#include <fbl/vector.h>
+#include <minfs/writeback.h>
+
+#include <memory>
+#endif
+
+namespace minfs {
+
+// Sets |*start| to the block holding the JournalInfo of |info|, and |*blocks|
+// to the number of blocks of the journal, including the JournalInfo.
+void GetJournalLocation(const Superblock& info, blk_t* start, blk_t* blocks);
+
+// Returns the checksum to store in |info|.
+uint64_t JournalInfoChecksum(const JournalInfo& info);
+
+// Copies every entry of the journal which hasn't been retired to its target
+// blocks, then retires them.  This must happen before any other metadata is
+// read from |bc|, as the entries may update any of it, including |info|.
+zx_status_t ReplayJournal(Bcache* bc, const Superblock& info);
+
+#ifdef __Fuchsia__
+
+class Buffer;
+
+// Writes the metadata updates of the writeback thread to the journal before
+// they are written in place.
+//
+// Consecutive metadata works are grouped into a single entry, so that many
+// operations share one sequential write and one flush of the device.  Once
+// the entry is durable, its blocks are written in place without waiting.
+// Entries are retired in bulk: when the journal is full, when it is about to
+// be torn down, or when a block it holds is about to be reused for file data,
+// which a replay would otherwise overwrite.
+//
+// This is not the journal of blobfs, which is built on blobfs's own
+// TransactionManager, VmoBuffer and WritebackWork and runs its own thread.
+// Minfs writes through its own writeback queue and Buffer, so its journal
+// works on those instead; sharing one would first mean moving blobfs's
+// journal into a library common to both.
+//
+// This class is thread-compatible: it is only used by the writeback thread.
+class Journal {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Journal);
+
+    ~Journal();
+
+    // Creates the journal of |info|, which must have been replayed, writing
+    // blocks out of |buffer|.
+    static zx_status_t Create(Bcache* bc, const Superblock& info, Buffer* buffer,
+                              std::unique_ptr<Journal>* out);
+
+    // Returns the maximum number of blocks which may be committed in one entry.
+    blk_t GetMaximumEntryBlocks() const;
+
+    // Writes the blocks of the |count| works at |works|, which are held in
+    // the buffer, to the journal as one entry, then in place.  Doesn't
+    // complete the works.  Returns ZX_ERR_OUT_OF_RANGE if the works update
+    // more than |GetMaximumEntryBlocks()| blocks.
+    zx_status_t Commit(WritebackWork* const* works, size_t count);
+
+    // Prepares the journal for the blocks of file data |work| to be written
+    // in place, retiring the journal if it holds any of them.
+    zx_status_t PrepareData(WritebackWork* work);
+
+    // Waits for every committed entry to be written in place, and empties the
+    // journal.
+    zx_status_t Retire();
+
+private:
+    // A block updated by an entry, and where it is held in the buffer.
+    struct Target {
+        blk_t dev_block;
+        blk_t buffer_block;
+    };
+
+    Journal(Bcache* bc, Buffer* buffer, std::unique_ptr<Buffer> blocks, blk_t start,
+            blk_t capacity, blk_t dat_block, uint64_t timestamp)
+        : bc_(bc), buffer_(buffer), blocks_(std::move(blocks)), start_(start),
+          capacity_(capacity), dat_block_(dat_block), timestamp_(timestamp) {}
+
+    // Writes the JournalInfo, marking the entry at |next_| as the first one.
+    zx_status_t WriteInfo();
+
+    Bcache* bc_;
+    // The writeback buffer, holding the blocks of the works.
+    Buffer* buffer_;
+    // Scratch blocks for the header and commit of an entry, and the JournalInfo.
+    std::unique_ptr<Buffer> blocks_;
+
+    // The block holding the JournalInfo, followed by |capacity_| entry blocks.
+    const blk_t start_;
+    const blk_t capacity_;
+    const blk_t dat_block_;
+
+    // Entry block at which the next entry is written.
+    blk_t next_ = 0;
+    // Timestamp of the next entry.
+    uint64_t timestamp_;
+
+    // The blocks of the data region held by the live entries, sorted.
+    fbl::Vector<blk_t> data_targets_;
+    // The blocks of the entry being committed.
+    fbl::Vector<Target> targets_;
+};
+
+#endif // __Fuchsia__
+
+} // namespace minfs
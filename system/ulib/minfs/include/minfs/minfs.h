@@ -44,6 +44,10 @@ struct MountOptions {
 
     // Number of slices to preallocate for data when the filesystem is created.
     uint32_t fvm_data_slices = 1;
+
+    // Map the data of new files with extents rather than block pointers, when the filesystem is
+    // created. Drivers which don't know about extents can't read these files.
+    bool extents = false;
 };
 
 // Format the partition backed by |bc| as MinFS.
@@ -29,7 +29,8 @@ public:
     // section within one transaction. For data vnodes, based on a max write size of 64kb, this is
     // currently expected to be 3 indirect blocks (would be 4 with the introduction of more doubly
     // indirect blocks). For directories, with a max dirent size of 268b, this is expected to be 5
-    // blocks.
+    // blocks, plus the blocks of the directory index. Files mapped by extents may update up to
+    // |kMaxExtentTreeBlocks| nodes instead.
     blk_t GetMaximumMetaDataBlocks() const { return max_meta_data_blocks_; }
 
     // Returns the maximum number of data blocks (including indirects) that we expect to be
@@ -64,6 +65,15 @@ public:
     // A maximum of 1 inode can be created or deleted during a single transaction.
     static constexpr blk_t kMaxInodeBitmapBlocks = 1;
 
+    // Maximum number of directory index blocks that can be modified within one transaction.
+    // Adding a dirent updates the index root and a bucket, which may be split into a new bucket.
+    static constexpr blk_t kMaxDirectoryIndexBlocks = 3;
+
+    // Maximum number of extent tree nodes that can be modified within one transaction.
+    // Updating the extents of a file rewrites up to three nodes of each depth, and may add one
+    // more to grow the tree.
+    static constexpr blk_t kMaxExtentTreeBlocks = 7;
+
     // Maximum number of inode table blocks that can be modified within one transaction.
     // No more than 2 inodes will be modified during a single transaction.
     // (In the case of Create, the parent directory and the child inode will be modified.)
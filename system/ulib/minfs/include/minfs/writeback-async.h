@@ -8,8 +8,11 @@
 #error Fuchsia-only Header
 #endif
 
+#include <minfs/journal.h>
 #include <minfs/writeback.h>
 
+#include <memory>
+
 namespace minfs {
 
 // In-memory data buffer.
@@ -36,12 +39,17 @@ public:
     void CopyTransaction(WriteTxn* txn);
 
     // Returns true if |txn| belongs to this buffer, and if so verifies
-    // that it owns the next valid set of blocks within the buffer.
-    bool VerifyTransaction(WriteTxn* txn) const;
+    // that it owns the next valid set of blocks within the buffer, once the
+    // first |skip| blocks have been freed.
+    bool VerifyTransaction(WriteTxn* txn, blk_t skip = 0) const;
 
     // Free the first |blocks| blocks in the buffer.
     void FreeSpace(blk_t blocks);
 
+    // Returns a pointer to data starting at block |index| in the buffer.
+    void* GetData(blk_t index);
+
+    fuchsia_hardware_block_VmoID vmoid() const { return vmoid_; }
     blk_t start() const { return start_; }
     blk_t length() const { return length_; }
     blk_t capacity() const { return capacity_; }
@@ -51,9 +59,6 @@ private:
         : bc_(bc), mapper_(std::move(mapper)), start_(0), length_(0),
           capacity_(static_cast<blk_t>(mapper_.size() / kMinfsBlockSize)) {}
 
-    // Returns a pointer to data starting at block |index| in the buffer.
-    void* GetData(blk_t index);
-
     Bcache* bc_;
 
     fzl::OwnedVmoMapper mapper_;
@@ -72,6 +77,9 @@ enum class WritebackState {
 
 // Manages an in-memory writeback buffer (and background thread,
 // which flushes this buffer out to disk).
+//
+// Metadata works are written through the journal, batching the consecutive
+// ones which are ready at once into one entry.
 class WritebackQueue {
 public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(WritebackQueue);
@@ -79,8 +87,9 @@ public:
     ~WritebackQueue();
 
     // Initializes the WritebackQueue at |out|
-    // with a buffer of |buffer_blocks| blocks of size kMinfsBlockSize.
-    static zx_status_t Create(Bcache* bc, const blk_t buffer_blocks,
+    // with a buffer of |buffer_blocks| blocks of size kMinfsBlockSize,
+    // and the journal of |info|.
+    static zx_status_t Create(Bcache* bc, const Superblock& info, const blk_t buffer_blocks,
                               fbl::unique_ptr<WritebackQueue>* out);
 
     // Copies all transaction data referenced from |work| into the writeback buffer.
@@ -108,6 +117,10 @@ private:
 
     static int WritebackThread(void* arg);
 
+    // Writes out the |count| works at |works|, which are either a batch of
+    // journaled works, or a single other work.
+    zx_status_t ProcessWorks(WritebackWork* const* works, size_t count);
+
     // Asynchronously processes writeback work.
     void ProcessLoop();
 
@@ -127,6 +140,10 @@ private:
     // Buffer which stores transactions to be written out to disk.
     std::unique_ptr<Buffer> buffer_;
 
+    // Journal through which metadata is written out of |buffer_|.
+    // Only accessed by the background thread once it is running.
+    std::unique_ptr<Journal> journal_;
+
     bool unmounting_ __TA_GUARDED(lock_) = false;
 
     // The WritebackQueue will start off in a kInit state, and will change to kRunning when the
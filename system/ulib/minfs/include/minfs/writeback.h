@@ -64,6 +64,11 @@ public:
     // Only one closure may be set for each WritebackWork unit.
     using SyncCallback = fs::Vnode::SyncCallback;
     void SetSyncCallback(SyncCallback closure);
+
+    // Returns true if the work is written to the journal before it is written in place, which
+    // is the case of all works but those writing file data.
+    bool IsJournaled() const { return journaled_; }
+    void SetJournaled(bool journaled) { journaled_ = journaled; }
 #endif
 private:
 #ifdef __Fuchsia__
@@ -72,6 +77,7 @@ private:
     void ResetCallbacks(zx_status_t status);
 
     SyncCallback sync_cb_; // Optional.
+    bool journaled_ = true;
 #endif
     size_t node_count_;
     // May be empty. Currently '4' is the maximum number of vnodes within a
@@ -124,6 +130,9 @@ public:
         ZX_DEBUG_ASSERT(work_ != nullptr);
         ZX_DEBUG_ASSERT(data_work_ == nullptr);
         data_work_.reset(new WritebackWork(bc_));
+#ifdef __Fuchsia__
+        data_work_->SetJournaled(false);
+#endif
     }
 
     WritebackWork* GetDataWork() {
@@ -164,6 +173,9 @@ public:
         block_promise_.GiveBlocks(requested, other_promise);
     }
 
+    // Returns the number of blocks which are still reserved.
+    size_t GetReservedBlocks() const { return block_promise_.GetReserved(); }
+
     // Removes |requested| blocks from |other_promise| and gives them to block_promise_.
     void MergeBlockPromise(AllocatorPromise* other_promise) {
         other_promise->GiveBlocks(other_promise->GetReserved(), &block_promise_);
@@ -93,18 +93,22 @@ std::unique_ptr<disk_inspector::DiskObject> InodeObject::GetElementAt(uint32_t i
             return CreateUint32DiskObj("next_inode", &(inode_.next_inode));
         }
         case 11: {
-            //uint32_t Array rsvd
-            return CreateUint32ArrayDiskObj("reserved", inode_.rsvd, 3);
+            // uint32_t flags
+            return CreateUint32DiskObj("flags", &(inode_.flags));
         }
         case 12: {
+            //uint32_t Array rsvd
+            return CreateUint32ArrayDiskObj("reserved", inode_.rsvd, 2);
+        }
+        case 13: {
             // blk_t/uint32_t Array dnum
             return CreateUint32ArrayDiskObj("direct blocks", inode_.dnum, kMinfsDirect);
         }
-        case 13: {
+        case 14: {
             // blk_t/uint32_t Array inum
             return CreateUint32ArrayDiskObj("indirect blocks", inode_.inum, kMinfsIndirect);
         }
-        case 14: {
+        case 15: {
             // blk_t/uint32_t Array dinum
             return CreateUint32ArrayDiskObj("double indirect blocks", inode_.dinum,
                                             kMinfsDoublyIndirect);
@@ -248,20 +252,20 @@ std::unique_ptr<disk_inspector::DiskObject> JournalObject::GetElementAt(uint32_t
             return CreateUint64DiskObj("magic", &(journal_info_->magic));
         }
         case 1: {
-            // uint64_t reserved0
-            return CreateUint64DiskObj("reserved0", &(journal_info_->reserved0));
+            // uint64_t start_block
+            return CreateUint64DiskObj("start_block", &(journal_info_->start_block));
         }
         case 2: {
-            // uint64_t reserved1
-            return CreateUint64DiskObj("reserved1", &(journal_info_->reserved1));
+            // uint64_t timestamp
+            return CreateUint64DiskObj("timestamp", &(journal_info_->timestamp));
         }
         case 3: {
-            // uint64_t reserved2
-            return CreateUint64DiskObj("reserved2", &(journal_info_->reserved2));
+            // uint64_t checksum
+            return CreateUint64DiskObj("checksum", &(journal_info_->checksum));
         }
         case 4: {
-            // uint64_t reserved3
-            return CreateUint64DiskObj("reserved3", &(journal_info_->reserved3));
+            // uint64_t reserved
+            return CreateUint64DiskObj("reserved", &(journal_info_->reserved));
         }
     }
     return nullptr;
@@ -0,0 +1,385 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <minfs/journal.h>
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <fs/block-txn.h>
+#include <fs/trace.h>
+#include <lib/cksum.h>
+#include <minfs/transaction-limits.h>
+
+#ifdef __Fuchsia__
+#include <minfs/writeback-async.h>
+
+#include <algorithm>
+#include <utility>
+#endif
+
+namespace minfs {
+
+namespace {
+
+void SetInfo(JournalInfo* info, uint64_t start_block, uint64_t timestamp) {
+    memset(info, 0, kMinfsBlockSize);
+    info->magic = kJournalMagic;
+    info->start_block = start_block;
+    info->timestamp = timestamp;
+    info->checksum = JournalInfoChecksum(*info);
+}
+
+// Checks the magic and checksum of |info|.  The fields other than the magic
+// are left zeroed by older versions of mkfs.
+zx_status_t CheckInfo(const JournalInfo& info) {
+    if (info.magic != kJournalMagic) {
+        FS_TRACE_ERROR("minfs: invalid journal magic\n");
+        return ZX_ERR_BAD_STATE;
+    }
+    if ((info.start_block != 0 || info.timestamp != 0 || info.checksum != 0) &&
+        info.checksum != JournalInfoChecksum(info)) {
+        FS_TRACE_ERROR("minfs: journal info checksum corrupt\n");
+        return ZX_ERR_BAD_STATE;
+    }
+    return ZX_OK;
+}
+
+} // namespace
+
+void GetJournalLocation(const Superblock& info, blk_t* start, blk_t* blocks) {
+    *start = info.journal_start_block;
+    if ((info.flags & kMinfsFlagFVM) == kMinfsFlagFVM) {
+        const size_t kBlocksPerSlice = info.slice_size / kMinfsBlockSize;
+        *blocks = static_cast<blk_t>(info.journal_slices * kBlocksPerSlice);
+    } else {
+        *blocks = info.dat_block - info.journal_start_block;
+    }
+}
+
+uint64_t JournalInfoChecksum(const JournalInfo& info) {
+    JournalInfo copy = info;
+    copy.checksum = 0;
+    return crc32(0, reinterpret_cast<const uint8_t*>(&copy), sizeof(copy));
+}
+
+zx_status_t ReplayJournal(Bcache* bc, const Superblock& info) {
+#ifndef __Fuchsia__
+    // Sparse images are only built on the host, which writes in place.
+    if (bc->extent_lengths_.size() > 0) {
+        return ZX_OK;
+    }
+#endif
+    if ((info.magic0 != kMinfsMagic0) || (info.magic1 != kMinfsMagic1)) {
+        FS_TRACE_ERROR("minfs: bad magic\n");
+        return ZX_ERR_INVALID_ARGS;
+    }
+    blk_t start, blocks;
+    GetJournalLocation(info, &start, &blocks);
+    if (blocks <= TransactionLimits::kJournalMetadataBlocks) {
+        FS_TRACE_ERROR("minfs: journal too small\n");
+        return ZX_ERR_BAD_STATE;
+    }
+    const blk_t entries = start + TransactionLimits::kJournalMetadataBlocks;
+    const blk_t capacity = blocks - TransactionLimits::kJournalMetadataBlocks;
+
+    zx_status_t status;
+    char info_data[kMinfsBlockSize];
+    if ((status = bc->Readblk(start, info_data)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not read journal block\n");
+        return status;
+    }
+    const JournalInfo* journal_info = reinterpret_cast<const JournalInfo*>(info_data);
+    if ((status = CheckInfo(*journal_info)) != ZX_OK) {
+        return status;
+    }
+
+    char header_data[kMinfsBlockSize];
+    char commit_data[kMinfsBlockSize];
+    char data[kMinfsBlockSize];
+    const JournalEntryHeader* header = reinterpret_cast<const JournalEntryHeader*>(header_data);
+    const JournalEntryCommit* commit = reinterpret_cast<const JournalEntryCommit*>(commit_data);
+
+    // Replay entries until we find one that isn't intact, or which was written
+    // before the journal was last retired.
+    uint64_t position = journal_info->start_block;
+    uint64_t timestamp = journal_info->timestamp;
+    size_t total_entries = 0;
+    size_t total_blocks = 0;
+    while (position + 2 <= capacity) {
+        const blk_t header_block = static_cast<blk_t>(entries + position);
+        if ((status = bc->Readblk(header_block, header_data)) != ZX_OK) {
+            return status;
+        }
+        if (header->magic != kJournalEntryHeaderMagic || header->timestamp != timestamp ||
+            header->num_blocks > kJournalEntryHeaderMaxBlocks ||
+            position + header->num_blocks + 2 > capacity) {
+            break;
+        }
+        const blk_t num_blocks = static_cast<blk_t>(header->num_blocks);
+        if ((status = bc->Readblk(header_block + num_blocks + 1, commit_data)) != ZX_OK) {
+            return status;
+        }
+        if (commit->magic != kJournalEntryCommitMagic || commit->timestamp != timestamp) {
+            break;
+        }
+
+        // The entry may have been torn by a crash before its flush, so verify
+        // its blocks before writing any of them.
+        uint32_t checksum = crc32(0, reinterpret_cast<const uint8_t*>(header_data),
+                                  kMinfsBlockSize);
+        for (blk_t i = 0; i < num_blocks; i++) {
+            if ((status = bc->Readblk(header_block + 1 + i, data)) != ZX_OK) {
+                return status;
+            }
+            checksum = crc32(checksum, reinterpret_cast<const uint8_t*>(data), kMinfsBlockSize);
+        }
+        if (commit->checksum != checksum) {
+            FS_TRACE_WARN("minfs: journal entry %" PRIu64 " is corrupt\n", timestamp);
+            break;
+        }
+
+        for (blk_t i = 0; i < num_blocks; i++) {
+            if ((status = bc->Readblk(header_block + 1 + i, data)) != ZX_OK) {
+                return status;
+            }
+            if ((status = bc->Writeblk(header->target_blocks[i], data)) != ZX_OK) {
+                return status;
+            }
+        }
+
+        position += num_blocks + 2;
+        timestamp++;
+        total_entries++;
+        total_blocks += num_blocks;
+    }
+
+    if (total_entries == 0) {
+        return ZX_OK;
+    }
+
+    FS_TRACE_INFO("minfs: replayed %zu journal entries, updating %zu blocks\n", total_entries,
+                  total_blocks);
+
+    // Make sure the replayed blocks are durable before retiring the entries.
+    if ((status = bc->Sync()) != ZX_OK) {
+        return status;
+    }
+    SetInfo(reinterpret_cast<JournalInfo*>(info_data), 0, timestamp);
+    if ((status = bc->Writeblk(start, info_data)) != ZX_OK) {
+        return status;
+    }
+    return bc->Sync();
+}
+
+#ifdef __Fuchsia__
+
+namespace {
+
+// The blocks of |Journal::blocks_|.
+constexpr blk_t kHeaderBlock = 0;
+constexpr blk_t kCommitBlock = 1;
+constexpr blk_t kInfoBlock = 2;
+constexpr blk_t kScratchBlocks = 3;
+
+} // namespace
+
+Journal::~Journal() = default;
+
+zx_status_t Journal::Create(Bcache* bc, const Superblock& info, Buffer* buffer,
+                            std::unique_ptr<Journal>* out) {
+    blk_t start, blocks;
+    GetJournalLocation(info, &start, &blocks);
+    if (blocks <= TransactionLimits::kJournalMetadataBlocks + 2) {
+        FS_TRACE_ERROR("minfs: journal too small\n");
+        return ZX_ERR_BAD_STATE;
+    }
+
+    zx_status_t status;
+    char data[kMinfsBlockSize];
+    if ((status = bc->Readblk(start, data)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not read journal block\n");
+        return status;
+    }
+    const JournalInfo* journal_info = reinterpret_cast<const JournalInfo*>(data);
+    if ((status = CheckInfo(*journal_info)) != ZX_OK) {
+        return status;
+    }
+    if (journal_info->start_block != 0) {
+        FS_TRACE_ERROR("minfs: journal has not been replayed\n");
+        return ZX_ERR_BAD_STATE;
+    }
+
+    std::unique_ptr<Buffer> scratch;
+    if ((status = Buffer::Create(bc, kScratchBlocks, "minfs-journal", &scratch)) != ZX_OK) {
+        return status;
+    }
+
+    out->reset(new Journal(bc, buffer, std::move(scratch), start,
+                           blocks - TransactionLimits::kJournalMetadataBlocks, info.dat_block,
+                           journal_info->timestamp));
+    return ZX_OK;
+}
+
+blk_t Journal::GetMaximumEntryBlocks() const {
+    return fbl::min(kJournalEntryHeaderMaxBlocks, capacity_ - 2);
+}
+
+zx_status_t Journal::Commit(WritebackWork* const* works, size_t count) {
+    // Collect the blocks updated by the works.  When several works update the
+    // same block, only the last copy is kept.
+    targets_.reset();
+    for (size_t i = 0; i < count; i++) {
+        for (const WriteRequest& request : works[i]->Requests()) {
+            for (blk_t b = 0; b < request.length; b++) {
+                targets_.push_back({request.dev_offset + b, request.vmo_offset + b});
+            }
+        }
+    }
+    std::stable_sort(targets_.begin(), targets_.end(), [](const Target& a, const Target& b) {
+        return a.dev_block < b.dev_block;
+    });
+    blk_t block_count = 0;
+    for (size_t i = 0; i < targets_.size(); i++) {
+        if (i + 1 < targets_.size() && targets_[i + 1].dev_block == targets_[i].dev_block) {
+            continue;
+        }
+        targets_[block_count++] = targets_[i];
+    }
+    if (block_count == 0) {
+        return ZX_OK;
+    }
+    // The entry must be written whole to be atomic, so it can't be split.
+    if (block_count > GetMaximumEntryBlocks()) {
+        FS_TRACE_ERROR("minfs: %u blocks do not fit in a journal entry\n", block_count);
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    zx_status_t status;
+    if (next_ + block_count + 2 > capacity_ && (status = Retire()) != ZX_OK) {
+        return status;
+    }
+    if (next_ + block_count + 2 > capacity_) {
+        return ZX_ERR_NO_SPACE;
+    }
+
+    JournalEntryHeader* header =
+        reinterpret_cast<JournalEntryHeader*>(blocks_->GetData(kHeaderBlock));
+    memset(header, 0, kMinfsBlockSize);
+    header->magic = kJournalEntryHeaderMagic;
+    header->timestamp = timestamp_;
+    header->num_blocks = block_count;
+    for (blk_t i = 0; i < block_count; i++) {
+        header->target_blocks[i] = targets_[i].dev_block;
+    }
+    uint32_t checksum = crc32(0, reinterpret_cast<const uint8_t*>(header), kMinfsBlockSize);
+    for (blk_t i = 0; i < block_count; i++) {
+        checksum = crc32(checksum,
+                         reinterpret_cast<const uint8_t*>(buffer_->GetData(
+                             targets_[i].buffer_block)),
+                         kMinfsBlockSize);
+    }
+
+    JournalEntryCommit* commit =
+        reinterpret_cast<JournalEntryCommit*>(blocks_->GetData(kCommitBlock));
+    memset(commit, 0, kMinfsBlockSize);
+    commit->magic = kJournalEntryCommitMagic;
+    commit->timestamp = timestamp_;
+    commit->checksum = checksum;
+
+    // Write the entry to the journal, as one sequential run of blocks.
+    const blk_t entry_start = start_ + TransactionLimits::kJournalMetadataBlocks + next_;
+    fs::WriteTxn entry_txn(bc_);
+    entry_txn.Enqueue(blocks_->vmoid().id, kHeaderBlock, entry_start, 1);
+    for (blk_t i = 0; i < block_count;) {
+        blk_t run = 1;
+        while (i + run < block_count &&
+               targets_[i + run].buffer_block == targets_[i].buffer_block + run) {
+            run++;
+        }
+        entry_txn.Enqueue(buffer_->vmoid().id, targets_[i].buffer_block, entry_start + 1 + i, run);
+        i += run;
+    }
+    entry_txn.Enqueue(blocks_->vmoid().id, kCommitBlock, entry_start + 1 + block_count, 1);
+    if ((status = entry_txn.Transact()) != ZX_OK) {
+        return status;
+    }
+
+    // Once the entry is durable, its blocks may be written in place in any
+    // order, and without waiting for them to reach the disk.
+    if ((status = bc_->Sync()) != ZX_OK) {
+        return status;
+    }
+
+    fs::WriteTxn txn(bc_);
+    for (blk_t i = 0; i < block_count;) {
+        blk_t run = 1;
+        while (i + run < block_count &&
+               targets_[i + run].dev_block == targets_[i].dev_block + run &&
+               targets_[i + run].buffer_block == targets_[i].buffer_block + run) {
+            run++;
+        }
+        txn.Enqueue(buffer_->vmoid().id, targets_[i].buffer_block, targets_[i].dev_block, run);
+        i += run;
+    }
+    if ((status = txn.Transact()) != ZX_OK) {
+        return status;
+    }
+
+    for (blk_t i = 0; i < block_count; i++) {
+        if (targets_[i].dev_block >= dat_block_) {
+            data_targets_.push_back(targets_[i].dev_block);
+        }
+    }
+    std::sort(data_targets_.begin(), data_targets_.end());
+
+    next_ += block_count + 2;
+    timestamp_++;
+    return ZX_OK;
+}
+
+zx_status_t Journal::PrepareData(WritebackWork* work) {
+    for (const WriteRequest& request : work->Requests()) {
+        const blk_t* target = std::lower_bound(data_targets_.begin(), data_targets_.end(),
+                                               request.dev_offset);
+        if (target != data_targets_.end() && *target < request.dev_offset + request.length) {
+            return Retire();
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t Journal::Retire() {
+    if (next_ == 0) {
+        return ZX_OK;
+    }
+
+    // The entries may only be retired once their blocks have reached their
+    // place on disk.
+    zx_status_t status;
+    if ((status = bc_->Sync()) != ZX_OK) {
+        return status;
+    }
+
+    next_ = 0;
+    if ((status = WriteInfo()) != ZX_OK) {
+        return status;
+    }
+    if ((status = bc_->Sync()) != ZX_OK) {
+        return status;
+    }
+    data_targets_.reset();
+    return ZX_OK;
+}
+
+zx_status_t Journal::WriteInfo() {
+    SetInfo(reinterpret_cast<JournalInfo*>(blocks_->GetData(kInfoBlock)), next_, timestamp_);
+    fs::WriteTxn txn(bc_);
+    txn.Enqueue(blocks_->vmoid().id, kInfoBlock, start_, 1);
+    return txn.Transact();
+}
+
+#endif // __Fuchsia__
+
+} // namespace minfs
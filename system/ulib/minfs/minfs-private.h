@@ -86,6 +86,9 @@ constexpr uint32_t kMxFsSyncCtime = (1 << 1);
 
 constexpr uint32_t kMinfsBlockCacheSize = 64;
 
+// Number of missing names remembered by the Vfs.
+constexpr size_t kMinfsDentryCacheSize = 1024;
+
 // Used by fsck
 class MinfsChecker;
 class VnodeMinfs;
@@ -29,6 +29,7 @@
 #endif
 
 #include <minfs/fsck.h>
+#include <minfs/journal.h>
 #include <minfs/minfs.h>
 
 #include <utility>
@@ -106,9 +107,17 @@ zx_status_t CheckSuperblock(const Superblock* info, Bcache* bc) {
         FS_TRACE_ERROR("minfs: bad magic\n");
         return ZX_ERR_INVALID_ARGS;
     }
-    if (info->version != kMinfsVersion) {
+    if ((info->flags & ~kMinfsFlagsKnown) != 0) {
+        FS_TRACE_ERROR("minfs: unsupported flags %08x\n", info->flags & ~kMinfsFlagsKnown);
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    // Only filesystems which opted into extents carry the newer version, so
+    // existing filesystems keep mounting.
+    const uint32_t version = (info->flags & kMinfsFlagExtents) ? kMinfsExtentsVersion
+                                                               : kMinfsVersion;
+    if (info->version != version) {
         FS_TRACE_ERROR("minfs: FS Version: %08x. Driver version: %08x\n", info->version,
-                       kMinfsVersion);
+                       version);
         return ZX_ERR_INVALID_ARGS;
     }
     if ((info->block_size != kMinfsBlockSize) || (info->inode_size != kMinfsInodeSize)) {
@@ -365,6 +374,7 @@ Minfs::Minfs(fbl::unique_ptr<Bcache> bc, fbl::unique_ptr<SuperblockManager> sb,
 #endif
 
 Minfs::~Minfs() {
+    ClearDentryCache();
     vnode_hash_.clear();
 }
 
@@ -387,6 +397,36 @@ zx_status_t Minfs::InoFree(Transaction* transaction, VnodeMinfs* vn) {
     inodes_->Free(transaction->GetWork(), vn->GetIno());
     uint32_t block_count = vn->GetInode()->block_count;
 
+    if (vn->HasExtents()) {
+        ExtentTree* tree;
+        zx_status_t status;
+        if ((status = vn->GetExtentTree(&tree)) != ZX_OK) {
+            return status;
+        }
+        fbl::Vector<blk_t> nodes;
+        if ((status = tree->GetNodes(&nodes)) != ZX_OK) {
+            return status;
+        }
+
+        // release the blocks of the extents, then the nodes of the tree
+        for (const Extent& extent : tree->Extents()) {
+            for (blk_t n = 0; n < extent.length; n++) {
+                ValidateBno(extent.bno + n);
+                block_count--;
+                block_allocator_->Free(transaction->GetWork(), extent.bno + n);
+            }
+        }
+        for (blk_t bno : nodes) {
+            ValidateBno(bno);
+            block_count--;
+            block_allocator_->Free(transaction->GetWork(), bno);
+        }
+
+        ZX_DEBUG_ASSERT(block_count == 0);
+        ZX_DEBUG_ASSERT(vn->IsUnlinked());
+        return ZX_OK;
+    }
+
     // release all direct blocks
     for (unsigned n = 0; n < kMinfsDirect; n++) {
         if (vn->GetInode()->dnum[n] == 0) {
@@ -897,7 +937,8 @@ zx_status_t Minfs::InitializeWriteback() {
     static const blk_t kWriteBufferBlocks = static_cast<blk_t>(kWriteBufferSize / kMinfsBlockSize);
 
     zx_status_t status;
-    if ((status = WritebackQueue::Create(bc_.get(), kWriteBufferBlocks, &writeback_)) != ZX_OK) {
+    if ((status = WritebackQueue::Create(bc_.get(), Info(), kWriteBufferBlocks,
+                                         &writeback_)) != ZX_OK) {
         return status;
     }
 
@@ -929,12 +970,28 @@ zx_status_t Mount(fbl::unique_ptr<minfs::Bcache> bc, const MountOptions& options
         FS_TRACE_WARN("minfs: filesystem not unmounted cleanly. Integrity check required\n");
     }
 #endif
+    if ((status = ReplayJournal(bc.get(), *info)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: failed to replay journal: %d\n", status);
+        return status;
+    }
+    // The journal may have updated the superblock.
+    if ((status = bc->Readblk(0, &blk)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not read info block: %d\n", status);
+        return status;
+    }
     fbl::unique_ptr<Minfs> fs;
     if ((status = Minfs::Create(std::move(bc), info, &fs, IntegrityCheck::kAll)) != ZX_OK) {
         FS_TRACE_ERROR("minfs: failed to create filesystem object %d\n", status);
         return status;
     }
 
+    // A cached vnode would keep its data vmo resident long after it was
+    // closed, so only the names which don't exist are cached.
+    fs::DentryCacheOptions dentry_options;
+    dentry_options.capacity = kMinfsDentryCacheSize;
+    dentry_options.positive_entries = false;
+    fs->EnableDentryCache(dentry_options);
+
 #ifdef __Fuchsia__
     if (!options.readonly && (status = fs->InitializeWriteback()) != ZX_OK) {
         return status;
@@ -1004,6 +1061,9 @@ void Minfs::Shutdown(fs::Vfs::ShutdownCallback cb) {
         }
     }
     ManagedVfs::Shutdown([this, cb = std::move(cb)](zx_status_t status) mutable {
+        // Release the vnodes held by cached lookups while they can still be
+        // written back.
+        ClearDentryCache();
         Sync([this, cb = std::move(cb)](zx_status_t) mutable {
             async::PostTask(dispatcher(), [this, cb = std::move(cb)]() mutable {
                 // Ensure writeback buffer completes before auxilliary structures
@@ -1050,6 +1110,10 @@ zx_status_t Mkfs(const MountOptions& options, fbl::unique_ptr<Bcache> bc) {
     info.magic1 = kMinfsMagic1;
     info.version = kMinfsVersion;
     info.flags = kMinfsFlagClean;
+    if (options.extents) {
+        info.version = kMinfsExtentsVersion;
+        info.flags |= kMinfsFlagExtents;
+    }
     info.block_size = kMinfsBlockSize;
     info.inode_size = kMinfsInodeSize;
 
@@ -1283,6 +1347,10 @@ zx_status_t Mkfs(const MountOptions& options, fbl::unique_ptr<Bcache> bc) {
     memset(blk, 0, sizeof(blk));
     JournalInfo* journal_info = reinterpret_cast<JournalInfo*>(blk);
     journal_info->magic = kJournalMagic;
+    // Start the timestamps of the entries at an arbitrary value, so that entries left on the
+    // device by a previous filesystem are never replayed.
+    journal_info->timestamp = GetTimeUTC();
+    journal_info->checksum = JournalInfoChecksum(*journal_info);
     bc->Writeblk(info.journal_start_block, blk);
 
     fvm_cleanup.cancel();
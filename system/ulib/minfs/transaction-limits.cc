@@ -88,7 +88,10 @@ void TransactionLimits::CalculateDataBlocks() {
     blk_t direct_blocks = (fbl::round_up(kMaxWriteBytes, kMinfsBlockSize) / kMinfsBlockSize) + 1;
     blk_t max_indirect_blocks = max_data_blocks_ - direct_blocks;
 
-    max_meta_data_blocks_ = fbl::max(max_directory_blocks, max_indirect_blocks);
+    max_directory_blocks += kMaxDirectoryIndexBlocks;
+
+    max_meta_data_blocks_ = fbl::max(fbl::max(max_directory_blocks, max_indirect_blocks),
+                                     kMaxExtentTreeBlocks);
 }
 
 void TransactionLimits::CalculateJournalBlocks(blk_t block_bitmap_blocks) {
@@ -108,7 +111,10 @@ void TransactionLimits::CalculateJournalBlocks(blk_t block_bitmap_blocks) {
     // vnode's maximum possible number of data blocks + indirect blocks, or a data vnode's maximum
     // possible number of indirect blocks.
     blk_t maximum_directory_blocks;
-    ZX_ASSERT(GetRequiredBlockCount(0, kMinfsMaxDirectorySize, &maximum_directory_blocks) == ZX_OK);
+    // This includes the blocks of the directory index, which follow the dirents.
+    constexpr size_t kMaxDirectoryIndexEnd =
+        kMinfsDirIndexStart + (kMinfsDirIndexMaxBuckets + 1) * kMinfsBlockSize;
+    ZX_ASSERT(GetRequiredBlockCount(0, kMaxDirectoryIndexEnd, &maximum_directory_blocks) == ZX_OK);
     blk_t maximum_indirect_blocks = kMinfsIndirect + kMinfsDoublyIndirect * kMinfsDirectPerIndirect;
     blk_t revocation_blocks = fbl::round_up(fbl::max(maximum_directory_blocks,
                                                      maximum_indirect_blocks),
@@ -11,6 +11,7 @@
 #include <sys/stat.h>
 
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <fbl/string_piece.h>
 #include <fs/block-txn.h>
@@ -87,6 +88,25 @@ void VnodeMinfs::SetIno(ino_t ino) {
     ino_ = ino;
 }
 
+zx_status_t VnodeMinfs::GetExtentTree(ExtentTree** out) {
+    ZX_DEBUG_ASSERT(HasExtents());
+    if (extent_tree_ == nullptr) {
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<ExtentTree> tree(new (&ac) ExtentTree(fs_, &inode_));
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        zx_status_t status;
+        if ((status = tree->Load()) != ZX_OK) {
+            FS_TRACE_ERROR("minfs: Failed to load extents of inode %u: %d\n", ino_, status);
+            return status;
+        }
+        extent_tree_ = std::move(tree);
+    }
+    *out = extent_tree_.get();
+    return ZX_OK;
+}
+
 void VnodeMinfs::InodeSync(WritebackWork* wb, uint32_t flags) {
     // by default, c/mtimes are not updated to current time
     if (flags != kMxFsSyncDefault) {
@@ -258,6 +278,23 @@ zx_status_t VnodeMinfs::InitVmo(Transaction* transaction) {
                                ticker.End());
     });
 
+    if (HasExtents()) {
+        // Each extent is read with a single request, however long.
+        ExtentTree* tree;
+        if ((status = GetExtentTree(&tree)) != ZX_OK) {
+            vmo_.reset();
+            return status;
+        }
+        for (const Extent& extent : tree->Extents()) {
+            dnum_count += extent.length;
+            read_transaction.Enqueue(vmoid_.id, extent.start,
+                                     extent.bno + fs_->Info().dat_block, extent.length);
+        }
+        status = read_transaction.Transact();
+        ValidateVmoTail(GetSize());
+        return status;
+    }
+
     // Initialize all direct blocks
     blk_t bno;
     for (uint32_t d = 0; d < kMinfsDirect; d++) {
@@ -538,7 +575,79 @@ void VnodeMinfs::ClearIndirectBlock(blk_t bno) {
 }
 #endif
 
+zx_status_t VnodeMinfs::BlockOpExtents(BlockOpArgs* op_args) {
+    ExtentTree* tree;
+    zx_status_t status;
+    if ((status = GetExtentTree(&tree)) != ZX_OK) {
+        return status;
+    }
+    const fbl::Vector<Extent>& extents = tree->Extents();
+
+    blk_t start = op_args->start;
+    blk_t end = start + op_args->count;
+    if (op_args->op == BlockOp::kDelete) {
+        // No block past the end of the file or its last extent is allocated or pending.
+        blk_t last = static_cast<blk_t>(fbl::round_up(GetSize(), kMinfsBlockSize) /
+                                        kMinfsBlockSize);
+        if (!extents.is_empty()) {
+            const Extent& extent = extents[extents.size() - 1];
+            last = fbl::max(last, extent.start + extent.length);
+        }
+        end = fbl::min(end, fbl::max(last, start));
+    }
+
+    // Collect the new mapping of the blocks, then replace the extents covering them at once.
+    fbl::Vector<Extent> mapped;
+    bool dirty = false;
+    size_t next = tree->Find(start);
+    for (blk_t n = start; n < end; n++) {
+        while (next < extents.size() && extents[next].start + extents[next].length <= n) {
+            next++;
+        }
+        blk_t old_bno = 0;
+        if (next < extents.size() && extents[next].start <= n) {
+            old_bno = extents[next].bno + (n - extents[next].start);
+        }
+        blk_t bno = old_bno;
+        op_args->callback(n, old_bno, &bno);
+        if (op_args->bnos != nullptr) {
+            op_args->bnos[n - start] = bno ? bno : old_bno;
+        }
+        dirty |= bno != old_bno;
+        if (bno == 0) {
+            continue;
+        }
+        if (!mapped.is_empty()) {
+            Extent& last_extent = mapped[mapped.size() - 1];
+            if (last_extent.start + last_extent.length == n &&
+                last_extent.bno + last_extent.length == bno) {
+                last_extent.length++;
+                continue;
+            }
+        }
+        fbl::AllocChecker ac;
+        mapped.push_back({n, bno, 1}, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+
+    if (dirty) {
+        ZX_DEBUG_ASSERT(op_args->transaction != nullptr);
+        if ((status = tree->Replace(op_args->transaction, start, end, mapped.get(),
+                                    mapped.size())) != ZX_OK) {
+            return status;
+        }
+        InodeSync(op_args->transaction->GetWork(), kMxFsSyncDefault);
+    }
+    return ZX_OK;
+}
+
 zx_status_t VnodeMinfs::ApplyOperation(BlockOpArgs* op_args) {
+    if (HasExtents()) {
+        return BlockOpExtents(op_args);
+    }
+
     blk_t start = op_args->start;
     blk_t found = 0;
     bool dirty = false;
@@ -644,7 +753,7 @@ zx_status_t VnodeMinfs::ApplyOperation(BlockOpArgs* op_args) {
 
 zx_status_t VnodeMinfs::EnsureIndirectVmoSize(blk_t n) {
 #ifdef __Fuchsia__
-    if (n >= kMinfsDirect) {
+    if (n >= kMinfsDirect && !HasExtents()) {
         zx_status_t status;
         // If the vmo_indirect_ vmo has not been created, make it now.
         if ((status = InitIndirectVmo()) != ZX_OK) {
@@ -818,7 +927,7 @@ void VnodeMinfs::Purge(Transaction* transaction) {
     fs_->VnodeRelease(this);
 #ifdef __Fuchsia__
     // TODO(smklein): Only init indirect vmo if it's needed
-    if (InitIndirectVmo() == ZX_OK) {
+    if (HasExtents() || InitIndirectVmo() == ZX_OK) {
         fs_->InoFree(transaction, this);
     } else {
         FS_TRACE_ERROR("minfs: Failed to Init Indirect VMO while purging %u\n", ino_);
@@ -1078,6 +1187,9 @@ void VnodeMinfs::Allocate(Minfs* fs, uint32_t type, fbl::RefPtr<VnodeMinfs>* out
         (*out)->inode_.dirent_count = 2;
     } else {
         (*out)->inode_.link_count = 1;
+        if (fs->Info().flags & kMinfsFlagExtents) {
+            (*out)->inode_.flags |= kMinfsInodeFlagExtents;
+        }
     }
 }
 
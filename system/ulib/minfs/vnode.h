@@ -37,6 +37,8 @@
 #include <minfs/transaction-limits.h>
 #include <minfs/writeback.h>
 
+#include "extent-tree.h"
+
 namespace minfs {
 
 // Used by fsck
@@ -184,6 +186,13 @@ public:
     void ReadIndirectBlock(blk_t bno, uint32_t* entry);
 #endif
 
+    // Returns true if the data of the vnode is mapped by extents rather than block pointers.
+    bool HasExtents() const { return (inode_.flags & kMinfsInodeFlagExtents) != 0; }
+
+    // Sets |*out| to the extent tree of the vnode, loading it on first use.
+    // The vnode must have extents.
+    zx_status_t GetExtentTree(ExtentTree** out);
+
     // Update the vnode's inode and write it to disk.
     void InodeSync(WritebackWork* wb, uint32_t flags);
 
@@ -372,6 +381,7 @@ protected:
     zx_status_t BlockOpDirect(BlockOpArgs* op_args, DirectArgs* params);
     zx_status_t BlockOpIndirect(BlockOpArgs* op_args, IndirectArgs* params);
     zx_status_t BlockOpDindirect(BlockOpArgs* op_args, DindirectArgs* params);
+    zx_status_t BlockOpExtents(BlockOpArgs* op_args);
 
     // Ensures that the indirect vmo is large enough to reference a block at
     // relative block address |n| within the file.
@@ -458,6 +468,10 @@ protected:
     // be held before accessing it.
     Inode inode_{};
 
+    // The extents of |inode_|, if it has any and they have been loaded. Like |inode_|, a valid
+    // Transaction object must be held before modifying them.
+    fbl::unique_ptr<ExtentTree> extent_tree_;
+
     // This field tracks the current number of file descriptors with
     // an open reference to this Vnode. Notably, this is distinct from the
     // VnodeMinfs's own refcount, since there may still be filesystem
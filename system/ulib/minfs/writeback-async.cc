@@ -133,13 +133,13 @@ void Buffer::CopyTransaction(WriteTxn* write_transaction) {
     write_transaction->SetBuffer(vmoid_, first_block);
 }
 
-bool Buffer::VerifyTransaction(WriteTxn* write_transaction) const {
+bool Buffer::VerifyTransaction(WriteTxn* write_transaction, blk_t skip) const {
     if (write_transaction->CheckBuffer(vmoid_)) {
         if (write_transaction->BlockCount() > 0) {
             // If the work belongs to the WritebackQueue, verify that it matches up with the
             // buffer's start/len.
-            ZX_ASSERT(write_transaction->BlockStart() == start_);
-            ZX_ASSERT(write_transaction->BlockCount() <= length_);
+            ZX_ASSERT(write_transaction->BlockStart() == (start_ + skip) % capacity_);
+            ZX_ASSERT(skip + write_transaction->BlockCount() <= length_);
         }
 
         return true;
@@ -181,7 +181,7 @@ WritebackQueue::~WritebackQueue() {
     ZX_DEBUG_ASSERT(producer_queue_.is_empty());
 }
 
-zx_status_t WritebackQueue::Create(Bcache* bc, const blk_t buffer_blocks,
+zx_status_t WritebackQueue::Create(Bcache* bc, const Superblock& info, const blk_t buffer_blocks,
                                    fbl::unique_ptr<WritebackQueue>* out) {
     zx_status_t status;
     std::unique_ptr<Buffer> buffer;
@@ -191,6 +191,10 @@ zx_status_t WritebackQueue::Create(Bcache* bc, const blk_t buffer_blocks,
 
     fbl::unique_ptr<WritebackQueue> queue(new WritebackQueue(std::move(buffer)));
 
+    if ((status = Journal::Create(bc, info, queue->buffer_.get(), &queue->journal_)) != ZX_OK) {
+        return status;
+    }
+
     if (thrd_create_with_name(&queue->worker_,
                               WritebackQueue::WritebackThread, queue.get(),
                               "minfs-writeback") != thrd_success) {
@@ -270,30 +274,68 @@ int WritebackQueue::WritebackThread(void* arg) {
     return 0;
 }
 
+zx_status_t WritebackQueue::ProcessWorks(WritebackWork* const* works, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        // If we should complete the work, make sure it has been buffered.
+        // (This is not necessary if we are currently in an error state).
+        ZX_ASSERT(works[i]->IsBuffered());
+    }
+
+    zx_status_t status;
+    if (works[0]->IsJournaled()) {
+        status = journal_->Commit(works, count);
+        for (size_t i = 0; i < count; i++) {
+            works[i]->MarkCompleted(status);
+        }
+        return status;
+    }
+
+    ZX_DEBUG_ASSERT(count == 1);
+    if ((status = journal_->PrepareData(works[0])) != ZX_OK) {
+        works[0]->MarkCompleted(status);
+        return status;
+    }
+    return works[0]->Complete();
+}
+
 void WritebackQueue::ProcessLoop() {
+    fbl::Vector<fbl::unique_ptr<WritebackWork>> batch;
+    fbl::Vector<WritebackWork*> works;
+
     lock_.Acquire();
     while (true) {
         bool error = IsReadOnlyLocked();
         while (!work_queue_.is_empty()) {
-            fbl::unique_ptr<WritebackWork> work = work_queue_.pop();
             TRACE_DURATION("minfs", "WritebackQueue::WritebackThread");
 
-            bool our_buffer = buffer_->VerifyTransaction(work.get());
-
-            // Stay unlocked while processing a unit of work.
+            // Take the next work. If it is journaled, also take the journaled works following it,
+            // as long as they fit in the same journal entry.
+            blk_t buffer_blocks = 0;
+            blk_t entry_blocks = 0;
+            do {
+                fbl::unique_ptr<WritebackWork> work = work_queue_.pop();
+                if (buffer_->VerifyTransaction(work.get(), buffer_blocks)) {
+                    buffer_blocks += work->BlockCount();
+                }
+                entry_blocks += work->BlockCount();
+                works.push_back(work.get());
+                batch.push_back(std::move(work));
+            } while (batch[0]->IsJournaled() && !work_queue_.is_empty() &&
+                     work_queue_.front().IsJournaled() &&
+                     entry_blocks + work_queue_.front().BlockCount() <=
+                         journal_->GetMaximumEntryBlocks());
+
+            // Stay unlocked while processing the works.
             lock_.Release();
 
-            blk_t block_count = work->BlockCount();
-
             if (error) {
-                // If we are in a read only state, reset the work without completing it.
-                work->MarkCompleted(ZX_ERR_BAD_STATE);
+                // If we are in a read only state, reset the works without completing them.
+                for (WritebackWork* work : works) {
+                    work->MarkCompleted(ZX_ERR_BAD_STATE);
+                }
             } else {
-                // If we should complete the work, make sure it has been buffered.
-                // (This is not necessary if we are currently in an error state).
-                ZX_ASSERT(work->IsBuffered());
                 zx_status_t status;
-                if ((status = work->Complete()) != ZX_OK) {
+                if ((status = ProcessWorks(works.get(), works.size())) != ZX_OK) {
                     fprintf(stderr, "Work failed with status %d - "
                                     "converting writeback to read only state.\n", status);
                     // If work completion failed, set the buffer to an error state.
@@ -301,8 +343,11 @@ void WritebackQueue::ProcessLoop() {
                 }
             }
 
-            TRACE_FLOW_END("minfs", "writeback", reinterpret_cast<trace_flow_id_t>(work.get()));
-            work = nullptr;
+            for (WritebackWork* work : works) {
+                TRACE_FLOW_END("minfs", "writeback", reinterpret_cast<trace_flow_id_t>(work));
+            }
+            works.reset();
+            batch.reset();
             lock_.Acquire();
 
             if (error) {
@@ -310,10 +355,8 @@ void WritebackQueue::ProcessLoop() {
                 state_ = WritebackState::kReadOnly;
             }
 
-            if (our_buffer) {
-                // Update the buffer's start/len accordingly.
-                buffer_->FreeSpace(block_count);
-            }
+            // Update the buffer's start/len accordingly.
+            buffer_->FreeSpace(buffer_blocks);
 
             // We may have opened up space (or entered a read only state),
             // so signal the producer queue.
@@ -324,6 +367,10 @@ void WritebackQueue::ProcessLoop() {
         // If work still remains in the work or producer queues,
         // continue the loop until they are empty.
         if (unmounting_ && work_queue_.is_empty() && producer_queue_.is_empty()) {
+            // Leave nothing in the journal for the next mount to replay.
+            if (!IsReadOnlyLocked() && journal_->Retire() != ZX_OK) {
+                fprintf(stderr, "Failed to retire the journal.\n");
+            }
             break;
         }
 
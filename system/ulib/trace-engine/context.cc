@@ -72,6 +72,23 @@
 // manage. The protocol allows for records to be dropped if buffers can't be
 // saved fast enough.
 
+// Notes on allocation modes
+// -------------------------
+//
+// Shared: Every non-durable record is allocated by atomically bumping
+// |rolling_buffer_current_|. This is cheap with one writer, but the shared
+// cache line becomes a bottleneck with many threads tracing at once.
+//
+// Per-thread: Each thread reserves a chunk of the rolling buffer with a single
+// shared allocation and then allocates its records from the chunk without
+// touching any shared state. Any space in the chunk not yet used by records
+// is covered by a padding metadata record, so the buffer can be read at any
+// time. Chunks are abandoned whenever the rolling buffer changes (buffer
+// switch, clear, or tracing being artificially stopped), which is tracked with
+// |thread_chunk_epoch_|. Records from different threads are interleaved in
+// chunk order rather than time order, readers must not assume timestamps are
+// monotonic in the buffer.
+
 #include "context_impl.h"
 
 #include <assert.h>
@@ -80,6 +97,7 @@
 #include <lib/trace-engine/fields.h>
 #include <lib/trace-engine/handler.h>
 
+#include <algorithm>
 #include <atomic>
 #include <mutex>
 
@@ -89,14 +107,40 @@ namespace {
 // The next context generation number.
 std::atomic<uint32_t> g_next_generation{1u};
 
+// The chunk of the rolling buffer the current thread allocates records from
+// in |TRACE_ALLOCATION_MODE_PER_THREAD|.
+struct ThreadChunk {
+    // The generation number of the context the chunk was reserved from.
+    uint32_t generation;
+    // The value of |thread_chunk_epoch_| when the chunk was reserved.
+    uint32_t epoch;
+    // The unused part of the chunk.
+    uint8_t* current;
+    uint8_t* end;
+};
+
+thread_local ThreadChunk tls_chunk{};
+
+// Fills |num_bytes| at |ptr| with a single padding record.
+void WritePadding(uint8_t* ptr, size_t num_bytes) {
+    ZX_DEBUG_ASSERT((num_bytes & 7) == 0);
+    ZX_DEBUG_ASSERT(num_bytes <= RecordFields::kMaxRecordSizeBytes);
+    *reinterpret_cast<uint64_t*>(ptr) =
+        MetadataRecordFields::Type::Make(ToUnderlyingType(RecordType::kMetadata)) |
+        MetadataRecordFields::RecordSize::Make(num_bytes >> 3) |
+        MetadataRecordFields::MetadataType::Make(ToUnderlyingType(MetadataType::kPadding));
+}
+
 } // namespace
 } // namespace trace
 
 trace_context::trace_context(void* buffer, size_t buffer_num_bytes,
                              trace_buffering_mode_t buffering_mode,
+                             trace_allocation_mode_t allocation_mode,
                              trace_handler_t* handler)
     : generation_(trace::g_next_generation.fetch_add(1u, std::memory_order_relaxed) + 1u),
       buffering_mode_(buffering_mode),
+      allocation_mode_(allocation_mode),
       buffer_start_(reinterpret_cast<uint8_t*>(buffer)),
       buffer_end_(buffer_start_ + buffer_num_bytes),
       header_(reinterpret_cast<trace_buffer_header*>(buffer)),
@@ -116,6 +160,45 @@ uint64_t* trace_context::AllocRecord(size_t num_bytes) {
         return nullptr;
     static_assert(TRACE_ENCODED_RECORD_MAX_LENGTH < kMaxRollingBufferSize, "");
 
+    // Shared allocation is the default, so it stays the fast path.
+    if (unlikely(allocation_mode_ == TRACE_ALLOCATION_MODE_PER_THREAD))
+        return AllocThreadRecord(num_bytes);
+    return AllocSharedRecord(num_bytes);
+}
+
+uint64_t* trace_context::AllocThreadRecord(size_t num_bytes) {
+    // Records which would use up a good part of a chunk aren't worth
+    // batching, and may not fit at all.
+    if (unlikely(num_bytes > thread_chunk_size_ / 4))
+        return AllocSharedRecord(num_bytes);
+
+    trace::ThreadChunk& chunk = trace::tls_chunk;
+    uint32_t epoch = thread_chunk_epoch_.load(std::memory_order_acquire);
+    if (unlikely(chunk.generation != generation_ || chunk.epoch != epoch ||
+                 static_cast<size_t>(chunk.end - chunk.current) < num_bytes)) {
+        // Any space left in the old chunk is already covered by padding.
+        // |epoch| was read before reserving the chunk, so if the buffer is
+        // switched meanwhile the chunk will be abandoned at the next
+        // allocation.
+        uint64_t* ptr = AllocSharedRecord(thread_chunk_size_);
+        if (unlikely(!ptr)) {
+            chunk.generation = 0u;
+            return nullptr;
+        }
+        chunk.generation = generation_;
+        chunk.epoch = epoch;
+        chunk.current = reinterpret_cast<uint8_t*>(ptr);
+        chunk.end = chunk.current + thread_chunk_size_;
+    }
+
+    uint8_t* ptr = chunk.current;
+    chunk.current += num_bytes;
+    if (chunk.current != chunk.end)
+        trace::WritePadding(chunk.current, chunk.end - chunk.current);
+    return reinterpret_cast<uint64_t*>(ptr);
+}
+
+uint64_t* trace_context::AllocSharedRecord(size_t num_bytes) {
     // For the circular and streaming cases, try at most once for each buffer.
     // Note: Keep the normal case of one successful pass the fast path.
     // E.g., We don't do a mode comparison unless we have to.
@@ -374,6 +457,10 @@ void trace_context::ComputeBufferSizes() {
     default:
         __UNREACHABLE;
     }
+
+    static_assert(kMaxThreadChunkSize <= trace::RecordFields::kMaxRecordSizeBytes, "");
+    thread_chunk_size_ = std::min(kMaxThreadChunkSize,
+                                  rolling_buffer_size_ / kMinThreadChunksPerBuffer) & ~size_t{7};
 }
 
 void trace_context::ResetDurableBufferPointers() {
@@ -385,6 +472,7 @@ void trace_context::ResetRollingBufferPointers() {
     rolling_buffer_current_.store(0);
     rolling_buffer_full_mark_[0].store(0);
     rolling_buffer_full_mark_[1].store(0);
+    InvalidateThreadChunks();
 }
 
 void trace_context::ResetBufferPointers() {
@@ -550,6 +638,8 @@ void trace_context::SwitchRollingBufferLocked(uint32_t prev_wrapped_count,
     uint64_t new_offset_plus_counter = MakeOffsetPlusCounter(0, new_wrapped_count);
     rolling_buffer_current_.store(new_offset_plus_counter,
                                   std::memory_order_relaxed);
+    // Chunks reserved from the previous buffer must no longer be written to.
+    InvalidateThreadChunks();
 }
 
 void trace_context::MarkTracingArtificiallyStopped() {
@@ -562,6 +652,7 @@ void trace_context::MarkTracingArtificiallyStopped() {
     // then check |tracing_artificially_stopped_|.
     tracing_artificially_stopped_ = true;
     SnapToEnd(CurrentWrappedCount());
+    InvalidateThreadChunks();
 }
 
 void trace_context::NotifyRollingBufferFullLocked(uint32_t wrapped_count,
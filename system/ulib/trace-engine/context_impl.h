@@ -52,7 +52,7 @@ void trace_engine_request_save_buffer(uint32_t wrapped_count,
 // Implements the opaque type declared in <trace-engine/context.h>.
 struct trace_context {
     trace_context(void* buffer, size_t buffer_num_bytes, trace_buffering_mode_t buffering_mode,
-                  trace_handler_t* handler);
+                  trace_allocation_mode_t allocation_mode, trace_handler_t* handler);
 
     ~trace_context();
 
@@ -72,6 +72,8 @@ struct trace_context {
 
     trace_buffering_mode_t buffering_mode() const { return buffering_mode_; }
 
+    trace_allocation_mode_t allocation_mode() const { return allocation_mode_; }
+
     uint64_t num_records_dropped() const {
         return num_records_dropped_.load(std::memory_order_relaxed);
     }
@@ -159,6 +161,14 @@ private:
     // To keep things simple we ignore the header.
     static constexpr size_t kMaxPhysicalBufferSize = kMaxRollingBufferSize;
 
+    // The largest chunk threads reserve in |TRACE_ALLOCATION_MODE_PER_THREAD|.
+    // This must fit in a single padding record.
+    static constexpr size_t kMaxThreadChunkSize = 16 * 1024;
+
+    // Threads reserve chunks of at most this fraction of a rolling buffer, so
+    // that small buffers are not used up by a few threads' chunks.
+    static constexpr size_t kMinThreadChunksPerBuffer = 16;
+
     // The minimum size of the durable buffer.
     // There must be enough space for at least the initialization record.
     static constexpr size_t kMinDurableBufferSize = 16;
@@ -229,6 +239,19 @@ private:
 
     void ComputeBufferSizes();
 
+    // Allocates from the shared rolling buffer.
+    uint64_t* AllocSharedRecord(size_t num_bytes);
+
+    // Allocates from the current thread's chunk of the rolling buffer,
+    // reserving a new chunk if necessary.
+    uint64_t* AllocThreadRecord(size_t num_bytes);
+
+    // Called whenever the rolling buffer threads reserve chunks from changes,
+    // to make threads give up the chunks they hold.
+    void InvalidateThreadChunks() {
+        thread_chunk_epoch_.fetch_add(1u, std::memory_order_release);
+    }
+
     void MarkDurableBufferFull(uint64_t last_offset);
 
     void MarkOneshotBufferFull(uint64_t last_offset);
@@ -270,6 +293,9 @@ private:
     // The buffering mode.
     trace_buffering_mode_t const buffering_mode_;
 
+    // The allocation mode for non-durable records.
+    trace_allocation_mode_t const allocation_mode_;
+
     // Buffer start and end pointers.
     // These encapsulate the entire physical buffer.
     uint8_t* const buffer_start_;
@@ -292,6 +318,13 @@ private:
     // The size of both rolling buffers.
     size_t rolling_buffer_size_;
 
+    // The size of the chunks threads reserve in |TRACE_ALLOCATION_MODE_PER_THREAD|.
+    size_t thread_chunk_size_;
+
+    // Incremented whenever threads must stop allocating from the chunks they
+    // hold, which are tagged with the value at the time they were reserved.
+    std::atomic<uint32_t> thread_chunk_epoch_{0u};
+
     // Current allocation pointer for durable records.
     // This only used in circular and streaming modes.
     // Starts at |durable_buffer_start| and grows from there.
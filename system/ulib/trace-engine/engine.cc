@@ -53,6 +53,12 @@ async_dispatcher_t* g_dispatcher{nullptr};
 //   - can be read outside the lock only while the engine is not stopped
 trace_handler_t* g_handler{nullptr};
 
+// Allocation mode of the next trace context.
+// Rules:
+//   - can only be accessed or modified while holding g_engine_mutex
+trace_allocation_mode_t g_allocation_mode __TA_GUARDED(g_engine_mutex) {
+    TRACE_ALLOCATION_MODE_SHARED};
+
 // Set to true when a trace is terminated and writes are in flight.
 // Rules:
 //   - can only be accessed or modified while holding g_engine_mutex
@@ -374,7 +380,8 @@ EXPORT_NO_DDK zx_status_t trace_engine_initialize(
     g_dispatcher = dispatcher;
     g_handler = handler;
     g_disposition = ZX_OK;
-    g_context = new trace_context(buffer, buffer_num_bytes, buffering_mode, handler);
+    g_context = new trace_context(buffer, buffer_num_bytes, buffering_mode,
+                                  g_allocation_mode, handler);
     g_event = std::move(event);
     g_trace_terminated = false;
 
@@ -387,6 +394,25 @@ EXPORT_NO_DDK zx_status_t trace_engine_initialize(
     return ZX_OK;
 }
 
+// thread-safe
+EXPORT_NO_DDK zx_status_t trace_engine_set_allocation_mode(trace_allocation_mode_t mode) {
+    switch (mode) {
+    case TRACE_ALLOCATION_MODE_SHARED:
+    case TRACE_ALLOCATION_MODE_PER_THREAD:
+        break;
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    std::lock_guard<std::mutex> lock(g_engine_mutex);
+
+    if (g_handler) {
+        return ZX_ERR_BAD_STATE;
+    }
+    g_allocation_mode = mode;
+    return ZX_OK;
+}
+
 // thread-safe
 EXPORT_NO_DDK zx_status_t trace_engine_start(trace_start_mode_t start_mode) {
     std::lock_guard<std::mutex> lock(g_engine_mutex);
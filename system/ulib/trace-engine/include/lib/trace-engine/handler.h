@@ -124,6 +124,19 @@ zx_status_t trace_engine_initialize(async_dispatcher_t* dispatcher,
                                     void* buffer,
                                     size_t buffer_num_bytes);
 
+// Sets how writers allocate space for records in the nondurable buffer
+// in trace sessions initialized after this call.
+// The default is |TRACE_ALLOCATION_MODE_SHARED|. |TRACE_ALLOCATION_MODE_PER_THREAD|
+// is opt-in: compare the two with trace-benchmark's contention benchmark on the
+// target before selecting it.
+//
+// Returns |ZX_OK| on success.
+// Returns |ZX_ERR_INVALID_ARGS| if |mode| is not a valid allocation mode.
+// Returns |ZX_ERR_BAD_STATE| if the engine is already initialized.
+//
+// This function is thread-safe.
+zx_status_t trace_engine_set_allocation_mode(trace_allocation_mode_t mode);
+
 // Asynchronously starts the trace engine.
 // The engine must have already be initialized with |trace_engine_initialize()|.
 //
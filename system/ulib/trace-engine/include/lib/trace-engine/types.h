@@ -356,6 +356,17 @@ typedef enum {
     TRACE_BUFFERING_MODE_STREAMING = 2,
 } trace_buffering_mode_t;
 
+// How writers allocate space for records in the nondurable buffer.
+typedef enum {
+    // Every record is allocated from the shared buffer.
+    TRACE_ALLOCATION_MODE_SHARED = 0,
+    // Each thread reserves chunks of the shared buffer and allocates its
+    // records from them, so that threads writing many records don't contend
+    // on the shared allocation pointer. Space left over at the end of a chunk
+    // is filled with padding records, which readers skip.
+    TRACE_ALLOCATION_MODE_PER_THREAD = 1,
+} trace_allocation_mode_t;
+
 __END_CDECLS
 
 #ifdef __cplusplus
@@ -381,6 +392,8 @@ enum class MetadataType {
     kProviderSection = 2,
     kProviderEvent = 3,
     kTraceInfo = 4,
+    // Unused space, to be skipped. The record may be of any size.
+    kPadding = 5,
 };
 
 // Enumerates all provider events.
@@ -173,6 +173,8 @@ bool TraceReader::ReadMetadataRecord(Chunk& record, RecordHeader header) {
         }
         break;
     }
+    case MetadataType::kPadding:
+        break;
     default: {
         // Ignore unknown metadata types for forward compatibility.
         ReportError(fbl::StringPrintf(
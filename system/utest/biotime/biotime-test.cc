@@ -68,10 +68,20 @@ bool TestBiotimeWrite() {
     END_TEST;
 }
 
+bool TestBiotimeMixed() {
+    BEGIN_TEST;
+
+    fbl::Vector<const char*> args = {"-mixed", "-live-dangerously", "-bs", "4K"};
+    EXPECT_TRUE(run_biotime(std::move(args)));
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(biotime_tests)
 RUN_TEST(TestBiotimeLinearAccess)
 RUN_TEST(TestBiotimeRandomAccess)
 RUN_TEST(TestBiotimeWrite)
+RUN_TEST(TestBiotimeMixed)
 END_TEST_CASE(biotime_tests)
 
 }
@@ -64,6 +64,9 @@ struct BlobfsInfo {
     // Size in bytes of each blob in BlobFs.
     size_t blob_size;
 
+    // Whether the blobs contain compressible data, which blobfs stores compressed.
+    bool compressible = false;
+
     // Path to every blob in Blobfs
     fbl::Vector<fbl::StringBuffer<fs_test_utils::kPathSize>> paths;
 
@@ -115,8 +118,9 @@ fbl::String GetNameForOrder(ReadOrder order) {
     return "";
 }
 
-// Creates a an in memory blob.
-bool MakeBlob(fbl::String fs_path, size_t blob_size, unsigned int* seed,
+// Creates a an in memory blob. Compressible blobs are made of short runs of
+// repeated bytes.
+bool MakeBlob(fbl::String fs_path, size_t blob_size, bool compressible, unsigned int* seed,
               fbl::unique_ptr<BlobInfo>* out) {
     BEGIN_HELPER;
     // Generate a Blob of random data
@@ -130,8 +134,17 @@ bool MakeBlob(fbl::String fs_path, size_t blob_size, unsigned int* seed,
     // sequence for each byte. We did hit this issue, which translates into
     // test failures.
     unsigned int initial_seed = rand_r(seed);
-    for (size_t i = 0; i < blob_size; i++) {
-        info->data[i] = static_cast<char>(rand_r(&initial_seed));
+    if (compressible) {
+        size_t i = 0;
+        while (i < blob_size) {
+            size_t run_length = fbl::min<size_t>(1 + rand_r(&initial_seed) % 64, blob_size - i);
+            memset(&info->data[i], rand_r(&initial_seed), run_length);
+            i += run_length;
+        }
+    } else {
+        for (size_t i = 0; i < blob_size; i++) {
+            info->data[i] = static_cast<char>(rand_r(&initial_seed));
+        }
     }
     info->size_data = blob_size;
 
@@ -183,7 +196,8 @@ public:
         fbl::unique_ptr<BlobInfo> new_blob;
 
         for (int64_t curr = 0; curr < info_.blob_count; ++curr) {
-            MakeBlob(fixture->fs_path(), info_.blob_size, fixture->mutable_seed(), &new_blob);
+            MakeBlob(fixture->fs_path(), info_.blob_size, info_.compressible,
+                     fixture->mutable_seed(), &new_blob);
             fbl::unique_fd fd(open(new_blob->path.c_str(), O_CREAT | O_RDWR));
             ASSERT_TRUE(fd, strerror(errno));
             ASSERT_EQ(ftruncate(fd.get(), info_.blob_size), 0, strerror(errno));
@@ -211,7 +225,8 @@ public:
         // At this specific state, measure how much time in average it takes to perform each of the
         // operations declared.
         while (state->KeepRunning()) {
-            MakeBlob(fixture->fs_path(), info_.blob_size, fixture->mutable_seed(), &new_blob);
+            MakeBlob(fixture->fs_path(), info_.blob_size, info_.compressible,
+                     fixture->mutable_seed(), &new_blob);
             state->NextStep();
 
             fbl::unique_fd fd(open(new_blob->path.c_str(), O_CREAT | O_RDWR));
@@ -279,6 +294,35 @@ public:
         END_HELPER;
     }
 
+    // After doing the API test, we use the written blobs to measure the latency of
+    // opening a blob and reading a small range of it at a random offset, which
+    // need not read or decompress the rest of the blob.
+    bool ReadAtRandomTest(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        state->DeclareStep("open");
+        state->DeclareStep("read");
+        state->DeclareStep("close");
+        ASSERT_GT(info_.paths.size(), 0);
+        ASSERT_GE(info_.blob_size, kRandomReadSize);
+
+        char buffer[kRandomReadSize];
+        const size_t offsets = info_.blob_size / kRandomReadSize;
+        while (state->KeepRunning()) {
+            size_t path_index = rand_r(fixture->mutable_seed()) % info_.paths.size();
+            off_t offset = (rand_r(fixture->mutable_seed()) % offsets) * kRandomReadSize;
+            fbl::unique_fd fd(open(info_.paths[path_index].c_str(), O_RDONLY));
+            ASSERT_TRUE(fd);
+            state->NextStep();
+            ASSERT_EQ(pread(fd.get(), buffer, sizeof(buffer), offset),
+                      static_cast<ssize_t>(sizeof(buffer)));
+            state->NextStep();
+            ASSERT_EQ(close(fd.release()), 0);
+        }
+        END_HELPER;
+    }
+
+    static constexpr size_t kRandomReadSize = 4096;
+
 private:
     void SortPathsByOrder(ReadOrder order, unsigned int* seed) {
         switch (order) {
@@ -341,53 +385,76 @@ bool RunBenchmark(int argc, char** argv) {
     size_t test_index = 0;
     for (auto blob_size : blob_sizes) {
         for (auto blob_count : blob_counts) {
-            // Skip the largest blob size/count combination because it
-            // increases the overall running time too much.
-            if (blob_size >= 1024 * 1024 && blob_count >= 10000) {
-                continue;
-            }
-            BlobfsInfo fs_info;
-            fs_info.blob_count = (p_opts.is_unittest) ? 1 : blob_count;
-            fs_info.blob_size = blob_size;
-            blobfs_tests.push_back(std::move(fs_info));
-            TestCaseInfo testcase;
-            testcase.teardown = false;
-            testcase.sample_count = kSampleCount;
-
-            fbl::String size = GetNameForSize(blob_size);
-
-            TestInfo api_test;
-            api_test.name =
-                fbl::StringPrintf("%s/%s/%luBlobs/Api", disk_format_string_[f_opts.fs_type],
-                                  size.c_str(), blob_count);
-            // There should be enough space for each blob, the merkle tree nodes, and the inodes.
-            api_test.required_disk_space =
-                blob_count * (blob_size + 2 * MerkleTree::kNodeSize + blobfs::kBlobfsInodeSize);
-            api_test.test_fn = [test_index, &blobfs_tests](perftest::RepeatState* state,
-                                                           fs_test_utils::Fixture* fixture) {
-                return blobfs_tests[test_index].ApiTest(state, fixture);
-            };
-            testcase.tests.push_back(std::move(api_test));
-
-            if (blob_count > 0) {
-                for (auto order : orders) {
+            for (bool compressible : {false, true}) {
+                // Skip the largest blob size/count combination because it
+                // increases the overall running time too much.
+                if (blob_size >= 1024 * 1024 && blob_count >= 10000) {
+                    continue;
+                }
+                // Compressible blobs are only interesting when reading part of a large blob.
+                if (compressible && (blob_size < 128 * 1024 || blob_count > 100)) {
+                    continue;
+                }
+                BlobfsInfo fs_info;
+                fs_info.blob_count = (p_opts.is_unittest) ? 1 : blob_count;
+                fs_info.blob_size = blob_size;
+                fs_info.compressible = compressible;
+                blobfs_tests.push_back(std::move(fs_info));
+                TestCaseInfo testcase;
+                testcase.teardown = false;
+                testcase.sample_count = kSampleCount;
+
+                fbl::String size = GetNameForSize(blob_size);
+                if (compressible) {
+                    size = fbl::StringPrintf("%s/Compressible", size.c_str());
+                }
+                // There should be enough space for each blob, the merkle tree nodes, and the
+                // inodes.
+                const size_t required_disk_space =
+                    blob_count * (blob_size + 2 * MerkleTree::kNodeSize + blobfs::kBlobfsInodeSize);
+
+                TestInfo api_test;
+                api_test.name =
+                    fbl::StringPrintf("%s/%s/%luBlobs/Api", disk_format_string_[f_opts.fs_type],
+                                      size.c_str(), blob_count);
+                api_test.required_disk_space = required_disk_space;
+                api_test.test_fn = [test_index, &blobfs_tests](perftest::RepeatState* state,
+                                                               fs_test_utils::Fixture* fixture) {
+                    return blobfs_tests[test_index].ApiTest(state, fixture);
+                };
+                testcase.tests.push_back(std::move(api_test));
+
+                if (blob_count > 0) {
+                    for (auto order : orders) {
+                        TestInfo read_test;
+                        read_test.name = fbl::StringPrintf(
+                            "%s/%s/%luBlobs/Read%s", disk_format_string_[f_opts.fs_type],
+                            size.c_str(), blob_count, GetNameForOrder(order).c_str());
+                        read_test.test_fn = [test_index, order,
+                                             &blobfs_tests](perftest::RepeatState* state,
+                                                            fs_test_utils::Fixture* fixture) {
+                            return blobfs_tests[test_index].ReadTest(order, state, fixture);
+                        };
+                        read_test.required_disk_space = required_disk_space;
+                        testcase.tests.push_back(std::move(read_test));
+                    }
+                }
+                if (blob_count > 0 && blob_size >= BlobfsTest::kRandomReadSize) {
                     TestInfo read_test;
-                    read_test.name = fbl::StringPrintf(
-                        "%s/%s/%luBlobs/Read%s", disk_format_string_[f_opts.fs_type], size.c_str(),
-                        blob_count, GetNameForOrder(order).c_str());
-                    read_test.test_fn = [test_index, order,
-                                         &blobfs_tests](perftest::RepeatState* state,
-                                                        fs_test_utils::Fixture* fixture) {
-                        return blobfs_tests[test_index].ReadTest(order, state, fixture);
+                    read_test.name = fbl::StringPrintf("%s/%s/%luBlobs/ReadAtRandom",
+                                                       disk_format_string_[f_opts.fs_type],
+                                                       size.c_str(), blob_count);
+                    read_test.test_fn = [test_index, &blobfs_tests](
+                                            perftest::RepeatState* state,
+                                            fs_test_utils::Fixture* fixture) {
+                        return blobfs_tests[test_index].ReadAtRandomTest(state, fixture);
                     };
-                    read_test.required_disk_space =
-                        blob_count *
-                        (blob_size + 2 * MerkleTree::kNodeSize + blobfs::kBlobfsInodeSize);
+                    read_test.required_disk_space = required_disk_space;
                     testcase.tests.push_back(std::move(read_test));
                 }
+                testcases.push_back(std::move(testcase));
+                ++test_index;
             }
-            testcases.push_back(std::move(testcase));
-            ++test_index;
         }
     }
 
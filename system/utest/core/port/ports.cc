@@ -97,6 +97,47 @@ TEST(PortTest, QueueTooMany) {
     }
 }
 
+TEST(PortTest, WaitManyReturnsQueuedPacketsInOrder) {
+    zx::port port;
+    ASSERT_OK(zx::port::create(0, &port));
+
+    constexpr size_t kNumPackets = 5;
+    for (uint64_t i = 0; i < kNumPackets; ++i) {
+        const zx_port_packet_t packet = {i, ZX_PKT_TYPE_USER, 0, { {} }};
+        ASSERT_OK(port.queue(&packet));
+    }
+
+    // Asking for fewer packets than are queued leaves the rest in the port.
+    zx_port_packet_t out[kNumPackets + 1] = {};
+    size_t actual = 0;
+    ASSERT_OK(zx_port_wait_many(port.get(), ZX_TIME_INFINITE, out, 3, &actual));
+    ASSERT_EQ(actual, 3u);
+    for (uint64_t i = 0; i < actual; ++i) {
+        EXPECT_EQ(out[i].key, i);
+        EXPECT_EQ(out[i].type, ZX_PKT_TYPE_USER);
+    }
+
+    // Asking for more returns only what is there, without blocking.
+    ASSERT_OK(zx_port_wait_many(port.get(), ZX_TIME_INFINITE, out, fbl::count_of(out), &actual));
+    ASSERT_EQ(actual, kNumPackets - 3);
+    EXPECT_EQ(out[0].key, 3u);
+    EXPECT_EQ(out[1].key, 4u);
+
+    EXPECT_EQ(zx_port_wait_many(port.get(), zx::deadline_after(zx::nsec(1)).get(), out,
+                                fbl::count_of(out), nullptr),
+              ZX_ERR_TIMED_OUT);
+}
+
+TEST(PortTest, WaitManyZeroCountReturnsInvalidArgs) {
+    zx::port port;
+    ASSERT_OK(zx::port::create(0, &port));
+
+    zx_port_packet_t out = {};
+    size_t actual = 0;
+    EXPECT_EQ(zx_port_wait_many(port.get(), ZX_TIME_INFINITE, &out, 0, &actual),
+              ZX_ERR_INVALID_ARGS);
+}
+
 TEST(PortTest, AsyncWaitChannelTimedOut) {
     constexpr uint64_t kEventKey = 6567;
 
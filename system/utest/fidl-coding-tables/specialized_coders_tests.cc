@@ -0,0 +1,173 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fidl/test/example/specializedcoders/c/fidl.h>
+#include <lib/fidl/coding.h>
+#include <lib/fidl/internal.h>
+#include <lib/fidl/specialized_coders.h>
+#include <string.h>
+#include <zircon/syscalls.h>
+#include <zxtest/zxtest.h>
+
+namespace {
+
+using Message = fidl_test_example_specializedcoders_SpecializedFlatRequest;
+
+const fidl_type_t& kSpecializedType =
+    fidl_test_example_specializedcoders_SpecializedFlatRequestTable;
+
+// The same coding table, without specialized coders, so that it is coded by the walker.
+const fidl_type_t kWalkerType = fidl_type_t(::fidl::FidlCodedStruct(
+    kSpecializedType.coded_struct.fields, kSpecializedType.coded_struct.field_count,
+    kSpecializedType.coded_struct.size, kSpecializedType.coded_struct.name));
+
+// A message with garbage in all of its padding, which encoding zeroes.
+void MakeMessage(Message* message, zx_handle_t* handles) {
+  memset(message, 0xff, sizeof(*message));
+  memset(&message->hdr, 0, sizeof(message->hdr));
+  message->o.first.tag = 1;
+  message->o.first.h = handles[0];
+  message->o.first.color = fidl_test_example_specializedcoders_Color_RED;
+  for (uint32_t i = 0; i < 3; i++) {
+    message->o.rest[i].tag = static_cast<uint8_t>(2 + i);
+    message->o.rest[i].h = ZX_HANDLE_INVALID;
+    message->o.rest[i].color = fidl_test_example_specializedcoders_Color_GREEN;
+  }
+  message->o.rest[1].h = handles[1];
+  message->o.flags = fidl_test_example_specializedcoders_Flags_A |
+                     fidl_test_example_specializedcoders_Flags_B;
+  message->o.counter = 42;
+  message->c = handles[2];
+  message->trailer = 7;
+}
+
+void CreateHandles(zx_handle_t* handles) {
+  ASSERT_OK(zx_event_create(0, &handles[0]));
+  ASSERT_OK(zx_event_create(0, &handles[1]));
+  zx_handle_t other;
+  ASSERT_OK(zx_channel_create(0, &handles[2], &other));
+  ASSERT_OK(zx_handle_close(other));
+}
+
+TEST(SpecializedCoders, OnlyForInlineMessages) {
+  EXPECT_NOT_NULL(fidl::SpecializedCodersFor(&kSpecializedType));
+  EXPECT_NULL(fidl::SpecializedCodersFor(
+      &fidl_test_example_specializedcoders_SpecializedWithVectorRequestTable));
+  EXPECT_NULL(fidl::SpecializedCodersFor(&kWalkerType));
+}
+
+TEST(SpecializedCoders, MatchesWalker) {
+  zx_handle_t handles[3];
+  ASSERT_NO_FATAL_FAILURES(CreateHandles(handles));
+
+  Message specialized, walked;
+  MakeMessage(&specialized, handles);
+  MakeMessage(&walked, handles);
+
+  zx_handle_t specialized_handles[3] = {};
+  zx_handle_t walked_handles[3] = {};
+  uint32_t specialized_actual = 0, walked_actual = 0;
+  const char* error = nullptr;
+  ASSERT_OK(fidl_encode(&kSpecializedType, &specialized, sizeof(specialized), specialized_handles,
+                        3, &specialized_actual, &error),
+            "%s", error);
+  ASSERT_OK(fidl_encode(&kWalkerType, &walked, sizeof(walked), walked_handles, 3, &walked_actual,
+                        &error),
+            "%s", error);
+  EXPECT_EQ(3u, specialized_actual);
+  EXPECT_EQ(walked_actual, specialized_actual);
+  EXPECT_BYTES_EQ(reinterpret_cast<uint8_t*>(walked_handles),
+                  reinterpret_cast<uint8_t*>(specialized_handles), sizeof(walked_handles));
+  EXPECT_BYTES_EQ(reinterpret_cast<uint8_t*>(&walked), reinterpret_cast<uint8_t*>(&specialized),
+                  sizeof(walked));
+
+  EXPECT_OK(fidl_validate(&kSpecializedType, &specialized, sizeof(specialized), 3, &error), "%s",
+            error);
+
+  ASSERT_OK(fidl_decode(&kSpecializedType, &specialized, sizeof(specialized), specialized_handles,
+                        3, &error),
+            "%s", error);
+  ASSERT_OK(fidl_decode(&kWalkerType, &walked, sizeof(walked), walked_handles, 3, &error), "%s",
+            error);
+  EXPECT_BYTES_EQ(reinterpret_cast<uint8_t*>(&walked), reinterpret_cast<uint8_t*>(&specialized),
+                  sizeof(walked));
+  EXPECT_EQ(handles[1], specialized.o.rest[1].h);
+
+  for (zx_handle_t handle : handles) {
+    EXPECT_OK(zx_handle_close(handle));
+  }
+}
+
+// An encoded message which only refers to |c| in the handle table.
+void MakeEncodedMessage(Message* message) {
+  memset(message, 0, sizeof(*message));
+  message->o.first.color = fidl_test_example_specializedcoders_Color_GREEN;
+  for (auto& inner : message->o.rest) {
+    inner.color = fidl_test_example_specializedcoders_Color_GREEN;
+  }
+  message->o.flags = fidl_test_example_specializedcoders_Flags_A;
+  message->c = FIDL_HANDLE_PRESENT;
+}
+
+// Checks that the specialized coders and the walker fail in the same way on |message|.
+void ExpectSameError(const Message& message) {
+  Message specialized = message, walked = message;
+  const char* specialized_error = nullptr;
+  const char* walked_error = nullptr;
+
+  zx_status_t status = fidl_validate(&kSpecializedType, &specialized, sizeof(specialized), 1,
+                                     &specialized_error);
+  EXPECT_STATUS(ZX_ERR_INVALID_ARGS, status);
+  EXPECT_STATUS(status, fidl_validate(&kWalkerType, &walked, sizeof(walked), 1, &walked_error));
+  EXPECT_STR_EQ(walked_error, specialized_error);
+
+  // Decode without a handle table, so that there is nothing to close on failure. The errors
+  // below all come before |c| in the message.
+  status = fidl_decode(&kSpecializedType, &specialized, sizeof(specialized), nullptr, 0,
+                       &specialized_error);
+  EXPECT_STATUS(ZX_ERR_INVALID_ARGS, status);
+  EXPECT_STATUS(status, fidl_decode(&kWalkerType, &walked, sizeof(walked), nullptr, 0,
+                                    &walked_error));
+  EXPECT_STR_EQ(walked_error, specialized_error);
+}
+
+TEST(SpecializedCoders, InvalidEnum) {
+  Message message;
+  MakeEncodedMessage(&message);
+  message.o.rest[2].color = 3;
+  ASSERT_NO_FATAL_FAILURES(ExpectSameError(message));
+}
+
+TEST(SpecializedCoders, InvalidBits) {
+  Message message;
+  MakeEncodedMessage(&message);
+  message.o.flags = 0x2;
+  ASSERT_NO_FATAL_FAILURES(ExpectSameError(message));
+}
+
+TEST(SpecializedCoders, MissingHandle) {
+  Message message;
+  MakeEncodedMessage(&message);
+  // |c| is not nullable.
+  message.c = ZX_HANDLE_INVALID;
+  ASSERT_NO_FATAL_FAILURES(ExpectSameError(message));
+
+  zx_handle_t handles[3];
+  uint32_t actual = 1;
+  const char* error = nullptr;
+  EXPECT_STATUS(ZX_ERR_INVALID_ARGS, fidl_encode(&kSpecializedType, &message, sizeof(message),
+                                                 handles, 3, &actual, &error));
+  EXPECT_STR_EQ("message is missing a non-nullable handle", error);
+  EXPECT_EQ(0u, actual);
+}
+
+TEST(SpecializedCoders, NonZeroPadding) {
+  Message message;
+  MakeEncodedMessage(&message);
+  // The padding between |tag| and |h| in the second array element.
+  reinterpret_cast<uint8_t*>(&message.o.rest[1])[2] = 1;
+  ASSERT_NO_FATAL_FAILURES(ExpectSameError(message));
+}
+
+}  // namespace
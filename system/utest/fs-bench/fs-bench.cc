@@ -5,19 +5,24 @@
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <fbl/function.h>
 #include <fbl/string.h>
 #include <fbl/string_buffer.h>
 #include <fbl/string_printf.h>
 #include <fbl/unique_fd.h>
+#include <fbl/vector.h>
 #include <fs-management/mount.h>
 #include <fs-test-utils/fixture.h>
 #include <fs-test-utils/perftest.h>
 #include <perftest/perftest.h>
 #include <unittest/unittest.h>
 
+#include <atomic>
+#include <thread>
 #include <utility>
 
 namespace fs_bench {
@@ -158,6 +163,255 @@ private:
     fbl::StringBuffer<fs_test_utils::kPathSize> path_;
 };
 
+constexpr char kDirectoryName[] = "/dir";
+
+// Wrapper so the number of entries can be shared across calls. Each iteration operates on one
+// entry of a single directory, so the cost of each operation grows with the number of entries
+// unless the filesystem indexes its directories.
+class DirectoryOp {
+public:
+    DirectoryOp() = default;
+    DirectoryOp(const DirectoryOp&) = delete;
+    DirectoryOp(DirectoryOp&&) = delete;
+    DirectoryOp& operator=(const DirectoryOp&) = delete;
+    DirectoryOp& operator=(DirectoryOp&&) = delete;
+    ~DirectoryOp() = default;
+
+    // Will create entries until |state::KeepGoing| returns false.
+    bool Create(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        SetDirectoryPath(*fixture);
+        ASSERT_EQ(mkdir(path_.c_str(), 0666), 0);
+        entry_count_ = 0;
+        while (state->KeepRunning()) {
+            SetEntryPath(*fixture, entry_count_++);
+            fbl::unique_fd fd(open(path_.c_str(), O_CREAT | O_RDWR | O_EXCL, 0666));
+            ASSERT_TRUE(fd, path_.c_str());
+        }
+        END_HELPER;
+    }
+
+    // Will stat the created entries until |state::KeepGoing| returns false.
+    bool Lookup(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        ASSERT_GT(entry_count_, 0);
+        int entry = 0;
+        while (state->KeepRunning()) {
+            SetEntryPath(*fixture, entry);
+            struct stat buff;
+            ASSERT_EQ(stat(path_.c_str(), &buff), 0, path_.c_str());
+            entry = (entry + 1) % entry_count_;
+        }
+        END_HELPER;
+    }
+
+    // Will unlink the created entries until |state::KeepGoing| returns false, and the directory
+    // once all of them are gone.
+    bool Unlink(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        int entry = 0;
+        while (state->KeepRunning() && entry < entry_count_) {
+            SetEntryPath(*fixture, entry++);
+            ASSERT_EQ(unlink(path_.c_str()), 0, path_.c_str());
+        }
+        if (entry == entry_count_) {
+            SetDirectoryPath(*fixture);
+            ASSERT_EQ(rmdir(path_.c_str()), 0);
+            entry_count_ = 0;
+        }
+        END_HELPER;
+    }
+
+private:
+    void SetDirectoryPath(const Fixture& fixture) {
+        path_.Clear();
+        path_.Append(fixture.fs_path());
+        path_.Append(kDirectoryName);
+    }
+
+    void SetEntryPath(const Fixture& fixture, int entry) {
+        SetDirectoryPath(fixture);
+        path_.AppendPrintf("/%08x", entry);
+    }
+
+    fbl::StringBuffer<fs_test_utils::kPathSize> path_;
+    int entry_count_ = 0;
+};
+
+constexpr char kOpenDirectoryName[] = "/open";
+
+// Number of directories between the root of the tree and the file opened by name.
+constexpr int kOpenDepth = 4;
+
+// Number of directories searched for a file, of which only the last holds it.
+constexpr int kSearchDirectories = 8;
+
+// Wrapper so the tree can be shared across calls. Opens go through every component of their
+// path, and the searches mostly fail, as a loader looking for a library does, so the cost of
+// each iteration depends on how well the filesystem remembers lookups.
+class OpenOp {
+public:
+    OpenOp() = default;
+    OpenOp(const OpenOp&) = delete;
+    OpenOp(OpenOp&&) = delete;
+    OpenOp& operator=(const OpenOp&) = delete;
+    OpenOp& operator=(OpenOp&&) = delete;
+    ~OpenOp() = default;
+
+    // Will open and close a nested file until |state::KeepGoing| returns false.
+    bool Open(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        ASSERT_TRUE(CreateTree(*fixture));
+        fbl::String path = fbl::StringPrintf("%s%s", fixture->fs_path().c_str(), file_.c_str());
+        while (state->KeepRunning()) {
+            fbl::unique_fd fd(open(path.c_str(), O_RDONLY));
+            ASSERT_TRUE(fd, path.c_str());
+        }
+        END_HELPER;
+    }
+
+    // Will search the directories for a file until |state::KeepGoing| returns false, and then
+    // remove the tree.
+    bool Search(perftest::RepeatState* state, Fixture* fixture) {
+        BEGIN_HELPER;
+        ASSERT_TRUE(CreateTree(*fixture));
+        fbl::Vector<fbl::String> paths;
+        for (int i = 0; i < kSearchDirectories; i++) {
+            paths.push_back(fbl::StringPrintf("%s%s/lib%d/libtarget.so",
+                                              fixture->fs_path().c_str(), kOpenDirectoryName, i));
+        }
+        while (state->KeepRunning()) {
+            fbl::unique_fd fd;
+            for (const fbl::String& path : paths) {
+                fd.reset(open(path.c_str(), O_RDONLY));
+                if (fd) {
+                    break;
+                }
+            }
+            ASSERT_TRUE(fd);
+        }
+        ASSERT_TRUE(RemoveTree(*fixture));
+        END_HELPER;
+    }
+
+private:
+    // Creates the directories and files, relative to the root of |fixture|, unless they exist.
+    bool CreateTree(const Fixture& fixture) {
+        BEGIN_HELPER;
+        if (!entries_.is_empty()) {
+            return true;
+        }
+        fbl::String path = kOpenDirectoryName;
+        ASSERT_TRUE(Mkdir(fixture, path));
+        for (int i = 0; i < kSearchDirectories; i++) {
+            ASSERT_TRUE(Mkdir(fixture, fbl::StringPrintf("%s/lib%d", path.c_str(), i)));
+        }
+        ASSERT_TRUE(CreateFile(fixture, fbl::StringPrintf("%s/lib%d/libtarget.so", path.c_str(),
+                                                          kSearchDirectories - 1)));
+        for (int i = 0; i < kOpenDepth; i++) {
+            path = fbl::StringPrintf("%s/dir%d", path.c_str(), i);
+            ASSERT_TRUE(Mkdir(fixture, path));
+        }
+        file_ = fbl::StringPrintf("%s/file", path.c_str());
+        ASSERT_TRUE(CreateFile(fixture, file_));
+        END_HELPER;
+    }
+
+    bool Mkdir(const Fixture& fixture, fbl::String path) {
+        BEGIN_HELPER;
+        fbl::String full_path = fbl::StringPrintf("%s%s", fixture.fs_path().c_str(), path.c_str());
+        ASSERT_EQ(mkdir(full_path.c_str(), 0666), 0, full_path.c_str());
+        entries_.push_back(std::move(path));
+        END_HELPER;
+    }
+
+    bool CreateFile(const Fixture& fixture, fbl::String path) {
+        BEGIN_HELPER;
+        fbl::String full_path = fbl::StringPrintf("%s%s", fixture.fs_path().c_str(), path.c_str());
+        fbl::unique_fd fd(open(full_path.c_str(), O_CREAT | O_RDWR | O_EXCL, 0666));
+        ASSERT_TRUE(fd, full_path.c_str());
+        entries_.push_back(std::move(path));
+        END_HELPER;
+    }
+
+    bool RemoveTree(const Fixture& fixture) {
+        BEGIN_HELPER;
+        for (size_t i = entries_.size(); i > 0; i--) {
+            fbl::String path =
+                fbl::StringPrintf("%s%s", fixture.fs_path().c_str(), entries_[i - 1].c_str());
+            ASSERT_EQ(unlink(path.c_str()), 0, path.c_str());
+        }
+        entries_.reset();
+        END_HELPER;
+    }
+
+    // Paths of the entries of the tree, relative to the root of the filesystem, in the order
+    // they were created.
+    fbl::Vector<fbl::String> entries_;
+    fbl::String file_;
+};
+
+// Size of the file read by each client of the concurrency tests.
+constexpr ssize_t kClientFileSize = 8 * (1 << 10);
+
+// Number of times each client of the concurrency tests opens its file per iteration.
+constexpr int kClientOpsPerIteration = 8;
+
+// Opens, reads and stats the file at |path| |kClientOpsPerIteration| times. This runs on the
+// client threads, so failures are reported to the test thread rather than asserted.
+bool OpenReadStat(const char* path) {
+    uint8_t data[kClientFileSize];
+    for (int i = 0; i < kClientOpsPerIteration; i++) {
+        fbl::unique_fd fd(open(path, O_RDONLY));
+        if (!fd || read(fd.get(), data, kClientFileSize) != kClientFileSize) {
+            return false;
+        }
+        struct stat buff;
+        if (fstat(fd.get(), &buff) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Will have |clients| threads open, read and stat a file of their own until |state::KeepGoing|
+// returns false, and then remove the files. Every iteration waits for the slowest client, so
+// the time taken only stays flat as clients are added if the filesystem serves their requests
+// in parallel.
+bool ConcurrentClients(int clients, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    fbl::Vector<fbl::String> paths;
+    uint8_t data[kClientFileSize];
+    memset(data, static_cast<uint8_t>(rand_r(fixture->mutable_seed()) % (1 << 8)), sizeof(data));
+    for (int i = 0; i < clients; i++) {
+        paths.push_back(fbl::StringPrintf("%s/client%d", fixture->fs_path().c_str(), i));
+        fbl::unique_fd fd(open(paths[i].c_str(), O_CREAT | O_RDWR | O_EXCL, 0666));
+        ASSERT_TRUE(fd, paths[i].c_str());
+        ASSERT_EQ(write(fd.get(), data, kClientFileSize), kClientFileSize);
+    }
+
+    while (state->KeepRunning()) {
+        std::atomic<bool> succeeded = true;
+        fbl::Vector<std::thread> threads;
+        for (const fbl::String& path : paths) {
+            threads.push_back(std::thread([&succeeded, &path] {
+                if (!OpenReadStat(path.c_str())) {
+                    succeeded = false;
+                }
+            }));
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        ASSERT_TRUE(succeeded);
+    }
+
+    for (const fbl::String& path : paths) {
+        ASSERT_EQ(unlink(path.c_str()), 0, path.c_str());
+    }
+    END_HELPER;
+}
+
 } // namespace
 
 bool RunBenchmark(int argc, char** argv) {
@@ -239,6 +493,101 @@ bool RunBenchmark(int argc, char** argv) {
         testcases.push_back(std::move(testcase));
     }
 
+    // Large directory tests. The dirents of a MinFS directory are capped at 1 MiB, which holds
+    // about 50000 of these names.
+    const int directory_sample_counts[] = {
+        1000,
+        10000,
+        40000,
+    };
+
+    DirectoryOp dir_op;
+    for (int test_sample_count : directory_sample_counts) {
+        TestCaseInfo testcase;
+        testcase.name = fbl::StringPrintf("%s/Directory/%d-Entries",
+                                          disk_format_string_[f_opts.fs_type], test_sample_count);
+        testcase.sample_count = test_sample_count;
+        testcase.teardown = false;
+
+        TestInfo create_test;
+        create_test.name = fbl::StringPrintf("%s/Create", testcase.name.c_str());
+        create_test.test_fn = fbl::BindMember(&dir_op, &DirectoryOp::Create);
+        testcase.tests.push_back(std::move(create_test));
+
+        TestInfo lookup_test;
+        lookup_test.name = fbl::StringPrintf("%s/Lookup", testcase.name.c_str());
+        lookup_test.test_fn = fbl::BindMember(&dir_op, &DirectoryOp::Lookup);
+        testcase.tests.push_back(std::move(lookup_test));
+
+        TestInfo unlink_test;
+        unlink_test.name = fbl::StringPrintf("%s/Unlink", testcase.name.c_str());
+        unlink_test.test_fn = fbl::BindMember(&dir_op, &DirectoryOp::Unlink);
+        testcase.tests.push_back(std::move(unlink_test));
+
+        testcases.push_back(std::move(testcase));
+    }
+
+    // Open tests.
+    const int open_sample_counts[] = {
+        1000,
+        10000,
+    };
+
+    OpenOp open_op;
+    for (int test_sample_count : open_sample_counts) {
+        TestCaseInfo testcase;
+        testcase.name = fbl::StringPrintf("%s/Open/%d-Ops", disk_format_string_[f_opts.fs_type],
+                                          test_sample_count);
+        testcase.sample_count = test_sample_count;
+        testcase.teardown = false;
+
+        TestInfo open_test;
+        open_test.name = fbl::StringPrintf("%s/Open", testcase.name.c_str());
+        open_test.test_fn = fbl::BindMember(&open_op, &OpenOp::Open);
+        testcase.tests.push_back(std::move(open_test));
+
+        TestInfo search_test;
+        search_test.name = fbl::StringPrintf("%s/Search", testcase.name.c_str());
+        search_test.test_fn = fbl::BindMember(&open_op, &OpenOp::Search);
+        testcase.tests.push_back(std::move(search_test));
+
+        testcases.push_back(std::move(testcase));
+    }
+
+    // Concurrency tests.
+    const int concurrent_sample_counts[] = {
+        100,
+        1000,
+    };
+    const int client_counts[] = {
+        1,
+        2,
+        4,
+        8,
+        16,
+    };
+
+    for (int test_sample_count : concurrent_sample_counts) {
+        TestCaseInfo testcase;
+        testcase.name = fbl::StringPrintf("%s/Concurrent/%d-Ops",
+                                          disk_format_string_[f_opts.fs_type], test_sample_count);
+        testcase.sample_count = test_sample_count;
+        testcase.teardown = false;
+
+        for (int clients : client_counts) {
+            TestInfo clients_test;
+            clients_test.name =
+                fbl::StringPrintf("%s/%d-Clients", testcase.name.c_str(), clients);
+            clients_test.test_fn = [clients](perftest::RepeatState* state, Fixture* fixture) {
+                return ConcurrentClients(clients, state, fixture);
+            };
+            clients_test.required_disk_space = clients * kClientFileSize;
+            testcase.tests.push_back(std::move(clients_test));
+        }
+
+        testcases.push_back(std::move(testcase));
+    }
+
     return fs_test_utils::RunTestCases(f_opts, p_opts, testcases);
 }
 } // namespace fs_bench
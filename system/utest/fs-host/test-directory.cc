@@ -4,7 +4,11 @@
 
 #include "util.h"
 
+#include <unistd.h>
+
 #include <fbl/algorithm.h>
+#include <fbl/unique_fd.h>
+#include <minfs/format.h>
 
 bool check_dir_contents(const char* dirname, expected_dirent_t* edirents, size_t len) {
     BEGIN_HELPER;
@@ -120,8 +124,223 @@ bool TestDirectoryReaddirLarge(void) {
     END_TEST;
 }
 
+bool TestDirectoryIndexed(void) {
+    BEGIN_TEST;
+
+    // Enough entries to index the directory, and to split some buckets of the index.
+    size_t num_entries = 4000;
+    ASSERT_EQ(emu_mkdir("::indexed", 0755), 0);
+
+    for (size_t i = 0; i < num_entries; i++) {
+        char path[100];
+        snprintf(path, 100, "::indexed/%05lu", i);
+        int fd = emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0);
+        ASSERT_EQ(emu_close(fd), 0);
+    }
+
+    for (size_t i = 0; i < num_entries; i++) {
+        char path[100];
+        snprintf(path, 100, "::indexed/%05lu", i);
+        struct stat s;
+        ASSERT_EQ(emu_stat(path, &s), 0);
+        ASSERT_EQ(emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644), -1);
+    }
+    struct stat s;
+    ASSERT_NE(emu_stat("::indexed/missing", &s), 0);
+
+    // Entries are still listed in the order they were created.
+    DIR* dir = emu_opendir("::indexed");
+    ASSERT_NONNULL(dir);
+    struct dirent* de;
+    size_t i = 0;
+    while ((de = emu_readdir(dir)) != NULL) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+            continue;
+        }
+        char name[100];
+        snprintf(name, 100, "%05lu", i++);
+        ASSERT_EQ(strcmp(de->d_name, name), 0, "Unexpected dirent");
+    }
+    ASSERT_EQ(i, num_entries, "Did not see all expected entries");
+    ASSERT_EQ(emu_closedir(dir), 0);
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+// Creates the entries named |format| with 0 to |count| - 1 in the directory |dir|.
+bool CreateEntries(const char* dir, const char* format, size_t count) {
+    BEGIN_HELPER;
+    for (size_t i = 0; i < count; i++) {
+        char name[100];
+        snprintf(name, sizeof(name), format, i);
+        char path[200];
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        int fd = emu_open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0);
+        ASSERT_EQ(emu_close(fd), 0);
+    }
+    END_HELPER;
+}
+
+bool Exists(const char* path) {
+    struct stat s;
+    return emu_stat(path, &s) == 0;
+}
+
+uint64_t UsedData() {
+    uint64_t data_size, inodes, used_size;
+    if (emu_get_used_resources(MOUNT_PATH, &data_size, &inodes, &used_size) != 0) {
+        return 0;
+    }
+    return data_size;
+}
+
+// Returns the name of the last entry listed by readdir in |dir|.
+bool LastEntry(const char* dir, char* name, size_t len) {
+    BEGIN_HELPER;
+    DIR* d = emu_opendir(dir);
+    ASSERT_NONNULL(d);
+    struct dirent* de;
+    name[0] = 0;
+    while ((de = emu_readdir(d)) != NULL) {
+        strncpy(name, de->d_name, len - 1);
+        name[len - 1] = 0;
+    }
+    ASSERT_EQ(emu_closedir(d), 0);
+    END_HELPER;
+}
+
+bool TestDirectoryIndexedUnlink(void) {
+    BEGIN_TEST;
+
+    const size_t kEntries = 4000;
+    ASSERT_EQ(emu_mkdir("::unlinked", 0755), 0);
+    ASSERT_TRUE(CreateEntries("::unlinked", "%05lu", kEntries));
+    const uint64_t used = UsedData();
+
+    for (size_t i = 0; i < kEntries; i++) {
+        char path[100];
+        snprintf(path, 100, "::unlinked/%05lu", i);
+        ASSERT_EQ(emu_unlink(path), 0);
+        ASSERT_FALSE(Exists(path));
+        ASSERT_NE(emu_unlink(path), 0);
+    }
+    ASSERT_EQ(run_fsck(), 0);
+
+    // Each unlinked dirent was merged with the free one before it, so the longer names fit
+    // in the space they left, which no single one of them could hold.
+    const size_t kLongEntries = kEntries / 2;
+    ASSERT_TRUE(CreateEntries("::unlinked", "longer%05lu", kLongEntries));
+    ASSERT_LE(UsedData(), used);
+    for (size_t i = 0; i < kLongEntries; i++) {
+        char path[100];
+        snprintf(path, 100, "::unlinked/longer%05lu", i);
+        ASSERT_TRUE(Exists(path));
+    }
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+bool TestDirectoryIndexedRename(void) {
+    BEGIN_TEST;
+
+    const size_t kEntries = 4000;
+    ASSERT_EQ(emu_mkdir("::renamed", 0755), 0);
+    ASSERT_EQ(emu_mkdir("::other", 0755), 0);
+    ASSERT_TRUE(CreateEntries("::renamed", "%05lu", kEntries));
+
+    // Rename some entries within the directory, some out of it, and one over another.
+    for (size_t i = 0; i < kEntries; i++) {
+        char oldpath[100];
+        char newpath[100];
+        snprintf(oldpath, 100, "::renamed/%05lu", i);
+        if (i % 3 == 0) {
+            snprintf(newpath, 100, "::renamed/renamed%05lu", i);
+        } else if (i % 7 == 0) {
+            snprintf(newpath, 100, "::other/%05lu", i);
+        } else {
+            continue;
+        }
+        ASSERT_EQ(emu_rename(oldpath, newpath), 0);
+    }
+    ASSERT_EQ(emu_rename("::renamed/00001", "::renamed/00002"), 0);
+
+    for (size_t i = 0; i < kEntries; i++) {
+        char path[100];
+        snprintf(path, 100, "::renamed/%05lu", i);
+        if (i % 3 == 0 || (i % 7 == 0) || i == 1) {
+            ASSERT_FALSE(Exists(path));
+        } else {
+            ASSERT_TRUE(Exists(path));
+        }
+        if (i % 3 == 0) {
+            snprintf(path, 100, "::renamed/renamed%05lu", i);
+            ASSERT_TRUE(Exists(path));
+        } else if (i % 7 == 0) {
+            snprintf(path, 100, "::other/%05lu", i);
+            ASSERT_TRUE(Exists(path));
+        }
+    }
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+bool TestDirectoryIndexRebuild(void) {
+    BEGIN_TEST;
+
+    const size_t kEntries = 4000;
+    ASSERT_EQ(emu_mkdir("::rebuilt", 0755), 0);
+    ASSERT_TRUE(CreateEntries("::rebuilt", "%05lu", kEntries));
+    // Leave a gap, which new dirents only fill when the directory has no index.
+    for (size_t i = 100; i < 200; i++) {
+        char path[100];
+        snprintf(path, 100, "::rebuilt/%05lu", i);
+        ASSERT_EQ(emu_unlink(path), 0);
+    }
+    struct stat s;
+    ASSERT_EQ(emu_stat("::rebuilt", &s), 0);
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+
+    // Modify the directory as a driver unaware of the index would, which leaves it stale.
+    {
+        fbl::unique_fd disk(open(MOUNT_PATH, O_RDWR));
+        ASSERT_TRUE(disk);
+        minfs::Superblock info;
+        ASSERT_EQ(pread(disk.get(), &info, sizeof(info), 0), static_cast<ssize_t>(sizeof(info)));
+        off_t inode_off = static_cast<off_t>(info.ino_block) * minfs::kMinfsBlockSize +
+                          static_cast<off_t>(s.st_ino) * minfs::kMinfsInodeSize;
+        minfs::Inode inode;
+        ASSERT_EQ(pread(disk.get(), &inode, sizeof(inode), inode_off),
+                  static_cast<ssize_t>(sizeof(inode)));
+        inode.seq_num++;
+        ASSERT_EQ(pwrite(disk.get(), &inode, sizeof(inode), inode_off),
+                  static_cast<ssize_t>(sizeof(inode)));
+    }
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    ASSERT_EQ(run_fsck(), 0);
+    ASSERT_TRUE(Exists("::rebuilt/00000"));
+    ASSERT_TRUE(Exists("::rebuilt/03999"));
+    ASSERT_FALSE(Exists("::rebuilt/00100"));
+
+    // The next creation rebuilds the index, so the new dirent goes at the end rather than
+    // into the gap.
+    ASSERT_TRUE(CreateEntries("::rebuilt", "new%lu", 1));
+    char last[100];
+    ASSERT_TRUE(LastEntry("::rebuilt", last, sizeof(last)));
+    ASSERT_EQ(strcmp(last, "new0"), 0);
+    ASSERT_EQ(emu_unlink("::rebuilt/new0"), 0);
+    ASSERT_EQ(emu_unlink("::rebuilt/00000"), 0);
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
 RUN_MINFS_TESTS(directory_tests,
     RUN_TEST_LARGE(TestDirectoryLarge)
     RUN_TEST_MEDIUM(TestDirectoryReaddir)
     RUN_TEST_MEDIUM(TestDirectoryReaddirLarge)
+    RUN_TEST_LARGE(TestDirectoryIndexed)
+    RUN_TEST_LARGE(TestDirectoryIndexedUnlink)
+    RUN_TEST_LARGE(TestDirectoryIndexedRename)
+    RUN_TEST_LARGE(TestDirectoryIndexRebuild)
 )
@@ -0,0 +1,277 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Tests files mapped by extents, on a filesystem created with them enabled.
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <minfs/bcache.h>
+#include <minfs/format.h>
+#include <minfs/minfs.h>
+
+#include <utility>
+
+#include "util.h"
+
+namespace {
+
+constexpr size_t kBlockSize = minfs::kMinfsBlockSize;
+
+bool MkfsWithExtents() {
+    BEGIN_HELPER;
+    fbl::unique_fd disk(open(MOUNT_PATH, O_RDWR));
+    ASSERT_TRUE(disk);
+    struct stat stats;
+    ASSERT_EQ(fstat(disk.get(), &stats), 0);
+    uint32_t blocks = static_cast<uint32_t>(stats.st_size / kBlockSize);
+    fbl::unique_ptr<minfs::Bcache> bc;
+    ASSERT_EQ(minfs::Bcache::Create(&bc, std::move(disk), blocks), ZX_OK);
+    minfs::MountOptions options = {};
+    options.extents = true;
+    ASSERT_EQ(minfs::Mkfs(options, std::move(bc)), ZX_OK);
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    END_HELPER;
+}
+
+bool ReadSuperblock(minfs::Superblock* info) {
+    BEGIN_HELPER;
+    fbl::unique_fd disk(open(MOUNT_PATH, O_RDONLY));
+    ASSERT_TRUE(disk);
+    ASSERT_EQ(pread(disk.get(), info, sizeof(*info), 0), static_cast<ssize_t>(sizeof(*info)));
+    END_HELPER;
+}
+
+// The byte expected at |block| of the file |id|, after it was written |pass| times.
+uint8_t Fill(int id, uint32_t block, int pass) {
+    return static_cast<uint8_t>(id * 31 + block * 7 + pass * 13 + 1);
+}
+
+bool WriteBlock(int fd, int id, uint32_t block, int pass) {
+    BEGIN_HELPER;
+    char data[kBlockSize];
+    memset(data, Fill(id, block, pass), sizeof(data));
+    ASSERT_EQ(emu_pwrite(fd, data, sizeof(data), block * kBlockSize),
+              static_cast<ssize_t>(sizeof(data)));
+    END_HELPER;
+}
+
+// Checks that the first |blocks| blocks of the file |id| hold the fill of |pass|, and that
+// nothing follows them.
+bool CheckFile(const char* path, int id, uint32_t blocks, int pass) {
+    BEGIN_HELPER;
+    int fd = emu_open(path, O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+    struct stat stats;
+    ASSERT_EQ(emu_fstat(fd, &stats), 0);
+    ASSERT_EQ(stats.st_size, static_cast<off_t>(blocks * kBlockSize));
+    char data[kBlockSize];
+    char expected[kBlockSize];
+    for (uint32_t i = 0; i < blocks; i++) {
+        ASSERT_EQ(emu_pread(fd, data, sizeof(data), i * kBlockSize),
+                  static_cast<ssize_t>(sizeof(data)));
+        memset(expected, Fill(id, i, pass), sizeof(expected));
+        ASSERT_EQ(memcmp(data, expected, sizeof(data)), 0);
+    }
+    ASSERT_EQ(emu_close(fd), 0);
+    END_HELPER;
+}
+
+// Reads the depth of the extent tree of the file at |path| from the disk.
+bool ExtentDepth(const char* path, uint32_t* depth) {
+    BEGIN_HELPER;
+    struct stat stats;
+    ASSERT_EQ(emu_stat(path, &stats), 0);
+    minfs::Superblock info;
+    ASSERT_TRUE(ReadSuperblock(&info));
+    fbl::unique_fd disk(open(MOUNT_PATH, O_RDONLY));
+    ASSERT_TRUE(disk);
+    off_t off = static_cast<off_t>(info.ino_block) * kBlockSize +
+                static_cast<off_t>(stats.st_ino) * minfs::kMinfsInodeSize;
+    minfs::Inode inode;
+    ASSERT_EQ(pread(disk.get(), &inode, sizeof(inode), off), static_cast<ssize_t>(sizeof(inode)));
+    ASSERT_NE(inode.flags & minfs::kMinfsInodeFlagExtents, 0);
+    *depth = minfs::GetExtentRoot(&inode)->depth;
+    END_HELPER;
+}
+
+uint64_t UsedData() {
+    uint64_t data_size, inodes, used_size;
+    if (emu_get_used_resources(MOUNT_PATH, &data_size, &inodes, &used_size) != 0) {
+        return 0;
+    }
+    return data_size;
+}
+
+bool test_extents_sequential(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(MkfsWithExtents());
+    const uint64_t used = UsedData();
+
+    // Contiguous writes share a single extent, so the file needs no nodes.
+    const uint32_t kBlocks = 300;
+    int fd = emu_open("::file", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    for (uint32_t i = 0; i < kBlocks; i++) {
+        ASSERT_TRUE(WriteBlock(fd, 0, i, 0));
+    }
+    ASSERT_EQ(emu_close(fd), 0);
+    ASSERT_EQ(UsedData(), used + kBlocks * kBlockSize);
+    ASSERT_TRUE(CheckFile("::file", 0, kBlocks, 0));
+
+    // Shrinking to a partial block, then growing again, reads zeros past the old end.
+    fd = emu_open("::file", O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+    const off_t kSize = 10 * kBlockSize + 100;
+    ASSERT_EQ(emu_ftruncate(fd, kSize), 0);
+    ASSERT_EQ(emu_ftruncate(fd, 2 * kSize), 0);
+    char data[kBlockSize];
+    ASSERT_EQ(emu_pread(fd, data, sizeof(data), 10 * kBlockSize),
+              static_cast<ssize_t>(sizeof(data)));
+    for (size_t i = 0; i < sizeof(data); i++) {
+        ASSERT_EQ(data[i], i < 100 ? static_cast<char>(Fill(0, 10, 0)) : 0);
+    }
+    ASSERT_EQ(emu_ftruncate(fd, 0), 0);
+    ASSERT_EQ(emu_close(fd), 0);
+    ASSERT_EQ(UsedData(), used);
+
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+bool test_extents_sparse(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(MkfsWithExtents());
+
+    // Holes aren't mapped, and read as zeros.
+    const uint32_t kBlocks[] = {3, 40, 41, 2000, 70000};
+    int fd = emu_open("::sparse", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    for (uint32_t block : kBlocks) {
+        ASSERT_TRUE(WriteBlock(fd, 1, block, 0));
+    }
+    ASSERT_EQ(emu_close(fd), 0);
+
+    for (int mount = 0; mount < 2; mount++) {
+        fd = emu_open("::sparse", O_RDWR, 0644);
+        ASSERT_GT(fd, 0);
+        char data[kBlockSize];
+        for (uint32_t block = 0; block <= 70000; block += (block < 50 ? 1 : 1000)) {
+            uint8_t expected = 0;
+            for (uint32_t written : kBlocks) {
+                if (written == block) {
+                    expected = Fill(1, block, 0);
+                }
+            }
+            ASSERT_EQ(emu_pread(fd, data, sizeof(data), block * kBlockSize),
+                      static_cast<ssize_t>(sizeof(data)));
+            ASSERT_EQ(static_cast<uint8_t>(data[0]), expected);
+            ASSERT_EQ(static_cast<uint8_t>(data[kBlockSize - 1]), expected);
+        }
+        ASSERT_EQ(emu_close(fd), 0);
+        ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    }
+
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+bool test_extents_fragmented(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(MkfsWithExtents());
+    const uint64_t used = UsedData();
+
+    // Interleaving the writes of two files gives each block of both its own extent. The
+    // root and the nodes it lists hold up to kMinfsInlineExtents * kMinfsExtentsPerNode
+    // extents, so this many need every depth of the tree.
+    const uint32_t kBlocks = 12000;
+    static_assert(kBlocks > minfs::kMinfsInlineExtents * minfs::kMinfsExtentsPerNode,
+                  "too few blocks to fill the tree");
+    int fds[2];
+    fds[0] = emu_open("::first", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fds[0], 0);
+    fds[1] = emu_open("::second", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fds[1], 0);
+    for (uint32_t i = 0; i < kBlocks; i++) {
+        ASSERT_TRUE(WriteBlock(fds[0], 0, i, 0));
+        ASSERT_TRUE(WriteBlock(fds[1], 1, i, 0));
+    }
+    ASSERT_GT(UsedData(), used + 2 * kBlocks * kBlockSize);
+    ASSERT_TRUE(CheckFile("::first", 0, kBlocks, 0));
+    ASSERT_TRUE(CheckFile("::second", 1, kBlocks, 0));
+
+    // Overwrites keep the mapping of the blocks.
+    for (uint32_t i = 0; i < kBlocks; i += 97) {
+        ASSERT_TRUE(WriteBlock(fds[0], 0, i, 1));
+        ASSERT_TRUE(WriteBlock(fds[0], 0, i, 0));
+    }
+    ASSERT_EQ(emu_close(fds[0]), 0);
+    ASSERT_EQ(emu_close(fds[1]), 0);
+
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    ASSERT_EQ(run_fsck(), 0);
+    ASSERT_TRUE(CheckFile("::first", 0, kBlocks, 0));
+    ASSERT_TRUE(CheckFile("::second", 1, kBlocks, 0));
+    uint32_t depth;
+    ASSERT_TRUE(ExtentDepth("::first", &depth));
+    ASSERT_EQ(depth, minfs::kMinfsExtentMaxDepth);
+
+    // Shrink the files in steps, merging nodes and collapsing the tree back into the inode.
+    const struct {
+        uint32_t blocks;
+        uint32_t depth;
+    } kSizes[] = {{9000, 2}, {4000, 1}, {700, 1}, {16, 1}, {15, 0}, {1, 0}, {0, 0}};
+    for (const auto& size : kSizes) {
+        for (int id = 0; id < 2; id++) {
+            const char* path = id == 0 ? "::first" : "::second";
+            int fd = emu_open(path, O_RDWR, 0644);
+            ASSERT_GT(fd, 0);
+            ASSERT_EQ(emu_ftruncate(fd, size.blocks * kBlockSize), 0);
+            ASSERT_EQ(emu_close(fd), 0);
+            ASSERT_TRUE(CheckFile(path, id, size.blocks, 0));
+        }
+        ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+        ASSERT_EQ(run_fsck(), 0);
+        ASSERT_TRUE(ExtentDepth("::second", &depth));
+        ASSERT_EQ(depth, size.depth);
+    }
+    ASSERT_EQ(UsedData(), used);
+    END_TEST;
+}
+
+bool test_extents_version(void) {
+    BEGIN_TEST;
+    // Filesystems made without extents keep the version older drivers accept.
+    ASSERT_EQ(emu_mkfs(MOUNT_PATH), 0);
+    minfs::Superblock info;
+    ASSERT_TRUE(ReadSuperblock(&info));
+    ASSERT_EQ(info.version, minfs::kMinfsVersion);
+    ASSERT_EQ(info.flags & minfs::kMinfsFlagExtents, 0);
+    ASSERT_EQ(run_fsck(), 0);
+
+    ASSERT_TRUE(MkfsWithExtents());
+    ASSERT_TRUE(ReadSuperblock(&info));
+    ASSERT_EQ(info.version, minfs::kMinfsExtentsVersion);
+    ASSERT_NE(info.flags & minfs::kMinfsFlagExtents, 0);
+    ASSERT_EQ(run_fsck(), 0);
+
+    // The extents version is only valid along with the flag.
+    info.flags &= ~minfs::kMinfsFlagExtents;
+    fbl::unique_fd disk(open(MOUNT_PATH, O_RDWR));
+    ASSERT_TRUE(disk);
+    ASSERT_EQ(pwrite(disk.get(), &info, sizeof(info), 0), static_cast<ssize_t>(sizeof(info)));
+    ASSERT_NE(run_fsck(), 0);
+    END_TEST;
+}
+
+} // namespace
+
+RUN_MINFS_TESTS(extent_tests,
+    RUN_TEST_MEDIUM(test_extents_version)
+    RUN_TEST_MEDIUM(test_extents_sequential)
+    RUN_TEST_MEDIUM(test_extents_sparse)
+    RUN_TEST_MEDIUM(test_extents_fragmented)
+)
@@ -0,0 +1,190 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Tests the replay of the minfs journal, as left behind by a crash.
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <lib/cksum.h>
+#include <minfs/bcache.h>
+#include <minfs/format.h>
+#include <minfs/journal.h>
+#include <minfs/transaction-limits.h>
+
+#include <utility>
+
+#include "util.h"
+
+namespace {
+
+using minfs::blk_t;
+
+bool OpenDisk(fbl::unique_ptr<minfs::Bcache>* out) {
+    BEGIN_HELPER;
+    fbl::unique_fd disk(open(MOUNT_PATH, O_RDWR));
+    ASSERT_TRUE(disk);
+    struct stat stats;
+    ASSERT_EQ(fstat(disk.get(), &stats), 0);
+    uint32_t blocks = static_cast<uint32_t>(stats.st_size / minfs::kMinfsBlockSize);
+    ASSERT_EQ(minfs::Bcache::Create(out, std::move(disk), blocks), ZX_OK);
+    END_HELPER;
+}
+
+bool ReadInfo(minfs::Bcache* bc, minfs::Superblock* out) {
+    BEGIN_HELPER;
+    char data[minfs::kMinfsBlockSize];
+    ASSERT_EQ(bc->Readblk(0, data), ZX_OK);
+    memcpy(out, data, sizeof(*out));
+    END_HELPER;
+}
+
+bool ReadJournalInfo(minfs::Bcache* bc, const minfs::Superblock& info,
+                     minfs::JournalInfo* out) {
+    BEGIN_HELPER;
+    blk_t start, blocks;
+    minfs::GetJournalLocation(info, &start, &blocks);
+    char data[minfs::kMinfsBlockSize];
+    ASSERT_EQ(bc->Readblk(start, data), ZX_OK);
+    memcpy(out, data, sizeof(*out));
+    ASSERT_EQ(out->magic, minfs::kJournalMagic);
+    END_HELPER;
+}
+
+// Writes an entry at |position| in the journal, which sets each of the |count| blocks at
+// |targets| to the matching byte of |fills|.  If |corrupt|, one of those blocks doesn't
+// match the checksum of the entry, as if it hadn't reached the disk.
+bool WriteEntry(minfs::Bcache* bc, const minfs::Superblock& info, blk_t position,
+                uint64_t timestamp, const blk_t* targets, const uint8_t* fills, blk_t count,
+                bool corrupt) {
+    BEGIN_HELPER;
+    blk_t start, blocks;
+    minfs::GetJournalLocation(info, &start, &blocks);
+    const blk_t entry = start + minfs::TransactionLimits::kJournalMetadataBlocks + position;
+    ASSERT_LE(entry + count + 2, start + blocks);
+
+    char data[minfs::kMinfsBlockSize];
+    memset(data, 0, sizeof(data));
+    minfs::JournalEntryHeader* header = reinterpret_cast<minfs::JournalEntryHeader*>(data);
+    header->magic = minfs::kJournalEntryHeaderMagic;
+    header->timestamp = timestamp;
+    header->num_blocks = count;
+    memcpy(header->target_blocks, targets, count * sizeof(blk_t));
+    uint32_t checksum = crc32(0, reinterpret_cast<const uint8_t*>(data), sizeof(data));
+    ASSERT_EQ(bc->Writeblk(entry, data), ZX_OK);
+
+    for (blk_t i = 0; i < count; i++) {
+        memset(data, fills[i], sizeof(data));
+        checksum = crc32(checksum, reinterpret_cast<const uint8_t*>(data), sizeof(data));
+        if (corrupt && i == count - 1) {
+            data[0] ^= 1;
+        }
+        ASSERT_EQ(bc->Writeblk(entry + 1 + i, data), ZX_OK);
+    }
+
+    memset(data, 0, sizeof(data));
+    minfs::JournalEntryCommit* commit = reinterpret_cast<minfs::JournalEntryCommit*>(data);
+    commit->magic = minfs::kJournalEntryCommitMagic;
+    commit->timestamp = timestamp;
+    commit->checksum = checksum;
+    ASSERT_EQ(bc->Writeblk(entry + 1 + count, data), ZX_OK);
+    END_HELPER;
+}
+
+bool CheckBlock(minfs::Bcache* bc, blk_t bno, uint8_t fill) {
+    BEGIN_HELPER;
+    char data[minfs::kMinfsBlockSize];
+    char expected[minfs::kMinfsBlockSize];
+    memset(expected, fill, sizeof(expected));
+    ASSERT_EQ(bc->Readblk(bno, data), ZX_OK);
+    ASSERT_EQ(memcmp(data, expected, sizeof(data)), 0);
+    END_HELPER;
+}
+
+bool test_journal_replay(void) {
+    BEGIN_TEST;
+    fbl::unique_ptr<minfs::Bcache> bc;
+    ASSERT_TRUE(OpenDisk(&bc));
+    minfs::Superblock info;
+    ASSERT_TRUE(ReadInfo(bc.get(), &info));
+    minfs::JournalInfo journal_info;
+    ASSERT_TRUE(ReadJournalInfo(bc.get(), info, &journal_info));
+    const uint64_t timestamp = journal_info.timestamp;
+
+    // Use free blocks at the end of the data region as targets.
+    const blk_t first = info.dat_block + info.block_count - 1;
+    const blk_t second = first - 1;
+
+    // Two intact entries, the second of which updates the target of the first
+    // again, followed by a torn entry.
+    const blk_t targets1[] = {first};
+    const uint8_t fills1[] = {0xa1};
+    ASSERT_TRUE(WriteEntry(bc.get(), info, 0, timestamp, targets1, fills1, 1, false));
+    const blk_t targets2[] = {first, second};
+    const uint8_t fills2[] = {0xb2, 0xb3};
+    ASSERT_TRUE(WriteEntry(bc.get(), info, 3, timestamp + 1, targets2, fills2, 2, false));
+    const blk_t targets3[] = {second};
+    const uint8_t fills3[] = {0xc4};
+    ASSERT_TRUE(WriteEntry(bc.get(), info, 7, timestamp + 2, targets3, fills3, 1, true));
+
+    ASSERT_EQ(minfs::ReplayJournal(bc.get(), info), ZX_OK);
+    ASSERT_TRUE(CheckBlock(bc.get(), first, 0xb2));
+    ASSERT_TRUE(CheckBlock(bc.get(), second, 0xb3));
+
+    // The replayed entries are retired, and the torn one is expected next.
+    ASSERT_TRUE(ReadJournalInfo(bc.get(), info, &journal_info));
+    ASSERT_EQ(journal_info.start_block, 0);
+    ASSERT_EQ(journal_info.timestamp, timestamp + 2);
+    ASSERT_EQ(journal_info.checksum, minfs::JournalInfoChecksum(journal_info));
+
+    // Replaying again doesn't write anything.
+    char zero[minfs::kMinfsBlockSize] = {};
+    ASSERT_EQ(bc->Writeblk(first, zero), ZX_OK);
+    ASSERT_EQ(minfs::ReplayJournal(bc.get(), info), ZX_OK);
+    ASSERT_TRUE(CheckBlock(bc.get(), first, 0));
+
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+bool test_journal_stale_entry(void) {
+    BEGIN_TEST;
+    fbl::unique_ptr<minfs::Bcache> bc;
+    ASSERT_TRUE(OpenDisk(&bc));
+    minfs::Superblock info;
+    ASSERT_TRUE(ReadInfo(bc.get(), &info));
+    minfs::JournalInfo journal_info;
+    ASSERT_TRUE(ReadJournalInfo(bc.get(), info, &journal_info));
+    const uint64_t timestamp = journal_info.timestamp;
+
+    const blk_t first = info.dat_block + info.block_count - 1;
+    char zero[minfs::kMinfsBlockSize] = {};
+    ASSERT_EQ(bc->Writeblk(first, zero), ZX_OK);
+
+    // An entry written before the journal was last retired is never replayed.
+    const blk_t targets[] = {first};
+    const uint8_t fills[] = {0xd5};
+    ASSERT_TRUE(WriteEntry(bc.get(), info, 0, timestamp - 1, targets, fills, 1, false));
+    ASSERT_EQ(minfs::ReplayJournal(bc.get(), info), ZX_OK);
+    ASSERT_TRUE(CheckBlock(bc.get(), first, 0));
+
+    // Entries are replayed on mount.
+    ASSERT_TRUE(WriteEntry(bc.get(), info, 0, timestamp, targets, fills, 1, false));
+    bc.reset();
+    ASSERT_EQ(emu_mount(MOUNT_PATH), 0);
+    ASSERT_TRUE(OpenDisk(&bc));
+    ASSERT_TRUE(CheckBlock(bc.get(), first, 0xd5));
+    ASSERT_TRUE(ReadJournalInfo(bc.get(), info, &journal_info));
+    ASSERT_EQ(journal_info.timestamp, timestamp + 1);
+
+    ASSERT_EQ(run_fsck(), 0);
+    END_TEST;
+}
+
+} // namespace
+
+RUN_MINFS_TESTS(journal_tests,
+    RUN_TEST_MEDIUM(test_journal_replay)
+    RUN_TEST_MEDIUM(test_journal_stale_entry)
+)
@@ -6,6 +6,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -556,6 +557,62 @@ bool TestUnlinkFail(void) {
     END_TEST;
 }
 
+// Puts the ramdisk to sleep at various points of a burst of metadata updates, as if the device
+// had lost power, and verifies that the filesystem is consistent once its journal is replayed,
+// and that everything synced before the cut is still there.
+bool TestJournalCrash(void) {
+    BEGIN_TEST;
+
+    if (use_real_disk) {
+        fprintf(stderr, "Ramdisk required; skipping test\n");
+        return true;
+    }
+
+    constexpr uint64_t kDiskBlocksPerMinfsBlock = minfs::kMinfsBlockSize / TEST_BLOCK_SIZE_DEFAULT;
+    constexpr uint64_t kCuts[] = {0, 1, 2, 3, 5, 8, 13, 21, 34, 55};
+
+    for (uint64_t cut : kCuts) {
+        fbl::unique_fd mnt_fd(open(kMountPath, O_RDONLY | O_DIRECTORY));
+        ASSERT_TRUE(mnt_fd);
+
+        char synced[32];
+        snprintf(synced, sizeof(synced), "synced_%" PRIu64, cut);
+        ASSERT_EQ(mkdirat(mnt_fd.get(), synced, 0755), 0);
+        char path[64];
+        snprintf(path, sizeof(path), "%s/file", synced);
+        fbl::unique_fd fd(openat(mnt_fd.get(), path, O_CREAT | O_RDWR | O_EXCL, 0644));
+        ASSERT_TRUE(fd);
+        ASSERT_EQ(close(fd.release()), 0);
+        ASSERT_EQ(syncfs(mnt_fd.get()), 0);
+
+        ASSERT_EQ(ramdisk_sleep_after(test_ramdisk, cut * kDiskBlocksPerMinfsBlock), ZX_OK);
+
+        // Once the ramdisk is asleep, the filesystem turns read only, and the following updates
+        // start failing.
+        for (unsigned i = 0; i < 32; i++) {
+            char name[64];
+            snprintf(name, sizeof(name), "cut_%" PRIu64 "_%u", cut, i);
+            fd.reset(openat(mnt_fd.get(), name, O_CREAT | O_RDWR, 0644));
+            char renamed[64];
+            snprintf(renamed, sizeof(renamed), "%s/%s", synced, name);
+            renameat(mnt_fd.get(), name, mnt_fd.get(), renamed);
+        }
+        fd.reset();
+        syncfs(mnt_fd.get());
+        mnt_fd.reset();
+
+        ASSERT_EQ(ramdisk_wake(test_ramdisk), ZX_OK);
+        ASSERT_TRUE(check_remount());
+
+        mnt_fd.reset(open(kMountPath, O_RDONLY | O_DIRECTORY));
+        ASSERT_TRUE(mnt_fd);
+        struct stat s;
+        ASSERT_EQ(fstatat(mnt_fd.get(), path, &s, 0), 0);
+    }
+
+    END_TEST;
+}
+
 bool GetAllocatedBlocks(uint64_t* out_allocated_blocks) {
     BEGIN_HELPER;
     fuchsia_io_FilesystemInfo info;
@@ -647,6 +704,7 @@ bool TestGetAllocatedRegions() {
 RUN_MINFS_TESTS_NORMAL(FsMinfsTests,
     RUN_TEST_LARGE(TestFullOperations)
     RUN_TEST_MEDIUM(TestUnlinkFail)
+    RUN_TEST_MEDIUM(TestJournalCrash)
     RUN_TEST_MEDIUM(TestGetAllocatedRegions)
 )
 
@@ -654,6 +712,7 @@ RUN_MINFS_TESTS_FVM(FsMinfsFvmTests,
     RUN_TEST_MEDIUM(TestQueryInfo)
     RUN_TEST_MEDIUM(TestMetrics)
     RUN_TEST_MEDIUM(TestUnlinkFail)
+    RUN_TEST_MEDIUM(TestJournalCrash)
 )
 
 // Running with an isolated FVM to avoid interactions with the other integration tests.
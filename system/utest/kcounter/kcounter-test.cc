@@ -101,6 +101,26 @@ TEST(Counters, Basic) {
       EXPECT_GT(value, 0);
     }
   }
+
+  // The buckets of a histogram are adjacent, and this test made syscalls.
+  const counters::Descriptor kHistogramFirst = {"syscall.latency_ns.00",
+                                                counters::Type::kHistogram};
+  auto first = find(kHistogramFirst);
+  ASSERT_NOT_NULL(first, "expected histogram not found");
+  const size_t first_idx = first - desc->begin();
+  ASSERT_LE(first_idx + counters::kHistogramBuckets, desc->num_counters());
+  int64_t total = 0;
+  for (size_t bucket = 0; bucket < counters::kHistogramBuckets; ++bucket) {
+    const auto& entry = desc->descriptor_table[first_idx + bucket];
+    char name[sizeof(entry.name)];
+    snprintf(name, sizeof(name), "syscall.latency_ns.%02zu", bucket);
+    EXPECT_STR_EQ(entry.name, name, "histogram bucket out of order");
+    EXPECT_EQ(entry.type, counters::Type::kHistogram, "histogram bucket has wrong type");
+    for (uint64_t cpu = 0; cpu < desc->max_cpus; ++cpu) {
+      total += arena[(cpu * desc->num_counters()) + first_idx + bucket];
+    }
+  }
+  EXPECT_GT(total, 0);
 }
 
 }  // anonymous namespace
@@ -0,0 +1,53 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
+#include <lib/zx/channel.h>
+#include <perftest/perftest.h>
+
+namespace {
+
+// Measures the cost of sending a message of the given size over a channel
+// and reading it back out on the same thread.  This is dominated by the
+// kernel's per-message allocation and copying costs.
+bool ChannelWriteReadTest(perftest::RepeatState* state, uint32_t message_size) {
+    state->DeclareStep("write");
+    state->DeclareStep("read");
+    state->SetBytesProcessedPerRun(message_size);
+
+    zx::channel channel1;
+    zx::channel channel2;
+    ZX_ASSERT(zx::channel::create(0, &channel1, &channel2) == ZX_OK);
+    fbl::unique_ptr<uint8_t[]> buffer(new uint8_t[message_size]);
+    memset(buffer.get(), 0, message_size);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(channel1.write(0, buffer.get(), message_size, nullptr, 0) == ZX_OK);
+        state->NextStep();
+        uint32_t actual_bytes;
+        ZX_ASSERT(channel2.read(0, buffer.get(), nullptr, message_size, 0, &actual_bytes,
+                                nullptr) == ZX_OK);
+        ZX_ASSERT(actual_bytes == message_size);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const uint32_t kMessageSizesBytes[] = {
+        64,
+        1024,
+        32 * 1024,
+        64 * 1024,
+    };
+    for (auto size : kMessageSizesBytes) {
+        auto name = fbl::StringPrintf("Channel/WriteRead/%ubytes", size);
+        perftest::RegisterTest(name.c_str(), ChannelWriteReadTest, size);
+    }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
@@ -0,0 +1,128 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <string.h>
+
+#include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
+#include <fidl/test/perftest/coding/c/fidl.h>
+#include <lib/fidl/coding.h>
+#include <lib/fidl/internal.h>
+#include <lib/zx/event.h>
+#include <perftest/perftest.h>
+
+namespace {
+
+// Returns a copy of |type| without its specialized coders, which the runtime
+// codes by walking the coding table.
+fidl_type_t WalkerType(const fidl_type_t& type) {
+    ZX_ASSERT(type.type_tag == fidl::kFidlTypeStruct);
+    ZX_ASSERT(type.coded_struct.specialized_coders != nullptr);
+    return fidl_type_t(fidl::FidlCodedStruct(type.coded_struct.fields,
+                                             type.coded_struct.field_count,
+                                             type.coded_struct.size, type.coded_struct.name));
+}
+
+struct MessageSpec {
+    const fidl_type_t* type;
+    uint32_t num_entries;
+    size_t entries_offset;
+};
+
+// Fills in a message of |spec| where every other entry carries a handle, and
+// returns the number of handles in it.
+uint32_t FillMessage(const MessageSpec& spec, uint8_t* bytes, const zx::event& event) {
+    auto entries = reinterpret_cast<fidl_test_perftest_coding_Entry*>(bytes + spec.entries_offset);
+    uint32_t num_handles = 0;
+    for (uint32_t i = 0; i < spec.num_entries; i++) {
+        entries[i].kind = fidl_test_perftest_coding_Kind_WRITE;
+        entries[i].vmo = i % 2 == 0 ? event.get() : ZX_HANDLE_INVALID;
+        entries[i].offset = i * 4096;
+        entries[i].flags = 1;
+        if (entries[i].vmo != ZX_HANDLE_INVALID) {
+            num_handles++;
+        }
+    }
+    return num_handles;
+}
+
+// Measures encoding a message in place and decoding it again, using the
+// specialized coders that fidlc generated for it or, if |walker| is set, the
+// coding table.
+bool EncodeDecodeTest(perftest::RepeatState* state, MessageSpec spec, bool walker) {
+    state->DeclareStep("encode");
+    state->DeclareStep("decode");
+
+    fidl_type_t walker_type = WalkerType(*spec.type);
+    const fidl_type_t* type = walker ? &walker_type : spec.type;
+    uint32_t num_bytes = spec.type->coded_struct.size;
+    state->SetBytesProcessedPerRun(num_bytes);
+
+    zx::event event;
+    ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+    FIDL_ALIGNDECL uint8_t bytes[ZX_CHANNEL_MAX_MSG_BYTES] = {};
+    uint32_t num_handles = FillMessage(spec, bytes, event);
+    zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+
+    while (state->KeepRunning()) {
+        uint32_t actual_handles;
+        const char* error;
+        ZX_ASSERT(fidl_encode(type, bytes, num_bytes, handles, ZX_CHANNEL_MAX_MSG_HANDLES,
+                              &actual_handles, &error) == ZX_OK);
+        ZX_ASSERT(actual_handles == num_handles);
+        state->NextStep();
+        ZX_ASSERT(fidl_decode(type, bytes, num_bytes, handles, actual_handles, &error) == ZX_OK);
+    }
+    return true;
+}
+
+// Measures validating an encoded message.
+bool ValidateTest(perftest::RepeatState* state, MessageSpec spec, bool walker) {
+    fidl_type_t walker_type = WalkerType(*spec.type);
+    const fidl_type_t* type = walker ? &walker_type : spec.type;
+    uint32_t num_bytes = spec.type->coded_struct.size;
+    state->SetBytesProcessedPerRun(num_bytes);
+
+    zx::event event;
+    ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+    FIDL_ALIGNDECL uint8_t bytes[ZX_CHANNEL_MAX_MSG_BYTES] = {};
+    FillMessage(spec, bytes, event);
+    zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+    uint32_t num_handles;
+    const char* error;
+    ZX_ASSERT(fidl_encode(type, bytes, num_bytes, handles, ZX_CHANNEL_MAX_MSG_HANDLES,
+                          &num_handles, &error) == ZX_OK);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(fidl_validate(type, bytes, num_bytes, num_handles, &error) == ZX_OK);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const struct {
+        const char* name;
+        MessageSpec spec;
+    } kMessages[] = {
+        {"One",
+         {&fidl_test_perftest_coding_CodingOneRequestTable, 1,
+          offsetof(fidl_test_perftest_coding_CodingOneRequest, entry)}},
+        {"Many",
+         {&fidl_test_perftest_coding_CodingManyRequestTable, 64,
+          offsetof(fidl_test_perftest_coding_CodingManyRequest, entries)}},
+    };
+    for (const auto& message : kMessages) {
+        for (bool walker : {false, true}) {
+            const char* coder = walker ? "Walker" : "Specialized";
+            auto name = fbl::StringPrintf("Fidl/EncodeDecode/%s/%s", message.name, coder);
+            perftest::RegisterTest(name.c_str(), EncodeDecodeTest, message.spec, walker);
+            name = fbl::StringPrintf("Fidl/Validate/%s/%s", message.name, coder);
+            perftest::RegisterTest(name.c_str(), ValidateTest, message.spec, walker);
+        }
+    }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
@@ -0,0 +1,110 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <digest/digest.h>
+#include <digest/merkle-tree.h>
+#include <digest/thread-pool.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
+#include <perftest/perftest.h>
+
+namespace {
+
+using digest::Digest;
+using digest::MerkleTree;
+
+// Allocates |size| bytes of data and the Merkle tree for it.  Returns false
+// if the memory isn't available, which can be the case for the largest sizes
+// on small devices.
+bool AllocateBuffers(size_t size, fbl::unique_ptr<uint8_t[]>* data,
+                     fbl::unique_ptr<uint8_t[]>* tree) {
+    fbl::AllocChecker ac;
+    data->reset(new (&ac) uint8_t[size]);
+    if (!ac.check()) {
+        return false;
+    }
+    tree->reset(new (&ac) uint8_t[MerkleTree::GetTreeLength(size)]);
+    if (!ac.check()) {
+        return false;
+    }
+    memset(data->get(), 0x5a, size);
+    return true;
+}
+
+// Test performance of creating the Merkle tree for a blob of the given size,
+// hashing the nodes on the threads of |pool| if not null.
+bool CreateTest(perftest::RepeatState* state, size_t size, digest::ThreadPool* pool) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<uint8_t[]> data;
+    fbl::unique_ptr<uint8_t[]> tree;
+    if (!AllocateBuffers(size, &data, &tree)) {
+        printf("Skipping test: cannot allocate %zu bytes\n", size);
+        return true;
+    }
+    size_t tree_len = MerkleTree::GetTreeLength(size);
+    Digest digest;
+
+    while (state->KeepRunning()) {
+        if (MerkleTree::Create(data.get(), size, tree.get(), tree_len, &digest, pool) != ZX_OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Test performance of verifying the whole of a blob of the given size,
+// hashing the nodes on the threads of |pool| if not null.
+bool VerifyTest(perftest::RepeatState* state, size_t size, digest::ThreadPool* pool) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<uint8_t[]> data;
+    fbl::unique_ptr<uint8_t[]> tree;
+    if (!AllocateBuffers(size, &data, &tree)) {
+        printf("Skipping test: cannot allocate %zu bytes\n", size);
+        return true;
+    }
+    size_t tree_len = MerkleTree::GetTreeLength(size);
+    Digest digest;
+    if (MerkleTree::Create(data.get(), size, tree.get(), tree_len, &digest) != ZX_OK) {
+        return false;
+    }
+
+    while (state->KeepRunning()) {
+        if (MerkleTree::Verify(data.get(), size, tree.get(), tree_len, 0, size, digest,
+                               pool) != ZX_OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RegisterTests() {
+    // Shared by all the tests, so that its threads are only created once.
+    static digest::ThreadPool pool;
+
+    static const size_t kSizesBytes[] = {
+        1 << 20,
+        16 << 20,
+        256 << 20,
+        1 << 30,
+    };
+    for (auto size : kSizesBytes) {
+        auto name = fbl::StringPrintf("MerkleTree/Create/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), CreateTest, size, nullptr);
+        name = fbl::StringPrintf("MerkleTree/CreateParallel/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), CreateTest, size, &pool);
+        name = fbl::StringPrintf("MerkleTree/Verify/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), VerifyTest, size, nullptr);
+        name = fbl::StringPrintf("MerkleTree/VerifyParallel/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), VerifyTest, size, &pool);
+    }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
@@ -0,0 +1,68 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/string_printf.h>
+#include <lib/zx/port.h>
+#include <perftest/perftest.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+namespace {
+
+constexpr size_t kMaxBatchSize = 64;
+
+// Measures the cost of queueing |batch_size| packets on a port and reading
+// them back out one zx_port_wait() call at a time.
+bool PortWaitTest(perftest::RepeatState* state, size_t batch_size) {
+    zx::port port;
+    ZX_ASSERT(zx::port::create(0, &port) == ZX_OK);
+    const zx_port_packet_t packet = {};
+
+    while (state->KeepRunning()) {
+        for (size_t i = 0; i < batch_size; ++i) {
+            ZX_ASSERT(port.queue(&packet) == ZX_OK);
+        }
+        for (size_t i = 0; i < batch_size; ++i) {
+            zx_port_packet_t out;
+            ZX_ASSERT(port.wait(zx::time::infinite(), &out) == ZX_OK);
+        }
+    }
+    return true;
+}
+
+// Same as PortWaitTest, but reads the packets back with zx_port_wait_many().
+bool PortWaitManyTest(perftest::RepeatState* state, size_t batch_size) {
+    zx::port port;
+    ZX_ASSERT(zx::port::create(0, &port) == ZX_OK);
+    const zx_port_packet_t packet = {};
+
+    while (state->KeepRunning()) {
+        for (size_t i = 0; i < batch_size; ++i) {
+            ZX_ASSERT(port.queue(&packet) == ZX_OK);
+        }
+        zx_port_packet_t out[kMaxBatchSize];
+        size_t actual;
+        ZX_ASSERT(zx_port_wait_many(port.get(), ZX_TIME_INFINITE, out, batch_size,
+                                    &actual) == ZX_OK);
+        ZX_ASSERT(actual == batch_size);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const size_t kBatchSizes[] = {
+        1,
+        8,
+        kMaxBatchSize,
+    };
+    for (auto batch_size : kBatchSizes) {
+        auto name = fbl::StringPrintf("Port/Wait/%zupackets", batch_size);
+        perftest::RegisterTest(name.c_str(), PortWaitTest, batch_size);
+        name = fbl::StringPrintf("Port/WaitMany/%zupackets", batch_size);
+        perftest::RegisterTest(name.c_str(), PortWaitManyTest, batch_size);
+    }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
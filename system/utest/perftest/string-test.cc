@@ -0,0 +1,128 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
+#include <perftest/perftest.h>
+
+namespace {
+
+// Test performance of strlen() on a string of the given length.
+bool StrlenTest(perftest::RepeatState* state, size_t size) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<char[]> str(new char[size + 1]);
+    memset(str.get(), 'a', size);
+    str[size] = '\0';
+
+    while (state->KeepRunning()) {
+        perftest::DoNotOptimize(strlen(str.get()));
+        // Stop the compiler from hoisting the strlen() call out of the loop.
+        perftest::DoNotOptimize(str.get());
+    }
+    return true;
+}
+
+// Test performance of strchr() finding the last character of a string of
+// the given length.
+bool StrchrTest(perftest::RepeatState* state, size_t size) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<char[]> str(new char[size + 1]);
+    memset(str.get(), 'a', size - 1);
+    str[size - 1] = 'b';
+    str[size] = '\0';
+
+    while (state->KeepRunning()) {
+        perftest::DoNotOptimize(strchr(str.get(), 'b'));
+        perftest::DoNotOptimize(str.get());
+    }
+    return true;
+}
+
+// Test performance of memchr() finding the last byte of a block of the
+// given size.
+bool MemchrTest(perftest::RepeatState* state, size_t size) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<char[]> buf(new char[size]);
+    memset(buf.get(), 'a', size - 1);
+    buf[size - 1] = 'b';
+
+    while (state->KeepRunning()) {
+        perftest::DoNotOptimize(memchr(buf.get(), 'b', size));
+        perftest::DoNotOptimize(buf.get());
+    }
+    return true;
+}
+
+// Test performance of memcmp() on two blocks of the given size which only
+// differ in their last byte.
+bool MemcmpTest(perftest::RepeatState* state, size_t size) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<char[]> buf1(new char[size]);
+    fbl::unique_ptr<char[]> buf2(new char[size]);
+    memset(buf1.get(), 'a', size);
+    memset(buf2.get(), 'a', size);
+    buf2[size - 1] = 'b';
+
+    while (state->KeepRunning()) {
+        perftest::DoNotOptimize(memcmp(buf1.get(), buf2.get(), size));
+        perftest::DoNotOptimize(buf1.get());
+        perftest::DoNotOptimize(buf2.get());
+    }
+    return true;
+}
+
+// Test performance of strcmp() on two strings of the given length which
+// only differ in their last character.  The second string is offset by
+// one byte so that the strings are not equally aligned.
+bool StrcmpTest(perftest::RepeatState* state, size_t size) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<char[]> str1(new char[size + 1]);
+    fbl::unique_ptr<char[]> buf2(new char[size + 2]);
+    char* str2 = buf2.get() + 1;
+    memset(str1.get(), 'a', size);
+    memset(str2, 'a', size);
+    str1[size] = '\0';
+    str2[size - 1] = 'b';
+    str2[size] = '\0';
+
+    while (state->KeepRunning()) {
+        perftest::DoNotOptimize(strcmp(str1.get(), str2));
+        perftest::DoNotOptimize(str1.get());
+        perftest::DoNotOptimize(str2);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const size_t kSizesBytes[] = {
+        8,
+        64,
+        512,
+        4096,
+        65536,
+        1048576,
+    };
+    for (auto size : kSizesBytes) {
+        auto name = fbl::StringPrintf("String/Strlen/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), StrlenTest, size);
+        name = fbl::StringPrintf("String/Strchr/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), StrchrTest, size);
+        name = fbl::StringPrintf("String/Memchr/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), MemchrTest, size);
+        name = fbl::StringPrintf("String/Memcmp/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), MemcmpTest, size);
+        name = fbl::StringPrintf("String/Strcmp/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), StrcmpTest, size);
+    }
+}
+PERFTEST_CTOR(RegisterTests)
+
+}  // namespace
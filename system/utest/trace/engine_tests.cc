@@ -837,6 +837,50 @@ bool TestShutdownWhenFull() {
     END_TRACE_TEST;
 }
 
+bool TestPerThreadAllocationMode() {
+    BEGIN_TRACE_TEST;
+
+    EXPECT_EQ(trace_engine_set_allocation_mode(TRACE_ALLOCATION_MODE_PER_THREAD), ZX_OK);
+    fixture_initialize_and_start_tracing();
+
+    // The allocation mode can't change while the engine is running.
+    EXPECT_EQ(trace_engine_set_allocation_mode(TRACE_ALLOCATION_MODE_SHARED),
+              ZX_ERR_BAD_STATE);
+
+    constexpr size_t kNumThreads = 4;
+    constexpr size_t kNumRecordsPerThread = 1000;
+    thrd_t threads[kNumThreads];
+    for (auto& thread : threads) {
+        int result = thrd_create(&thread, [](void*) {
+            for (size_t i = 0; i < kNumRecordsPerThread; ++i) {
+                TRACE_INSTANT("+enabled", "name", TRACE_SCOPE_GLOBAL,
+                              "k1", TA_UINT64(i));
+            }
+            return 0;
+        }, nullptr);
+        ASSERT_EQ(result, thrd_success);
+    }
+    for (auto& thread : threads) {
+        int result = thrd_join(thread, nullptr);
+        ASSERT_EQ(result, thrd_success);
+    }
+
+    fixture_stop_and_terminate_tracing();
+    EXPECT_EQ(trace_engine_set_allocation_mode(TRACE_ALLOCATION_MODE_SHARED), ZX_OK);
+
+    // The padding between each thread's records must be skipped.
+    fbl::Vector<trace::Record> records;
+    ASSERT_TRUE(fixture_read_records(&records));
+    size_t num_events = 0;
+    for (const auto& record : records) {
+        if (record.type() == trace::RecordType::kEvent)
+            ++num_events;
+    }
+    EXPECT_EQ(num_events, kNumThreads * kNumRecordsPerThread);
+
+    END_TRACE_TEST;
+}
+
 // NOTE: The functions for writing trace records are exercised by other trace tests.
 
 } // namespace
@@ -863,4 +907,5 @@ RUN_TEST(TestEventWithInlineEverything)
 RUN_TEST(TestCircularMode)
 RUN_TEST(TestStreamingMode)
 RUN_TEST(TestShutdownWhenFull)
+RUN_TEST(TestPerThreadAllocationMode)
 END_TEST_CASE(engine_tests)
@@ -0,0 +1,15 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#ifndef __ASSEMBLER__
+
+#include <stddef.h>
+
+static inline size_t __get_hwcap(void) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,32 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+// Bits in __hwcap, which the dynamic linker sets at startup.
+#define HWCAP_X86_AVX2 (1 << 0)
+
+#ifndef __ASSEMBLER__
+
+#include <cpuid.h>
+#include <stddef.h>
+
+static inline size_t __get_hwcap(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+        !(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+        return 0;
+
+    // AVX2 can only be used if the OS saves the SSE and AVX state.
+    unsigned int xcr0, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0 & 0x6) != 0x6)
+        return 0;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return 0;
+    return (ebx & bit_AVX2) ? HWCAP_X86_AVX2 : 0;
+}
+
+#endif
@@ -1,5 +1,6 @@
 #define _GNU_SOURCE
 #include "dynlink.h"
+#include "hwcap.h"
 #include "relr.h"
 #include "libc.h"
 #include "asan_impl.h"
@@ -1699,6 +1700,10 @@ static dl_start_return_t __dls3(void* start_arg);
 
 __NO_SAFESTACK NO_ASAN __attribute__((__visibility__("hidden")))
 dl_start_return_t __dls2(void* start_arg, void* vdso_map) {
+    // The string functions choose their implementation based on this,
+    // so it's set before anything else.  Until then they use the baseline.
+    __hwcap = __get_hwcap();
+
     ldso.l_map.l_addr = (uintptr_t)__ehdr_start;
 
     Ehdr* ehdr = (void*)ldso.l_map.l_addr;
@@ -0,0 +1,32 @@
+// Copyright 2019 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include "asm.h"
+#include "hwcap.h"
+
+// DISPATCH_ENTRY(name) starts the SSE2 version of |name|, which every x86-64
+// CPU supports.  When the dynamic linker has found AVX2 support, the entry
+// jumps to __name_avx2 instead.
+//
+// Userboot and hermetic modules (HIDDEN) have no dynamic linker and no
+// writable data, so they always use the SSE2 version.  Files must only
+// define the AVX2 versions #ifndef HIDDEN.
+#ifdef HIDDEN
+#define DISPATCH_ENTRY(name) ENTRY(name)
+#else
+.hidden __hwcap
+#define DISPATCH_ENTRY(name) \
+    ENTRY(name); \
+    testb $HWCAP_X86_AVX2, __hwcap(%rip); \
+    jnz __##name##_avx2
+#endif
+
+// Broadcast the low byte of |reg32| to every byte of |xmm|.
+#define SSE2_BROADCAST_BYTE(reg32, xmm) \
+    movd reg32, xmm; \
+    punpcklbw xmm, xmm; \
+    punpcklwd xmm, xmm; \
+    pshufd $0, xmm, xmm